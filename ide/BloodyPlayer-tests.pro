@@ -10,7 +10,8 @@ CONFIG -= app_bundle
 SOURCES += \
     ../tests/ModelTests/AudioServiceTests/AudioServiceTests.cpp \
     ../tests/main.cpp \
-    ../tests/ModelTests/TrackTests/TrackTests.cpp
+    ../tests/ModelTests/TrackTests/TrackTests.cpp \
+    ../tests/ModelTests/TrackStoreTests/TrackStoreTests.cpp
 
 LIBS += -L"$$_PRO_FILE_PWD_/../tests" -lBloodyPlayer
 win32:
@@ -29,10 +29,33 @@ SOURCES += \
         ../ext/qcustomplot/qcustomplot.cpp \
         ../src/Controller/controller.cpp \
         ../src/Model/AudioService/audioservice.cpp \
+        ../src/Model/CacheFolder/cachefolder.cpp \
+        ../src/Model/CommandQueue/commandqueue.cpp \
+        ../src/Model/ConvolutionReverb/convolutionreverb.cpp \
+        ../src/Model/Equalizer/equalizer.cpp \
+        ../src/Model/FFT/fft.cpp \
+        ../src/Model/FXProfileMonitor/fxprofilemonitor.cpp \
+        ../src/Model/LoudnessMeter/loudnessmeter.cpp \
+        ../src/Model/MP3Parser/mp3parser.cpp \
+        ../src/Model/MappedFile/mappedfile.cpp \
+        ../src/Model/MappedFileSystem/mappedfilesystem.cpp \
+        ../src/Model/MasterAnalyzer/masteranalyzer.cpp \
+        ../src/Model/MeterBuffer/meterbuffer.cpp \
+        ../src/Model/PositionSnapshot/positionsnapshot.cpp \
+        ../src/Model/PreloadCache/preloadcache.cpp \
+        ../src/Model/SeekTable/seektable.cpp \
+        ../src/Model/ShuffleBag/shufflebag.cpp \
+        ../src/Model/ThreadGroup/threadgroup.cpp \
+        ../src/Model/TimeStretch/timestretch.cpp \
         ../src/Model/Track/track.cpp \
+        ../src/Model/TrackExporter/trackexporter.cpp \
+        ../src/Model/TrackHistory/trackhistory.cpp \
+        ../src/Model/TrackLoudness/trackloudness.cpp \
+        ../src/Model/TrackStore/trackstore.cpp \
         ../src/View/AboutWindow/aboutwindow.cpp \
         ../src/View/FXWindow/fxwindow.cpp \
         ../src/View/SearchWindow/searchwindow.cpp \
+        ../src/View/SpectrumWidget/spectrumwidget.cpp \
         ../src/View/TrackList/tracklist.cpp \
         ../src/View/TrackWidget/trackwidget.cpp \
         ../src/View/VSTWindow/vstwindow.cpp \
@@ -44,11 +67,34 @@ HEADERS += \
         ../ext/qcustomplot/qcustomplot.h \
         ../src/Controller/controller.h \
         ../src/Model/AudioService/audioservice.h \
+        ../src/Model/CacheFolder/cachefolder.h \
+        ../src/Model/CommandQueue/commandqueue.h \
+        ../src/Model/ConvolutionReverb/convolutionreverb.h \
+        ../src/Model/Equalizer/equalizer.h \
+        ../src/Model/FFT/fft.h \
+        ../src/Model/FXProfileMonitor/fxprofilemonitor.h \
+        ../src/Model/LoudnessMeter/loudnessmeter.h \
+        ../src/Model/MP3Parser/mp3parser.h \
+        ../src/Model/MappedFile/mappedfile.h \
+        ../src/Model/MappedFileSystem/mappedfilesystem.h \
+        ../src/Model/MasterAnalyzer/masteranalyzer.h \
+        ../src/Model/MeterBuffer/meterbuffer.h \
+        ../src/Model/PositionSnapshot/positionsnapshot.h \
+        ../src/Model/PreloadCache/preloadcache.h \
+        ../src/Model/SeekTable/seektable.h \
+        ../src/Model/ShuffleBag/shufflebag.h \
+        ../src/Model/ThreadGroup/threadgroup.h \
+        ../src/Model/TimeStretch/timestretch.h \
         ../src/Model/Track/track.h \
+        ../src/Model/TrackExporter/trackexporter.h \
+        ../src/Model/TrackHistory/trackhistory.h \
+        ../src/Model/TrackLoudness/trackloudness.h \
+        ../src/Model/TrackStore/trackstore.h \
         ../src/View/AboutWindow/aboutwindow.h \
         ../src/View/FXWindow/fxwindow.h \
         ../src/View/MainWindow/mainwindow.h \
         ../src/View/SearchWindow/searchwindow.h \
+        ../src/View/SpectrumWidget/spectrumwidget.h \
         ../src/View/TrackList/tracklist.h \
         ../src/View/TrackWidget/trackwidget.h \
         ../src/View/VSTWindow/vstwindow.h \
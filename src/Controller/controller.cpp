@@ -10,9 +10,14 @@
 
 // Custom
 #include "Model/AudioService/audioservice.h"
+#include "globalparams.h"
 
 Controller::Controller(MainWindow* pMainWindow)
 {
+    // Commands that change the playback are executed in the audio-control thread (see AudioService::enqueueCommand())
+    // so the GUI thread never waits for FMOD or for the tracklist mutex.
+    // Sliders use enqueueLatestCommand(): while their command waits in the queue it's replaced by the new value.
+
     pAudioService = new AudioService(pMainWindow);
 
     bRepeatTrack = false;
@@ -31,22 +36,42 @@ void Controller::addTracks(const std::vector<std::wstring>& paths)
 
 void Controller::playTrack(size_t iTrackIndex)
 {
-    pAudioService->playTrack(iTrackIndex);
+    pAudioService->enqueueCommand( [=] { pAudioService->playTrack(iTrackIndex); } );
 }
 
 void Controller::pauseTrack()
 {
-    pAudioService->pauseTrack();
+    pAudioService->enqueueCommand( [=] { pAudioService->pauseTrack(); } );
 }
 
 void Controller::setTrackPos(unsigned int graphPos)
 {
-    pAudioService->setTrackPos(graphPos);
+    pAudioService->enqueueCommand( [=] { pAudioService->setTrackPos(graphPos); } );
 }
 
 void Controller::setRepeatPoint(unsigned int graphPos)
 {
-    pAudioService->setRepeatPoint(graphPos);
+    pAudioService->enqueueCommand( [=] { pAudioService->setRepeatPoint(graphPos); } );
+}
+
+void Controller::setCrossfade(unsigned int iLengthInMS, char cCurve)
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->setCrossfade(iLengthInMS, cCurve); } );
+}
+
+void Controller::setRepeatSectionSeamFade(unsigned int iLengthInMS)
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->setRepeatSectionSeamFade(iLengthInMS); } );
+}
+
+void Controller::setPreloadBudget(unsigned int iBudgetInMB)
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->setPreloadBudget(iBudgetInMB); } );
+}
+
+void Controller::setLoudnessNormalization(char cMode)
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->setLoudnessNormalization(cMode); } );
 }
 
 std::string Controller::getBloodyVersion()
@@ -56,43 +81,44 @@ std::string Controller::getBloodyVersion()
 
 void Controller::stopTrack()
 {
-    pAudioService->stopTrack();
+    pAudioService->enqueueCommand( [=] { pAudioService->stopTrack(); } );
 }
 
 void Controller::nextTrack()
 {
-    if (bRandomTrack) pAudioService->nextTrack(false, true);
-    else              pAudioService->nextTrack();
+    bool bRandomNextTrack = bRandomTrack;
+
+    pAudioService->enqueueCommand( [=] { pAudioService->nextTrack(false, bRandomNextTrack); } );
 }
 
 void Controller::prevTrack()
 {
-    pAudioService->prevTrack();
+    pAudioService->enqueueCommand( [=] { pAudioService->prevTrack(); } );
 }
 
 void Controller::setVolume(float fNewVolume)
 {
-    pAudioService->setVolume(fNewVolume);
+    pAudioService->enqueueLatestCommand( COMMAND_SLOT_VOLUME, [=] { pAudioService->setVolume(fNewVolume); } );
 }
 
 void Controller::removeTrack(size_t iTrackIndex)
 {
-    pAudioService->removeTrack(iTrackIndex);
+    pAudioService->enqueueCommand( [=] { pAudioService->removeTrack(iTrackIndex); } );
 }
 
 void Controller::clearPlaylist()
 {
-    pAudioService->clearPlaylist();
+    pAudioService->enqueueCommand( [=] { pAudioService->clearPlaylist(); } );
 }
 
 void Controller::moveDown(size_t iTrackIndex)
 {
-    pAudioService->moveDown(iTrackIndex);
+    pAudioService->enqueueCommand( [=] { pAudioService->moveDown(iTrackIndex); } );
 }
 
 void Controller::moveUp(size_t iTrackIndex)
 {
-    pAudioService->moveUp(iTrackIndex);
+    pAudioService->enqueueCommand( [=] { pAudioService->moveUp(iTrackIndex); } );
 }
 
 void Controller::openTracklist(std::wstring pathToTracklist, bool bClearCurrent)
@@ -104,52 +130,68 @@ void Controller::openTracklist(std::wstring pathToTracklist, bool bClearCurrent)
 
 void Controller::saveTracklist(std::wstring pathToTracklist)
 {
-    pAudioService->saveTracklist(pathToTracklist);
+    pAudioService->enqueueCommand( [=] { pAudioService->saveTracklist(pathToTracklist); } );
 }
 
 void Controller::searchFindPrev()
 {
-    pAudioService->searchFindPrev ();
+    pAudioService->enqueueCommand( [=] { pAudioService->searchFindPrev(); } );
 }
 
 void Controller::searchFindNext()
 {
-    pAudioService->searchFindNext ();
+    pAudioService->enqueueCommand( [=] { pAudioService->searchFindNext(); } );
 }
 
 void Controller::searchTextSet(const std::wstring &sKeyword)
 {
-    pAudioService->searchTextSet (sKeyword);
+    // The keyword is copied into the command.
+    pAudioService->enqueueCommand( [=] { pAudioService->searchTextSet(sKeyword); } );
 }
 
 void Controller::setPan(float fPan)
 {
-    pAudioService->setPan(fPan);
+    pAudioService->enqueueLatestCommand( COMMAND_SLOT_PAN, [=] { pAudioService->setPan(fPan); } );
 }
 
 void Controller::setPitch(float fPitch)
 {
-    pAudioService->setPitch(fPitch);
+    pAudioService->enqueueLatestCommand( COMMAND_SLOT_PITCH, [=] { pAudioService->setPitch(fPitch); } );
 }
 
 void Controller::setSpeedByPitch(float fSpeed)
 {
-    pAudioService->setSpeedByPitch(fSpeed);
+    pAudioService->enqueueLatestCommand( COMMAND_SLOT_SPEED_BY_PITCH, [=] { pAudioService->setSpeedByPitch(fSpeed); } );
 }
 
 void Controller::setSpeedByTime(float fSpeed)
 {
-    pAudioService->setSpeedByTime(fSpeed);
+    pAudioService->enqueueLatestCommand( COMMAND_SLOT_SPEED_BY_TIME, [=] { pAudioService->setSpeedByTime(fSpeed); } );
 }
 
 void Controller::setReverbVolume(float fVolume)
 {
-    pAudioService->setReverbVolume(fVolume);
+    pAudioService->enqueueLatestCommand( COMMAND_SLOT_REVERB_VOLUME, [=] { pAudioService->setReverbVolume(fVolume); } );
 }
 
 void Controller::setEchoVolume(float fEchoVolume)
 {
-    pAudioService->setEchoVolume(fEchoVolume);
+    pAudioService->enqueueLatestCommand( COMMAND_SLOT_ECHO_VOLUME, [=] { pAudioService->setEchoVolume(fEchoVolume); } );
+}
+
+void Controller::setEqualizerBandGain(int iBand, float fGainInDB)
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->setEqualizerBandGain(iBand, fGainInDB); } );
+}
+
+void Controller::loadImpulseResponse(const std::wstring& sPathToFile)
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->loadImpulseResponse(sPathToFile); } );
+}
+
+void Controller::unloadImpulseResponse()
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->unloadImpulseResponse(); } );
 }
 
 #if _WIN32
@@ -166,12 +208,27 @@ void Controller::unloadVSTPlugin()
 
 void Controller::systemUpdate()
 {
-    pAudioService->systemUpdate();
+    pAudioService->enqueueCommand( [=] { pAudioService->systemUpdate(); } );
+}
+
+void Controller::setFXProfile(char cProfile)
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->setFXProfile(cProfile); } );
+}
+
+void Controller::exportTrack(size_t iTrackIndex, const std::wstring& sOutputPath, unsigned int iFromMS, unsigned int iToMS)
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->exportTrack(iTrackIndex, sOutputPath, iFromMS, iToMS); } );
+}
+
+void Controller::exportTracks(const std::vector<size_t>& vTrackIndices, const std::wstring& sOutputFolder)
+{
+    pAudioService->enqueueCommand( [=] { pAudioService->exportTracks(vTrackIndices, sOutputFolder); } );
 }
 
 void Controller::repeatTrack()
 {
-    pAudioService->repeatTrack();
+    pAudioService->enqueueCommand( [=] { pAudioService->repeatTrack(); } );
 
     bRepeatTrack = !bRepeatTrack;
     if (bRepeatTrack && bRandomTrack) bRandomTrack = false;
@@ -179,7 +236,7 @@ void Controller::repeatTrack()
 
 void Controller::randomNextTrack()
 {
-    pAudioService->randomNextTrack();
+    pAudioService->enqueueCommand( [=] { pAudioService->randomNextTrack(); } );
 
     bRandomTrack = !bRandomTrack;
     if (bRandomTrack && bRepeatTrack) bRepeatTrack = false;
@@ -190,6 +247,41 @@ size_t Controller::getPlaingTrackIndex(bool& bSomeTrackIsPlaying)
     return pAudioService->getPlayingTrackIndex(bSomeTrackIsPlaying);
 }
 
+bool Controller::getPlaybackPosition(PlaybackPosition* pPosition)
+{
+    return pAudioService->getPlaybackPosition(pPosition);
+}
+
+bool Controller::getMeterFrame(MeterFrame* pFrame)
+{
+    return pAudioService->getMeterFrame(pFrame);
+}
+
+PreloadStats Controller::getPreloadStats()
+{
+    return pAudioService->getPreloadStats();
+}
+
+CommandQueueStats Controller::getCommandQueueStats()
+{
+    return pAudioService->getCommandQueueStats();
+}
+
+char Controller::getFXProfile()
+{
+    return pAudioService->getFXProfile();
+}
+
+bool Controller::isFXProfileAuto()
+{
+    return pAudioService->isFXProfileAuto();
+}
+
+FXProfileStats Controller::getFXProfileStats(char cProfile)
+{
+    return pAudioService->getFXProfileStats(cProfile);
+}
+
 
 
 
@@ -12,6 +12,13 @@
 #include <vector>
 #include <string>
 
+// Custom
+#include "Model/PreloadCache/preloadcache.h"
+#include "Model/CommandQueue/commandqueue.h"
+#include "Model/PositionSnapshot/positionsnapshot.h"
+#include "Model/MeterBuffer/meterbuffer.h"
+#include "Model/FXProfileMonitor/fxprofilemonitor.h"
+
 
 
 
@@ -75,11 +82,21 @@ public:
         void    setSpeedByTime   (float    fSpeed);
         void    setReverbVolume  (float    fVolume);
         void    setEchoVolume    (float    fEchoVolume);
+        void    setEqualizerBandGain (int  iBand,  float fGainInDB);
+        void    loadImpulseResponse  (const std::wstring& sPathToFile);
+        void    unloadImpulseResponse();
 #if _WIN32
         void    loadVSTPlugin    (wchar_t* pPathToDll);
         void    unloadVSTPlugin  ();
 #endif
         void    systemUpdate     ();
+        void    setFXProfile     (char     cProfile);
+
+
+    // Export
+
+        void    exportTrack      (size_t iTrackIndex,  const std::wstring& sOutputPath,  unsigned int iFromMS,  unsigned int iToMS);
+        void    exportTracks     (const std::vector<size_t>& vTrackIndices,  const std::wstring& sOutputFolder);
 
 
     // Set
@@ -88,12 +105,23 @@ public:
         void    setVolume        (float fNewVolume);
         void    setTrackPos      (unsigned int graphPos);
         void    setRepeatPoint   (unsigned int graphPos);
+        void    setCrossfade     (unsigned int iLengthInMS,  char cCurve);
+        void    setRepeatSectionSeamFade (unsigned int iLengthInMS);
+        void    setPreloadBudget (unsigned int iBudgetInMB);
+        void    setLoudnessNormalization (char cMode);
 
 
     // Get
 
         std::string  getBloodyVersion     ();
         size_t       getPlaingTrackIndex  (bool& bSomeTrackIsPlaying);
+        bool         getPlaybackPosition  (PlaybackPosition* pPosition);
+        bool         getMeterFrame        (MeterFrame* pFrame);
+        PreloadStats getPreloadStats      ();
+        CommandQueueStats getCommandQueueStats ();
+        char         getFXProfile         ();
+        bool         isFXProfileAuto      ();
+        FXProfileStats getFXProfileStats  (char cProfile);
 
 
 
@@ -16,6 +16,11 @@
 // Custom
 #include "View/MainWindow/mainwindow.h"
 #include "Model/Track/track.h"
+#include "Model/MappedFileSystem/mappedfilesystem.h"
+#include "Model/Equalizer/equalizer.h"
+#include "Model/TimeStretch/timestretch.h"
+#include "Model/ConvolutionReverb/convolutionreverb.h"
+#include "Model/MasterAnalyzer/masteranalyzer.h"
 #include "globalparams.h"
 #include "../ext/FMOD/inc/fmod_errors.h"
 
@@ -33,15 +38,19 @@
 #endif
 
 
-AudioService::AudioService(MainWindow* pMainWindow)
+AudioService::AudioService(MainWindow* pMainWindow) : AudioService(pMainWindow, OUTPUT_MODE_DEVICE, "")
 {
+}
+
+AudioService::AudioService(MainWindow* pMainWindow, char cOutputMode, const std::string& sOutputFilePath) : fxProfileMonitor(DEFAULT_FX_PROFILE), tracksHistory(MAX_HISTORY_SIZE)
+{
+    // 'cOutputMode' - OUTPUT_MODE_..., 'sOutputFilePath' - the file of OUTPUT_MODE_WAVWRITER_NRT.
+
     sBloodyVersion       = BLOODY_PLAYER_VERSION;
 
 
     this ->pMainWindow   = pMainWindow;
     pSystem              = nullptr;
-    pRndGen              = new std::mt19937_64( std::random_device{}() );
-    iCurrentlyDrawingTrackIndex = new size_t(0);
 
 
     bMonitorTracks      = false;
@@ -51,25 +60,80 @@ AudioService::AudioService(MainWindow* pMainWindow)
     bDrawing            = false;
     bCurrentTrackPaused = false;
     bFMODStarted        = false;
+    bPrepareSeekTables  = true;
+    bAnalyzeLoudness    = true;
+    bExportTracks       = true;
+    iExportsInProgress  = 0;
+    bMonitorWakeUp      = false;
+    iMonitorWakeUps     = 0;
+    iPublishedPlayingTrack = 0;
+    vLatestCommands.resize(COMMAND_SLOT_COUNT);
 
 
     cRepeatSectionState = 0;
+    iRepeatSeamFadeInMS = DEFAULT_REPEAT_SEAM_FADE_MS;
+    iRepeatSeamDSPClock = 0;
+
+
+    // Loudness normalization
+    cLoudnessNormalization  = DEFAULT_LOUDNESS_NORMALIZATION;
+
+
+    // Preload
+    pPreloadCache           = new PreloadCache( static_cast<size_t>(DEFAULT_PRELOAD_BUDGET_MB) * 1024 * 1024 );
+    bPreloadTracks          = true;
+    iFirstAudioStartPosInMS = 0;
+    bWaitingForFirstAudio   = false;
+    bFirstAudioPreloaded    = false;
+
+
+    // Crossfade
+    iCrossfadeInMS  = DEFAULT_CROSSFADE_MS;
+    iScheduledStartDSPClock = 0;
+    cCrossfadeCurve = DEFAULT_CROSSFADE_CURVE;
 
 
     // FX
-    pPitch        = nullptr;
-    pPitchForTime = nullptr;
-    pReverb       = nullptr;
-    pEcho         = nullptr;
-    pVST          = nullptr;
+    pPitch             = nullptr;
+    pTimeStretch       = nullptr;
+    pReverb            = nullptr;
+    pEcho              = nullptr;
+    pEqualizer         = nullptr;
+    pConvolutionReverb = nullptr;
+    pVST               = nullptr;
+    pAnalyzer          = nullptr;
+    pMasterAnalyzer    = nullptr;
+
+    iImpulseResponseRequest = 0;
+
+
+    // Output
+    this ->cOutputMode     = cOutputMode;
+    this ->sOutputFilePath = sOutputFilePath;
+    iDSPBufferLength       = 0;
+    iOutputRate            = 0;
+    iDSPBufferCount        = 0;
+    iVirtualClock          = 0;
 
 
     fCurrentVolume = DEFAULT_VOLUME;
-    iCurrentlyPlayingTrackIndex = 0;
+    fCurrentPan    = 0.0f;
     fCurrentSpeedByPitch = 1.0f;
     fCurrentSpeedByTime  = 1.0f;
+    fCurrentReverbVolume = -80.0f;
+    fCurrentPitch        = 1.0f;
+    fCurrentEchoVolume   = -80.0f;
+    vLazyFXBypassClocks.resize(LAZY_FX_COUNT, 0);
 
     FMODinit();
+
+    // In the non-realtime modes the work of this thread is done in advanceTime().
+    if (bFMODStarted && (cOutputMode == OUTPUT_MODE_DEVICE))
+    {
+        // This thread lives as long as the AudioService and sleeps while nothing is playing (and there are no commands).
+        bMonitorTracks = true;
+        monitorThread  = std::thread(&AudioService::monitorTrack, this);
+    }
 }
 
 bool AudioService::FMODinit()
@@ -87,7 +151,63 @@ bool AudioService::FMODinit()
         return true;
     }
 
-    result = pSystem->init(MAX_CHANNELS, FMOD_INIT_NORMAL, nullptr);
+    // All files are read from the shared memory mappings.
+    if ( MappedFileSystem::attach(pSystem) == false )
+    {
+        pMainWindow->showMessageBox( true, "AudioService::AudioService::FMOD::System::setFileSystem() failed. Files will be read by FMOD." );
+    }
+
+    if (cOutputMode != OUTPUT_MODE_DEVICE)
+    {
+        // Non-realtime: the output is mixed only when System::update() is called (see advanceTime()).
+
+        result = pSystem->setOutput( (cOutputMode == OUTPUT_MODE_WAVWRITER_NRT) ? FMOD_OUTPUTTYPE_WAVWRITER_NRT : FMOD_OUTPUTTYPE_NOSOUND_NRT );
+        if (result)
+        {
+            pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::setOutput() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+            pMainWindow->showMessageBox( false, "The audio system has not been started and the application will be closed.");
+            // Look main.cpp (isSystemReady() function)
+            // app will be closed.
+            pMainWindow->markAnError();
+            return true;
+        }
+    }
+
+    // The wav writer takes the path of the output file.
+    void* pExtraDriverData = nullptr;
+    if ( (cOutputMode == OUTPUT_MODE_WAVWRITER_NRT) && (sOutputFilePath.empty() == false) )
+    {
+        pExtraDriverData = const_cast<char*>(sOutputFilePath.c_str());
+    }
+
+    // DSP buffer and resampler of the FX profile (FMOD takes them only before System::init()).
+
+    const unsigned int       vBufferLengths[] = FX_PROFILE_BUFFER_LENGTHS;
+    const int                vBufferCounts[]  = FX_PROFILE_BUFFER_COUNTS;
+    const FMOD_DSP_RESAMPLER vResamplers[]    = FX_PROFILE_RESAMPLERS;
+
+    result = pSystem->setDSPBufferSize(vBufferLengths[DEFAULT_FX_PROFILE], vBufferCounts[DEFAULT_FX_PROFILE]);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::setDSPBufferSize() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+    }
+
+    FMOD_ADVANCEDSETTINGS advancedSettings = {};
+    advancedSettings.cbSize = sizeof(FMOD_ADVANCEDSETTINGS);
+
+    pSystem->getAdvancedSettings(&advancedSettings);
+    advancedSettings.resamplerMethod = vResamplers[DEFAULT_FX_PROFILE];
+
+    result = pSystem->setAdvancedSettings(&advancedSettings);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::setAdvancedSettings() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+    }
+
+    // Without the mixer thread there is nobody to feed the streams, they are decoded in System::update() too.
+    FMOD_INITFLAGS initFlags = (cOutputMode == OUTPUT_MODE_DEVICE) ? FMOD_INIT_NORMAL : FMOD_INIT_STREAM_FROM_UPDATE;
+
+    result = pSystem->init(MAX_CHANNELS, initFlags, pExtraDriverData);
     if (result)
     {
         pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::init() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
@@ -117,72 +237,62 @@ bool AudioService::FMODinit()
     pSystem->getMasterChannelGroup(&pMaster);
 
 
-    result = pSystem->createDSPByType(FMOD_DSP_TYPE_PITCHSHIFT, &pPitch);
-    if (result)
-    {
-        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::createDSPByType() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
-        pPitch = nullptr;
-    }
-    else
-    {
-        pPitch->setParameterFloat(FMOD_DSP_PITCHSHIFT_FFTSIZE, 4096);
-        pPitch->setBypass(true);
-        pMaster->addDSP(0, pPitch);
-    }
-
+    // Pitch, time stretch, reverb and echo are created when they are turned on (see applyLazyFX()).
 
 
-    result = pSystem->createDSPByType(FMOD_DSP_TYPE_PITCHSHIFT, &pPitchForTime);
-    if (result)
+    // Flat bands are skipped by the equalizer itself, so it's never bypassed (gain changes are smoothed).
+    if ( Equalizer::createDSP(pSystem, &pEqualizer) == false )
     {
-        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::createDSPByType() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
-        pPitchForTime = nullptr;
+        pMainWindow->showMessageBox( true, "AudioService::AudioService::FMOD::System::createDSP() failed. The equalizer will not be available." );
+        pEqualizer = nullptr;
     }
     else
     {
-        pPitchForTime->setParameterFloat(FMOD_DSP_PITCHSHIFT_FFTSIZE, 4096);
-        pPitchForTime->setBypass(true);
-        pMaster->addDSP(1, pPitchForTime);
+        insertIntoChain(pEqualizer);
     }
 
 
-    result = pSystem->createDSPByType(FMOD_DSP_TYPE_SFXREVERB, &pReverb);
-    if (result)
+
+    // Bypassed until the impulse response is loaded (see loadImpulseResponse()).
+    if ( ConvolutionReverb::createDSP(pSystem, &pConvolutionReverb) == false )
     {
-        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::createDSPByType() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
-        pReverb = nullptr;
+        pMainWindow->showMessageBox( true, "AudioService::AudioService::FMOD::System::createDSP() failed. The convolution reverb will not be available." );
+        pConvolutionReverb = nullptr;
     }
     else
     {
-        pMaster->addDSP(3, pReverb);
-        pReverb->setParameterFloat(FMOD_DSP_SFXREVERB_WETLEVEL, -80.0f);
-        pReverb->setBypass(true);
+        pConvolutionReverb->setParameterFloat(0, -80.0f);
+        pConvolutionReverb->setBypass(true);
+        insertIntoChain(pConvolutionReverb);
     }
 
 
 
-    result = pSystem->createDSPByType(FMOD_DSP_TYPE_ECHO, &pEcho);
-    if (result)
+    // On the head, so it sees the output of all FX.
+    if ( MasterAnalyzer::createDSP(pSystem, &pAnalyzer) == false )
     {
-        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::createDSPByType() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
-        pEcho = nullptr;
+        pMainWindow->showMessageBox( true, "AudioService::AudioService::FMOD::System::createDSP() failed. The meters will not be available." );
+        pAnalyzer = nullptr;
     }
     else
     {
-        pMaster->addDSP(4, pEcho);
-        pEcho->setParameterFloat(FMOD_DSP_ECHO_DELAY, 1000);
-        pEcho->setParameterFloat(FMOD_DSP_ECHO_WETLEVEL, -80.0f);
-        pEcho->setBypass(true);
+        insertIntoChain(pAnalyzer);
+        pMasterAnalyzer = MasterAnalyzer::getAnalyzer(pAnalyzer);
     }
 
     pMaster->setPan(0.0f);
 
 
+    // Samples mixed by one System::update() in the non-realtime modes.
+    pSystem->getDSPBufferSize(&iDSPBufferLength, &iDSPBufferCount);
+    pSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr);
+
+
     bFMODStarted = true;
     return false;
 }
 
-bool AudioService::addTrack(const std::wstring& sFilePath)
+bool AudioService::addTrack(const std::wstring& sFilePath, std::vector<TrackHandle>* pAddedTracks)
 {
     Track* pNewTrack = new Track(sFilePath, getTrackName(sFilePath), pMainWindow, pSystem);
     if ( !pNewTrack->setupTrack() )
@@ -191,6 +301,14 @@ bool AudioService::addTrack(const std::wstring& sFilePath)
         return true;
     }
 
+    pNewTrack->setEndCallback(&AudioService::onTrackEnded, this);
+
+
+    // Calculate the bitrate here (in the import thread).
+    // The track is not in the tracklist yet so we don't need to lock anything.
+    int iBitrate = 0;
+    pNewTrack->getBitRate(&iBitrate);
+
     std::wstring wPathStr(sFilePath);
 
 
@@ -241,30 +359,43 @@ bool AudioService::addTrack(const std::wstring& sFilePath)
     if (iSeconds < 10) trackTime += "0";
     trackTime += std::to_string(iSeconds);
 
-    pNewTrack->setSpeedByFreq(fCurrentSpeedByPitch);
-    pNewTrack->setSpeedByTime(fCurrentSpeedByTime);
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    // addTracks() removes the tracks over the limit but other imports could add their tracks meanwhile.
+    if (tracks.size() >= MAX_CHANNELS)
+    {
+        delete pNewTrack;
+        return true;
+    }
 
-    std::lock_guard<std::mutex> lock(mtxThreadLoadAddTrack);
+    // The next track changes only if the last track is playing (the new one goes after it).
+    if ( (bRandomNextTrack == false) && (tracks.size() > 0) && (getCurrentTrackIndex() == tracks.size() - 1) )
+    {
+        cancelTransitions();
+    }
 
 
-    vTracks.push_back(pNewTrack);
 
-    pMainWindow->addNewTrack(trackName, trackInfo, trackTime);
+    // The drawing thread resolves its handle under 'mtxGetCurrentDrawingIndex'.
+    mtxGetCurrentDrawingIndex.lock();
+    TrackHandle newTrack = tracks.add(pNewTrack);
+    mtxGetCurrentDrawingIndex.unlock();
 
-    if (vTracks.size() == 1)
+    if (tracks.get(playingTrack) == nullptr)
     {
-        bMonitorTracks = true;
-        std::thread monitor(&AudioService::monitorTrack, this);
-        monitor.detach();
-    }
+        // First track in the tracklist.
+        playingTrack = newTrack;
 
-    FMOD_RESULT result = pSystem->update();
-    if (result)
-    {
-        pMainWindow->showMessageBox( true, std::string("AudioService::addTrack::FMOD::System::update() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
-        return true;
+        publishPlayingTrack();
     }
 
+    shuffleBag.addTrack(newTrack);
+    pAddedTracks->push_back(newTrack);
+
+    pMainWindow->addNewTrack(trackName, trackInfo, trackTime);
+
+    // FMOD::System::update() is called by the audio-control thread (see monitorTrack()).
+
     return false;
 }
 
@@ -296,13 +427,15 @@ std::wstring AudioService::getTrackName(const std::wstring& pFilePath)
 void AudioService::addTracks(std::vector<std::wstring> paths)
 {
     // This function adds tracks by using private 'threadAddTracks()' and 'addTrack()' functions.
+    // 'mtxTracksVec' is locked only when the new track is added to the tracklist (see addTrack())
+    // so the playback can be controlled while we are adding tracks.
 
     mtxTracksVec.lock();
 
     // Remove some of the tracks if we exceed MAX_CHANNELS (i.e. max amount of tracks)
-    if (paths.size() + vTracks.size() > MAX_CHANNELS)
+    if (paths.size() + tracks.size() > MAX_CHANNELS)
     {
-        size_t removeCount = paths.size() + vTracks.size() - MAX_CHANNELS;
+        size_t removeCount = paths.size() + tracks.size() - MAX_CHANNELS;
 
         for (size_t i = 0; i < removeCount; i++)
         {
@@ -312,6 +445,8 @@ void AudioService::addTracks(std::vector<std::wstring> paths)
         pMainWindow->showMessageBox(true, "Maximum tracks exceeded. " + std::to_string(removeCount) + " tracks have not been added.");
     }
 
+    mtxTracksVec.unlock();
+
 
 
     if (paths .size() >= MIN_TRACKS_TO_SHOW_LOADING)
@@ -328,6 +463,8 @@ void AudioService::addTracks(std::vector<std::wstring> paths)
     std::vector<bool*> threadsDoneFlags;
     int* allCount = new int(0);
 
+    std::vector<TrackHandle> vAddedTracks;
+
 
     if (paths.size() >= threads * 2)
     {
@@ -348,7 +485,7 @@ void AudioService::addTracks(std::vector<std::wstring> paths)
                 iStop = i;
 
                 threadsDoneFlags.push_back(new bool(false));
-                std::thread t (&AudioService::threadAddTracks, this, paths, iStart, iStop, threadsDoneFlags.back(), allCount, static_cast<int>(paths.size()));
+                std::thread t (&AudioService::threadAddTracks, this, paths, iStart, iStop, threadsDoneFlags.back(), allCount, static_cast<int>(paths.size()), &vAddedTracks);
                 t.detach();
 
                 iCurrentPos = 0;
@@ -360,7 +497,7 @@ void AudioService::addTracks(std::vector<std::wstring> paths)
             iStop = paths.size() - 1;
 
             threadsDoneFlags.push_back(new bool(false));
-            std::thread t (&AudioService::threadAddTracks, this, paths, iStart, iStop, threadsDoneFlags.back(), allCount, static_cast<int>(paths.size()));
+            std::thread t (&AudioService::threadAddTracks, this, paths, iStart, iStop, threadsDoneFlags.back(), allCount, static_cast<int>(paths.size()), &vAddedTracks);
             t.detach();
         }
     }
@@ -370,13 +507,15 @@ void AudioService::addTracks(std::vector<std::wstring> paths)
 
         for (size_t i = 0; i < paths.size(); i++)
         {
-            addTrack(paths[i]);
+            addTrack(paths[i], &vAddedTracks);
 
             if (paths .size() >= MIN_TRACKS_TO_SHOW_LOADING)
             {
                 pMainWindow->setProgress( static_cast<int>(100.0f * ( i + 1 ) / paths.size()) );
             }
         }
+
+        showTracksBitrate(vAddedTracks);
     }
 
     if (paths.size() >= threads * 2)
@@ -415,40 +554,58 @@ void AudioService::addTracks(std::vector<std::wstring> paths)
     }
 
     // Wait until MainWindow added all tracks
+    size_t iTracksCount = 0;
     do
     {
         std::this_thread::sleep_for( std::chrono::milliseconds(WAIT_FOR_UI_IN_MS) );
-    } while ( pMainWindow->getTracksCount() != vTracks.size() );
+
+        mtxTracksVec.lock();
+        iTracksCount = tracks.size();
+        mtxTracksVec.unlock();
+    } while ( pMainWindow->getTracksCount() != iTracksCount );
 
     pMainWindow->showAllTracks();
 
+    seekTableThreads.start( std::bind(&AudioService::threadPrepareSeekTables, this, vAddedTracks) );
+
+    if (cLoudnessNormalization != LOUDNESS_NORMALIZATION_OFF)
+    {
+        loudnessThreads.start( std::bind(&AudioService::threadAnalyzeLoudness, this, vAddedTracks) );
+    }
+
     // Wait to show all tracks
     std::this_thread::sleep_for( std::chrono::milliseconds(500) );
 
-    pMainWindow->setFocusOnTrack( vTracks.size() - 1 );
-
-    mtxTracksVec.unlock();
+    if (iTracksCount > 0)
+    {
+        pMainWindow->setFocusOnTrack( iTracksCount - 1 );
+    }
 }
 
 void AudioService::playTrack(size_t iTrackIndex, bool bDontLockMutex)
 {
     // This function starts track playback.
 
+    std::chrono::steady_clock::time_point tpRequested = std::chrono::steady_clock::now();
+
     if (!bDontLockMutex) mtxTracksVec.lock();
 
+    // The user started other track (the scheduled track is adopted in switchToOtherTrack()).
+    cancelTransitions();
+
 
-    size_t iOldPlayingTrackIndex = iCurrentlyPlayingTrackIndex;
-    bool   bFirstTrack           = false;
+    TrackHandle oldPlayingTrack = playingTrack;
 
-    if ( iTrackIndex < vTracks.size() )
+    if ( iTrackIndex < tracks.size() )
     {
-        if ( ((bCurrentTrackPaused == false) && (bIsSomeTrackPlaying == false)) || (iTrackIndex != iCurrentlyPlayingTrackIndex) )
+        TrackHandle track  = tracks.getHandle(iTrackIndex);
+        Track*      pTrack = tracks.getTrack(iTrackIndex);
+
+        if ( ((bCurrentTrackPaused == false) && (bIsSomeTrackPlaying == false)) || (track != playingTrack) )
         {
             // If I'm correct then (bCurrentTrackPaused == false) && (bIsSomeTrackPlaying == false) should happend only when
             // we play first track after player's started.
 
-            bFirstTrack = true;
-
             if (bDrawing)
             {
                 // Some thread is drawing on the oscillogram, stop it.
@@ -460,10 +617,15 @@ void AudioService::playTrack(size_t iTrackIndex, bool bDontLockMutex)
                 mtxDrawGraph.unlock();
             }
 
+            if (drawGraphThread.joinable())
+            {
+                drawGraphThread.join();
+            }
+
             // Draw new oscillogram.
-            *iCurrentlyDrawingTrackIndex = iTrackIndex;
-            std::thread drawGraphThread(&AudioService::drawGraph, this, iCurrentlyDrawingTrackIndex);
-            drawGraphThread.detach();
+            // 'bDrawing' is set here (not in the thread) so the thread can be stopped before it has started.
+            bDrawing        = true;
+            drawGraphThread = std::thread(&AudioService::drawGraph, this, track);
         }
 
         if (bDontLockMutex == false)
@@ -473,82 +635,116 @@ void AudioService::playTrack(size_t iTrackIndex, bool bDontLockMutex)
 
             if ( isCurrentTrackEnded() )
             {
-                vTracks[iCurrentlyPlayingTrackIndex]->reCreateTrack(fCurrentVolume);
+                tracks.get(playingTrack)->reCreateTrack(fCurrentVolume);
             }
         }
 
         // Stop currently playing track
         if (bIsSomeTrackPlaying)
         {
-            if (iTrackIndex != iCurrentlyPlayingTrackIndex)
+            if (track != playingTrack)
             {
-                vTracks[iCurrentlyPlayingTrackIndex]->stopTrack();
-                pMainWindow->removePlayingOnTrack(iCurrentlyPlayingTrackIndex);
+                tracks.get(playingTrack)->stopTrack();
+                pMainWindow->removePlayingOnTrack(getCurrentTrackIndex());
             }
         }
-        else if (bCurrentTrackPaused && (iTrackIndex != iCurrentlyPlayingTrackIndex))
+        else if (bCurrentTrackPaused && (track != playingTrack))
         {
-            vTracks[iCurrentlyPlayingTrackIndex]->stopTrack();
-            pMainWindow->removePlayingOnTrack(iCurrentlyPlayingTrackIndex);
+            tracks.get(playingTrack)->stopTrack();
+            pMainWindow->removePlayingOnTrack(getCurrentTrackIndex());
         }
 
 
         bool         bOldTrackWasPaused = bCurrentTrackPaused;
-        unsigned int iTrackOldPos       = vTracks[iCurrentlyPlayingTrackIndex]->getPositionInMS();
+        unsigned int iTrackOldPos       = tracks.get(playingTrack)->getPositionInMS();
+
+        // Track start (not unpause and not the scheduled track that is already playing), see checkFirstAudio().
+        bool         bNewStart          = ( (track != playingTrack) || ((bIsSomeTrackPlaying == false) && (bCurrentTrackPaused == false)) )
+                                          && (pTrack->isScheduled() == false);
+        bool         bPreloaded         = pTrack->isPreloaded();
 
 
+        pTrack->setLoudnessGain( getLoudnessGain(pTrack) );
+
+        // Only the current track gets the new speed in setSpeedByPitch() / setSpeedByTime().
+        pTrack->setSpeedByFreq(fCurrentSpeedByPitch);
+        pTrack->setSpeedByTime(fCurrentSpeedByTime);
+
         // Play track
-        if ( vTracks[iTrackIndex]->playTrack(fCurrentVolume) )
+        if ( pTrack->playTrack(fCurrentVolume) )
         {
             bIsSomeTrackPlaying  = true;
             bCurrentTrackPaused  = false;
 
 
-            iCurrentlyPlayingTrackIndex  = iTrackIndex;
-
-
+            playingTrack         = track;
 
-            // Add to history.
 
-            vTracksHistory.push_back(vTracks[iTrackIndex]);
 
-            if (vTracksHistory.size() > MAX_HISTORY_SIZE)
+            if ( pTrack->needsAccurateSound() )
             {
-                vTracksHistory.erase( vTracksHistory.begin() );
+                // VBR MP3, open it with FMOD_ACCURATETIME in the background for exact seeking.
+                seekTableThreads.start( std::bind(&AudioService::threadOpenAccurateSound, this, track,
+                                                  std::wstring(pTrack->getFilePath())) );
             }
 
 
 
-            if ( (cRepeatSectionState != 0) && (iCurrentlyPlayingTrackIndex != iOldPlayingTrackIndex) )
+            // Add to history.
+
+            tracksHistory.push(track);
+            shuffleBag.markPlayed(track);
+
+
+
+            if ( (cRepeatSectionState != 0) && (playingTrack != oldPlayingTrack) )
             {
                 pMainWindow->eraseRepeatSection();
 
                 cRepeatSectionState = 0;
             }
-            else if ( (cRepeatSectionState != 0) && (iCurrentlyPlayingTrackIndex == iOldPlayingTrackIndex) )
+            else if ( (cRepeatSectionState != 0) && (playingTrack == oldPlayingTrack) )
             {
                 if (bOldTrackWasPaused)
                 {
-                    if ( vTracks[iTrackIndex]->getPositionInMS() >= iFirstRepeatTimePos )
+                    if ( pTrack->getPositionInMS() >= iFirstRepeatTimePos )
                     {
-                        vTracks[iTrackIndex]->setPositionInMS(iTrackOldPos);
+                        pTrack->setPositionInMS(iTrackOldPos);
                     }
                     else
                     {
-                        vTracks[iTrackIndex]->setPositionInMS(iFirstRepeatTimePos);
+                        pTrack->setPositionInMS(iFirstRepeatTimePos);
                     }
                 }
                 else
                 {
-                    vTracks[iTrackIndex]->setPositionInMS(iFirstRepeatTimePos);
+                    pTrack->setPositionInMS(iFirstRepeatTimePos);
+                }
+
+                if (cRepeatSectionState == 2)
+                {
+                    // The channel could be recreated.
+                    pTrack->setLoopSection(iFirstRepeatTimePos, iSecondRepeatTimePos);
                 }
             }
+
+
+
+            if (bNewStart)
+            {
+                tpPlayRequested         = tpRequested;
+                iFirstAudioStartPosInMS = pTrack->getPositionInMS();
+                bFirstAudioPreloaded    = bPreloaded;
+                bWaitingForFirstAudio   = true;
+            }
+
+            preloadNextTrack();
         }
         else
         {
             bIsSomeTrackPlaying = false;
             bCurrentTrackPaused = false;
-            iCurrentlyPlayingTrackIndex = 0;
+            playingTrack        = tracks.getHandle(0);
             pMainWindow->showMessageBox(false, "Something went wrong and we could not play the track.");
         }
 
@@ -558,7 +754,11 @@ void AudioService::playTrack(size_t iTrackIndex, bool bDontLockMutex)
             pMainWindow->showMessageBox( true, std::string("AudioService::playTrack::FMOD::System::update() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
         }
 
-        pMainWindow->setPlayingOnTrack(iCurrentlyPlayingTrackIndex);
+        pMainWindow->setPlayingOnTrack(getCurrentTrackIndex());
+
+        publishPlayingTrack();
+
+        wakeUpMonitor();
     }
     else
     {
@@ -566,60 +766,42 @@ void AudioService::playTrack(size_t iTrackIndex, bool bDontLockMutex)
     }
 
     if (!bDontLockMutex) mtxTracksVec.unlock();
-
-
-
-    if ( (bFirstTrack) )
-    {
-        if ( (vTracks[iCurrentlyPlayingTrackIndex] ->isBitrateCalculated() == false)
-             &&
-             (vTracks[iCurrentlyPlayingTrackIndex] ->getFormat() == "MP3") )
-        {
-            std::thread tCalcBitrate(&AudioService::calcBitrate, this);
-            tCalcBitrate .detach();
-        }
-    }
 }
 
 void AudioService::setTrackPos(unsigned int graphPos)
 {
     mtxTracksVec.lock();
 
-    if ( (vTracks.size() > 0) && (bIsSomeTrackPlaying || bCurrentTrackPaused) )
+    cancelTransitions();
+
+    if ( (tracks.size() > 0) && (bIsSomeTrackPlaying || bCurrentTrackPaused) )
     {
+        Track* pCurrentTrack = tracks.get(playingTrack);
+
         // track->getMaxValueOnGraph() - 100%
         // graphPos                    - x%
 
-        double fPosMult = graphPos / static_cast<double>(vTracks[iCurrentlyPlayingTrackIndex]->getMaxValueOnGraph());
+        double fPosMult = graphPos / static_cast<double>(pCurrentTrack->getMaxValueOnGraph());
         // cast to avoid overflow
-        unsigned int iPosInMS = static_cast<unsigned int>(vTracks[iCurrentlyPlayingTrackIndex]->getLengthInMS() * fPosMult);
+        unsigned int iPosInMS = static_cast<unsigned int>(pCurrentTrack->getLengthInMS() * fPosMult);
 
         if (cRepeatSectionState == 2)
         {
             if ( (iPosInMS > iFirstRepeatTimePos) && (iPosInMS < iSecondRepeatTimePos) )
             {
-                if ( vTracks[iCurrentlyPlayingTrackIndex]->setPositionInMS(iPosInMS) )
-                {
-                    pMainWindow->setCurrentPos(fPosMult, vTracks[iCurrentlyPlayingTrackIndex]->getCurrentTime());
-                }
+                pCurrentTrack->setPositionInMS(iPosInMS);
             }
         }
         else if (cRepeatSectionState == 1)
         {
             if ( iPosInMS > iFirstRepeatTimePos )
             {
-                if ( vTracks[iCurrentlyPlayingTrackIndex]->setPositionInMS(iPosInMS) )
-                {
-                    pMainWindow->setCurrentPos(fPosMult, vTracks[iCurrentlyPlayingTrackIndex]->getCurrentTime());
-                }
+                pCurrentTrack->setPositionInMS(iPosInMS);
             }
         }
         else
         {
-            if ( vTracks[iCurrentlyPlayingTrackIndex]->setPositionInMS(iPosInMS) )
-            {
-                pMainWindow->setCurrentPos(fPosMult, vTracks[iCurrentlyPlayingTrackIndex]->getCurrentTime());
-            }
+            pCurrentTrack->setPositionInMS(iPosInMS);
         }
     }
 
@@ -630,6 +812,9 @@ void AudioService::setTrackPos(unsigned int graphPos)
         pMainWindow->showMessageBox( true, std::string("AudioService::setTrackPos::FMOD::System::update() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
     }
 
+    // Time to the track end is changed.
+    wakeUpMonitor();
+
     mtxTracksVec.unlock();
 }
 
@@ -637,12 +822,16 @@ void AudioService::setRepeatPoint(unsigned int graphPos)
 {
     mtxTracksVec.lock();
 
-    if ( (vTracks.size() > 0) && (bIsSomeTrackPlaying || bCurrentTrackPaused) )
+    cancelTransitions();
+
+    if ( (tracks.size() > 0) && (bIsSomeTrackPlaying || bCurrentTrackPaused) )
     {
+        Track* pCurrentTrack = tracks.get(playingTrack);
+
         // track->getMaxValueOnGraph() - 100%
         // graphPos                    - x%
 
-        double fPosMult = graphPos / static_cast<double>(vTracks[iCurrentlyPlayingTrackIndex]->getMaxValueOnGraph());
+        double fPosMult = graphPos / static_cast<double>(pCurrentTrack->getMaxValueOnGraph());
 
         if (cRepeatSectionState == 0)
         {
@@ -651,26 +840,23 @@ void AudioService::setRepeatPoint(unsigned int graphPos)
 
             cRepeatSectionState = 1;
 
-            unsigned int iPosInMS = static_cast<unsigned int>(vTracks[iCurrentlyPlayingTrackIndex]->getLengthInMS() * fPosMult);
+            unsigned int iPosInMS = static_cast<unsigned int>(pCurrentTrack->getLengthInMS() * fPosMult);
             iFirstRepeatTimePos = iPosInMS;
 
 
             // Set track pos
-            if ( vTracks[iCurrentlyPlayingTrackIndex]->getPositionInMS() < iFirstRepeatTimePos )
+            if ( pCurrentTrack->getPositionInMS() < iFirstRepeatTimePos )
             {
-                if ( vTracks[iCurrentlyPlayingTrackIndex]->setPositionInMS(iFirstRepeatTimePos) )
-                {
-                    pMainWindow->setCurrentPos(fPosMult, vTracks[iCurrentlyPlayingTrackIndex]->getCurrentTime());
-                }
+                pCurrentTrack->setPositionInMS(iFirstRepeatTimePos);
             }
         }
         else if (cRepeatSectionState == 1)
         {
-            unsigned int iPosInMS = static_cast<unsigned int>(vTracks[iCurrentlyPlayingTrackIndex]->getLengthInMS() * fPosMult);
+            unsigned int iPosInMS = static_cast<unsigned int>(pCurrentTrack->getLengthInMS() * fPosMult);
             iSecondRepeatTimePos = iPosInMS;
 
             if ( iPosInMS
-                 < (vTracks[iCurrentlyPlayingTrackIndex]->getLengthInMS() - MAX_SECOND_REPEAT_BOUND_FROM_END_MS) )
+                 < (pCurrentTrack->getLengthInMS() - MAX_SECOND_REPEAT_BOUND_FROM_END_MS) )
             {
                 if ( iPosInMS > iFirstRepeatTimePos + MAX_SECOND_REPEAT_BOUND_FROM_END_MS )
                 {
@@ -680,14 +866,14 @@ void AudioService::setRepeatPoint(unsigned int graphPos)
                     // Done
                     cRepeatSectionState = 2;
 
+                    // The mixer will jump from B to A on the exact sample.
+                    pCurrentTrack->setLoopSection(iFirstRepeatTimePos, iSecondRepeatTimePos);
+
 
                     // Set track pos
-                    if ( vTracks[iCurrentlyPlayingTrackIndex]->getPositionInMS() > iSecondRepeatTimePos )
+                    if ( pCurrentTrack->getPositionInMS() > iSecondRepeatTimePos )
                     {
-                        if ( vTracks[iCurrentlyPlayingTrackIndex]->setPositionInMS(iFirstRepeatTimePos) )
-                        {
-                            pMainWindow->setCurrentPos(fPosMult, vTracks[iCurrentlyPlayingTrackIndex]->getCurrentTime());
-                        }
+                        pCurrentTrack->setPositionInMS(iFirstRepeatTimePos);
                     }
                 }
             }
@@ -697,13 +883,110 @@ void AudioService::setRepeatPoint(unsigned int graphPos)
             // User pressed RMB again, erase section
             pMainWindow->eraseRepeatSection();
 
+            pCurrentTrack->clearLoopSection();
+
             cRepeatSectionState = 0;
         }
     }
 
+    // The seam fade is scheduled by the monitor.
+    wakeUpMonitor();
+
+    mtxTracksVec.unlock();
+}
+
+void AudioService::setRepeatSectionSeamFade(unsigned int iLengthInMS)
+{
+    // 0 ms - no fade, the mixer jumps from B to A right away.
+
+    if (iLengthInMS > MAX_REPEAT_SEAM_FADE_MS)
+    {
+        iLengthInMS = MAX_REPEAT_SEAM_FADE_MS;
+    }
+
+    mtxTracksVec.lock();
+
+    cancelTransitions();
+
+    iRepeatSeamFadeInMS = iLengthInMS;
+
+    wakeUpMonitor();
+
+    mtxTracksVec.unlock();
+}
+
+void AudioService::setCrossfade(unsigned int iLengthInMS, char cCurve)
+{
+    // 0 ms - the next track starts right after the last sample of the current one (gapless).
+    // New value will be used for the next transition (the current transition is not changed).
+
+    if (iLengthInMS > MAX_CROSSFADE_MS)
+    {
+        iLengthInMS = MAX_CROSSFADE_MS;
+    }
+
+    if ( (cCurve != CROSSFADE_CURVE_LINEAR) && (cCurve != CROSSFADE_CURVE_EQUAL_POWER) )
+    {
+        cCurve = DEFAULT_CROSSFADE_CURVE;
+    }
+
+    mtxTracksVec.lock();
+
+    iCrossfadeInMS  = iLengthInMS;
+    cCrossfadeCurve = cCurve;
+
     mtxTracksVec.unlock();
 }
 
+void AudioService::setPreloadBudget(unsigned int iBudgetInMB)
+{
+    // 0 MB - the tracks are streamed from the disk.
+
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    pPreloadCache->setBudget( static_cast<size_t>(iBudgetInMB) * 1024 * 1024 );
+
+    if (bIsSomeTrackPlaying || bCurrentTrackPaused)
+    {
+        // Release or preload the next track.
+        preloadNextTrack();
+    }
+}
+
+void AudioService::setLoudnessNormalization(char cMode)
+{
+    // The gain is applied to the current track right away, the tracks that are not analyzed yet
+    // will get it on the next playTrack().
+
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    cLoudnessNormalization = cMode;
+
+    if (cMode != LOUDNESS_NORMALIZATION_OFF)
+    {
+        std::vector<TrackHandle> vTracksToAnalyze;
+
+        for (size_t i = 0; i < tracks.size(); i++)
+        {
+            if (tracks.getTrack(i)->getLoudness().isAnalyzed() == false)
+            {
+                vTracksToAnalyze.push_back(tracks.getHandle(i));
+            }
+        }
+
+        if (vTracksToAnalyze.size() > 0)
+        {
+            loudnessThreads.start( std::bind(&AudioService::threadAnalyzeLoudness, this, vTracksToAnalyze) );
+        }
+    }
+
+    if (bIsSomeTrackPlaying || bCurrentTrackPaused)
+    {
+        tracks.get(playingTrack)->setLoudnessGain( getLoudnessGain(tracks.get(playingTrack)) );
+        tracks.get(playingTrack)->setVolume(fCurrentVolume);
+    }
+}
+
 std::string AudioService::getBloodyVersion()
 {
     return sBloodyVersion;
@@ -715,15 +998,19 @@ void AudioService::pauseTrack()
 
     mtxTracksVec.lock();
 
-    if ( vTracks.size() > 0 )
+    cancelTransitions();
+
+    if ( tracks.size() > 0 )
     {
         if ( isCurrentTrackEnded() )
         {
-            vTracks[iCurrentlyPlayingTrackIndex] ->reCreateTrack(fCurrentVolume);
+            tracks.get(playingTrack) ->reCreateTrack(fCurrentVolume);
         }
 
-        if ( vTracks[iCurrentlyPlayingTrackIndex]->pauseTrack() )
+        if ( tracks.get(playingTrack)->pauseTrack() )
         {
+            bWaitingForFirstAudio = false;
+
             if (bIsSomeTrackPlaying)
             {
                 bIsSomeTrackPlaying = false;
@@ -744,6 +1031,10 @@ void AudioService::pauseTrack()
         pMainWindow->showMessageBox( true, std::string("AudioService::pauseTrack::FMOD::System::update() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
     }
 
+    publishPlayingTrack();
+
+    wakeUpMonitor();
+
     mtxTracksVec.unlock();
 }
 
@@ -753,11 +1044,16 @@ void AudioService::stopTrack()
 
     mtxTracksVec.lock();
 
-    if ( (vTracks.size() > 0) && (bIsSomeTrackPlaying || bCurrentTrackPaused) )
+    cancelTransitions();
+
+    if ( (tracks.size() > 0) && (bIsSomeTrackPlaying || bCurrentTrackPaused) )
     {
-        vTracks[iCurrentlyPlayingTrackIndex]->stopTrack();
-        bIsSomeTrackPlaying = false;
-        bCurrentTrackPaused = true;
+        tracks.get(playingTrack)->stopTrack();
+        bIsSomeTrackPlaying   = false;
+        bCurrentTrackPaused   = true;
+        bWaitingForFirstAudio = false;
+        publishPosition();
+        publishPlayingTrack();
         pMainWindow->clearGraph(true);
     }
 
@@ -770,44 +1066,62 @@ void AudioService::nextTrack(bool bDontLockMutex, bool bRandomNextTrackLocal)
 
     if (!bDontLockMutex) mtxTracksVec.lock();
 
-    if ( vTracks.size() > 0 )
+    if ( tracks.size() > 0 )
     {
         if ( isCurrentTrackEnded() )
         {
-            vTracks[iCurrentlyPlayingTrackIndex]->reCreateTrack(fCurrentVolume);
+            tracks.get(playingTrack)->reCreateTrack(fCurrentVolume);
         }
 
-        if (bRandomNextTrackLocal)
-        {
-            size_t iNewTrackIndex = iCurrentlyPlayingTrackIndex;
+        playTrack(getNextTrackIndex(bRandomNextTrackLocal), true);
+    }
 
-            if (vTracks.size() != 1)
-            {
-                std::uniform_int_distribution<> uid(0, static_cast<int>(vTracks.size()) - 1);
+    if (!bDontLockMutex) mtxTracksVec.unlock();
+}
 
-                do
-                {
-                    iNewTrackIndex = static_cast<size_t>(uid(*pRndGen));
+size_t AudioService::getNextTrackIndex(bool bRandomNextTrackLocal)
+{
+    // This function is executed in mtxTracksVec.lock();
 
-                }while (iNewTrackIndex == iCurrentlyPlayingTrackIndex);
-            }
+    if (bRandomNextTrackLocal)
+    {
+        size_t iNextTrackIndex = 0;
+
+        if ( (nextRandomTrack != playingTrack) && tracks.getIndex(nextRandomTrack, &iNextTrackIndex) )
+        {
+            // Picked in advance (see preloadNextTrack()).
+            return iNextTrackIndex;
+        }
 
-            playTrack(iNewTrackIndex, true);
+        tracks.getIndex(shuffleBag.getNextTrack(playingTrack), &iNextTrackIndex);
+
+        return iNextTrackIndex;
+    }
+    else
+    {
+        size_t iCurrentTrackIndex = getCurrentTrackIndex();
+
+        if (iCurrentTrackIndex == (tracks.size() - 1))
+        {
+            return 0;
         }
         else
         {
-            if (iCurrentlyPlayingTrackIndex == (vTracks.size() - 1))
-            {
-                playTrack(0, true);
-            }
-            else
-            {
-                playTrack(iCurrentlyPlayingTrackIndex + 1, true);
-            }
+            return iCurrentTrackIndex + 1;
         }
     }
+}
 
-    if (!bDontLockMutex) mtxTracksVec.unlock();
+size_t AudioService::getCurrentTrackIndex()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // The index of the current track is changed by removeTrack(), moveUp() and moveDown() (the handle is not).
+
+    size_t iTrackIndex = 0;
+
+    tracks.getIndex(playingTrack, &iTrackIndex);
+
+    return iTrackIndex;
 }
 
 void AudioService::prevTrack()
@@ -816,41 +1130,35 @@ void AudioService::prevTrack()
 
     mtxTracksVec.lock();
 
-    if ( vTracks.size() > 0 )
+    cancelTransitions();
+
+    if ( tracks.size() > 0 )
     {
         if ( isCurrentTrackEnded() )
         {
-            vTracks[iCurrentlyPlayingTrackIndex]->reCreateTrack(fCurrentVolume);
+            tracks.get(playingTrack)->reCreateTrack(fCurrentVolume);
         }
 
-        if (vTracksHistory.size() > 1)
-        {
-            size_t iTrackIndex = 0;
-
-            Track* pPrevTrack = vTracksHistory[ vTracksHistory.size() - 2 ];
+        size_t iTrackIndex = 0;
 
-            for (size_t i = 0; i < vTracks.size(); i++)
-            {
-                if (pPrevTrack == vTracks[i])
-                {
-                    iTrackIndex = i;
-                    break;
-                }
-            }
+        if ( (tracksHistory.getSize() > 1) && tracks.getIndex(tracksHistory.getFromBack(1), &iTrackIndex) )
+        {
+            // playTrack() will add it again.
+            tracksHistory.popBack();
+            tracksHistory.popBack();
 
 
             mtxTracksVec.unlock();
 
-            vTracksHistory.pop_back();
-            vTracksHistory.pop_back();
-
             playTrack ( iTrackIndex );
         }
         else
         {
+            iTrackIndex = getCurrentTrackIndex();
+
             mtxTracksVec.unlock();
 
-            playTrack( iCurrentlyPlayingTrackIndex );
+            playTrack( iTrackIndex );
         }
     }
     else
@@ -865,21 +1173,17 @@ void AudioService::removeTrack(size_t iTrackIndex)
 
     mtxTracksVec.lock();
 
-    if ( iTrackIndex < vTracks.size() )
+    cancelTransitions();
+
+    if ( iTrackIndex < tracks.size() )
     {
         mtxGetCurrentDrawingIndex.lock();
 
-        if ( vTracks.size() == 0)
+        TrackHandle track = tracks.getHandle(iTrackIndex);
+
+        if (bIsSomeTrackPlaying || bCurrentTrackPaused)
         {
-            bMonitorTracks      = false;
-            bIsSomeTrackPlaying = false;
-            bCurrentTrackPaused = false;
-            iCurrentlyPlayingTrackIndex = 0;
-            pMainWindow->clearGraph();
-        }
-        else if (bIsSomeTrackPlaying || bCurrentTrackPaused)
-        {
-            if (iTrackIndex == iCurrentlyPlayingTrackIndex)
+            if (track == playingTrack)
             {
                 mtxGetCurrentDrawingIndex.unlock();
                 bDrawing = false;
@@ -889,7 +1193,7 @@ void AudioService::removeTrack(size_t iTrackIndex)
 
                 bIsSomeTrackPlaying = false;
                 bCurrentTrackPaused = false;
-                iCurrentlyPlayingTrackIndex = 0;
+                positionSnapshot.invalidate();
 
                 pMainWindow->eraseRepeatSection();
                 cRepeatSectionState = 0;
@@ -899,28 +1203,21 @@ void AudioService::removeTrack(size_t iTrackIndex)
 
                 pMainWindow->clearGraph();
             }
-            else if ( (iCurrentlyPlayingTrackIndex != 0) && (iTrackIndex < iCurrentlyPlayingTrackIndex) )
-            {
-                // Move 'iCurrentlyPlayingTrackIndex' to the left in the 'tracks' vector because of the delete.
-                iCurrentlyPlayingTrackIndex--;
-                *iCurrentlyDrawingTrackIndex -= 1;
-            }
+
+            // Handles of the playing and drawing tracks are not changed by the delete.
         }
 
 
-        // Erase from vTracksHistory
-        for (size_t i = 0; i < vTracksHistory.size(); i++)
+        tracksHistory.removeTrack(track);
+        shuffleBag   .removeTrack(track);
+
+        delete tracks.remove(iTrackIndex);
+
+        if (track == playingTrack)
         {
-            if (vTracksHistory[i] == vTracks[iTrackIndex])
-            {
-                vTracksHistory.erase ( vTracksHistory.begin() + i );
-                break;
-            }
+            playingTrack = tracks.getHandle(0);
         }
 
-        delete vTracks[iTrackIndex];
-        vTracks.erase( vTracks.begin() + iTrackIndex );
-
         FMOD_RESULT result;
         result = pSystem->update();
         if (result)
@@ -929,6 +1226,8 @@ void AudioService::removeTrack(size_t iTrackIndex)
         }
 
         mtxGetCurrentDrawingIndex.unlock();
+
+        publishPlayingTrack();
     }
     else
     {
@@ -942,20 +1241,28 @@ void AudioService::clearPlaylist()
 {
     mtxTracksVec.lock();
 
+    cancelTransitions();
+
     bDrawing = false;
     mtxDrawGraph.lock();
     mtxDrawGraph.unlock();
 
-    bMonitorTracks = false;
     bIsSomeTrackPlaying = false;
 
-    iCurrentlyPlayingTrackIndex = 0;
+    positionSnapshot.invalidate();
+
+    mtxGetCurrentDrawingIndex.lock();
 
-    for (size_t i = 0; i < vTracks.size(); i++)
+    for (size_t i = 0; i < tracks.size(); i++)
     {
-        delete vTracks[i];
+        delete tracks.getTrack(i);
     }
-    vTracks.clear();
+    tracks.clear();
+
+    mtxGetCurrentDrawingIndex.unlock();
+
+    playingTrack    = TrackHandle();
+    nextRandomTrack = TrackHandle();
 
     //fCurrentVolume = DEFAULT_VOLUME;
 
@@ -964,7 +1271,10 @@ void AudioService::clearPlaylist()
     cRepeatSectionState = 0;
 
 
-    vTracksHistory.clear();
+    tracksHistory.clear();
+    shuffleBag   .clear();
+
+    publishPlayingTrack();
 
     mtxTracksVec.unlock();
 }
@@ -982,12 +1292,12 @@ void AudioService::saveTracklist(std::wstring pathToTracklist)
     std::ofstream tracklistFile (out, std::ios::binary);
 #endif
 
-    short iTrackCount = static_cast<short>(vTracks.size());
+    short iTrackCount = static_cast<short>(tracks.size());
     tracklistFile.write(reinterpret_cast<char*>(&iTrackCount), sizeof(short));
 
-    for (size_t i = 0; i < vTracks.size(); i++)
+    for (size_t i = 0; i < tracks.size(); i++)
     {
-        std::wstring trackPath( vTracks[i]->getFilePath() );
+        std::wstring trackPath( tracks.getTrack(i)->getFilePath() );
         short iPathSize = static_cast<short>(trackPath.size() * sizeof(wchar_t));
 
         // Write path size
@@ -1054,7 +1364,9 @@ void AudioService::setPan(float fPan)
 {
     mtxTracksVec.lock();
 
-    if (vTracks.size() > 0)
+    fCurrentPan = fPan;
+
+    if (tracks.size() > 0)
     {
         FMOD::ChannelGroup* pMaster;
         pSystem->getMasterChannelGroup(&pMaster);
@@ -1068,19 +1380,11 @@ void AudioService::setPan(float fPan)
 
 void AudioService::setPitch(float fPitch)
 {
-    if (pPitch)
-    {
-        pPitch->setParameterFloat(FMOD_DSP_PITCHSHIFT_PITCH, fPitch);
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
 
-        if (fPitch != 1.0f)
-        {
-            pPitch->setBypass(false);
-        }
-        else
-        {
-            pPitch->setBypass(true);
-        }
-    }
+    fCurrentPitch = fPitch;
+
+    applyLazyFX(LAZY_FX_PITCH);
 }
 
 void AudioService::setSpeedByPitch(float fSpeed)
@@ -1089,16 +1393,20 @@ void AudioService::setSpeedByPitch(float fSpeed)
 
     fCurrentSpeedByPitch = fSpeed;
 
-    if (vTracks.size() > 0)
+    // The slider sends a lot of values: the transition that is already running gets the new speed too.
+    cancelPendingTransition();
+
+    // Only the current and the scheduled tracks have the channel,
+    // the other tracks get the speed when they are started (see playTrack() and scheduleNextTrack()).
+    if ( tracks.get(playingTrack) )
     {
-        for (size_t i = 0; i < vTracks.size(); i++)
-        {
-            vTracks[i]->setSpeedByFreq(fSpeed);
-        }
+        tracks.get(playingTrack)->setSpeedByFreq(fSpeed);
     }
 
     pSystem->update();
 
+    wakeUpMonitor();
+
     mtxTracksVec.unlock();
 }
 
@@ -1108,66 +1416,107 @@ void AudioService::setSpeedByTime(float fSpeed)
 
     fCurrentSpeedByTime = fSpeed;
 
-    if (vTracks.size() > 0)
-    {
-        for (size_t i = 0; i < vTracks.size(); i++)
-        {
-            vTracks[i]->setSpeedByTime(fSpeed);
-        }
-    }
-
-    pPitchForTime->setParameterFloat(FMOD_DSP_PITCHSHIFT_PITCH, 1.0f / fSpeed);
+    // The slider sends a lot of values: the transition that is already running gets the new speed too.
+    cancelPendingTransition();
 
-    if (fSpeed != 1.0f)
+    // Only the current and the scheduled tracks have the channel,
+    // the other tracks get the speed when they are started (see playTrack() and scheduleNextTrack()).
+    if ( tracks.get(playingTrack) )
     {
-        pPitchForTime->setBypass(false);
-    }
-    else
-    {
-        pPitchForTime->setBypass(true);
+        tracks.get(playingTrack)->setSpeedByTime(fSpeed);
     }
 
+    applyLazyFX(LAZY_FX_TIME_STRETCH);
+
     pSystem->update();
 
+    wakeUpMonitor();
+
     mtxTracksVec.unlock();
 }
 
 void AudioService::setReverbVolume(float fVolume)
 {
-    if (pReverb)
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    fCurrentReverbVolume = fVolume;
+
+    // Only one of the reverbs is used.
+    bool bConvolution = sImpulseResponsePath.empty() == false;
+
+    applyLazyFX(LAZY_FX_REVERB);
+
+    if (pConvolutionReverb)
     {
-        if (fVolume <= -80.0f)
+        if ( (bConvolution == false) || (fVolume <= -80.0f) )
         {
-            pReverb->setBypass(true);
+            pConvolutionReverb->setBypass(true);
         }
         else
         {
-            pReverb->setBypass(false);
+            pConvolutionReverb->setBypass(false);
         }
 
-        pReverb->setParameterFloat(FMOD_DSP_SFXREVERB_WETLEVEL, fVolume);
-        pSystem->update();
+        pConvolutionReverb->setParameterFloat(0, fVolume);
     }
+
+    pSystem->update();
 }
 
 void AudioService::setEchoVolume(float fEchoVolume)
 {
-    if (pEcho)
-    {
-        if (fEchoVolume <= -80.0f)
-        {
-            pEcho->setBypass(true);
-        }
-        else
-        {
-            pEcho->setBypass(false);
-        }
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    fCurrentEchoVolume = fEchoVolume;
+
+    applyLazyFX(LAZY_FX_ECHO);
+
+    pSystem->update();
+}
+
+void AudioService::setEqualizerBandGain(int iBand, float fGainInDB)
+{
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
 
-        pEcho->setParameterFloat(FMOD_DSP_ECHO_WETLEVEL, fEchoVolume);
+    if (pEqualizer)
+    {
+        pEqualizer->setParameterFloat(iBand, fGainInDB);
         pSystem->update();
     }
 }
 
+void AudioService::loadImpulseResponse(const std::wstring& sPathToFile)
+{
+    // Decoding and partitioning the response takes a while so it's done in a separate thread
+    // and this thread only swaps it (see setImpulseResponse()).
+
+    if (pConvolutionReverb == nullptr)
+    {
+        return;
+    }
+
+    unsigned int iRequest = ++iImpulseResponseRequest;
+
+    impulseResponseThreads.start( std::bind(&AudioService::threadLoadImpulseResponse, this, sPathToFile, iRequest) );
+}
+
+void AudioService::unloadImpulseResponse()
+{
+    // The response that is still loading will not be applied.
+    unsigned int iRequest = ++iImpulseResponseRequest;
+
+    mtxTracksVec.lock();
+    bool bLoaded = sImpulseResponsePath.empty() == false;
+    mtxTracksVec.unlock();
+
+    if ( (pConvolutionReverb == nullptr) || (bLoaded == false) )
+    {
+        return;
+    }
+
+    setImpulseResponse(nullptr, std::wstring(), iRequest);
+}
+
 #if _WIN32
 void AudioService::loadVSTPlugin(wchar_t *pPathToDll)
 {
@@ -1199,7 +1548,9 @@ void AudioService::loadVSTPlugin(wchar_t *pPathToDll)
     FMOD::ChannelGroup* pMaster;
     pSystem->getMasterChannelGroup(&pMaster);
 
-    pMaster->addDSP(5, pVST);
+    mtxTracksVec.lock();
+    insertIntoChain(pVST);
+    mtxTracksVec.unlock();
 
     char name[MAX_PATH];
     memset(name, 0, MAX_PATH);
@@ -1259,114 +1610,149 @@ void AudioService::unloadVSTPlugin()
 }
 #endif
 
-void AudioService::systemUpdate()
+void AudioService::exportTrack(size_t iTrackIndex, const std::wstring& sOutputPath, unsigned int iFromMS, unsigned int iToMS)
 {
-    pSystem->update();
+    // 'iToMS' == 0 - until the end of the track.
+
+    std::vector<ExportJob> vJobs;
+
+    mtxTracksVec.lock();
+
+    if (iTrackIndex < tracks.size())
+    {
+        vJobs.push_back( getExportJob(iTrackIndex, sOutputPath) );
+        vJobs.back().iFromMS = iFromMS;
+        vJobs.back().iToMS   = iToMS;
+    }
+
+    mtxTracksVec.unlock();
+
+    if (vJobs.empty())
+    {
+        return;
+    }
+
+    iExportsInProgress++;
+
+    exportThreads.start( std::bind(&AudioService::threadExportTracks, this, vJobs, getExportSettings()) );
 }
 
-void AudioService::moveDown(size_t iTrackIndex)
+void AudioService::exportTracks(const std::vector<size_t>& vTrackIndices, const std::wstring& sOutputFolder)
 {
-    mtxTracksVec.lock();
+    // Every track is saved to the 'sOutputFolder' as "<track name>.wav".
 
-    mtxGetCurrentDrawingIndex.lock();
+    std::wstring sFolder = sOutputFolder;
 
-    if (iTrackIndex == vTracks.size() - 1)
+    if ( (sFolder.empty() == false) && (sFolder.back() != L'/') && (sFolder.back() != L'\\') )
     {
-        Track* pTemp = vTracks[iTrackIndex];
-        vTracks.pop_back();
-        vTracks.insert( vTracks.begin(), pTemp );
+        sFolder += L'/';
+    }
 
-        if (bIsSomeTrackPlaying)
+    std::vector<ExportJob> vJobs;
+
+    mtxTracksVec.lock();
+
+    for (size_t i = 0; i < vTrackIndices.size(); i++)
+    {
+        if (vTrackIndices[i] < tracks.size())
         {
-            if (iTrackIndex == iCurrentlyPlayingTrackIndex)
-            {
-                iCurrentlyPlayingTrackIndex = 0;
-                *iCurrentlyDrawingTrackIndex = 0;
-            }
-            else
-            {
-                iCurrentlyPlayingTrackIndex++;
-                *iCurrentlyDrawingTrackIndex += 1;
-            }
+            std::wstring sOutputPath = sFolder + getTrackName( tracks.getTrack(vTrackIndices[i])->getFilePath() ) + L".wav";
+
+            vJobs.push_back( getExportJob(vTrackIndices[i], sOutputPath) );
         }
     }
-    else
+
+    mtxTracksVec.unlock();
+
+    if (vJobs.empty())
     {
-        Track* pTemp = vTracks[iTrackIndex + 1];
-        vTracks[iTrackIndex + 1] = vTracks[iTrackIndex];
-        vTracks[iTrackIndex] = pTemp;
+        return;
+    }
 
-        if (bIsSomeTrackPlaying)
-        {
-            if (iTrackIndex == iCurrentlyPlayingTrackIndex)
-            {
-                iCurrentlyPlayingTrackIndex++;
-                *iCurrentlyDrawingTrackIndex += 1;
-            }
-            else if (iCurrentlyPlayingTrackIndex != 0)
-            {
-                if (iTrackIndex == iCurrentlyPlayingTrackIndex - 1)
-                {
-                    iCurrentlyPlayingTrackIndex--;
-                    *iCurrentlyDrawingTrackIndex -= 1;
-                }
-            }
-        }
+    iExportsInProgress++;
+
+    exportThreads.start( std::bind(&AudioService::threadExportTracks, this, vJobs, getExportSettings()) );
+}
+
+bool AudioService::isExportRunning()
+{
+    return iExportsInProgress > 0;
+}
+
+void AudioService::systemUpdate()
+{
+    pSystem->update();
+}
+
+void AudioService::setFXProfile(char cProfile)
+{
+    // Only the FFT size of the pitch shifter can be changed while the system is running
+    // (see FX_PROFILE_BUFFER_LENGTHS and FX_PROFILE_RESAMPLERS in FMODinit()).
+
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    fxProfileMonitor.setProfile(cProfile);
+
+    applyFXProfile();
+}
+
+char AudioService::getFXProfile()
+{
+    return fxProfileMonitor.getProfile();
+}
+
+bool AudioService::isFXProfileAuto()
+{
+    return fxProfileMonitor.isAuto();
+}
+
+FXProfileStats AudioService::getFXProfileStats(char cProfile)
+{
+    // Does not lock 'mtxTracksVec', the FX window shows the stats while the track is playing.
+
+    FXProfileStats stats = fxProfileMonitor.getStats(cProfile);
+
+    if ( (cProfile < 0) || (cProfile >= FX_PROFILE_COUNT) || (bFMODStarted == false) || (iOutputRate == 0) )
+    {
+        return stats;
     }
 
-    mtxGetCurrentDrawingIndex.unlock();
+    const float vFFTSizes[] = FX_PROFILE_FFT_SIZES;
 
-    mtxTracksVec.unlock();
+    // The pitch shifter outputs the block after it has the whole FFT window.
+    stats.fLatencyInMS = (static_cast<float>(iDSPBufferLength) * iDSPBufferCount + vFFTSizes[static_cast<size_t>(cProfile)]) * 1000.0f / iOutputRate;
+
+    return stats;
 }
 
-void AudioService::moveUp(size_t iTrackIndex)
+void AudioService::moveDown(size_t iTrackIndex)
 {
+    // The playing and the drawing tracks are referenced by handles so nothing else is changed here.
+
     mtxTracksVec.lock();
 
-    mtxGetCurrentDrawingIndex.lock();
+    // The next track may change.
+    cancelTransitions();
 
-    if (iTrackIndex == 0)
-    {
-        Track* pTemp = vTracks[iTrackIndex];
-        vTracks.erase( vTracks.begin() );
-        vTracks.push_back( pTemp );
+    tracks.moveDown(iTrackIndex);
 
-        if (bIsSomeTrackPlaying)
-        {
-            if (iTrackIndex == iCurrentlyPlayingTrackIndex)
-            {
-                iCurrentlyPlayingTrackIndex = vTracks.size() - 1;
-                *iCurrentlyDrawingTrackIndex = vTracks.size() - 1;
-            }
-            else
-            {
-                iCurrentlyPlayingTrackIndex--;
-                *iCurrentlyDrawingTrackIndex -= 1;
-            }
-        }
-    }
-    else
-    {
-        Track* pTemp = vTracks[iTrackIndex - 1];
-        vTracks[iTrackIndex - 1] = vTracks[iTrackIndex];
-        vTracks[iTrackIndex] = pTemp;
+    publishPlayingTrack();
 
-        if (bIsSomeTrackPlaying)
-        {
-            if (iTrackIndex == iCurrentlyPlayingTrackIndex)
-            {
-                iCurrentlyPlayingTrackIndex--;
-                *iCurrentlyDrawingTrackIndex -= 1;
-            }
-            else if (iTrackIndex == iCurrentlyPlayingTrackIndex + 1)
-            {
-                iCurrentlyPlayingTrackIndex++;
-                *iCurrentlyDrawingTrackIndex += 1;
-            }
-        }
-    }
+    mtxTracksVec.unlock();
+}
 
-    mtxGetCurrentDrawingIndex.unlock();
+void AudioService::moveUp(size_t iTrackIndex)
+{
+    // The playing and the drawing tracks are referenced by handles so nothing else is changed here.
+
+    mtxTracksVec.lock();
+
+    // The next track may change.
+    cancelTransitions();
+
+    tracks.moveUp(iTrackIndex);
+
+    publishPlayingTrack();
 
     mtxTracksVec.unlock();
 }
@@ -1437,9 +1823,9 @@ void AudioService::searchTextSet(const std::wstring &sKeyword)
 
     if (sKeyword != L"")
     {
-        for (size_t i = 0; i < vTracks.size(); i++)
+        for (size_t i = 0; i < tracks.size(); i++)
         {
-            if ( findCaseInsensitive( vTracks[i]->getTrackName(), const_cast<std::wstring&>(sKeyword)) != std::string::npos )
+            if ( findCaseInsensitive( tracks.getTrack(i)->getTrackName(), const_cast<std::wstring&>(sKeyword)) != std::string::npos )
             {
                 vSearchResult.push_back(i);
             }
@@ -1457,6 +1843,10 @@ void AudioService::searchTextSet(const std::wstring &sKeyword)
 
 void AudioService::repeatTrack()
 {
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    cancelTransitions();
+
     bRepeatTrack = !bRepeatTrack;
 
     if (bRepeatTrack && bRandomNextTrack)
@@ -1468,6 +1858,10 @@ void AudioService::repeatTrack()
 
 void AudioService::randomNextTrack()
 {
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    cancelTransitions();
+
     bRandomNextTrack = !bRandomNextTrack;
 
     if (bRandomNextTrack && bRepeatTrack)
@@ -1475,15 +1869,26 @@ void AudioService::randomNextTrack()
         bRepeatTrack = false;
         pMainWindow->uncheckRepeatTrackButton();
     }
+
+    if (bIsSomeTrackPlaying)
+    {
+        // The next track is changed.
+        preloadNextTrack();
+    }
 }
 
 void AudioService::setVolume(float fNewVolume)
 {
     mtxTracksVec.lock();
 
-    if (vTracks.size() > 0)
+    if (tracks.size() > 0)
+    {
+        tracks.get(playingTrack)->setVolume(fNewVolume);
+    }
+
+    if ( tracks.get(scheduledTrack) )
     {
-        vTracks[iCurrentlyPlayingTrackIndex]->setVolume(fNewVolume);
+        tracks.get(scheduledTrack)->setVolume(fNewVolume);
     }
 
     fCurrentVolume = fNewVolume;
@@ -1493,466 +1898,1699 @@ void AudioService::setVolume(float fNewVolume)
 
 size_t AudioService::getPlayingTrackIndex(bool &bSomeTrackIsPlaying)
 {
-    mtxTracksVec.lock();
+    // This function does not wait for 'mtxTracksVec' (reads the value published by publishPlayingTrack()).
 
-    bSomeTrackIsPlaying = bIsSomeTrackPlaying;
+    unsigned long long iPlayingTrack = iPublishedPlayingTrack;
 
-    mtxTracksVec.unlock();
-    return iCurrentlyPlayingTrackIndex;
+    bSomeTrackIsPlaying = (iPlayingTrack & 1) != 0;
+
+    return static_cast<size_t>(iPlayingTrack >> 1);
 }
 
-bool AudioService::isFMODStarted()
+void AudioService::enqueueCommand(std::function<void()> command)
 {
-    return bFMODStarted;
+    // This function does not wait for 'mtxTracksVec' (the command will be executed in the audio-control thread).
+
+    commandQueue.push(command);
+
+    wakeUpMonitor();
 }
 
-bool AudioService::isSomeTrackIsPlaying()
+void AudioService::enqueueLatestCommand(size_t iSlot, std::function<void()> command)
 {
-    return bIsSomeTrackPlaying;
+    // Slider events come faster than the audio-control thread applies them: while the command of the slot
+    // is in the queue a new one just replaces it, so only the latest value is applied per update tick.
+
+    mtxLatestCommands.lock();
+
+    bool bQueued           = static_cast<bool>(vLatestCommands[iSlot]);
+    vLatestCommands[iSlot] = command;
+
+    mtxLatestCommands.unlock();
+
+    if (bQueued == false)
+    {
+        enqueueCommand( [=]
+        {
+            std::function<void()> latestCommand;
+
+            mtxLatestCommands.lock();
+            latestCommand.swap(vLatestCommands[iSlot]);
+            mtxLatestCommands.unlock();
+
+            latestCommand();
+        } );
+    }
 }
 
-bool AudioService::isCurrentTrackPaused()
+CommandQueueStats AudioService::getCommandQueueStats()
 {
-    return bCurrentTrackPaused;
+    return commandQueue.getStats();
 }
 
-FMOD::System *AudioService::getFMODSystem()
+bool AudioService::getPlaybackPosition(PlaybackPosition* pPosition)
 {
-    return pSystem;
+    // Does not lock anything, can be called at the display refresh rate.
+
+    return positionSnapshot.read(pPosition);
 }
 
-Track *AudioService::getCurrentTrack()
+bool AudioService::getMeterFrame(MeterFrame* pFrame)
 {
-    mtxTracksVec .lock();
-    mtxTracksVec .unlock();
+    // Does not lock anything (see MeterBuffer), should be called only from one thread (the GUI).
 
-    if ( bCurrentTrackPaused == false && bIsSomeTrackPlaying )
-    {
-        return vTracks[ iCurrentlyPlayingTrackIndex ];
-    }
-    else
+    if (pMasterAnalyzer == nullptr)
     {
-        return nullptr;
+        return false;
     }
+
+    return pMasterAnalyzer->readFrame(pFrame);
 }
 
-size_t AudioService::getTracksCount()
+PreloadStats AudioService::getPreloadStats()
 {
-    mtxTracksVec .lock();
-    mtxTracksVec .unlock();
-
-    return vTracks .size();
+    return pPreloadCache->getStats();
 }
 
-void AudioService::monitorTrack()
+unsigned long long AudioService::getMonitorWakeUpsCount()
 {
-    while (bMonitorTracks)
-    {
-        mtxTracksVec.lock();
+    return iMonitorWakeUps;
+}
 
-        if (bIsSomeTrackPlaying)
-        {
-            if ( isCurrentTrackEnded() )
-            {
-                switchToOtherTrack();
-            }
-            else
-            {
-                if (cRepeatSectionState == 2)
-                {
-                    if ( vTracks[iCurrentlyPlayingTrackIndex]->getPositionInMS() >= iSecondRepeatTimePos - MAX_TIME_ERROR_MS )
-                    {
-                        for (float i = fCurrentVolume; i >= 0.0f; i-= 0.01f)
-                        {
-                            vTracks[iCurrentlyPlayingTrackIndex]->setVolume(i);
-
-                            std::this_thread::sleep_for (std::chrono::milliseconds(TRANSITION_SLEEP_MS));
-                        }
-
-                        vTracks[iCurrentlyPlayingTrackIndex]->setPositionInMS (iFirstRepeatTimePos);
-
-                        for (float i = 0; i <= fCurrentVolume; i+= 0.01f)
-                        {
-                            vTracks[iCurrentlyPlayingTrackIndex]->setVolume(i);
+void AudioService::setFXOverloadDSPUsage(float fDSPUsage)
+{
+    fxProfileMonitor.setOverloadDSPUsage(fDSPUsage);
+}
 
-                            std::this_thread::sleep_for (std::chrono::milliseconds(TRANSITION_SLEEP_MS));
-                        }
-                    }
-                }
+bool AudioService::isFMODStarted()
+{
+    return bFMODStarted;
+}
 
+bool AudioService::isSomeTrackIsPlaying()
+{
+    return bIsSomeTrackPlaying;
+}
 
-                // track->getLengthInMS()   - 1.0
-                // track->getPositionInMS() - x
+bool AudioService::isCurrentTrackPaused()
+{
+    return bCurrentTrackPaused;
+}
 
-                double x = static_cast<double>(vTracks[iCurrentlyPlayingTrackIndex]->getPositionInMS()) / vTracks[iCurrentlyPlayingTrackIndex]->getLengthInMS();
+FMOD::System *AudioService::getFMODSystem()
+{
+    return pSystem;
+}
 
-                pMainWindow->setCurrentPos(x, vTracks[iCurrentlyPlayingTrackIndex]->getCurrentTime());
-            }
-        }
+Track *AudioService::getCurrentTrack()
+{
+    mtxTracksVec .lock();
+    mtxTracksVec .unlock();
 
-        pSystem->update();
+    if ( bCurrentTrackPaused == false && bIsSomeTrackPlaying )
+    {
+        return tracks.get(playingTrack);
+    }
+    else
+    {
+        return nullptr;
+    }
+}
 
-        mtxTracksVec.unlock();
+bool AudioService::isLoudnessAnalyzed(size_t iTrackIndex)
+{
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
 
-        if (bMonitorTracks) std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS));
+    if (iTrackIndex >= tracks.size())
+    {
+        return false;
     }
+
+    return tracks.getTrack(iTrackIndex)->getLoudness().isAnalyzed();
 }
 
-bool AudioService::isCurrentTrackEnded()
+bool AudioService::isSeekTableBuilt(size_t iTrackIndex, bool* pLoadedFromCache)
 {
-    bool bError = false;
-
-    unsigned int iCurrentTimeInMS = vTracks[iCurrentlyPlayingTrackIndex]->getPositionInMS(&bError);
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
 
-    if (bError)
+    if (iTrackIndex >= tracks.size())
     {
-        // The track is ended?
-        return true;
+        return false;
     }
 
-    if ( iCurrentTimeInMS >= (vTracks[iCurrentlyPlayingTrackIndex]->getLengthInMS() - MAX_TIME_ERROR_MS) )
+    const SeekTable& seekTable = tracks.getTrack(iTrackIndex)->getSeekTable();
+
+    if (pLoadedFromCache)
     {
-        return true;
+        *pLoadedFromCache = seekTable.isLoadedFromCache();
     }
-    else
+
+    return seekTable.isBuilt();
+}
+
+bool AudioService::isAccurateSoundReady(size_t iTrackIndex)
+{
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    if (iTrackIndex >= tracks.size())
     {
         return false;
     }
+
+    return tracks.getTrack(iTrackIndex)->isAccurateSoundReady();
 }
 
-void AudioService::switchToOtherTrack()
+size_t AudioService::getTracksCount()
 {
-    // This function is executed in mtxTracksVec.lock();
+    mtxTracksVec .lock();
+    mtxTracksVec .unlock();
 
-    // The track is ended
-    // Play next
-    vTracks[iCurrentlyPlayingTrackIndex]->reCreateTrack(fCurrentVolume);
+    return tracks.size();
+}
 
-    FMOD_RESULT result = pSystem->update();
-    if (result)
-    {
-        pMainWindow->showMessageBox(true, std::string("AudioService::monitorTrack::FMOD::System::update() failed. Error: ") + FMOD_ErrorString(result));
-    }
+void AudioService::monitorTrack()
+{
+    // This function is the audio-control thread: it executes the commands from the Controller (see enqueueCommand())
+    // and switches to the next track when the current one is ended.
+    // The track end is reported by FMOD (see onTrackEnded()) from System::update() so while the track is playing
+    // we wake up to update the position on the graph and right after the expected track end.
+    // While nothing is playing this thread sleeps until wakeUpMonitor() is called (enqueueCommand() calls it too).
 
-    if (bRepeatTrack || cRepeatSectionState == 1)
+    while (bMonitorTracks)
     {
-        // Or not
-        playTrack(iCurrentlyPlayingTrackIndex, true);
+        iMonitorWakeUps++;
+
+        // Most of the commands lock 'mtxTracksVec' so we execute them first.
+        commandQueue.executeCommands();
+
+        bool         bPlaying     = false;
+        unsigned int iSleepTimeMS = MONITOR_TRACK_INTERVAL_MS;
+
+        mtxTracksVec.lock();
+
+        // Will call the 'end' callback if the track is ended.
+        pSystem->update();
+
+        mtxMonitorTrack.lock();
+        bMonitorWakeUp = false;
+        mtxMonitorTrack.unlock();
+
+        monitorPlayback(&bPlaying, &iSleepTimeMS);
+
+        if (bPlaying)
+        {
+            checkFXOverload();
+        }
+
+        // Wake up to release the FX even if nothing is playing.
+        bool bReleaseFX = releaseIdleFX();
+
+        mtxTracksVec.unlock();
+
+
+        std::unique_lock<std::mutex> lock(mtxMonitorTrack);
+
+        // 'bMonitorWakeUp' from the destructor (or from enqueueCommand()) could be reset above
+        // so we check 'bMonitorTracks' and the queue too.
+
+        if (bPlaying || bReleaseFX)
+        {
+            cvMonitorTrack.wait_for(lock, std::chrono::milliseconds(iSleepTimeMS), [this] { return bMonitorWakeUp || (bMonitorTracks == false) || (commandQueue.isEmpty() == false); });
+        }
+        else
+        {
+            cvMonitorTrack.wait(lock, [this] { return bMonitorWakeUp || (bMonitorTracks == false) || (commandQueue.isEmpty() == false); });
+        }
     }
-    else
+}
+
+void AudioService::monitorPlayback(bool* pPlaying, unsigned int* pSleepTimeMS)
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Called after System::update(): switches to the next track if the current one is ended,
+    // schedules the gapless transition and the repeat section fades.
+
+    if (bIsSomeTrackPlaying)
     {
-        if (bRandomNextTrack)
+        if ( isCurrentTrackEnded() )
         {
-            nextTrack(true, true);
+            switchToOtherTrack();
         }
         else
         {
-            nextTrack(true);
+            if (bWaitingForFirstAudio)
+            {
+                checkFirstAudio();
+            }
+
+            if ( (cRepeatSectionState == 2) && (iRepeatSeamFadeInMS > 0) )
+            {
+                // The mixer loops the section by itself, we only add the fade to the next seam.
+                scheduleRepeatSeamFade();
+            }
+
+
+            if ( (tracks.get(scheduledTrack) == nullptr) && (bRepeatTrack == false) && (cRepeatSectionState == 0) && (tracks.size() > 1)
+                 && (getTimeToTrackEndMS() <= GAPLESS_SCHEDULE_BEFORE_END_MS + iCrossfadeInMS) )
+            {
+                scheduleNextTrack();
+            }
+        }
+
+        *pPlaying = bIsSomeTrackPlaying;
+
+        if (*pPlaying)
+        {
+            *pSleepTimeMS = getMonitorSleepTimeMS();
         }
     }
+
+    // The GUI moves the playhead between our wake-ups.
+    publishPosition();
+    publishPlayingTrack();
 }
 
-void AudioService::drawGraph(size_t* iTrackIndex)
+void AudioService::checkFXOverload()
 {
-    mtxDrawGraph.lock();
-    bDrawing = true;
+    // This function is executed in mtxTracksVec.lock();
+    // Called by the audio-control thread while the track is playing: measures the DSP usage of the active profile,
+    // in FX_PROFILE_AUTO the monitor steps down to the cheaper profile when the DSP is overloaded.
 
+    float fDSPUsage = 0.0f;
 
-    // default: 16384
-    // "If FMOD_TIMEUNIT_RAWBYTES is used, the memory allocated is two times the size passed in, because fmod allocates a double buffer."
-    // 131072 * 2 = 256 kB (x8 times bigger than default) to speed up our graph draw (to speed up our readData() calls)
-    FMOD_RESULT fresult = pSystem->setStreamBufferSize(131072, FMOD_TIMEUNIT_RAWBYTES);
-    if (fresult)
+    if ( pSystem->getCPUUsage(&fDSPUsage, nullptr, nullptr, nullptr, nullptr) )
     {
-        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::setStreamBufferSize() failed. Error: ") + std::string(FMOD_ErrorString(fresult)) );
+        return;
     }
 
+    if ( fxProfileMonitor.addDSPUsage(fDSPUsage) )
+    {
+        applyFXProfile();
+    }
+}
 
-    pMainWindow->clearGraph();
+void AudioService::applyFXProfile()
+{
+    // This function is executed in mtxTracksVec.lock();
 
-    // this value combines 'iOnlySamplesInOneRead' samples in one to store less points for graph in memory
-    // more than '200' on a track that is about 5 minutes long looks bad
-    // for example 2.5 min track with 'iSamplesInOne' = 100, adds like 3 MB to RAM
-    // but less value can fill RAM very bad
-    unsigned int iOnlySamplesInOneRead = 150;
-    // so we calculate 'iSamplesInOne' like this:
-    // 3000 ('iSamplesInOne') - 6000 (sec.)
-    // x    ('iSamplesInOne') - track length (in sec.)
+    if (pPitch)
+    {
+        const float vFFTSizes[] = FX_PROFILE_FFT_SIZES;
 
-    mtxGetCurrentDrawingIndex.lock();
+        pPitch->setParameterFloat(FMOD_DSP_PITCHSHIFT_FFTSIZE, vFFTSizes[static_cast<size_t>(fxProfileMonitor.getProfile())]);
+    }
+}
 
+FMOD::DSP** AudioService::getLazyFX(char cEffect)
+{
+    switch (cEffect)
+    {
+    case LAZY_FX_PITCH:        return &pPitch;
+    case LAZY_FX_TIME_STRETCH: return &pTimeStretch;
+    case LAZY_FX_REVERB:       return &pReverb;
+    default:                   return &pEcho;
+    }
+}
 
+bool AudioService::createLazyFX(char cEffect)
+{
+    // This function is executed in mtxTracksVec.lock();
+    // The new DSP is bypassed, applyLazyFX() turns it on.
 
-    // here we do: 3000 * (tracks[iTrackIndex]->getLengthInMS() / 1000) / 6000, but we can replace this with just:
-    //iOnlySamplesInOneRead = vTracks[*iTrackIndex]->getLengthInMS() * 3 / 6000;
-    iOnlySamplesInOneRead = vTracks[*iTrackIndex]->getLengthInMS() / 2000;
-    if (iOnlySamplesInOneRead == 0) iOnlySamplesInOneRead = 1;
+    FMOD::DSP** ppDSP = getLazyFX(cEffect);
 
+    FMOD_RESULT result = FMOD_OK;
 
-    // Set max on graph
-    std::string format = vTracks[*iTrackIndex]->getPCMFormat();
-    unsigned int iTempMax;
-    if (format == "PCM16")
+    if (cEffect == LAZY_FX_TIME_STRETCH)
     {
-        iTempMax = vTracks[*iTrackIndex]->getLengthInPCMbytes() / 4 / iOnlySamplesInOneRead;
+        if ( TimeStretch::createDSP(pSystem, ppDSP) == false )
+        {
+            pMainWindow->showMessageBox( true, "AudioService::createLazyFX::FMOD::System::createDSP() failed. The speed (by time) will change the pitch." );
+            *ppDSP = nullptr;
+            return false;
+        }
     }
     else
     {
-        iTempMax = vTracks[*iTrackIndex]->getLengthInPCMbytes() / 6 / iOnlySamplesInOneRead;
+        FMOD_DSP_TYPE vTypes[] = {FMOD_DSP_TYPE_PITCHSHIFT, FMOD_DSP_TYPE_PITCHSHIFT, FMOD_DSP_TYPE_SFXREVERB, FMOD_DSP_TYPE_ECHO};
+
+        result = pSystem->createDSPByType(vTypes[static_cast<size_t>(cEffect)], ppDSP);
+        if (result)
+        {
+            pMainWindow->showMessageBox( true, std::string("AudioService::createLazyFX::FMOD::System::createDSPByType() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+            *ppDSP = nullptr;
+            return false;
+        }
     }
 
-    pMainWindow->setXMaxToGraph(iTempMax);
-    vTracks[*iTrackIndex]->setMaxPosInGraph(iTempMax);
+    (*ppDSP)->setBypass(true);
 
+    if (cEffect == LAZY_FX_PITCH)
+    {
+        const float vFFTSizes[] = FX_PROFILE_FFT_SIZES;
 
-    vTracks[*iTrackIndex]->createDummySound();
-    mtxGetCurrentDrawingIndex.unlock();
+        (*ppDSP)->setParameterFloat(FMOD_DSP_PITCHSHIFT_FFTSIZE, vFFTSizes[static_cast<size_t>(fxProfileMonitor.getProfile())]);
+    }
+    else if (cEffect == LAZY_FX_ECHO)
+    {
+        (*ppDSP)->setParameterFloat(FMOD_DSP_ECHO_DELAY, 1000);
+    }
 
-    // Buffer Size = 2 MB
-    unsigned int iBufferSize = 2097152;
-    unsigned int iGraphMax = 0;
-    char pcmFormat = 0;
-    char result = 1;
+    insertIntoChain(*ppDSP);
 
-    do
+    return true;
+}
+
+void AudioService::applyLazyFX(char cEffect)
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Applies the current value of the effect (LAZY_FX_...): the effect is created when it's turned on for the first time,
+    // when it's turned off it's bypassed and later released by releaseIdleFX().
+
+    bool bOn = false;
+
+    switch (cEffect)
     {
-        char* pSamplesBuffer = new char[iBufferSize];
-        unsigned int iActuallyReadBytes;
+    case LAZY_FX_PITCH:        bOn = (fCurrentPitch != 1.0f);                                                    break;
+    case LAZY_FX_TIME_STRETCH: bOn = (fCurrentSpeedByTime != 1.0f);                                              break;
+    case LAZY_FX_REVERB:       bOn = sImpulseResponsePath.empty() && (fCurrentReverbVolume > -80.0f);            break;
+    default:                   bOn = (fCurrentEchoVolume > -80.0f);                                              break;
+    }
 
+    FMOD::DSP** ppDSP = getLazyFX(cEffect);
 
+    if (*ppDSP == nullptr)
+    {
+        if ( (bOn == false) || (createLazyFX(cEffect) == false) )
+        {
+            return;
+        }
+    }
 
+    switch (cEffect)
+    {
+    case LAZY_FX_PITCH:        (*ppDSP)->setParameterFloat(FMOD_DSP_PITCHSHIFT_PITCH,    fCurrentPitch);        break;
+    case LAZY_FX_TIME_STRETCH: (*ppDSP)->setParameterFloat(0,                            fCurrentSpeedByTime);  break;
+    case LAZY_FX_REVERB:       (*ppDSP)->setParameterFloat(FMOD_DSP_SFXREVERB_WETLEVEL,  fCurrentReverbVolume); break;
+    default:                   (*ppDSP)->setParameterFloat(FMOD_DSP_ECHO_WETLEVEL,       fCurrentEchoVolume);   break;
+    }
 
-        // Read
+    bool bBypass = false;
+    (*ppDSP)->getBypass(&bBypass);
 
-        mtxGetCurrentDrawingIndex.lock();
+    if (bOn && bBypass)
+    {
+        // Don't play what was left in the buffers since the last time.
+        (*ppDSP)->reset();
+        (*ppDSP)->setBypass(false);
+    }
+    else if ( (bOn == false) && (bBypass == false) )
+    {
+        (*ppDSP)->setBypass(true);
 
-        result = vTracks[*iTrackIndex]->getPCMSamples(pSamplesBuffer, iBufferSize, &iActuallyReadBytes, &pcmFormat);
+        vLazyFXBypassClocks[static_cast<size_t>(cEffect)] = getDSPClock();
+    }
+}
 
-        mtxGetCurrentDrawingIndex.unlock();
+bool AudioService::releaseIdleFX()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // The bypassed DSP is still in the DSP graph and keeps its buffers (the echo keeps 1000 ms of the delay line),
+    // so the effect that was off for LAZY_FX_RELEASE_AFTER_MS is removed and released (applyLazyFX() will create it again).
+    // Returns true if some effect is waiting to be released.
 
+    FMOD::ChannelGroup* pMaster = nullptr;
+    pSystem->getMasterChannelGroup(&pMaster);
 
+    unsigned long long iNow      = getDSPClock();
+    unsigned long long iIdleTime = msToDSPClocks(LAZY_FX_RELEASE_AFTER_MS);
 
+    bool bWaiting = false;
 
-        // Check for errors
+    for (char i = 0; i < LAZY_FX_COUNT; i++)
+    {
+        FMOD::DSP** ppDSP = getLazyFX(i);
 
-        if (result == 0)
+        bool bBypass = false;
+
+        if ( (*ppDSP == nullptr) || (*ppDSP)->getBypass(&bBypass) || (bBypass == false) )
         {
-            delete[] pSamplesBuffer;
-            break;
+            continue;
         }
-        else if ((result == -1) && (iActuallyReadBytes == 0))
+
+        if (iNow < vLazyFXBypassClocks[static_cast<size_t>(i)] + iIdleTime)
         {
-            delete[] pSamplesBuffer;
-            break;
+            bWaiting = true;
+            continue;
+        }
+
+        pMaster->removeDSP(*ppDSP);
+        (*ppDSP)->release();
+        *ppDSP = nullptr;
+    }
+
+    return bWaiting;
+}
+
+void AudioService::insertIntoChain(FMOD::DSP* pDSP)
+{
+    // This function is executed in mtxTracksVec.lock() (or in FMODinit());
+    // The order of the master chain does not depend on the order in which the DSPs were created, from the head (output) to the tail:
+    // analyzer, pitch, time stretch, fader, reverb, echo, VST, equalizer, convolution reverb.
+
+    FMOD::ChannelGroup* pMaster = nullptr;
+    pSystem->getMasterChannelGroup(&pMaster);
+
+    FMOD::DSP* pFader = nullptr;
+    pMaster->getDSP(FMOD_CHANNELCONTROL_DSP_FADER, &pFader);
+
+    FMOD::DSP* vChain[] = {pAnalyzer, pPitch, pTimeStretch, pFader, pReverb, pEcho, pVST, pEqualizer, pConvolutionReverb};
+
+    // Right after the last DSP that is before it in the chain and is already added.
+    int iIndex = 0;
+
+    for (size_t i = 0; (i < sizeof(vChain) / sizeof(vChain[0])) && (vChain[i] != pDSP); i++)
+    {
+        int iChainIndex = 0;
+
+        if ( vChain[i] && (pMaster->getDSPIndex(vChain[i], &iChainIndex) == FMOD_OK) )
+        {
+            iIndex = iChainIndex + 1;
         }
+    }
+
+    pMaster->addDSP(iIndex, pDSP);
+}
+
+void AudioService::advanceTime(unsigned int iTimeInMS)
+{
+    // Virtual clock of the non-realtime output modes (does nothing with the real output device).
+    // Mixes 'iTimeInMS' of the output block by block and after every block does the work of the audio-control thread,
+    // so the playlist is played as fast as the CPU can mix it and the result does not depend on the thread timings.
+
+    if ( (cOutputMode == OUTPUT_MODE_DEVICE) || (bFMODStarted == false) || (iDSPBufferLength == 0) )
+    {
+        return;
+    }
+
+    unsigned long long iTargetClock = iVirtualClock + msToDSPClocks(iTimeInMS);
+
+    while (iVirtualClock < iTargetClock)
+    {
+        commandQueue.executeCommands();
+
+        bool         bPlaying     = false;
+        unsigned int iSleepTimeMS = 0;
+
+        mtxTracksVec.lock();
+
+        // Mixes one DSP buffer (and will call the 'end' callback if the track is ended).
+        pSystem->update();
+        iVirtualClock += iDSPBufferLength;
+
+        monitorPlayback(&bPlaying, &iSleepTimeMS);
+        releaseIdleFX();
+
+        mtxTracksVec.unlock();
+    }
+}
+
+unsigned long long AudioService::getVirtualTimeInMS()
+{
+    // Time mixed by advanceTime().
+
+    int iOutputRate = 0;
+
+    if ( (bFMODStarted == false) || pSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr) || (iOutputRate == 0) )
+    {
+        return 0;
+    }
+
+    return iVirtualClock * 1000 / static_cast<unsigned long long>(iOutputRate);
+}
+
+void AudioService::publishPosition()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Publishes the position of the current track for the GUI (see PositionSnapshot).
+
+    PlaybackPosition position;
+
+    if ( (bIsSomeTrackPlaying || bCurrentTrackPaused) && tracks.get(playingTrack)
+         && tracks.get(playingTrack)->getPlaybackPosition(&position) )
+    {
+        positionSnapshot.publish(position);
+    }
+    else
+    {
+        positionSnapshot.invalidate();
+    }
+}
+
+void AudioService::publishPlayingTrack()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Publishes the index of the current track for the GUI (see getPlayingTrackIndex()).
+    // Called after every change of 'playingTrack', 'bIsSomeTrackPlaying' or the order of the tracks.
+
+    iPublishedPlayingTrack = (static_cast<unsigned long long>(getCurrentTrackIndex()) << 1) | (bIsSomeTrackPlaying ? 1 : 0);
+}
+
+unsigned int AudioService::getMonitorSleepTimeMS()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Returns the time until the next graph update or until the track end (whichever comes first).
+
+    if (bWaitingForFirstAudio)
+    {
+        return PRELOAD_FIRST_AUDIO_POLL_MS;
+    }
+
+    unsigned int iTimeToEndMS = getTimeToTrackEndMS() + MONITOR_TRACK_END_MARGIN_MS;
+
+    return (iTimeToEndMS < MONITOR_TRACK_INTERVAL_MS) ? iTimeToEndMS : MONITOR_TRACK_INTERVAL_MS;
+}
+
+unsigned int AudioService::getTimeToTrackEndMS()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Returns the real time (with the current speed) until the end of the current track.
+
+    bool bError = false;
+
+    unsigned int iPosInMS    = tracks.get(playingTrack)->getPositionInMS(&bError);
+    unsigned int iLengthInMS = tracks.get(playingTrack)->getLengthInMS();
+
+    if ( bError || (iPosInMS >= iLengthInMS) )
+    {
+        return 0;
+    }
+
+    float fSpeed = (fCurrentSpeedByPitch != 1.0f) ? fCurrentSpeedByPitch : fCurrentSpeedByTime;
+
+    return static_cast<unsigned int>( (iLengthInMS - iPosInMS) / fSpeed );
+}
+
+void AudioService::scheduleNextTrack()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Starts the next track so that its first sample is played right after the last sample of the current track
+    // or (if the crossfade is enabled) 'iCrossfadeInMS' before the end so the tracks overlap.
+
+    size_t iNextTrackIndex = getNextTrackIndex(bRandomNextTrack);
+
+    if (tracks.getHandle(iNextTrackIndex) == playingTrack)
+    {
+        return;
+    }
+
+    Track* pCurrentTrack = tracks.get(playingTrack);
+    Track* pNextTrack    = tracks.getTrack(iNextTrackIndex);
+
+    unsigned long long iEndDSPClock = 0;
+
+    if ( pCurrentTrack->getEndDSPClock(&iEndDSPClock) == false )
+    {
+        return;
+    }
+
+    unsigned long long iStartDSPClock = iEndDSPClock;
+
+    if (iCrossfadeInMS > 0)
+    {
+        unsigned long long iCrossfadeInClocks = msToDSPClocks(iCrossfadeInMS);
+        unsigned long long iNow               = getDSPClock();
+
+        iStartDSPClock = (iEndDSPClock > iNow + iCrossfadeInClocks) ? (iEndDSPClock - iCrossfadeInClocks) : iNow;
+    }
+
+    pNextTrack->setLoudnessGain( getLoudnessGain(pNextTrack) );
+    pNextTrack->setSpeedByFreq(fCurrentSpeedByPitch);
+    pNextTrack->setSpeedByTime(fCurrentSpeedByTime);
+
+    if ( pNextTrack->scheduleTrack(fCurrentVolume, iStartDSPClock) )
+    {
+        scheduledTrack          = tracks.getHandle(iNextTrackIndex);
+        iScheduledStartDSPClock = iStartDSPClock;
+
+        if (iStartDSPClock < iEndDSPClock)
+        {
+            pNextTrack    ->addFade(iStartDSPClock, iEndDSPClock, true,  cCrossfadeCurve);
+            pCurrentTrack ->addFade(iStartDSPClock, iEndDSPClock, false, cCrossfadeCurve);
+        }
+
+        // Don't play the encoder padding of the current track over the start of the next one.
+        pCurrentTrack->setStopDSPClock(iEndDSPClock);
+    }
+}
+
+void AudioService::cancelTransitions()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Stops the scheduled track and removes the fades so the current track plays as usual.
+
+    Track* pCurrentTrack = tracks.get(playingTrack);
+
+    if ( tracks.get(scheduledTrack) )
+    {
+        tracks.get(scheduledTrack)->cancelSchedule();
+
+        if (pCurrentTrack)
+        {
+            pCurrentTrack->setStopDSPClock(0);
+        }
+    }
+
+    scheduledTrack = TrackHandle();
+
+    if ( pCurrentTrack && (bIsSomeTrackPlaying || bCurrentTrackPaused) )
+    {
+        pCurrentTrack->removeFades();
+    }
+
+    iRepeatSeamDSPClock = 0;
+}
+
+void AudioService::cancelPendingTransition()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Same as cancelTransitions() but keeps the transition that is already running (the next track is audible):
+    // stopping it would cut the next track and snap the current one back to the full volume.
+    // The running transition gets the current speed, the not started one will be scheduled again with the new speed (see monitorPlayback()).
+
+    Track* pScheduledTrack = tracks.get(scheduledTrack);
+
+    if ( pScheduledTrack && (getDSPClock() >= iScheduledStartDSPClock) )
+    {
+        pScheduledTrack->setSpeedByFreq(fCurrentSpeedByPitch);
+        pScheduledTrack->setSpeedByTime(fCurrentSpeedByTime);
+
+        return;
+    }
+
+    cancelTransitions();
+}
+
+void AudioService::scheduleRepeatSeamFade()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // The channel loops the repeat section by itself (see Track::setLoopSection()), here we add a short
+    // fade out before the next jump from B to A and a fade in after it so there is no click on the seam.
+
+    Track* pCurrentTrack = tracks.get(playingTrack);
+
+    unsigned long long iSeamDSPClock = 0;
+
+    if ( (pCurrentTrack->getLoopSeamDSPClock(&iSeamDSPClock) == false)
+         || (iSeamDSPClock == iRepeatSeamDSPClock) )
+    {
+        return;
+    }
+
+    unsigned long long iFadeInClocks = msToDSPClocks(iRepeatSeamFadeInMS);
+    unsigned long long iNow          = getDSPClock();
+
+    if ( (iNow < iRepeatSeamDSPClock + iFadeInClocks) || (iNow + iFadeInClocks > iSeamDSPClock) )
+    {
+        // The previous fade in is not finished or it's too late for this seam (the next one will be faded).
+        return;
+    }
+
+    pCurrentTrack->removeFades();
+
+    pCurrentTrack->addFade(iSeamDSPClock - iFadeInClocks, iSeamDSPClock, false, cCrossfadeCurve);
+    pCurrentTrack->addFade(iSeamDSPClock, iSeamDSPClock + iFadeInClocks, true, cCrossfadeCurve);
+
+    iRepeatSeamDSPClock = iSeamDSPClock;
+}
+
+unsigned long long AudioService::getDSPClock()
+{
+    // Returns the DSP clock of the master channel group (all channels use it for delays and fade points).
+
+    FMOD::ChannelGroup* pMasterGroup = nullptr;
+    unsigned long long  iDSPClock    = 0;
+
+    if ( pSystem->getMasterChannelGroup(&pMasterGroup) == FMOD_OK )
+    {
+        pMasterGroup->getDSPClock(&iDSPClock, nullptr);
+    }
+
+    return iDSPClock;
+}
+
+unsigned long long AudioService::msToDSPClocks(unsigned int iTimeInMS)
+{
+    int iOutputRate = 0;
+
+    if ( pSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr) )
+    {
+        return 0;
+    }
+
+    return static_cast<unsigned long long>(iTimeInMS) * static_cast<unsigned long long>(iOutputRate) / 1000;
+}
+
+void AudioService::wakeUpMonitor()
+{
+    std::lock_guard<std::mutex> lock(mtxMonitorTrack);
+
+    bMonitorWakeUp = true;
+
+    cvMonitorTrack.notify_one();
+}
+
+void AudioService::onTrackEnded(void* pUserData)
+{
+    // Called by FMOD (from System::update()) so 'mtxTracksVec' may be locked by the caller.
+
+    static_cast<AudioService*>(pUserData)->wakeUpMonitor();
+}
+
+bool AudioService::isCurrentTrackEnded()
+{
+    // The channel becomes invalid when the track is ended.
+
+    bool bError = false;
+
+    tracks.get(playingTrack)->getPositionInMS(&bError);
+
+    return bError;
+}
+
+void AudioService::switchToOtherTrack()
+{
+    // This function is executed in mtxTracksVec.lock();
+
+    // The track is ended
+    // Play next
+    tracks.get(playingTrack)->reCreateTrack(fCurrentVolume);
+
+    FMOD_RESULT result = pSystem->update();
+    if (result)
+    {
+        pMainWindow->showMessageBox(true, std::string("AudioService::monitorTrack::FMOD::System::update() failed. Error: ") + FMOD_ErrorString(result));
+    }
+
+    size_t iNextTrackIndex = 0;
+
+    if ( tracks.getIndex(scheduledTrack, &iNextTrackIndex) )
+    {
+        // The next track is already playing (see scheduleNextTrack()).
+        scheduledTrack = TrackHandle();
+
+        playTrack(iNextTrackIndex, true);
+        return;
+    }
+
+    if (bRepeatTrack || cRepeatSectionState == 1)
+    {
+        // Or not
+        playTrack(getCurrentTrackIndex(), true);
+    }
+    else
+    {
+        if (bRandomNextTrack)
+        {
+            nextTrack(true, true);
+        }
+        else
+        {
+            nextTrack(true);
+        }
+    }
+}
+
+void AudioService::drawGraph(TrackHandle track)
+{
+    // The track is used only under 'mtxGetCurrentDrawingIndex' and is resolved by the handle every time
+    // (it could be removed before this thread is started, see removeTrack()).
+
+    mtxDrawGraph.lock();
+
+    mtxGetCurrentDrawingIndex.lock();
+    bool bTrackExists = (tracks.get(track) != nullptr);
+    mtxGetCurrentDrawingIndex.unlock();
+
+    if (bTrackExists == false)
+    {
+        bDrawing = false;
+        mtxDrawGraph.unlock();
+        return;
+    }
+
+
+    // default: 16384
+    // "If FMOD_TIMEUNIT_RAWBYTES is used, the memory allocated is two times the size passed in, because fmod allocates a double buffer."
+    // 131072 * 2 = 256 kB (x8 times bigger than default) to speed up our graph draw (to speed up our readData() calls)
+    FMOD_RESULT fresult = pSystem->setStreamBufferSize(131072, FMOD_TIMEUNIT_RAWBYTES);
+    if (fresult)
+    {
+        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::setStreamBufferSize() failed. Error: ") + std::string(FMOD_ErrorString(fresult)) );
+    }
+
+
+    pMainWindow->clearGraph();
+
+    // this value combines 'iOnlySamplesInOneRead' samples in one to store less points for graph in memory
+    // more than '200' on a track that is about 5 minutes long looks bad
+    // for example 2.5 min track with 'iSamplesInOne' = 100, adds like 3 MB to RAM
+    // but less value can fill RAM very bad
+    unsigned int iOnlySamplesInOneRead = 150;
+    // so we calculate 'iSamplesInOne' like this:
+    // 3000 ('iSamplesInOne') - 6000 (sec.)
+    // x    ('iSamplesInOne') - track length (in sec.)
+
+    mtxGetCurrentDrawingIndex.lock();
+
+    // Could be removed while the graph was cleared.
+    Track* pTrack = tracks.get(track);
+
+    if (pTrack == nullptr)
+    {
+        mtxGetCurrentDrawingIndex.unlock();
+        bDrawing = false;
+        mtxDrawGraph.unlock();
+        return;
+    }
+
+
+
+    // here we do: 3000 * (tracks[iTrackIndex]->getLengthInMS() / 1000) / 6000, but we can replace this with just:
+    //iOnlySamplesInOneRead = pTrack->getLengthInMS() * 3 / 6000;
+    iOnlySamplesInOneRead = pTrack->getLengthInMS() / 2000;
+    if (iOnlySamplesInOneRead == 0) iOnlySamplesInOneRead = 1;
+
+
+    // Set max on graph
+    std::string format = pTrack->getPCMFormat();
+    unsigned int iTempMax;
+    if (format == "PCM16")
+    {
+        iTempMax = pTrack->getLengthInPCMbytes() / 4 / iOnlySamplesInOneRead;
+    }
+    else
+    {
+        iTempMax = pTrack->getLengthInPCMbytes() / 6 / iOnlySamplesInOneRead;
+    }
+
+    pMainWindow->setXMaxToGraph(iTempMax);
+    pTrack->setMaxPosInGraph(iTempMax);
+
+
+    pTrack->createDummySound();
+    mtxGetCurrentDrawingIndex.unlock();
+
+    // Buffer Size = 2 MB
+    unsigned int iBufferSize = 2097152;
+    unsigned int iGraphMax = 0;
+    char pcmFormat = 0;
+    char result = 1;
+
+    do
+    {
+        char* pSamplesBuffer = new char[iBufferSize];
+        unsigned int iActuallyReadBytes;
+
+
+
+
+        // Read
+
+        mtxGetCurrentDrawingIndex.lock();
+
+        pTrack = tracks.get(track);
+
+        result = (pTrack != nullptr) ? pTrack->getPCMSamples(pSamplesBuffer, iBufferSize, &iActuallyReadBytes, &pcmFormat) : 0;
+
+        mtxGetCurrentDrawingIndex.unlock();
+
+
+
+
+        // Check for errors
+
+        if (result == 0)
+        {
+            delete[] pSamplesBuffer;
+            break;
+        }
+        else if ((result == -1) && (iActuallyReadBytes == 0))
+        {
+            delete[] pSamplesBuffer;
+            break;
+        }
+
+
+
+
+        // Convert to proper massive format
+
+        if (pcmFormat == 16)
+        {
+            // PCM16
+
+            if (iActuallyReadBytes % 4 != 0)
+            {
+                // Wil probably appear on end of file
+
+                while (iActuallyReadBytes % 4 != 0)
+                {
+                    iActuallyReadBytes--;
+                }
+            }
+
+
+
+            float* pSamples = rawBytesToPCM16_0_1 (pSamplesBuffer, iActuallyReadBytes);
+
+
+            // Delete raw buffer
+
+            delete[] pSamplesBuffer;
+
+
+            // Send to Main Window new buffer
+
+            iGraphMax += iActuallyReadBytes / 4 / iOnlySamplesInOneRead;
+
+            pMainWindow->addDataToGraph(pSamples, iActuallyReadBytes / 2, iOnlySamplesInOneRead);
+        }
+        else
+        {
+            // PCM24
+
+            if (iActuallyReadBytes % 6 != 0)
+            {
+                // Wil probably appear on end of file
+
+                while (iActuallyReadBytes % 6 != 0)
+                {
+                    iActuallyReadBytes--;
+                }
+            }
+
+
+
+            float* pSamples = rawBytesToPCM24_0_1 (pSamplesBuffer, iActuallyReadBytes);
+
+
+            // Delete raw buffer
+
+            delete[] pSamplesBuffer;
+
+
+            // Send to Main Window new buffer
+
+            iGraphMax += iActuallyReadBytes / 6 / iOnlySamplesInOneRead;
+
+            pMainWindow->addDataToGraph(pSamples, iActuallyReadBytes / 3, iOnlySamplesInOneRead);
+        }
+
+    }while ( (result == 1) && (bDrawing) );
+
+
+
+    mtxGetCurrentDrawingIndex.lock();
+
+    pTrack = tracks.get(track);
+
+    if (pTrack != nullptr)
+    {
+        if (bDrawing)
+        {
+            pMainWindow->setXMaxToGraph(iGraphMax);
+            pTrack->setMaxPosInGraph(iGraphMax);
+        }
+
+        pTrack->releaseDummySound();
+    }
+
+
+
+    mtxGetCurrentDrawingIndex.unlock();
+
+
+
+    // set to default: 16384
+    fresult = pSystem->setStreamBufferSize(16384, FMOD_TIMEUNIT_RAWBYTES);
+    if (fresult)
+    {
+        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::setStreamBufferSize() failed. Error: ") + std::string(FMOD_ErrorString(fresult)) );
+    }
+
+
+    bDrawing = false;
+    mtxDrawGraph.unlock();
+}
+
+float *AudioService::rawBytesToPCM16_0_1(char *pBuffer, unsigned int iBufferSizeInBytes)
+{
+    float* pSamples     = new float[ iBufferSizeInBytes / 2 ];
+
+    size_t iPosInSamples = 0;
+
+    for (size_t i = 0; i < iBufferSizeInBytes; i += 4)
+    {
+        short int iSampleL = 0;
+
+        memcpy(reinterpret_cast<char*>(&iSampleL),     &pBuffer[i],     1);
+        memcpy(reinterpret_cast<char*>(&iSampleL) + 1, &pBuffer[i + 1], 1);
+
+        //unsigned short int iSampleLUnsigned = static_cast<unsigned short int> (iSampleL + USHRT_MAX / 2.0f);
+
+        //pSamples[iPosInSamples] = static_cast<float>(iSampleLUnsigned) / USHRT_MAX;
+        pSamples[iPosInSamples] = static_cast<float>(iSampleL) / SHRT_MAX;
+        iPosInSamples++;
+
+
+
+        short int iSampleR = 0;
+
+        memcpy(reinterpret_cast<char*>(&iSampleR),     &pBuffer[i + 2], 1);
+        memcpy(reinterpret_cast<char*>(&iSampleR) + 1, &pBuffer[i + 3], 1);
+
+        //unsigned short int iSampleRUnsigned = static_cast<unsigned short int> (iSampleR + USHRT_MAX / 2.0f);
+
+        //pSamples[iPosInSamples] = static_cast<float>(iSampleRUnsigned) / USHRT_MAX;
+        pSamples[iPosInSamples] = static_cast<float>(iSampleR) / SHRT_MAX;
+        iPosInSamples++;
+    }
+
+    return pSamples;
+}
+
+float *AudioService::rawBytesToPCM24_0_1(char *pBuffer, unsigned int iBufferSizeInBytes)
+{
+    float* pSamples     = new float [ iBufferSizeInBytes / 3 ];
+
+    size_t iPosInSamples = 0;
+
+    int iPow2To24 = pow(2, 24);
+
+    for (size_t i = 0; i < iBufferSizeInBytes; i += 6)
+    {
+        int iSampleL = interpret24bitAsInt32 (pBuffer[i + 2], pBuffer[i + 1], pBuffer[i]);
+
+        //unsigned int iSampleLUnsigned = static_cast<unsigned int> (iSampleL + iMin24BitSigned);
+
+        //pSamples[iPosInSamples] = static_cast<float>(iSampleLUnsigned / pow(2, 24));
+        pSamples[iPosInSamples] = static_cast<float>(iSampleL) / iPow2To24;
+        iPosInSamples++;
+
+
+
+        int iSampleR = interpret24bitAsInt32 (pBuffer[i + 5], pBuffer[i + 4], pBuffer[i + 3]);
+
+        //unsigned int iSampleRUnsigned = static_cast<unsigned int> (iSampleR + iMin24BitSigned);
+
+        //pSamples[iPosInSamples] = static_cast<float>(iSampleRUnsigned / pow(2, 24));
+        pSamples[iPosInSamples] = static_cast<float>(iSampleR) / iPow2To24;
+        iPosInSamples++;
+    }
+
+
+    return pSamples;
+}
+
+int AudioService::interpret24bitAsInt32(char byte0, char byte1, char byte2)
+{
+    // copy-paste from stackoverflow
+    return ( (byte0 << 24) | (byte1 << 16) | (byte2 << 8) ) >> 8;
+}
+
+size_t AudioService::findCaseInsensitive(std::wstring& sText, std::wstring& sKeyword)
+{
+    // All to lower case
+
+    std::transform(sText.begin(), sText.end(), sText.begin(), ::tolower);
+
+    std::transform(sKeyword.begin(), sKeyword.end(), sKeyword.begin(), ::tolower);
+
+    return sText.find(sKeyword);
+}
+
+void AudioService::showTracksBitrate(const std::vector<TrackHandle>& vAddedTracks)
+{
+    // This function sends the bitrate of the added tracks to the MainWindow in one batch.
+    // Bitrate is already calculated in addTrack() so we only need to find the current track indexes.
+
+    std::vector<size_t>      vTrackIndexes;
+    std::vector<std::string> vBitrates;
+
+    mtxTracksVec .lock();
+
+    for (size_t i = 0; i < vAddedTracks.size(); i++)
+    {
+        int    iBitrate    = 0;
+        size_t iTrackIndex = 0;
+
+        if ( tracks.getIndex(vAddedTracks[i], &iTrackIndex)
+             &&
+             tracks.get(vAddedTracks[i]) ->isBitrateCalculated()
+             &&
+             tracks.get(vAddedTracks[i]) ->getBitRate(&iBitrate) )
+        {
+            vTrackIndexes .push_back(iTrackIndex);
+            vBitrates     .push_back(std::to_string(iBitrate));
+        }
+    }
+
+    mtxTracksVec .unlock();
+
+
+    if (vTrackIndexes.size() > 0)
+    {
+        pMainWindow ->setTracksBitrate(vTrackIndexes, vBitrates);
+    }
+}
+
+void AudioService::threadPrepareSeekTables(std::vector<TrackHandle> vAddedTracks)
+{
+    // This function builds (or loads from the cache) seek tables (the VBR flag) of the added MP3 tracks.
+    // Tracks can be removed while we are working so we resolve the handles only under 'mtxTracksVec'.
+
+    std::lock_guard<std::mutex> lockSeekTables(mtxSeekTables);
+
+    std::vector<TrackHandle>  vMP3Tracks;
+    std::vector<std::wstring> vMP3Paths;
+
+    mtxTracksVec .lock();
+
+    for (size_t i = 0; i < vAddedTracks.size(); i++)
+    {
+        Track* pTrack = tracks.get(vAddedTracks[i]);
+
+        if ( pTrack && (pTrack->getFormat() == "MP3") )
+        {
+            vMP3Tracks .push_back(vAddedTracks[i]);
+            vMP3Paths  .push_back(pTrack->getFilePath());
+        }
+    }
+
+    mtxTracksVec .unlock();
+
+
+    for (size_t i = 0; (i < vMP3Tracks.size()) && bPrepareSeekTables; i++)
+    {
+        SeekTable seekTable;
+
+        if ( seekTable.build(vMP3Paths[i]) == false )
+        {
+            continue;
+        }
+
+        bool bOpenAccurateSound = false;
+
+        mtxTracksVec .lock();
+
+        Track* pTrack = tracks.get(vMP3Tracks[i]);
+
+        if (pTrack)
+        {
+            pTrack ->setSeekTable(seekTable);
+
+            // The track is already playing.
+            bOpenAccurateSound = bIsSomeTrackPlaying
+                                 && (playingTrack == vMP3Tracks[i])
+                                 && pTrack ->needsAccurateSound();
+        }
+
+        mtxTracksVec .unlock();
+
+
+        if (bOpenAccurateSound)
+        {
+            openAccurateSound(vMP3Tracks[i], vMP3Paths[i]);
+        }
+    }
+}
+
+void AudioService::threadOpenAccurateSound(TrackHandle track, std::wstring sFilePath)
+{
+    std::lock_guard<std::mutex> lockSeekTables(mtxSeekTables);
+
+    if (bPrepareSeekTables)
+    {
+        openAccurateSound(track, sFilePath);
+    }
+}
+
+void AudioService::openAccurateSound(TrackHandle track, const std::wstring& sFilePath)
+{
+    // FMOD_ACCURATETIME makes FMOD scan the whole file so we do it without 'mtxTracksVec' locked.
+
+    FMOD::Sound* pAccurateSound = nullptr;
+
+    if ( Track::openStream(pSystem, sFilePath, true, &pAccurateSound) == false )
+    {
+        // Not critical, seeking will be a little less accurate.
+        return;
+    }
+
+    // The track is changed by the audio-control thread.
+    enqueueCommand( [=] { setAccurateSound(track, pAccurateSound); } );
+}
+
+void AudioService::setAccurateSound(TrackHandle track, FMOD::Sound* pAccurateSound)
+{
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
+
+    // The handle is not resolved if the track was removed.
+    Track* pTrack = tracks.get(track);
+
+    if ( pTrack && pTrack->needsAccurateSound() )
+    {
+        pTrack ->setAccurateSound(pAccurateSound);
+    }
+    else
+    {
+        pAccurateSound ->release();
+    }
+}
+
+void AudioService::preloadNextTrack()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Reads the next track in memory (in a separate thread) so it will start without waiting for the disk.
+    // Other tracks release their memory.
+
+    if (nextRandomTrack == playingTrack)
+    {
+        // Was picked in advance and now it's playing.
+        nextRandomTrack = TrackHandle();
+    }
+
+    size_t      iNextTrackIndex = getNextTrackIndex(bRandomNextTrack);
+    TrackHandle nextTrack       = tracks.getHandle(iNextTrackIndex);
 
+    if (bRandomNextTrack)
+    {
+        // getNextTrackIndex() will return this track again.
+        nextRandomTrack = nextTrack;
+    }
 
+    bool bPreload = (pPreloadCache->getBudget() > 0) && (nextTrack != playingTrack);
 
 
-        // Convert to proper massive format
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        TrackHandle track = tracks.getHandle(i);
 
-        if (pcmFormat == 16)
+        if ( tracks.getTrack(i)->isPreloaded() && (track != playingTrack) && (track != scheduledTrack)
+             && ( (bPreload == false) || (track != nextTrack) ) )
         {
-            // PCM16
+            tracks.getTrack(i)->releasePreloadedSound();
+        }
+    }
 
-            if (iActuallyReadBytes % 4 != 0)
-            {
-                // Wil probably appear on end of file
 
-                while (iActuallyReadBytes % 4 != 0)
-                {
-                    iActuallyReadBytes--;
-                }
-            }
+    if ( (bPreload == false) || tracks.get(nextTrack)->isPreloaded() )
+    {
+        return;
+    }
 
+    preloadThreads.start( std::bind(&AudioService::threadPreloadTrack, this, nextTrack, std::wstring(tracks.get(nextTrack)->getFilePath())) );
+}
 
+void AudioService::threadPreloadTrack(TrackHandle track, std::wstring sFilePath)
+{
+    // Reading the file may take a while so we do it without 'mtxTracksVec' locked.
 
-            float* pSamples = rawBytesToPCM16_0_1 (pSamplesBuffer, iActuallyReadBytes);
+    std::lock_guard<std::mutex> lockPreload(mtxPreload);
 
+    if (bPreloadTracks == false)
+    {
+        return;
+    }
 
-            // Delete raw buffer
+    std::shared_ptr<std::vector<char>> pData = pPreloadCache->load(sFilePath);
 
-            delete[] pSamplesBuffer;
+    if (pData == nullptr)
+    {
+        // Not critical, the track will be streamed from the disk.
+        return;
+    }
 
+    FMOD::Sound* pPreloadedSound = nullptr;
 
-            // Send to Main Window new buffer
+    if ( Track::openMemoryStream(pSystem, *pData, &pPreloadedSound) == false )
+    {
+        return;
+    }
 
-            iGraphMax += iActuallyReadBytes / 4 / iOnlySamplesInOneRead;
+    // The track is changed by the audio-control thread.
+    enqueueCommand( [=] { setPreloadedSound(track, pPreloadedSound, pData); } );
+}
 
-            pMainWindow->addDataToGraph(pSamples, iActuallyReadBytes / 2, iOnlySamplesInOneRead);
-        }
-        else
-        {
-            // PCM24
+void AudioService::setPreloadedSound(TrackHandle track, FMOD::Sound* pPreloadedSound, std::shared_ptr<std::vector<char>> pData)
+{
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
 
-            if (iActuallyReadBytes % 6 != 0)
-            {
-                // Wil probably appear on end of file
+    // The handle is not resolved if the track was removed.
+    Track* pTrack        = tracks.get(track);
+    bool   bCurrentTrack = (bIsSomeTrackPlaying || bCurrentTrackPaused) && (track == playingTrack);
 
-                while (iActuallyReadBytes % 6 != 0)
-                {
-                    iActuallyReadBytes--;
-                }
-            }
+    if ( pTrack && (bCurrentTrack == false) && (track != scheduledTrack) && (pTrack->isPreloaded() == false) )
+    {
+        pTrack ->setPreloadedSound(pPreloadedSound, pData);
+    }
+    else
+    {
+        pPreloadedSound ->release();
+    }
+}
 
+void AudioService::checkFirstAudio()
+{
+    // This function is executed in mtxTracksVec.lock();
+    // The position of the track is changed when the mixer has read its first samples.
 
+    if ( tracks.get(playingTrack)->getPositionInMS() == iFirstAudioStartPosInMS )
+    {
+        return;
+    }
 
-            float* pSamples = rawBytesToPCM24_0_1 (pSamplesBuffer, iActuallyReadBytes);
+    bWaitingForFirstAudio = false;
 
+    double dLatencyInMS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpPlayRequested).count();
 
-            // Delete raw buffer
+    pPreloadCache->addTrackStart(bFirstAudioPreloaded, dLatencyInMS);
+}
 
-            delete[] pSamplesBuffer;
+void AudioService::threadAnalyzeLoudness(std::vector<TrackHandle> vTracksToAnalyze)
+{
+    // This function analyzes the loudness of the tracks (or loads it from the cache) on all cores.
+    // Tracks can be removed while we are working so we resolve the handles only under 'mtxTracksVec'.
 
+    std::lock_guard<std::mutex> lockLoudness(mtxLoudness);
 
-            // Send to Main Window new buffer
+    std::vector<TrackHandle>  vTracks;
+    std::vector<std::wstring> vPaths;
 
-            iGraphMax += iActuallyReadBytes / 6 / iOnlySamplesInOneRead;
+    mtxTracksVec .lock();
 
-            pMainWindow->addDataToGraph(pSamples, iActuallyReadBytes / 3, iOnlySamplesInOneRead);
-        }
+    for (size_t i = 0; i < vTracksToAnalyze.size(); i++)
+    {
+        Track* pTrack = tracks.get(vTracksToAnalyze[i]);
 
-    }while ( (result == 1) && (bDrawing) );
+        if ( pTrack && (pTrack->getLoudness().isAnalyzed() == false) )
+        {
+            vTracks .push_back(vTracksToAnalyze[i]);
+            vPaths  .push_back(pTrack->getFilePath());
+        }
+    }
 
+    mtxTracksVec .unlock();
 
 
-    mtxGetCurrentDrawingIndex.lock();
+    // Every worker decodes with its own FMOD system (the calls to one system are serialized by FMOD),
+    // FMOD allows only FMOD_MAX_SYSTEMS systems per process.
 
+    size_t iThreadCount = std::thread::hardware_concurrency();
 
-    if (bDrawing)
+    if (iThreadCount > LOUDNESS_MAX_ANALYSIS_THREADS)
+    {
+        iThreadCount = LOUDNESS_MAX_ANALYSIS_THREADS;
+    }
+    if (iThreadCount > vTracks.size())
+    {
+        iThreadCount = vTracks.size();
+    }
+    if ( (iThreadCount == 0) && (vTracks.size() > 0) )
     {
-        pMainWindow->setXMaxToGraph(iGraphMax);
-        vTracks[*iTrackIndex]->setMaxPosInGraph(iGraphMax);
+        iThreadCount = 1;
     }
 
-    vTracks[*iTrackIndex]->releaseDummySound();
+    std::atomic<size_t>      iNextTrack(0);
+    std::vector<std::thread> vWorkers;
 
+    for (size_t i = 0; i < iThreadCount; i++)
+    {
+        vWorkers.push_back( std::thread(&AudioService::workerAnalyzeLoudness, this, &vTracks, &vPaths, &iNextTrack) );
+    }
 
+    for (size_t i = 0; i < vWorkers.size(); i++)
+    {
+        vWorkers[i].join();
+    }
+}
 
-    mtxGetCurrentDrawingIndex.unlock();
+void AudioService::workerAnalyzeLoudness(const std::vector<TrackHandle>* pTracks, const std::vector<std::wstring>* pPaths, std::atomic<size_t>* pNextTrack)
+{
+    // Takes the next track until all tracks are analyzed.
 
+    FMOD::System* pWorkerSystem = nullptr;
 
+    FMOD_RESULT result;
+    result = FMOD::System_Create(&pWorkerSystem);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("AudioService::workerAnalyzeLoudness::FMOD::System_Create() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+        return;
+    }
 
-    // set to default: 16384
-    fresult = pSystem->setStreamBufferSize(16384, FMOD_TIMEUNIT_RAWBYTES);
-    if (fresult)
+    // No output: we only decode.
+    pWorkerSystem->setOutput(FMOD_OUTPUTTYPE_NOSOUND_NRT);
+    MappedFileSystem::attach(pWorkerSystem);
+
+    result = pWorkerSystem->init(1, FMOD_INIT_NORMAL, nullptr);
+    if (result)
     {
-        pMainWindow->showMessageBox( true, std::string("AudioService::AudioService::FMOD::System::setStreamBufferSize() failed. Error: ") + std::string(FMOD_ErrorString(fresult)) );
+        pMainWindow->showMessageBox( true, std::string("AudioService::workerAnalyzeLoudness::FMOD::System::init() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+        pWorkerSystem->release();
+        return;
     }
 
 
-    bDrawing = false;
-    mtxDrawGraph.unlock();
-}
+    for (size_t i = (*pNextTrack)++; (i < pTracks->size()) && bAnalyzeLoudness; i = (*pNextTrack)++)
+    {
+        TrackLoudness loudness;
 
-float *AudioService::rawBytesToPCM16_0_1(char *pBuffer, unsigned int iBufferSizeInBytes)
-{
-    float* pSamples     = new float[ iBufferSizeInBytes / 2 ];
+        if ( loudness.analyze(pWorkerSystem, (*pPaths)[i], &bAnalyzeLoudness) == false )
+        {
+            continue;
+        }
 
-    size_t iPosInSamples = 0;
+        std::lock_guard<std::mutex> lock(mtxTracksVec);
 
-    for (size_t i = 0; i < iBufferSizeInBytes; i += 4)
-    {
-        short int iSampleL = 0;
+        // The handle is not resolved if the track was removed.
+        Track* pTrack = tracks.get((*pTracks)[i]);
 
-        memcpy(reinterpret_cast<char*>(&iSampleL),     &pBuffer[i],     1);
-        memcpy(reinterpret_cast<char*>(&iSampleL) + 1, &pBuffer[i + 1], 1);
+        if (pTrack)
+        {
+            pTrack->setLoudness(loudness);
+        }
+    }
 
-        //unsigned short int iSampleLUnsigned = static_cast<unsigned short int> (iSampleL + USHRT_MAX / 2.0f);
+    pWorkerSystem->release();
+}
 
-        //pSamples[iPosInSamples] = static_cast<float>(iSampleLUnsigned) / USHRT_MAX;
-        pSamples[iPosInSamples] = static_cast<float>(iSampleL) / SHRT_MAX;
-        iPosInSamples++;
+float AudioService::getLoudnessGain(Track* pTrack)
+{
+    // This function is executed in mtxTracksVec.lock();
+    // Album - the tracks from the same folder.
+
+    if (cLoudnessNormalization == LOUDNESS_NORMALIZATION_OFF)
+    {
+        return 1.0f;
+    }
 
+    if (cLoudnessNormalization == LOUDNESS_NORMALIZATION_TRACK)
+    {
+        return pTrack->getLoudness().getGain();
+    }
 
 
-        short int iSampleR = 0;
+    std::wstring sTrackPath   = pTrack->getFilePath();
+    size_t       iFolderSize  = sTrackPath.find_last_of(L"/\\") + 1;
 
-        memcpy(reinterpret_cast<char*>(&iSampleR),     &pBuffer[i + 2], 1);
-        memcpy(reinterpret_cast<char*>(&iSampleR) + 1, &pBuffer[i + 3], 1);
+    std::vector<TrackLoudness> vAlbumTracks;
 
-        //unsigned short int iSampleRUnsigned = static_cast<unsigned short int> (iSampleR + USHRT_MAX / 2.0f);
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        std::wstring sPath = tracks.getTrack(i)->getFilePath();
 
-        //pSamples[iPosInSamples] = static_cast<float>(iSampleRUnsigned) / USHRT_MAX;
-        pSamples[iPosInSamples] = static_cast<float>(iSampleR) / SHRT_MAX;
-        iPosInSamples++;
+        if ( (sPath.compare(0, iFolderSize, sTrackPath, 0, iFolderSize) == 0)
+             && (sPath.find_last_of(L"/\\") + 1 == iFolderSize) )
+        {
+            vAlbumTracks.push_back( tracks.getTrack(i)->getLoudness() );
+        }
     }
 
-    return pSamples;
+    return TrackLoudness::getAlbumLoudness(vAlbumTracks).getGain();
 }
 
-float *AudioService::rawBytesToPCM24_0_1(char *pBuffer, unsigned int iBufferSizeInBytes)
+ExportSettings AudioService::getExportSettings()
 {
-    float* pSamples     = new float [ iBufferSizeInBytes / 3 ];
+    // The FX are read from the master DSP chain as they are now.
 
-    size_t iPosInSamples = 0;
+    ExportSettings settings;
 
-    int iPow2To24 = pow(2, 24);
+    std::lock_guard<std::mutex> lock(mtxTracksVec);
 
-    for (size_t i = 0; i < iBufferSizeInBytes; i += 6)
+    bool bBypass = true;
+
+    if ( pPitch && (pPitch->getBypass(&bBypass) == FMOD_OK) && (bBypass == false) )
     {
-        int iSampleL = interpret24bitAsInt32 (pBuffer[i + 2], pBuffer[i + 1], pBuffer[i]);
+        pPitch->getParameterFloat(FMOD_DSP_PITCHSHIFT_PITCH, &settings.fPitch, nullptr, 0);
+    }
 
-        //unsigned int iSampleLUnsigned = static_cast<unsigned int> (iSampleL + iMin24BitSigned);
+    if ( pReverb && (pReverb->getBypass(&bBypass) == FMOD_OK) && (bBypass == false) )
+    {
+        pReverb->getParameterFloat(FMOD_DSP_SFXREVERB_WETLEVEL, &settings.fReverbVolume, nullptr, 0);
+    }
 
-        //pSamples[iPosInSamples] = static_cast<float>(iSampleLUnsigned / pow(2, 24));
-        pSamples[iPosInSamples] = static_cast<float>(iSampleL) / iPow2To24;
-        iPosInSamples++;
+    if ( pConvolutionReverb && (pConvolutionReverb->getBypass(&bBypass) == FMOD_OK) && (bBypass == false) )
+    {
+        pConvolutionReverb->getParameterFloat(0, &settings.fReverbVolume, nullptr, 0);
+        settings.sImpulseResponsePath = sImpulseResponsePath;
+    }
 
+    if ( pEcho && (pEcho->getBypass(&bBypass) == FMOD_OK) && (bBypass == false) )
+    {
+        pEcho->getParameterFloat(FMOD_DSP_ECHO_WETLEVEL, &settings.fEchoVolume, nullptr, 0);
+    }
 
+    if (pEqualizer)
+    {
+        settings.vEqualizerGains.resize(EQ_BAND_COUNT, 0.0f);
 
-        int iSampleR = interpret24bitAsInt32 (pBuffer[i + 5], pBuffer[i + 4], pBuffer[i + 3]);
+        for (int i = 0; i < EQ_BAND_COUNT; i++)
+        {
+            pEqualizer->getParameterFloat(i, &settings.vEqualizerGains[i], nullptr, 0);
+        }
+    }
 
-        //unsigned int iSampleRUnsigned = static_cast<unsigned int> (iSampleR + iMin24BitSigned);
+    settings.fSpeedByPitch = fCurrentSpeedByPitch;
+    settings.fSpeedByTime  = fCurrentSpeedByTime;
+    settings.fPan          = fCurrentPan;
 
-        //pSamples[iPosInSamples] = static_cast<float>(iSampleRUnsigned / pow(2, 24));
-        pSamples[iPosInSamples] = static_cast<float>(iSampleR) / iPow2To24;
-        iPosInSamples++;
-    }
+    return settings;
+}
 
+ExportJob AudioService::getExportJob(size_t iTrackIndex, const std::wstring& sOutputPath)
+{
+    // This function is executed in mtxTracksVec.lock();
+    // The track is exported with the loudness gain we play it with (but not with the volume of the player).
 
-    return pSamples;
+    Track* pTrack = tracks.getTrack(iTrackIndex);
+
+    ExportJob job;
+    job.sFilePath   = pTrack->getFilePath();
+    job.sOutputPath = sOutputPath;
+    job.fGain       = getLoudnessGain(pTrack);
+
+    return job;
 }
 
-int AudioService::interpret24bitAsInt32(char byte0, char byte1, char byte2)
+void AudioService::threadLoadImpulseResponse(std::wstring sPathToFile, unsigned int iRequest)
 {
-    // copy-paste from stackoverflow
-    return ( (byte0 << 24) | (byte1 << 16) | (byte2 << 8) ) >> 8;
+    if (iRequest != iImpulseResponseRequest)
+    {
+        // Was loaded or unloaded again.
+        return;
+    }
+
+    // Partitions are calculated here (not in the audio thread).
+    std::string sErrorString;
+    ImpulseResponse* pImpulseResponse = ConvolutionReverb::loadImpulseResponse(pSystem, sPathToFile, &sErrorString);
+    if (pImpulseResponse == nullptr)
+    {
+        pMainWindow->showMessageBox(true, sErrorString);
+        return;
+    }
+
+    enqueueCommand( [=] { setImpulseResponse(pImpulseResponse, sPathToFile, iRequest); } );
 }
 
-size_t AudioService::findCaseInsensitive(std::wstring& sText, std::wstring& sKeyword)
+void AudioService::setImpulseResponse(ImpulseResponse* pImpulseResponse, const std::wstring& sPathToFile, unsigned int iRequest)
 {
-    // All to lower case
+    // 'pImpulseResponse' - nullptr to unload the response.
 
-    std::transform(sText.begin(), sText.end(), sText.begin(), ::tolower);
+    if (iRequest != iImpulseResponseRequest)
+    {
+        delete pImpulseResponse;
+        return;
+    }
 
-    std::transform(sKeyword.begin(), sKeyword.end(), sKeyword.begin(), ::tolower);
+    ConvolutionReverb::setImpulseResponse(pConvolutionReverb, pImpulseResponse);
 
-    return sText.find(sKeyword);
+    mtxTracksVec.lock();
+    sImpulseResponsePath = sPathToFile;
+    mtxTracksVec.unlock();
+
+    setReverbVolume(fCurrentReverbVolume);
 }
 
-void AudioService::calcBitrate()
+void AudioService::threadExportTracks(std::vector<ExportJob> vJobs, ExportSettings settings)
 {
-    mtxTracksVec .lock();
+    // This function exports the tracks on all cores.
+    // Export workers and loudness workers both take FMOD systems (only FMOD_MAX_SYSTEMS per process)
+    // so they never run at the same time.
 
-    int iBitrate = 0;
+    std::lock_guard<std::mutex> lockExport   (mtxExport);
+    std::lock_guard<std::mutex> lockLoudness (mtxLoudness);
 
-    bool bResult = vTracks[iCurrentlyPlayingTrackIndex] ->getBitRate(&iBitrate);
+    size_t iThreadCount = std::thread::hardware_concurrency();
 
-    if (bResult)
+    if (iThreadCount > EXPORT_MAX_THREADS)
+    {
+        iThreadCount = EXPORT_MAX_THREADS;
+    }
+    if (iThreadCount > vJobs.size())
     {
-        pMainWindow ->setTrackBitrate(iCurrentlyPlayingTrackIndex, std::to_string(iBitrate));
+        iThreadCount = vJobs.size();
+    }
+    if (iThreadCount == 0)
+    {
+        iThreadCount = 1;
     }
 
+    std::atomic<size_t>      iNextJob(0);
+    std::vector<std::thread> vWorkers;
 
-    mtxTracksVec .unlock();
+    for (size_t i = 0; i < iThreadCount; i++)
+    {
+        vWorkers.push_back( std::thread(&AudioService::workerExportTracks, this, &vJobs, &settings, &iNextJob) );
+    }
+
+    for (size_t i = 0; i < vWorkers.size(); i++)
+    {
+        vWorkers[i].join();
+    }
+
+    iExportsInProgress--;
+}
+
+void AudioService::workerExportTracks(const std::vector<ExportJob>* pJobs, const ExportSettings* pSettings, std::atomic<size_t>* pNextJob)
+{
+    // Takes the next job until all tracks are exported.
+
+    TrackExporter exporter(*pSettings);
+
+    for (size_t i = (*pNextJob)++; (i < pJobs->size()) && bExportTracks; i = (*pNextJob)++)
+    {
+        std::string sErrorString;
+
+        if ( (exporter.exportTrack((*pJobs)[i], &bExportTracks, &sErrorString) == false) && bExportTracks )
+        {
+            pMainWindow->showMessageBox(true, std::string("AudioService::workerExportTracks::") + sErrorString);
+        }
+    }
 }
 
-void AudioService::threadAddTracks(std::vector<std::wstring> paths, size_t iStart, size_t iStop, bool* done, int* allCount, int all)
+void AudioService::threadAddTracks(std::vector<std::wstring> paths, size_t iStart, size_t iStop, bool* done, int* allCount, int all, std::vector<TrackHandle>* pAddedTracks)
 {
+    // The bitrate is shown while the tracks are added: every BITRATE_BATCH_SIZE tracks
+    // or BITRATE_BATCH_INTERVAL_MS (see showTracksBitrate()).
+
+    std::vector<TrackHandle> vBitrateBatch;
+    std::chrono::steady_clock::time_point tpLastBatch = std::chrono::steady_clock::now();
+
     for (size_t i = iStart; i <= iStop; i++)
     {
-        addTrack(paths[i]);
+        addTrack(paths[i], &vBitrateBatch);
 
 
         mtxLoadThreadDone.lock();
@@ -1964,6 +3602,22 @@ void AudioService::threadAddTracks(std::vector<std::wstring> paths, size_t iStar
         }
 
         mtxLoadThreadDone.unlock();
+
+
+        std::chrono::steady_clock::time_point tpNow = std::chrono::steady_clock::now();
+
+        if ( (vBitrateBatch.size() >= BITRATE_BATCH_SIZE) || (i == iStop)
+             || (tpNow - tpLastBatch >= std::chrono::milliseconds(BITRATE_BATCH_INTERVAL_MS)) )
+        {
+            showTracksBitrate(vBitrateBatch);
+
+            mtxLoadThreadDone.lock();
+            pAddedTracks->insert(pAddedTracks->end(), vBitrateBatch.begin(), vBitrateBatch.end());
+            mtxLoadThreadDone.unlock();
+
+            vBitrateBatch.clear();
+            tpLastBatch = tpNow;
+        }
     }
 
     *done = true;
@@ -1972,21 +3626,42 @@ void AudioService::threadAddTracks(std::vector<std::wstring> paths, size_t iStar
 
 AudioService::~AudioService()
 {
+    // The audio-control thread is stopped first: its commands start the other threads.
+
+    bMonitorTracks = false;
+    wakeUpMonitor();
+
+    if (monitorThread.joinable())
+    {
+        monitorThread.join();
+    }
+
     bDrawing = false;
-    mtxDrawGraph.lock();
-    mtxDrawGraph.unlock();
 
-    delete iCurrentlyDrawingTrackIndex;
+    if (drawGraphThread.joinable())
+    {
+        drawGraphThread.join();
+    }
 
-    delete pRndGen;
+    bPrepareSeekTables = false;
+    seekTableThreads.joinAll();
 
-    bMonitorTracks = false;
-    mtxTracksVec.lock();
-    mtxTracksVec.unlock();
-    std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS));
+    bAnalyzeLoudness = false;
+    bExportTracks    = false;
+    exportThreads  .joinAll();
+    loudnessThreads.joinAll();
+
+    impulseResponseThreads.joinAll();
+
+    bPreloadTracks = false;
+    preloadThreads.joinAll();
+
+    // The threads above could hand their results to the stopped audio-control thread
+    // (see setPreloadedSound(), setImpulseResponse()).
+    commandQueue.executeCommands();
 
     // FX
-    if ( (pPitch != nullptr) || (pPitchForTime != nullptr) || (pReverb != nullptr) || (pEcho != nullptr) || (pVST != nullptr) )
+    if ( (pPitch != nullptr) || (pTimeStretch != nullptr) || (pReverb != nullptr) || (pEcho != nullptr) || (pEqualizer != nullptr) || (pConvolutionReverb != nullptr) || (pVST != nullptr) || (pAnalyzer != nullptr) )
     {
         FMOD::ChannelGroup* pMaster;
         pSystem->getMasterChannelGroup(&pMaster);
@@ -1996,10 +3671,10 @@ AudioService::~AudioService()
             pMaster->removeDSP(pPitch);
             pPitch->release();
         }
-        if (pPitchForTime)
+        if (pTimeStretch)
         {
-            pMaster->removeDSP(pPitchForTime);
-            pPitchForTime->release();
+            pMaster->removeDSP(pTimeStretch);
+            pTimeStretch->release();
         }
         if (pReverb)
         {
@@ -2011,6 +3686,23 @@ AudioService::~AudioService()
             pMaster->removeDSP(pEcho);
             pEcho->release();
         }
+        if (pEqualizer)
+        {
+            pMaster->removeDSP(pEqualizer);
+            pEqualizer->release();
+        }
+        if (pConvolutionReverb)
+        {
+            pMaster->removeDSP(pConvolutionReverb);
+            pConvolutionReverb->release();
+        }
+        if (pAnalyzer)
+        {
+            pMasterAnalyzer = nullptr;
+
+            pMaster->removeDSP(pAnalyzer);
+            pAnalyzer->release();
+        }
         if (pVST)
         {
             pMaster->removeDSP(pVST);
@@ -2023,11 +3715,13 @@ AudioService::~AudioService()
 
     FMOD_RESULT result;
 
-    for (size_t i = 0; i < vTracks.size(); i++)
+    for (size_t i = 0; i < tracks.size(); i++)
     {
-        delete vTracks[i];
+        delete tracks.getTrack(i);
     }
-    vTracks.clear();
+    tracks.clear();
+
+    delete pPreloadCache;
 
     result = pSystem->release();
     if (result)
@@ -10,7 +10,23 @@
 // STL
 #include <vector>
 #include <mutex>
-#include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+
+// Custom
+#include "Model/PreloadCache/preloadcache.h"
+#include "Model/CommandQueue/commandqueue.h"
+#include "Model/PositionSnapshot/positionsnapshot.h"
+#include "Model/MeterBuffer/meterbuffer.h"
+#include "Model/FXProfileMonitor/fxprofilemonitor.h"
+#include "Model/TrackStore/trackstore.h"
+#include "Model/ShuffleBag/shufflebag.h"
+#include "Model/TrackHistory/trackhistory.h"
+#include "Model/TrackExporter/trackexporter.h"
+#include "Model/ThreadGroup/threadgroup.h"
 
 // FMOD
 #include "../ext/FMOD/inc/fmod.hpp"
@@ -24,6 +40,8 @@
 
 class MainWindow;
 class Track;
+class MasterAnalyzer;
+struct ImpulseResponse;
 
 
 
@@ -36,6 +54,21 @@ class AudioService
 public:
 
     AudioService(MainWindow* pMainWindow);
+    AudioService(MainWindow* pMainWindow,  char cOutputMode,  const std::string& sOutputFilePath);
+
+
+    // Audio-control thread (see monitorTrack())
+
+        void    enqueueCommand       (std::function<void()> command);
+        // Only the latest command of the slot (COMMAND_SLOT_...) is executed, used for the slider events.
+        void    enqueueLatestCommand (size_t iSlot,  std::function<void()> command);
+        CommandQueueStats getCommandQueueStats ();
+
+
+    // Virtual clock (non-realtime output modes, the audio-control thread is not started)
+
+        void    advanceTime          (unsigned int iTimeInMS);
+        unsigned long long getVirtualTimeInMS ();
 
 
     // Main functions
@@ -82,6 +115,10 @@ public:
         void    setSpeedByTime       (float     fSpeed);
         void    setReverbVolume      (float     fVolume);
         void    setEchoVolume        (float     fEchoVolume);
+        void    setEqualizerBandGain (int       iBand,  float fGainInDB);
+        // The convolution reverb replaces the SFX reverb while the impulse response is loaded (same wet volume).
+        void    loadImpulseResponse  (const std::wstring& sPathToFile);
+        void    unloadImpulseResponse();
 #if _WIN32
         void    loadVSTPlugin        (wchar_t*  pPathToDll);
         void    unloadVSTPlugin      ();
@@ -89,18 +126,44 @@ public:
         void    systemUpdate         ();
 
 
+    // FX profiles (FX_PROFILE_...)
+
+        // The FFT size is changed right away, the DSP buffer and the resampler can be set only before
+        // FMOD::System::init() so they stay the ones of the profile that the system was started with (DEFAULT_FX_PROFILE).
+        // FX_PROFILE_AUTO starts with the best quality and steps down when the DSP is overloaded.
+        void    setFXProfile         (char cProfile);
+        // Active profile (never FX_PROFILE_AUTO).
+        char    getFXProfile         ();
+        bool    isFXProfileAuto      ();
+        FXProfileStats getFXProfileStats (char cProfile);
+
+
+    // Export (the current FX are applied, see TrackExporter)
+
+        void    exportTrack          (size_t iTrackIndex,  const std::wstring& sOutputPath,  unsigned int iFromMS = 0,  unsigned int iToMS = 0);
+        void    exportTracks         (const std::vector<size_t>& vTrackIndices,  const std::wstring& sOutputFolder);
+        bool    isExportRunning      ();
+
+
     // Set
 
         void    addTracks            (std::vector<std::wstring>  paths);
         void    setVolume            (float                  fNewVolume);
         void    setTrackPos          (unsigned int           graphPos);
         void    setRepeatPoint       (unsigned int graphPos);
+        void    setCrossfade         (unsigned int iLengthInMS,      char cCurve);
+        void    setRepeatSectionSeamFade (unsigned int iLengthInMS);
+        void    setPreloadBudget     (unsigned int iBudgetInMB);
+        void    setLoudnessNormalization (char cMode);
 
 
     // Get
 
         std::string   getBloodyVersion     ();
         size_t        getPlayingTrackIndex (bool& bSomeTrackIsPlaying);
+        bool          getPlaybackPosition  (PlaybackPosition* pPosition);
+        bool          getMeterFrame        (MeterFrame* pFrame);
+        PreloadStats  getPreloadStats      ();
 
 
     // For testing
@@ -111,6 +174,13 @@ public:
         bool          isFMODStarted        ();
         bool          isSomeTrackIsPlaying ();
         bool          isCurrentTrackPaused ();
+        bool          isLoudnessAnalyzed   (size_t iTrackIndex);
+        bool          isSeekTableBuilt     (size_t iTrackIndex,  bool* pLoadedFromCache = nullptr);
+        // The sound opened with FMOD_ACCURATETIME is ready (or the track is already switched to it).
+        bool          isAccurateSoundReady (size_t iTrackIndex);
+        unsigned long long getMonitorWakeUpsCount ();
+        // DSP usage (%) that counts as the overload in FX_PROFILE_AUTO (FX_AUTO_OVERLOAD_DSP_USAGE by default).
+        void          setFXOverloadDSPUsage (float fDSPUsage);
 
 
 
@@ -124,28 +194,83 @@ private:
         bool   FMODinit        ();
 
     // Functions for execution in a separete thread
-        void   threadAddTracks (std::vector<std::wstring> paths, size_t iStart, size_t iStop, bool* done,  int* allCount,  int all);
-        bool   addTrack        (const std::wstring& sFilePath);
+        void   threadAddTracks (std::vector<std::wstring> paths, size_t iStart, size_t iStop, bool* done,  int* allCount,  int all,  std::vector<TrackHandle>* pAddedTracks);
+        bool   addTrack        (const std::wstring& sFilePath,  std::vector<TrackHandle>* pAddedTracks);
         std::wstring getTrackName  (const std::wstring& sFilePath);
 
-    // Will switch to next track if one's ended
+    // Audio-control thread: executes the commands from the Controller and will switch to next track if one's ended
         void   monitorTrack    ();
         bool   isCurrentTrackEnded();
         void   switchToOtherTrack();
+        unsigned int getMonitorSleepTimeMS();
+        unsigned int getTimeToTrackEndMS ();
+        void   wakeUpMonitor   ();
+        void   monitorPlayback (bool* pPlaying,  unsigned int* pSleepTimeMS);
+        void   publishPosition ();
+        void   publishPlayingTrack ();
+        void   checkFXOverload ();
+        void   applyFXProfile  ();
+        static void onTrackEnded (void* pUserData);
+
+    // Pitch, time stretch, reverb and echo (LAZY_FX_...) are in the master chain only while they are used
+        FMOD::DSP** getLazyFX  (char cEffect);
+        bool   createLazyFX    (char cEffect);
+        void   applyLazyFX     (char cEffect);
+        bool   releaseIdleFX   ();
+        void   insertIntoChain (FMOD::DSP* pDSP);
 
     // Will draw the oscillogram for the current track
-        void   drawGraph       (size_t* iTrackIndex);
+        void   drawGraph       (TrackHandle track);
 
     // Used in drawGraph()
         float* rawBytesToPCM16_0_1   (char* pBuffer, unsigned int iBufferSizeInBytes);
         float* rawBytesToPCM24_0_1   (char* pBuffer, unsigned int iBufferSizeInBytes);
         int    interpret24bitAsInt32 (char byte0, char byte1, char byte2);
 
+    // Gapless playback, crossfades and repeat section seam fades
+        void   scheduleNextTrack    ();
+        void   cancelTransitions    ();
+        void   cancelPendingTransition ();
+        void   scheduleRepeatSeamFade ();
+        size_t getNextTrackIndex    (bool bRandomNextTrackLocal);
+
+    // Index of the 'playingTrack' in the tracklist (0 if the tracklist is empty)
+        size_t getCurrentTrackIndex ();
+        unsigned long long getDSPClock       ();
+        unsigned long long msToDSPClocks     (unsigned int iTimeInMS);
+
     // Used in search()
         size_t findCaseInsensitive(std::wstring& sText, std::wstring& sKeyword);
 
-    // Used in addTracks()
-        void   calcBitrate     ();
+    // Used in addTracks() and threadAddTracks()
+        void   showTracksBitrate (const std::vector<TrackHandle>& vAddedTracks);
+
+    // Seek tables and FMOD_ACCURATETIME streams are prepared in a separate thread (see Track::setupTrack())
+        void   threadPrepareSeekTables (std::vector<TrackHandle> vAddedTracks);
+        void   threadOpenAccurateSound (TrackHandle track,  std::wstring sFilePath);
+        void   openAccurateSound       (TrackHandle track,  const std::wstring& sFilePath);
+        void   setAccurateSound        (TrackHandle track,  FMOD::Sound* pAccurateSound);
+
+    // The next track is read in memory in a separate thread (see PreloadCache)
+        void   preloadNextTrack        ();
+        void   threadPreloadTrack      (TrackHandle track,  std::wstring sFilePath);
+        void   setPreloadedSound       (TrackHandle track,  FMOD::Sound* pPreloadedSound, std::shared_ptr<std::vector<char>> pData);
+        void   checkFirstAudio         ();
+
+    // Loudness is analyzed by the pool of threads (see TrackLoudness)
+        void   threadAnalyzeLoudness   (std::vector<TrackHandle> vTracksToAnalyze);
+        void   workerAnalyzeLoudness   (const std::vector<TrackHandle>* pTracks,  const std::vector<std::wstring>* pPaths,  std::atomic<size_t>* pNextTrack);
+        float  getLoudnessGain         (Track* pTrack);
+
+    // Impulse response is decoded in a separate thread (see ConvolutionReverb::loadImpulseResponse())
+        void   threadLoadImpulseResponse (std::wstring sPathToFile,  unsigned int iRequest);
+        void   setImpulseResponse      (ImpulseResponse* pImpulseResponse,  const std::wstring& sPathToFile,  unsigned int iRequest);
+
+    // Export jobs are rendered by the pool of threads (see TrackExporter)
+        ExportSettings getExportSettings ();
+        ExportJob getExportJob         (size_t iTrackIndex,  const std::wstring& sOutputPath);
+        void   threadExportTracks      (std::vector<ExportJob> vJobs,  ExportSettings settings);
+        void   workerExportTracks      (const std::vector<ExportJob>* pJobs,  const ExportSettings* pSettings,  std::atomic<size_t>* pNextJob);
 
 
 
@@ -156,23 +281,77 @@ private:
 
     FMOD::System*     pSystem;
     MainWindow*       pMainWindow;
-    std::mt19937_64*  pRndGen;
 
 
     // FX
     FMOD::DSP*        pPitch;
-    FMOD::DSP*        pPitchForTime;
+    // See TimeStretch.
+    FMOD::DSP*        pTimeStretch;
     FMOD::DSP*        pReverb;
     FMOD::DSP*        pEcho;
+    // See Equalizer.
+    FMOD::DSP*        pEqualizer;
+    // See ConvolutionReverb.
+    FMOD::DSP*        pConvolutionReverb;
+    std::wstring      sImpulseResponsePath;
+    // Impulse response threads (see threadLoadImpulseResponse()), only the latest request is applied.
+    ThreadGroup       impulseResponseThreads;
+    std::atomic<unsigned int> iImpulseResponseRequest;
     FMOD::DSP*        pVST;
+    // See MasterAnalyzer (on the head of the master chain, measures the output).
+    FMOD::DSP*        pAnalyzer;
+    MasterAnalyzer*   pMasterAnalyzer;
     unsigned int      iVSTHandle;
 
 
+    // FX profile (see setFXProfile())
+    FXProfileMonitor  fxProfileMonitor;
+
+
     // Oscillogram  drawing
+    std::thread       drawGraphThread;
     std::mutex        mtxDrawGraph;
     std::mutex        mtxGetCurrentDrawingIndex;
-    size_t*           iCurrentlyDrawingTrackIndex;
-    bool              bDrawing;
+    std::atomic<bool> bDrawing;
+
+
+    // Seek tables
+    // Seek table and accurate sound threads (see threadPrepareSeekTables(), threadOpenAccurateSound()).
+    ThreadGroup       seekTableThreads;
+    std::mutex        mtxSeekTables;
+    std::atomic<bool> bPrepareSeekTables;
+
+
+    // Preload
+    PreloadCache*     pPreloadCache;
+    // Preload threads (see threadPreloadTrack()), one of them reads the file at a time.
+    ThreadGroup       preloadThreads;
+    std::mutex        mtxPreload;
+    std::atomic<bool> bPreloadTracks;
+    // Random next track is picked in advance so we can preload it.
+    TrackHandle       nextRandomTrack;
+    // Time from playTrack() to the first mixed audio of the track (see checkFirstAudio()).
+    std::chrono::steady_clock::time_point tpPlayRequested;
+    unsigned int      iFirstAudioStartPosInMS;
+    bool              bWaitingForFirstAudio;
+    bool              bFirstAudioPreloaded;
+
+
+    // Loudness normalization
+    // Loudness threads (see threadAnalyzeLoudness()), one of them analyzes the tracks at a time.
+    ThreadGroup       loudnessThreads;
+    std::mutex        mtxLoudness;
+    std::atomic<bool> bAnalyzeLoudness;
+    // Read by the import threads without 'mtxTracksVec' (see addTracks()).
+    std::atomic<char> cLoudnessNormalization;
+
+
+    // Export
+    // Export threads (see threadExportTracks()), one of them exports the tracks at a time.
+    ThreadGroup         exportThreads;
+    std::mutex          mtxExport;
+    std::atomic<bool>   bExportTracks;
+    std::atomic<size_t> iExportsInProgress;
 
 
     // Search
@@ -182,37 +361,81 @@ private:
 
 
     // Tracks
-    std::vector<Track*> vTracks;
-    std::vector<Track*> vTracksHistory;
+    // Tracks are addressed by handles (slot + generation), the order of the tracklist is kept separately.
+    TrackStore          tracks;
+    TrackHandle         playingTrack;
+    TrackHandle         scheduledTrack;
+    TrackHistory        tracksHistory;
+    // Play order of the 'random track' mode.
+    ShuffleBag          shuffleBag;
 
 
     // Repeat section
     char              cRepeatSectionState;
     unsigned int      iFirstRepeatTimePos;
     unsigned int      iSecondRepeatTimePos;
+    // Short fade around the jump from B to A (0 ms - no fade).
+    unsigned int      iRepeatSeamFadeInMS;
+    // DSP clock of the seam that already has the fade (0 if none).
+    unsigned long long iRepeatSeamDSPClock;
+
+
+    // Crossfade (0 ms - gapless)
+    unsigned int      iCrossfadeInMS;
+    // DSP clock when the 'scheduledTrack' starts (the transition is running after this clock).
+    unsigned long long iScheduledStartDSPClock;
+    char              cCrossfadeCurve;
 
 
 
     std::mutex        mtxTracksVec;
-    std::mutex        mtxThreadLoadAddTrack;
     std::mutex        mtxLoadThreadDone;
 
 
-    std::string       sBloodyVersion;
+    // Track monitor (audio-control thread)
+    CommandQueue            commandQueue;
+    PositionSnapshot        positionSnapshot;
+    // Index of the current track (shifted left by 1) and 'bIsSomeTrackPlaying' (the lowest bit), see publishPlayingTrack().
+    std::atomic<unsigned long long> iPublishedPlayingTrack;
+    std::thread             monitorThread;
+    std::mutex              mtxMonitorTrack;
+    std::condition_variable cvMonitorTrack;
+    bool                    bMonitorWakeUp;
+    std::atomic<unsigned long long> iMonitorWakeUps;
+    // Commands of enqueueLatestCommand() waiting in the queue (empty - the slot has no command in the queue).
+    std::mutex              mtxLatestCommands;
+    std::vector<std::function<void()>> vLatestCommands;
+
+
+    // Output (OUTPUT_MODE_...)
+    char              cOutputMode;
+    std::string       sOutputFilePath;
+    unsigned int      iDSPBufferLength;
+    int               iDSPBufferCount;
+    // Read once in FMODinit() so the GUI does not call FMOD (see getFXProfileStats()).
+    int               iOutputRate;
+    // Mixed samples in the non-realtime modes (see advanceTime()).
+    unsigned long long iVirtualClock;
 
 
-    size_t            iCurrentlyPlayingTrackIndex;
+    std::string       sBloodyVersion;
 
 
     float             fCurrentVolume;
+    float             fCurrentPan;
     float             fCurrentSpeedByPitch;
     float             fCurrentSpeedByTime;
+    float             fCurrentReverbVolume;
+    float             fCurrentPitch;
+    float             fCurrentEchoVolume;
+    // DSP clock when the lazy effect was bypassed (see releaseIdleFX()).
+    std::vector<unsigned long long> vLazyFXBypassClocks;
 
 
     bool              bIsSomeTrackPlaying;
     bool              bCurrentTrackPaused;
     bool              bRepeatTrack;
     bool              bRandomNextTrack;
-    bool              bMonitorTracks;
+    std::atomic<bool> bMonitorTracks;
     bool              bFMODStarted;
 };
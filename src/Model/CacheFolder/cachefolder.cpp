@@ -0,0 +1,123 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "cachefolder.h"
+
+// STL
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+// Custom
+#include "globalparams.h"
+
+// Other
+#if _WIN32
+#include <windows.h>
+#else
+#include <locale>
+#include <codecvt>
+#include <sys/stat.h>
+#endif
+
+bool CacheFolder::getFileInfo(const std::wstring& sFilePath, long long* pFileSize, long long* pModificationTime)
+{
+    // The cache is valid only if the file size and the last modification time are the same.
+
+#if _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA fileInfo;
+    if ( GetFileAttributesExW(sFilePath.c_str(), GetFileExInfoStandard, &fileInfo) == 0 )
+    {
+        return false;
+    }
+
+    *pFileSize         = (static_cast<long long>(fileInfo.nFileSizeHigh) << 32) | fileInfo.nFileSizeLow;
+    *pModificationTime = (static_cast<long long>(fileInfo.ftLastWriteTime.dwHighDateTime) << 32) | fileInfo.ftLastWriteTime.dwLowDateTime;
+#else
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+    auto out = utf8_conv.to_bytes(sFilePath);
+
+    struct stat fileInfo;
+    if (stat(out.c_str(), &fileInfo) == -1)
+    {
+        return false;
+    }
+
+    *pFileSize         = static_cast<long long>(fileInfo.st_size);
+    *pModificationTime = static_cast<long long>(fileInfo.st_mtime);
+#endif
+
+    return true;
+}
+
+std::wstring CacheFolder::getCacheFilePath(const std::wstring& sFilePath, const char* pSubfolder, const char* pExtension)
+{
+    // This function returns the path to the cache file of the 'sFilePath' in the 'pSubfolder' (empty string if there is no cache folder).
+    // Cache file name is the hash (FNV-1a) of the audio file path.
+
+    uint64_t iHash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < sFilePath.size(); i++)
+    {
+        iHash ^= static_cast<uint64_t>(sFilePath[i]);
+        iHash *= 1099511628211ULL;
+    }
+
+    char vHash[17];
+    for (int i = 0; i < 16; i++)
+    {
+        vHash[i] = "0123456789abcdef"[ (iHash >> ((15 - i) * 4)) & 0xF ];
+    }
+    vHash[16] = '\0';
+
+    std::string sFileName = std::string(vHash) + pExtension;
+
+
+#if _WIN32
+    const wchar_t* pLocalAppData = _wgetenv(L"LOCALAPPDATA");
+    if (pLocalAppData == nullptr)
+    {
+        return L"";
+    }
+
+    std::wstring sFolder = std::wstring(pLocalAppData) + L"\\" + std::wstring(CACHE_APP_FOLDER, CACHE_APP_FOLDER + strlen(CACHE_APP_FOLDER));
+    CreateDirectoryW(sFolder.c_str(), nullptr);
+
+    sFolder += L"\\" + std::wstring(pSubfolder, pSubfolder + strlen(pSubfolder));
+    CreateDirectoryW(sFolder.c_str(), nullptr);
+
+    return sFolder + L"\\" + std::wstring(sFileName.begin(), sFileName.end());
+#else
+    std::string sFolder;
+
+    const char* pCacheHome = getenv("XDG_CACHE_HOME");
+    const char* pHome      = getenv("HOME");
+
+    if ( (pCacheHome != nullptr) && (pCacheHome[0] != '\0') )
+    {
+        sFolder = pCacheHome;
+    }
+    else if (pHome != nullptr)
+    {
+        sFolder = std::string(pHome) + "/.cache";
+        mkdir(sFolder.c_str(), 0755);
+    }
+    else
+    {
+        return L"";
+    }
+
+    sFolder += std::string("/") + CACHE_APP_FOLDER;
+    mkdir(sFolder.c_str(), 0755);
+
+    sFolder += std::string("/") + pSubfolder;
+    mkdir(sFolder.c_str(), 0755);
+
+    std::string sCacheFilePath = sFolder + "/" + sFileName;
+
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+    return utf8_conv.from_bytes(sCacheFilePath);
+#endif
+}
@@ -0,0 +1,28 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <string>
+
+
+
+
+
+// Per-user cache folder of the player (%LOCALAPPDATA% on Windows, $XDG_CACHE_HOME or ~/.cache on Linux).
+// Every audio file has one cache file in each subfolder (see SeekTable, TrackLoudness),
+// the cache is valid only while the size and the modification time of the audio file are the same.
+
+class CacheFolder
+{
+
+public:
+
+        static bool          getFileInfo      (const std::wstring& sFilePath,  long long* pFileSize,  long long* pModificationTime);
+        static std::wstring  getCacheFilePath (const std::wstring& sFilePath,  const char* pSubfolder,  const char* pExtension);
+};
@@ -0,0 +1,136 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "commandqueue.h"
+
+CommandQueue::CommandQueue()
+{
+    // Empty queue - head and tail point to the dummy node.
+
+    CommandNode* pDummy = new CommandNode();
+    pDummy->pNext       = nullptr;
+
+    pHead               = pDummy;
+    pTail               = pDummy;
+
+    iExecutedCommands   = 0;
+    dLatencySumInMS     = 0.0;
+    dMaxLatencyInMS     = 0.0;
+}
+
+
+
+
+
+void CommandQueue::push(std::function<void()> command)
+{
+    // This function can be called from any thread.
+
+    CommandNode* pNode = new CommandNode();
+    pNode->pNext       = nullptr;
+    pNode->command     = std::move(command);
+    pNode->tpPushed    = std::chrono::steady_clock::now();
+
+    CommandNode* pPrev = pHead.exchange(pNode, std::memory_order_acq_rel);
+
+    // Until this store the consumer does not see the new node (and the nodes pushed after it).
+    pPrev->pNext.store(pNode, std::memory_order_release);
+}
+
+bool CommandQueue::isEmpty()
+{
+    // Consumer only.
+    // May return 'true' while a producer is inside of push(), the producer will wake up the consumer after push().
+
+    return pTail->pNext.load(std::memory_order_acquire) == nullptr;
+}
+
+size_t CommandQueue::executeCommands()
+{
+    // Consumer only.
+    // Executes all commands in the order they were pushed, returns the number of executed commands.
+
+    size_t iCount = 0;
+
+    std::function<void()>                  command;
+    std::chrono::steady_clock::time_point  tpPushed;
+
+    while ( pop(&command, &tpPushed) )
+    {
+        double dLatencyInMS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpPushed).count();
+
+        mtxStats.lock();
+
+        iExecutedCommands++;
+        dLatencySumInMS += dLatencyInMS;
+
+        if (dLatencyInMS > dMaxLatencyInMS)
+        {
+            dMaxLatencyInMS = dLatencyInMS;
+        }
+
+        mtxStats.unlock();
+
+
+        command();
+
+        iCount++;
+    }
+
+    return iCount;
+}
+
+CommandQueueStats CommandQueue::getStats()
+{
+    std::lock_guard<std::mutex> lock(mtxStats);
+
+    CommandQueueStats stats;
+
+    stats.iExecutedCommands   = iExecutedCommands;
+    stats.dAverageLatencyInMS = (iExecutedCommands > 0) ? (dLatencySumInMS / iExecutedCommands) : 0.0;
+    stats.dMaxLatencyInMS     = dMaxLatencyInMS;
+
+    return stats;
+}
+
+bool CommandQueue::pop(std::function<void()>* pCommand, std::chrono::steady_clock::time_point* pPushTime)
+{
+    // Consumer only.
+    // The popped node becomes the new dummy node.
+
+    CommandNode* pNext = pTail->pNext.load(std::memory_order_acquire);
+
+    if (pNext == nullptr)
+    {
+        return false;
+    }
+
+    *pCommand  = std::move(pNext->command);
+    *pPushTime = pNext->tpPushed;
+
+    pNext->command = nullptr;
+
+    delete pTail;
+    pTail = pNext;
+
+    return true;
+}
+
+
+
+
+
+CommandQueue::~CommandQueue()
+{
+    // Not executed commands are discarded.
+
+    while (pTail)
+    {
+        CommandNode* pNext = pTail->pNext.load(std::memory_order_acquire);
+
+        delete pTail;
+        pTail = pNext;
+    }
+}
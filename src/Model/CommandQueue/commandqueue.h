@@ -0,0 +1,99 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+
+
+
+
+
+struct CommandQueueStats
+{
+    unsigned long long iExecutedCommands;
+
+    // Time from push() to the start of the command execution.
+    double             dAverageLatencyInMS;
+    double             dMaxLatencyInMS;
+};
+
+
+
+
+
+// Multiple producers (GUI and other threads, see Controller) - single consumer (audio-control thread, see AudioService::monitorTrack()).
+// push() never blocks: a producer swaps the head pointer and links the node (Vyukov's MPSC queue),
+// the consumer walks the list from the tail that only it owns.
+
+class CommandQueue
+{
+
+public:
+
+    CommandQueue();
+
+
+
+
+
+    // Producers
+
+        void               push              (std::function<void()> command);
+
+
+    // Consumer
+
+        bool               isEmpty           ();
+        size_t             executeCommands   ();
+
+
+    // Stats
+
+        CommandQueueStats  getStats          ();
+
+
+
+
+    ~CommandQueue();
+
+private:
+
+    struct CommandNode
+    {
+        std::atomic<CommandNode*>              pNext;
+        std::function<void()>                  command;
+        std::chrono::steady_clock::time_point  tpPushed;
+    };
+
+
+    // Used in executeCommands()
+
+        bool               pop               (std::function<void()>* pCommand,  std::chrono::steady_clock::time_point* pPushTime);
+
+
+
+
+
+
+    // Last pushed node (producers).
+    std::atomic<CommandNode*>  pHead;
+
+    // Already executed node, its 'pNext' is the next command (consumer).
+    CommandNode*               pTail;
+
+
+    // Stats
+    std::mutex                 mtxStats;
+    unsigned long long         iExecutedCommands;
+    double                     dLatencySumInMS;
+    double                     dMaxLatencyInMS;
+};
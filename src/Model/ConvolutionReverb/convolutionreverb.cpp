@@ -0,0 +1,766 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "convolutionreverb.h"
+
+// STL
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+
+// Custom
+#include "Model/Track/track.h"
+#include "globalparams.h"
+#include "../ext/FMOD/inc/fmod.hpp"
+#include "../ext/FMOD/inc/fmod_errors.h"
+
+
+struct ConvolutionReverbDSPCallbacks
+{
+    static FMOD_RESULT F_CALLBACK create(FMOD_DSP_STATE* pDSPState)
+    {
+        pDSPState->plugindata = new ConvolutionReverb();
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK release(FMOD_DSP_STATE* pDSPState)
+    {
+        delete static_cast<ConvolutionReverb*>(pDSPState->plugindata);
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK read(FMOD_DSP_STATE* pDSPState, float* pInBuffer, float* pOutBuffer, unsigned int iLength, int iInChannels, int* pOutChannels)
+    {
+        static_cast<ConvolutionReverb*>(pDSPState->plugindata)->process(pInBuffer, pOutBuffer, iLength, iInChannels);
+
+        *pOutChannels = iInChannels;
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK setParameterFloat(FMOD_DSP_STATE* pDSPState, int iIndex, float fValue)
+    {
+        (void)iIndex;
+
+        static_cast<ConvolutionReverb*>(pDSPState->plugindata)->setWetLevel(fValue);
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK getParameterFloat(FMOD_DSP_STATE* pDSPState, int iIndex, float* pValue, char* pValueString)
+    {
+        (void)iIndex;
+
+        *pValue = static_cast<ConvolutionReverb*>(pDSPState->plugindata)->getWetLevel();
+
+        if (pValueString)
+        {
+            snprintf(pValueString, FMOD_DSP_GETPARAM_VALUESTR_LENGTH, "%.1f", static_cast<double>(*pValue));
+        }
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK setParameterData(FMOD_DSP_STATE* pDSPState, int iIndex, void* pData, unsigned int iLength)
+    {
+        (void)iIndex;
+        (void)iLength;
+
+        static_cast<ConvolutionReverb*>(pDSPState->plugindata)->setImpulseResponse( static_cast<ImpulseResponse*>(pData) );
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK setParameterBool(FMOD_DSP_STATE* pDSPState, int iIndex, FMOD_BOOL bValue)
+    {
+        (void)iIndex;
+
+        static_cast<ConvolutionReverb*>(pDSPState->plugindata)->setWaitForTail(bValue != 0);
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK getParameterBool(FMOD_DSP_STATE* pDSPState, int iIndex, FMOD_BOOL* pValue, char* pValueString)
+    {
+        (void)iIndex;
+
+        *pValue = static_cast<ConvolutionReverb*>(pDSPState->plugindata)->getWaitForTail();
+
+        if (pValueString)
+        {
+            snprintf(pValueString, FMOD_DSP_GETPARAM_VALUESTR_LENGTH, "%s", *pValue ? "On" : "Off");
+        }
+
+        return FMOD_OK;
+    }
+};
+
+ImpulseResponse::ImpulseResponse(size_t iPartitionCount, size_t iBinCount, size_t iBlockSize)
+    : iDelayLineSize  (iPartitionCount + CONVOLUTION_HEAD_PARTITIONS + 2),
+      iTailSlotCount  (CONVOLUTION_HEAD_PARTITIONS + 2),
+      vTailBlocks     (CONVOLUTION_HEAD_PARTITIONS + 2)
+{
+    this->iPartitionCount = iPartitionCount;
+    this->iBinCount       = iBinCount;
+    this->iBlockSize      = iBlockSize;
+    iLengthInMS           = 0;
+
+    vPartitionsRe .resize(2 * iPartitionCount * iBinCount, 0.0f);
+    vPartitionsIm .resize(2 * iPartitionCount * iBinCount, 0.0f);
+
+    vDelayLineRe  .resize(iDelayLineSize * 2 * iBinCount, 0.0f);
+    vDelayLineIm  .resize(iDelayLineSize * 2 * iBinCount, 0.0f);
+
+    vTail         .resize(iTailSlotCount * 2 * iBlockSize, 0.0f);
+    for (size_t i = 0; i < iTailSlotCount; i++)
+    {
+        vTailBlocks[i] = -1;
+    }
+
+    // The tail of the first 'head' blocks is silence (there was no input before them).
+    iBlock           = 0;
+    iRequestedBlock  = CONVOLUTION_HEAD_PARTITIONS - 1;
+    iCalculatedBlock = CONVOLUTION_HEAD_PARTITIONS - 1;
+}
+
+ConvolutionReverb::ConvolutionReverb() : fft(CONVOLUTION_BLOCK_SIZE * 2)
+{
+    iBlockSize              = CONVOLUTION_BLOCK_SIZE;
+    iBinCount               = CONVOLUTION_BLOCK_SIZE + 1;
+
+    fWetLevelInDB           = 0.0f;
+    bWaitForTail            = false;
+    iMissedTails            = 0;
+
+    pImpulseResponse        = nullptr;
+    fCurrentWetGain         = 0.0f;
+    iBlockPos               = 0;
+
+    vInputBlock             .resize(2 * iBlockSize, 0.0f);
+    vPreviousInputBlock     .resize(2 * iBlockSize, 0.0f);
+    vOutputBlock            .resize(2 * iBlockSize, 0.0f);
+    vTimeRe                 .resize(2 * iBlockSize, 0.0f);
+    vTimeIm                 .resize(2 * iBlockSize, 0.0f);
+    vSumRe                  .resize(2 * iBinCount,  0.0f);
+    vSumIm                  .resize(2 * iBinCount,  0.0f);
+
+    bStopWorker             = false;
+    pPendingImpulseResponse = nullptr;
+    bPendingImpulseResponse = false;
+    pRetiredImpulseResponse = nullptr;
+
+    vWorkerTimeRe           .resize(2 * iBlockSize, 0.0f);
+    vWorkerTimeIm           .resize(2 * iBlockSize, 0.0f);
+    vWorkerSumRe            .resize(2 * iBinCount,  0.0f);
+    vWorkerSumIm            .resize(2 * iBinCount,  0.0f);
+
+    workerThread = std::thread(&ConvolutionReverb::workerCalculateTail, this);
+}
+
+
+
+
+
+bool ConvolutionReverb::createDSP(FMOD::System* pSystem, FMOD::DSP** ppDSP)
+{
+    static FMOD_DSP_PARAMETER_DESC  vParameters[3];
+    static FMOD_DSP_PARAMETER_DESC* vParameterPointers[3];
+    static FMOD_DSP_DESCRIPTION     description;
+    static std::once_flag           descriptionReady;
+
+    std::call_once(descriptionReady, []
+    {
+        FMOD_DSP_INIT_PARAMDESC_FLOAT(vParameters[0], "Wet", "dB", "Wet level", -80.0f, 20.0f, 0.0f);
+        FMOD_DSP_INIT_PARAMDESC_DATA (vParameters[1], "Response", "", "Impulse response", FMOD_DSP_PARAMETER_DATA_TYPE_USER);
+        FMOD_DSP_INIT_PARAMDESC_BOOL (vParameters[2], "Wait for tail", "", "Wait for the worker thread", false, nullptr);
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            vParameterPointers[i] = &vParameters[i];
+        }
+
+        memset(&description, 0, sizeof(description));
+
+        description.pluginsdkversion  = FMOD_PLUGIN_SDK_VERSION;
+        strncpy(description.name, "Bloody Convolution", sizeof(description.name) - 1);
+        description.version           = 1;
+        description.numinputbuffers   = 1;
+        description.numoutputbuffers  = 1;
+        description.create            = ConvolutionReverbDSPCallbacks::create;
+        description.release           = ConvolutionReverbDSPCallbacks::release;
+        description.read              = ConvolutionReverbDSPCallbacks::read;
+        description.numparameters     = 3;
+        description.paramdesc         = vParameterPointers;
+        description.setparameterfloat = ConvolutionReverbDSPCallbacks::setParameterFloat;
+        description.getparameterfloat = ConvolutionReverbDSPCallbacks::getParameterFloat;
+        description.setparameterdata  = ConvolutionReverbDSPCallbacks::setParameterData;
+        description.setparameterbool  = ConvolutionReverbDSPCallbacks::setParameterBool;
+        description.getparameterbool  = ConvolutionReverbDSPCallbacks::getParameterBool;
+    });
+
+    return pSystem->createDSP(&description, ppDSP) == FMOD_OK;
+}
+
+ImpulseResponse* ConvolutionReverb::loadImpulseResponse(FMOD::System* pSystem, const std::wstring& sPathToFile, std::string* pErrorString)
+{
+    // Decode the whole file.
+
+    FMOD::Sound* pSound = nullptr;
+
+    if ( Track::openStream(pSystem, sPathToFile, true, &pSound, pErrorString) == false )
+    {
+        *pErrorString = std::string("ConvolutionReverb::loadImpulseResponse::FMOD::System::createStream() failed. Error: ") + *pErrorString;
+        return nullptr;
+    }
+
+    FMOD_SOUND_FORMAT format = FMOD_SOUND_FORMAT_NONE;
+    int   iChannels      = 0;
+    float fSoundRate     = 0.0f;
+    unsigned int iLength = 0;
+
+    pSound->getFormat(nullptr, &format, &iChannels, nullptr);
+    pSound->getDefaults(&fSoundRate, nullptr);
+    pSound->getLength(&iLength, FMOD_TIMEUNIT_PCM);
+
+    size_t iBytesPerSample = 0;
+    switch (format)
+    {
+        case FMOD_SOUND_FORMAT_PCM8:     iBytesPerSample = 1; break;
+        case FMOD_SOUND_FORMAT_PCM16:    iBytesPerSample = 2; break;
+        case FMOD_SOUND_FORMAT_PCM24:    iBytesPerSample = 3; break;
+        case FMOD_SOUND_FORMAT_PCM32:
+        case FMOD_SOUND_FORMAT_PCMFLOAT: iBytesPerSample = 4; break;
+        default:                         break;
+    }
+
+    if ( (iBytesPerSample == 0) || (iChannels < 1) || (iChannels > 2) || (iLength == 0) || (fSoundRate <= 0.0f) )
+    {
+        *pErrorString = "ConvolutionReverb::loadImpulseResponse() failed. Error: only mono and stereo PCM files are supported.";
+        pSound->release();
+        return nullptr;
+    }
+
+    size_t iFrameCount = std::min(static_cast<size_t>(iLength), static_cast<size_t>(fSoundRate * CONVOLUTION_MAX_IR_SECONDS));
+
+    std::vector<char> vData(iFrameCount * static_cast<size_t>(iChannels) * iBytesPerSample);
+
+    // The stream has read some data already.
+    pSound->seekData(0);
+
+    size_t iReadBytes = 0;
+    while (iReadBytes < vData.size())
+    {
+        unsigned int iRead = 0;
+        FMOD_RESULT result = pSound->readData(vData.data() + iReadBytes, static_cast<unsigned int>(vData.size() - iReadBytes), &iRead);
+
+        iReadBytes += iRead;
+
+        if ( result || (iRead == 0) )
+        {
+            break;
+        }
+    }
+
+    pSound->release();
+
+    iFrameCount = iReadBytes / (static_cast<size_t>(iChannels) * iBytesPerSample);
+
+
+    // To float (left, right).
+
+    std::vector<float> vSamples[2];
+    vSamples[0].resize(iFrameCount);
+    vSamples[1].resize(iFrameCount);
+
+    for (size_t i = 0; i < iFrameCount; i++)
+    {
+        for (int c = 0; c < 2; c++)
+        {
+            // Mono - same response for both channels.
+            const unsigned char* pSample = reinterpret_cast<const unsigned char*>(vData.data())
+                                           + (i * static_cast<size_t>(iChannels) + static_cast<size_t>(std::min(c, iChannels - 1))) * iBytesPerSample;
+
+            float fSample = 0.0f;
+
+            switch (format)
+            {
+                case FMOD_SOUND_FORMAT_PCM8:
+                    fSample = static_cast<signed char>(pSample[0]) / 128.0f;
+                    break;
+                case FMOD_SOUND_FORMAT_PCM16:
+                    fSample = static_cast<short>(pSample[0] | (pSample[1] << 8)) / 32768.0f;
+                    break;
+                case FMOD_SOUND_FORMAT_PCM24:
+                    fSample = static_cast<int>( (static_cast<unsigned int>(pSample[0]) << 8) | (static_cast<unsigned int>(pSample[1]) << 16)
+                                                | (static_cast<unsigned int>(pSample[2]) << 24) ) / 2147483648.0f;
+                    break;
+                case FMOD_SOUND_FORMAT_PCM32:
+                {
+                    int iSample = 0;
+                    memcpy(&iSample, pSample, 4);
+                    fSample = iSample / 2147483648.0f;
+                    break;
+                }
+                default:
+                    memcpy(&fSample, pSample, 4);
+                    break;
+            }
+
+            vSamples[c][i] = fSample;
+        }
+    }
+
+
+    // Resample to the output rate.
+
+    int iOutputRate = 0;
+    pSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr);
+
+    if ( (iOutputRate > 0) && (static_cast<int>(fSoundRate) != iOutputRate) && (iFrameCount > 1) )
+    {
+        double dStep = static_cast<double>(fSoundRate) / iOutputRate;
+        size_t iNewFrameCount = static_cast<size_t>( (iFrameCount - 1) / dStep ) + 1;
+
+        for (int c = 0; c < 2; c++)
+        {
+            std::vector<float> vResampled(iNewFrameCount);
+
+            for (size_t i = 0; i < iNewFrameCount; i++)
+            {
+                double dPos   = i * dStep;
+                size_t iPos   = static_cast<size_t>(dPos);
+                float  fFrac  = static_cast<float>(dPos - iPos);
+                float  fNext  = (iPos + 1 < iFrameCount) ? vSamples[c][iPos + 1] : vSamples[c][iPos];
+
+                vResampled[i] = vSamples[c][iPos] + (fNext - vSamples[c][iPos]) * fFrac;
+            }
+
+            vSamples[c].swap(vResampled);
+        }
+
+        iFrameCount = iNewFrameCount;
+    }
+
+
+    // Unit energy (of the louder channel), so the wet level is about the level of the dry signal.
+
+    double dMaxEnergy = 0.0;
+    for (int c = 0; c < 2; c++)
+    {
+        double dEnergy = 0.0;
+        for (size_t i = 0; i < iFrameCount; i++)
+        {
+            dEnergy += static_cast<double>(vSamples[c][i]) * vSamples[c][i];
+        }
+
+        dMaxEnergy = std::max(dMaxEnergy, dEnergy);
+    }
+
+    if (dMaxEnergy <= 0.0)
+    {
+        *pErrorString = "ConvolutionReverb::loadImpulseResponse() failed. Error: the impulse response is silent.";
+        return nullptr;
+    }
+
+    float fScale = static_cast<float>( 1.0 / std::sqrt(dMaxEnergy) );
+
+
+    // Spectra of the partitions (both channels in one FFT).
+
+    const size_t iBlockSize = CONVOLUTION_BLOCK_SIZE;
+    const size_t iBinCount  = iBlockSize + 1;
+
+    size_t iPartitionCount = (iFrameCount + iBlockSize - 1) / iBlockSize;
+
+    ImpulseResponse* pImpulseResponse = new ImpulseResponse(iPartitionCount, iBinCount, iBlockSize);
+    pImpulseResponse->iLengthInMS = static_cast<unsigned int>( iFrameCount * 1000 / static_cast<size_t>(iOutputRate > 0 ? iOutputRate : 1) );
+
+    FFT fft(iBlockSize * 2);
+
+    std::vector<float> vRe(iBlockSize * 2);
+    std::vector<float> vIm(iBlockSize * 2);
+
+    for (size_t p = 0; p < iPartitionCount; p++)
+    {
+        std::fill(vRe.begin(), vRe.end(), 0.0f);
+        std::fill(vIm.begin(), vIm.end(), 0.0f);
+
+        for (size_t i = 0; (i < iBlockSize) && (p * iBlockSize + i < iFrameCount); i++)
+        {
+            vRe[i] = vSamples[0][p * iBlockSize + i] * fScale;
+            vIm[i] = vSamples[1][p * iBlockSize + i] * fScale;
+        }
+
+        fft.forward(vRe.data(), vIm.data());
+
+        splitSpectrum(vRe.data(), vIm.data(), iBlockSize * 2,
+                      &pImpulseResponse->vPartitionsRe[p * iBinCount],                     &pImpulseResponse->vPartitionsIm[p * iBinCount],
+                      &pImpulseResponse->vPartitionsRe[(iPartitionCount + p) * iBinCount], &pImpulseResponse->vPartitionsIm[(iPartitionCount + p) * iBinCount]);
+    }
+
+    return pImpulseResponse;
+}
+
+void ConvolutionReverb::setImpulseResponse(FMOD::DSP* pDSP, ImpulseResponse* pImpulseResponse)
+{
+    pDSP->setParameterData(1, pImpulseResponse, sizeof(ImpulseResponse*));
+}
+
+void ConvolutionReverb::process(const float* pIn, float* pOut, unsigned int iFrameCount, int iChannels)
+{
+    for (unsigned int iFrame = 0; iFrame < iFrameCount; iFrame++)
+    {
+        const float* pInFrame  = pIn  + iFrame * static_cast<size_t>(iChannels);
+        float*       pOutFrame = pOut + iFrame * static_cast<size_t>(iChannels);
+
+        vInputBlock[iBlockPos]              = pInFrame[0];
+        vInputBlock[iBlockSize + iBlockPos] = (iChannels > 1) ? pInFrame[1] : 0.0f;
+
+        pOutFrame[0] = pInFrame[0] + vOutputBlock[iBlockPos];
+        if (iChannels > 1)
+        {
+            pOutFrame[1] = pInFrame[1] + vOutputBlock[iBlockSize + iBlockPos];
+        }
+
+        for (int c = 2; c < iChannels; c++)
+        {
+            pOutFrame[c] = pInFrame[c];
+        }
+
+        iBlockPos++;
+
+        if (iBlockPos == iBlockSize)
+        {
+            processBlock();
+
+            iBlockPos = 0;
+        }
+    }
+}
+
+void ConvolutionReverb::setImpulseResponse(ImpulseResponse* pImpulseResponse)
+{
+    std::lock_guard<std::mutex> lock(mtxWorker);
+
+    // Was not taken by the audio thread.
+    delete pPendingImpulseResponse;
+
+    pPendingImpulseResponse = pImpulseResponse;
+    bPendingImpulseResponse = true;
+}
+
+void ConvolutionReverb::setWetLevel(float fWetLevelInDB)
+{
+    this->fWetLevelInDB = std::max(-80.0f, std::min(20.0f, fWetLevelInDB));
+}
+
+void ConvolutionReverb::setWaitForTail(bool bWaitForTail)
+{
+    this->bWaitForTail = bWaitForTail;
+}
+
+float ConvolutionReverb::getWetLevel() const
+{
+    return fWetLevelInDB;
+}
+
+bool ConvolutionReverb::getWaitForTail() const
+{
+    return bWaitForTail;
+}
+
+unsigned long long ConvolutionReverb::getMissedTails() const
+{
+    return iMissedTails;
+}
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+    mtxWorker.lock();
+    bStopWorker = true;
+    mtxWorker.unlock();
+
+    cvWorker.notify_one();
+
+    workerThread.join();
+
+    delete pImpulseResponse;
+    delete pPendingImpulseResponse;
+    delete pRetiredImpulseResponse;
+}
+
+void ConvolutionReverb::processBlock()
+{
+    // Wet output of the block that was just filled (played during the next block).
+
+    swapImpulseResponse();
+
+    float fTargetWetGain = 0.0f;
+    if ( pImpulseResponse && (pImpulseResponse->iPartitionCount > 0) && (fWetLevelInDB > -80.0f) )
+    {
+        fTargetWetGain = std::pow(10.0f, fWetLevelInDB / 20.0f);
+    }
+
+    if ( (pImpulseResponse == nullptr) || (pImpulseResponse->iPartitionCount == 0) )
+    {
+        std::fill(vOutputBlock.begin(), vOutputBlock.end(), 0.0f);
+
+        vInputBlock.swap(vPreviousInputBlock);
+        fCurrentWetGain = fTargetWetGain;
+
+        return;
+    }
+
+    ImpulseResponse* pResponse = pImpulseResponse;
+
+    const size_t iFFTSize  = iBlockSize * 2;
+    const size_t iHead     = std::min(static_cast<size_t>(CONVOLUTION_HEAD_PARTITIONS), pResponse->iPartitionCount);
+    const bool   bHasTail  = pResponse->iPartitionCount > CONVOLUTION_HEAD_PARTITIONS;
+    long long    iBlock    = pResponse->iBlock;
+
+
+    // Spectrum of the last two blocks (overlap-save) to the delay line.
+
+    memcpy(&vTimeRe[0],          &vPreviousInputBlock[0],          iBlockSize * sizeof(float));
+    memcpy(&vTimeRe[iBlockSize], &vInputBlock[0],                  iBlockSize * sizeof(float));
+    memcpy(&vTimeIm[0],          &vPreviousInputBlock[iBlockSize], iBlockSize * sizeof(float));
+    memcpy(&vTimeIm[iBlockSize], &vInputBlock[iBlockSize],         iBlockSize * sizeof(float));
+
+    fft.forward(vTimeRe.data(), vTimeIm.data());
+
+    size_t iSlot = static_cast<size_t>(iBlock % static_cast<long long>(pResponse->iDelayLineSize));
+    float* pLeftRe  = &pResponse->vDelayLineRe[(iSlot * 2)     * iBinCount];
+    float* pLeftIm  = &pResponse->vDelayLineIm[(iSlot * 2)     * iBinCount];
+    float* pRightRe = &pResponse->vDelayLineRe[(iSlot * 2 + 1) * iBinCount];
+    float* pRightIm = &pResponse->vDelayLineIm[(iSlot * 2 + 1) * iBinCount];
+
+    splitSpectrum(vTimeRe.data(), vTimeIm.data(), iFFTSize, pLeftRe, pLeftIm, pRightRe, pRightIm);
+
+    if (bHasTail)
+    {
+        // The tail of the block 'head' blocks later has all the input now.
+        pResponse->iRequestedBlock = iBlock + CONVOLUTION_HEAD_PARTITIONS;
+        cvWorker.notify_one();
+    }
+
+
+    // Head.
+
+    multiplyPartitions(pResponse, iBlock, 0, iHead, vSumRe.data(), vSumIm.data());
+
+    mergeSpectrum(&vSumRe[0], &vSumIm[0], &vSumRe[iBinCount], &vSumIm[iBinCount], iFFTSize, vTimeRe.data(), vTimeIm.data());
+
+    fft.inverse(vTimeRe.data(), vTimeIm.data());
+
+
+    // Tail (calculated by the worker thread).
+
+    const float* pTail = nullptr;
+
+    if ( bHasTail && (iBlock >= CONVOLUTION_HEAD_PARTITIONS) )
+    {
+        size_t iTailSlot = static_cast<size_t>(iBlock % static_cast<long long>(pResponse->iTailSlotCount));
+
+        if (bWaitForTail)
+        {
+            while (pResponse->vTailBlocks[iTailSlot].load(std::memory_order_acquire) != iBlock)
+            {
+                cvWorker.notify_one();
+                std::this_thread::yield();
+            }
+        }
+
+        if (pResponse->vTailBlocks[iTailSlot].load(std::memory_order_acquire) == iBlock)
+        {
+            pTail = &pResponse->vTail[iTailSlot * 2 * iBlockSize];
+        }
+        else
+        {
+            iMissedTails++;
+        }
+    }
+
+
+    // Output with the wet level (changes smoothly during the block).
+
+    float fGainStep = (fTargetWetGain - fCurrentWetGain) / iBlockSize;
+
+    for (size_t i = 0; i < iBlockSize; i++)
+    {
+        float fGain = fCurrentWetGain + fGainStep * (i + 1);
+
+        float fLeft  = vTimeRe[iBlockSize + i];
+        float fRight = vTimeIm[iBlockSize + i];
+
+        if (pTail)
+        {
+            fLeft  += pTail[i];
+            fRight += pTail[iBlockSize + i];
+        }
+
+        vOutputBlock[i]              = fLeft  * fGain;
+        vOutputBlock[iBlockSize + i] = fRight * fGain;
+    }
+
+    fCurrentWetGain = fTargetWetGain;
+
+    vInputBlock.swap(vPreviousInputBlock);
+
+    pResponse->iBlock = iBlock + 1;
+}
+
+void ConvolutionReverb::swapImpulseResponse()
+{
+    // The audio thread never waits for the lock: if the worker thread is busy we will swap on the next block.
+
+    if ( (bPendingImpulseResponse == false) || (mtxWorker.try_lock() == false) )
+    {
+        return;
+    }
+
+    // The worker thread has not deleted the last one yet.
+    if (pRetiredImpulseResponse == nullptr)
+    {
+        pRetiredImpulseResponse = pImpulseResponse;
+        pImpulseResponse        = pPendingImpulseResponse;
+        pPendingImpulseResponse = nullptr;
+        bPendingImpulseResponse = false;
+    }
+
+    mtxWorker.unlock();
+
+    cvWorker.notify_one();
+}
+
+void ConvolutionReverb::splitSpectrum(const float* pRe, const float* pIm, size_t iSize, float* pLeftRe, float* pLeftIm, float* pRightRe, float* pRightIm)
+{
+    // z = l + i * r (l and r are real) -> L[k] = (Z[k] + conj(Z[N - k])) / 2, R[k] = (Z[k] - conj(Z[N - k])) / 2i.
+
+    for (size_t k = 0; k <= iSize / 2; k++)
+    {
+        size_t iMirrored = (iSize - k) & (iSize - 1);
+
+        pLeftRe[k]  = (pRe[k] + pRe[iMirrored]) * 0.5f;
+        pLeftIm[k]  = (pIm[k] - pIm[iMirrored]) * 0.5f;
+        pRightRe[k] = (pIm[k] + pIm[iMirrored]) * 0.5f;
+        pRightIm[k] = (pRe[iMirrored] - pRe[k]) * 0.5f;
+    }
+}
+
+void ConvolutionReverb::mergeSpectrum(const float* pLeftRe, const float* pLeftIm, const float* pRightRe, const float* pRightIm, size_t iSize, float* pRe, float* pIm)
+{
+    // Z[k] = L[k] + i * R[k], Z[N - k] = conj(L[k]) + i * conj(R[k]).
+
+    for (size_t k = 0; k <= iSize / 2; k++)
+    {
+        pRe[k] = pLeftRe[k] - pRightIm[k];
+        pIm[k] = pLeftIm[k] + pRightRe[k];
+
+        if ( (k > 0) && (k < iSize / 2) )
+        {
+            pRe[iSize - k] = pLeftRe[k]  + pRightIm[k];
+            pIm[iSize - k] = pRightRe[k] - pLeftIm[k];
+        }
+    }
+}
+
+void ConvolutionReverb::multiplyPartitions(ImpulseResponse* pImpulseResponse, long long iOutputBlock, size_t iFirst, size_t iLast, float* pSumRe, float* pSumIm)
+{
+    const size_t iBinCount = pImpulseResponse->iBinCount;
+
+    std::fill(pSumRe, pSumRe + 2 * iBinCount, 0.0f);
+    std::fill(pSumIm, pSumIm + 2 * iBinCount, 0.0f);
+
+    for (size_t p = iFirst; p < iLast; p++)
+    {
+        long long iInputBlock = iOutputBlock - static_cast<long long>(p);
+
+        if (iInputBlock < 0)
+        {
+            // No input before the first block.
+            break;
+        }
+
+        size_t iSlot = static_cast<size_t>(iInputBlock % static_cast<long long>(pImpulseResponse->iDelayLineSize));
+
+        for (size_t c = 0; c < 2; c++)
+        {
+            const float* pInputRe     = &pImpulseResponse->vDelayLineRe[(iSlot * 2 + c) * iBinCount];
+            const float* pInputIm     = &pImpulseResponse->vDelayLineIm[(iSlot * 2 + c) * iBinCount];
+            const float* pPartitionRe = &pImpulseResponse->vPartitionsRe[(c * pImpulseResponse->iPartitionCount + p) * iBinCount];
+            const float* pPartitionIm = &pImpulseResponse->vPartitionsIm[(c * pImpulseResponse->iPartitionCount + p) * iBinCount];
+
+            float* pChannelSumRe = pSumRe + c * iBinCount;
+            float* pChannelSumIm = pSumIm + c * iBinCount;
+
+            for (size_t k = 0; k < iBinCount; k++)
+            {
+                pChannelSumRe[k] += pInputRe[k] * pPartitionRe[k] - pInputIm[k] * pPartitionIm[k];
+                pChannelSumIm[k] += pInputRe[k] * pPartitionIm[k] + pInputIm[k] * pPartitionRe[k];
+            }
+        }
+    }
+}
+
+void ConvolutionReverb::workerCalculateTail()
+{
+    std::unique_lock<std::mutex> lock(mtxWorker);
+
+    while (bStopWorker == false)
+    {
+        // The notification may be missed (the audio thread does not take the lock), so we don't wait for long.
+        cvWorker.wait_for(lock, std::chrono::milliseconds(CONVOLUTION_WORKER_WAIT_MS), [this]
+        {
+            return bStopWorker || pRetiredImpulseResponse
+                   || ( pImpulseResponse && (pImpulseResponse->iRequestedBlock > pImpulseResponse->iCalculatedBlock) );
+        });
+
+        delete pRetiredImpulseResponse;
+        pRetiredImpulseResponse = nullptr;
+
+        // The audio thread does not replace the response while we hold the lock.
+        ImpulseResponse* pResponse = pImpulseResponse;
+
+        if (pResponse == nullptr)
+        {
+            continue;
+        }
+
+        const size_t iFFTSize = iBlockSize * 2;
+
+        while ( (bStopWorker == false) && (pResponse->iCalculatedBlock < pResponse->iRequestedBlock) )
+        {
+            pResponse->iCalculatedBlock++;
+
+            long long iOutputBlock = pResponse->iCalculatedBlock;
+
+            if (iOutputBlock < pResponse->iBlock)
+            {
+                // Too late, the block is played already.
+                continue;
+            }
+
+            multiplyPartitions(pResponse, iOutputBlock, CONVOLUTION_HEAD_PARTITIONS, pResponse->iPartitionCount,
+                               vWorkerSumRe.data(), vWorkerSumIm.data());
+
+            mergeSpectrum(&vWorkerSumRe[0], &vWorkerSumIm[0], &vWorkerSumRe[iBinCount], &vWorkerSumIm[iBinCount],
+                          iFFTSize, vWorkerTimeRe.data(), vWorkerTimeIm.data());
+
+            fft.inverse(vWorkerTimeRe.data(), vWorkerTimeIm.data());
+
+            size_t iTailSlot = static_cast<size_t>(iOutputBlock % static_cast<long long>(pResponse->iTailSlotCount));
+            float* pTail     = &pResponse->vTail[iTailSlot * 2 * iBlockSize];
+
+            memcpy(pTail,              &vWorkerTimeRe[iBlockSize], iBlockSize * sizeof(float));
+            memcpy(pTail + iBlockSize, &vWorkerTimeIm[iBlockSize], iBlockSize * sizeof(float));
+
+            pResponse->vTailBlocks[iTailSlot].store(iOutputBlock, std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,211 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+// Custom
+#include "Model/FFT/fft.h"
+
+
+
+
+
+struct ConvolutionReverbDSPCallbacks;
+
+namespace FMOD
+{
+    class System;
+    class DSP;
+}
+
+
+
+
+
+// Impulse response prepared for the ConvolutionReverb (see ConvolutionReverb::loadImpulseResponse())
+// with all buffers that the convolution needs for it, so nothing is allocated in the audio thread.
+
+struct ImpulseResponse
+{
+    ImpulseResponse(size_t iPartitionCount,  size_t iBinCount,  size_t iBlockSize);
+
+
+    size_t                               iPartitionCount;
+    size_t                               iBinCount;
+    size_t                               iBlockSize;
+    unsigned int                         iLengthInMS;
+
+
+    // Spectra of the partitions (half spectra, left and right): [channel][partition][bin].
+    std::vector<float>                   vPartitionsRe;
+    std::vector<float>                   vPartitionsIm;
+
+    // Spectra of the last input blocks (frequency-domain delay line): [slot][channel][bin].
+    size_t                               iDelayLineSize;
+    std::vector<float>                   vDelayLineRe;
+    std::vector<float>                   vDelayLineIm;
+
+    // Output of the tail partitions (calculated by the worker thread): [slot][channel][frame]
+    // and the output block that is stored in the slot.
+    size_t                               iTailSlotCount;
+    std::vector<float>                   vTail;
+    std::vector<std::atomic<long long>>  vTailBlocks;
+
+    // Blocks processed by the audio thread, the last output block that needs the tail
+    // and the last one calculated by the worker thread.
+    std::atomic<long long>               iBlock;
+    std::atomic<long long>               iRequestedBlock;
+    long long                            iCalculatedBlock;
+};
+
+
+
+
+
+// Reverb that convolves the signal with the loaded impulse response as the FMOD DSP.
+// Uniformly partitioned overlap-save convolution: the response is split into CONVOLUTION_BLOCK_SIZE frames
+// and the spectrum of every input block is multiplied with the spectra of all partitions.
+// The audio thread handles the first CONVOLUTION_HEAD_PARTITIONS partitions (the head)
+// and the worker thread calculates the rest (the tail) of the future blocks in the background
+// (the tail of the block is needed 'head' blocks later).
+// Left and right channels go through one complex FFT (left - real part, right - imaginary part),
+// the wet signal is one block late (pre-delay), the dry signal is not delayed.
+
+class ConvolutionReverb
+{
+
+public:
+
+    ConvolutionReverb();
+
+
+
+
+
+    // FMOD
+
+        // Parameters: 0 - wet level (dB, same range as the SFX reverb), 1 - impulse response (see setImpulseResponse()),
+        // 2 - wait for the tail (bool, for the non-realtime output: the audio thread waits for the worker thread
+        // instead of skipping the tail that was not calculated in time).
+        static bool         createDSP              (FMOD::System* pSystem,  FMOD::DSP** ppDSP);
+
+        // Returns nullptr on error. Decoded by FMOD and resampled to the output rate of 'pSystem'.
+        static ImpulseResponse* loadImpulseResponse (FMOD::System* pSystem,  const std::wstring& sPathToFile,  std::string* pErrorString);
+
+        // The DSP becomes the owner of 'pImpulseResponse' (nullptr - no reverb).
+        static void         setImpulseResponse     (FMOD::DSP* pDSP,  ImpulseResponse* pImpulseResponse);
+
+
+    // Main functions
+
+        // 'pIn' and 'pOut' - interleaved samples, 'iFrameCount' samples of every channel.
+        // Only the first two channels get the reverb.
+        void                process                (const float* pIn,  float* pOut,  unsigned int iFrameCount,  int iChannels);
+
+
+    // 'Set' functions
+
+        // Can be called from any thread, the audio thread takes the response on the next block.
+        // The object becomes the owner of 'pImpulseResponse' (nullptr - no reverb).
+        void                setImpulseResponse     (ImpulseResponse* pImpulseResponse);
+        void                setWetLevel            (float fWetLevelInDB);
+        void                setWaitForTail         (bool  bWaitForTail);
+
+
+    // 'Get' functions
+
+        float               getWetLevel            () const;
+        bool                getWaitForTail         () const;
+        // Blocks that were played without the tail because the worker thread was late.
+        unsigned long long  getMissedTails         () const;
+
+
+    ~ConvolutionReverb();
+
+
+
+
+
+private:
+
+    friend struct ConvolutionReverbDSPCallbacks;
+
+
+    // Used in process()
+
+        void                processBlock           ();
+        void                swapImpulseResponse    ();
+
+
+    // Convolution
+
+        // Spectrum of the two channels in the complex array -> half spectra of the channels.
+        static void         splitSpectrum          (const float* pRe,  const float* pIm,  size_t iSize,
+                                                    float* pLeftRe,  float* pLeftIm,  float* pRightRe,  float* pRightIm);
+        static void         mergeSpectrum          (const float* pLeftRe,  const float* pLeftIm,  const float* pRightRe,  const float* pRightIm,
+                                                    size_t iSize,  float* pRe,  float* pIm);
+        // Sum of the input spectra of the blocks before 'iOutputBlock' multiplied with the partitions [iFirst, iLast).
+        static void         multiplyPartitions     (ImpulseResponse* pImpulseResponse,  long long iOutputBlock,  size_t iFirst,  size_t iLast,
+                                                    float* pSumRe,  float* pSumIm);
+
+
+    // Worker thread
+
+        void                workerCalculateTail    ();
+
+
+    FFT                          fft;
+    size_t                       iBlockSize;
+    size_t                       iBinCount;
+
+
+    // Parameters
+    std::atomic<float>           fWetLevelInDB;
+    std::atomic<bool>            bWaitForTail;
+    std::atomic<unsigned long long> iMissedTails;
+
+
+    // Audio thread
+    ImpulseResponse*             pImpulseResponse;
+    float                        fCurrentWetGain;
+    // Input of the current block and output of the last one: [channel][frame], 'iBlockPos' frames of the block are done.
+    std::vector<float>           vInputBlock;
+    std::vector<float>           vPreviousInputBlock;
+    std::vector<float>           vOutputBlock;
+    size_t                       iBlockPos;
+    // FFT buffers and the sum of the head partitions.
+    std::vector<float>           vTimeRe;
+    std::vector<float>           vTimeIm;
+    std::vector<float>           vSumRe;
+    std::vector<float>           vSumIm;
+
+
+    // Worker thread
+    // Locked by the worker thread while it's calculating and by the audio thread (try_lock) to swap the responses.
+    std::mutex                   mtxWorker;
+    std::condition_variable      cvWorker;
+    std::thread                  workerThread;
+    bool                         bStopWorker;
+    // Set by setImpulseResponse(), taken by the audio thread (under mtxWorker).
+    ImpulseResponse*             pPendingImpulseResponse;
+    std::atomic<bool>            bPendingImpulseResponse;
+    // Replaced by the audio thread, deleted by the worker thread.
+    ImpulseResponse*             pRetiredImpulseResponse;
+    // Buffers of the worker thread.
+    std::vector<float>           vWorkerTimeRe;
+    std::vector<float>           vWorkerTimeIm;
+    std::vector<float>           vWorkerSumRe;
+    std::vector<float>           vWorkerSumIm;
+};
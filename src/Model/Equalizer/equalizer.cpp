@@ -0,0 +1,354 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "equalizer.h"
+
+// STL
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+// Custom
+#include "globalparams.h"
+#include "../ext/FMOD/inc/fmod.hpp"
+
+
+struct EqualizerDSPCallbacks
+{
+    static FMOD_RESULT F_CALLBACK create(FMOD_DSP_STATE* pDSPState)
+    {
+        int iSampleRate = 0;
+        FMOD_DSP_GETSAMPLERATE(pDSPState, &iSampleRate);
+
+        pDSPState->plugindata = new Equalizer( static_cast<float>(iSampleRate) );
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK release(FMOD_DSP_STATE* pDSPState)
+    {
+        delete static_cast<Equalizer*>(pDSPState->plugindata);
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK reset(FMOD_DSP_STATE* pDSPState)
+    {
+        static_cast<Equalizer*>(pDSPState->plugindata)->reset();
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK read(FMOD_DSP_STATE* pDSPState, float* pInBuffer, float* pOutBuffer, unsigned int iLength, int iInChannels, int* pOutChannels)
+    {
+        static_cast<Equalizer*>(pDSPState->plugindata)->process(pInBuffer, pOutBuffer, iLength, iInChannels);
+
+        *pOutChannels = iInChannels;
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK shouldIProcess(FMOD_DSP_STATE* pDSPState, FMOD_BOOL bInputsIdle, unsigned int iLength, FMOD_CHANNELMASK inMask, int iInChannels, FMOD_SPEAKERMODE speakerMode)
+    {
+        (void)pDSPState;
+        (void)iLength;
+        (void)inMask;
+        (void)iInChannels;
+        (void)speakerMode;
+
+        return bInputsIdle ? FMOD_ERR_DSP_DONTPROCESS : FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK setParameterFloat(FMOD_DSP_STATE* pDSPState, int iIndex, float fValue)
+    {
+        static_cast<Equalizer*>(pDSPState->plugindata)->setBandGain(iIndex, fValue);
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK getParameterFloat(FMOD_DSP_STATE* pDSPState, int iIndex, float* pValue, char* pValueString)
+    {
+        *pValue = static_cast<Equalizer*>(pDSPState->plugindata)->getBandGain(iIndex);
+
+        if (pValueString)
+        {
+            snprintf(pValueString, FMOD_DSP_GETPARAM_VALUESTR_LENGTH, "%.1f", static_cast<double>(*pValue));
+        }
+
+        return FMOD_OK;
+    }
+};
+
+Equalizer::Equalizer(float fSampleRate)
+{
+    this->fSampleRate   = fSampleRate;
+    iBandCount          = EQ_BAND_COUNT;
+
+    vTargetGains        .resize(iBandCount, 0.0f);
+    bTargetGainsChanged = false;
+
+    vAudioTargetGains   .resize(iBandCount, 0.0f);
+    vCurrentGains       .resize(iBandCount, 0.0f);
+    vCoefficients       .resize(iBandCount * 5, 0.0f);
+    vZ1                 .resize(iBandCount * EQ_MAX_CHANNELS, 0.0f);
+    vZ2                 .resize(iBandCount * EQ_MAX_CHANNELS, 0.0f);
+
+    for (int i = 0; i < iBandCount; i++)
+    {
+        calculateCoefficients(i, 0.0f, &vCoefficients[i * 5]);
+    }
+}
+
+
+
+
+
+bool Equalizer::createDSP(FMOD::System* pSystem, FMOD::DSP** ppDSP)
+{
+    static FMOD_DSP_PARAMETER_DESC  vParameters[EQ_BAND_COUNT];
+    static FMOD_DSP_PARAMETER_DESC* vParameterPointers[EQ_BAND_COUNT];
+    static FMOD_DSP_DESCRIPTION     description;
+    static std::once_flag           descriptionReady;
+
+    std::call_once(descriptionReady, []
+    {
+        const float vFrequencies[] = EQ_BAND_FREQUENCIES;
+
+        for (int i = 0; i < EQ_BAND_COUNT; i++)
+        {
+            char vName[16];
+            snprintf(vName, sizeof(vName), "%.0f Hz", static_cast<double>(vFrequencies[i]));
+
+            FMOD_DSP_INIT_PARAMDESC_FLOAT(vParameters[i], vName, "dB", "Gain of the band", EQ_MIN_GAIN_DB, EQ_MAX_GAIN_DB, 0.0f);
+            vParameterPointers[i] = &vParameters[i];
+        }
+
+        memset(&description, 0, sizeof(description));
+
+        description.pluginsdkversion  = FMOD_PLUGIN_SDK_VERSION;
+        strncpy(description.name, "Bloody Equalizer", sizeof(description.name) - 1);
+        description.version           = 1;
+        description.numinputbuffers   = 1;
+        description.numoutputbuffers  = 1;
+        description.create            = EqualizerDSPCallbacks::create;
+        description.release           = EqualizerDSPCallbacks::release;
+        description.reset             = EqualizerDSPCallbacks::reset;
+        description.read              = EqualizerDSPCallbacks::read;
+        description.shouldiprocess    = EqualizerDSPCallbacks::shouldIProcess;
+        description.numparameters     = EQ_BAND_COUNT;
+        description.paramdesc         = vParameterPointers;
+        description.setparameterfloat = EqualizerDSPCallbacks::setParameterFloat;
+        description.getparameterfloat = EqualizerDSPCallbacks::getParameterFloat;
+    });
+
+    return pSystem->createDSP(&description, ppDSP) == FMOD_OK;
+}
+
+void Equalizer::process(const float* pIn, float* pOut, unsigned int iFrameCount, int iChannels)
+{
+    updateGains();
+
+    if ( (iChannels > EQ_MAX_CHANNELS) || (iFrameCount == 0) )
+    {
+        // Not supported (or nothing to do), pass the signal through.
+        memcpy(pOut, pIn, iFrameCount * static_cast<size_t>(iChannels) * sizeof(float));
+        return;
+    }
+
+
+    // Coefficients move from the last block to the new gains during this block.
+
+    const float vIdentity[5] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+    float vStart[EQ_BAND_COUNT * 5];
+    float vStep [EQ_BAND_COUNT * 5];
+    int   vActiveBands[EQ_BAND_COUNT];
+    int   iActiveBandCount = 0;
+
+    for (int i = 0; i < iBandCount; i++)
+    {
+        float* pStart = &vStart[i * 5];
+        float* pStep  = &vStep[i * 5];
+        float* pEnd   = &vCoefficients[i * 5];
+
+        memcpy(pStart, pEnd, 5 * sizeof(float));
+
+        calculateCoefficients(i, vCurrentGains[i], pEnd);
+
+        for (int k = 0; k < 5; k++)
+        {
+            pStep[k] = (pEnd[k] - pStart[k]) / iFrameCount;
+        }
+
+        // Flat band is the identity, we skip it (and clear what is left from the last change).
+        if ( (vCurrentGains[i] != 0.0f) || (memcmp(pStart, vIdentity, sizeof(vIdentity)) != 0) )
+        {
+            vActiveBands[iActiveBandCount] = i;
+            iActiveBandCount++;
+        }
+        else
+        {
+            memset(&vZ1[i * EQ_MAX_CHANNELS], 0, EQ_MAX_CHANNELS * sizeof(float));
+            memset(&vZ2[i * EQ_MAX_CHANNELS], 0, EQ_MAX_CHANNELS * sizeof(float));
+        }
+    }
+
+
+    float vFrame[EQ_MAX_CHANNELS] = {};
+
+    for (unsigned int iFrame = 0; iFrame < iFrameCount; iFrame++)
+    {
+        const float* pInFrame  = pIn  + iFrame * static_cast<size_t>(iChannels);
+        float*       pOutFrame = pOut + iFrame * static_cast<size_t>(iChannels);
+
+        for (int c = 0; c < iChannels; c++)
+        {
+            vFrame[c] = pInFrame[c];
+        }
+
+        for (int i = 0; i < iActiveBandCount; i++)
+        {
+            int    iBand  = vActiveBands[i];
+            float* pStart = &vStart[iBand * 5];
+            float* pStep  = &vStep[iBand * 5];
+
+            float fB0 = pStart[0] + pStep[0] * iFrame;
+            float fB1 = pStart[1] + pStep[1] * iFrame;
+            float fB2 = pStart[2] + pStep[2] * iFrame;
+            float fA1 = pStart[3] + pStep[3] * iFrame;
+            float fA2 = pStart[4] + pStep[4] * iFrame;
+
+            float* pZ1 = &vZ1[iBand * EQ_MAX_CHANNELS];
+            float* pZ2 = &vZ2[iBand * EQ_MAX_CHANNELS];
+
+            // All channels at once (unused channels are zeros).
+            for (int c = 0; c < EQ_MAX_CHANNELS; c++)
+            {
+                float fIn  = vFrame[c];
+                float fOut = fB0 * fIn + pZ1[c];
+
+                pZ1[c]     = fB1 * fIn - fA1 * fOut + pZ2[c];
+                pZ2[c]     = fB2 * fIn - fA2 * fOut;
+
+                vFrame[c]  = fOut;
+            }
+        }
+
+        for (int c = 0; c < iChannels; c++)
+        {
+            pOutFrame[c] = vFrame[c];
+        }
+    }
+}
+
+void Equalizer::reset()
+{
+    std::fill(vZ1.begin(), vZ1.end(), 0.0f);
+    std::fill(vZ2.begin(), vZ2.end(), 0.0f);
+}
+
+void Equalizer::setBandGain(int iBand, float fGainInDB)
+{
+    if ( (iBand < 0) || (iBand >= iBandCount) )
+    {
+        return;
+    }
+
+    if      (fGainInDB < EQ_MIN_GAIN_DB) fGainInDB = EQ_MIN_GAIN_DB;
+    else if (fGainInDB > EQ_MAX_GAIN_DB) fGainInDB = EQ_MAX_GAIN_DB;
+
+    std::lock_guard<std::mutex> lock(mtxTargetGains);
+
+    vTargetGains[iBand] = fGainInDB;
+    bTargetGainsChanged = true;
+}
+
+float Equalizer::getBandGain(int iBand)
+{
+    if ( (iBand < 0) || (iBand >= iBandCount) )
+    {
+        return 0.0f;
+    }
+
+    std::lock_guard<std::mutex> lock(mtxTargetGains);
+
+    return vTargetGains[iBand];
+}
+
+bool Equalizer::isFlat()
+{
+    std::lock_guard<std::mutex> lock(mtxTargetGains);
+
+    for (int i = 0; i < iBandCount; i++)
+    {
+        if (vTargetGains[i] != 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Equalizer::updateGains()
+{
+    // The audio thread never waits for the lock: if it's busy we will take the new gains on the next block.
+
+    if ( bTargetGainsChanged && mtxTargetGains.try_lock() )
+    {
+        vAudioTargetGains   = vTargetGains;
+        bTargetGainsChanged = false;
+
+        mtxTargetGains.unlock();
+    }
+
+    for (int i = 0; i < iBandCount; i++)
+    {
+        float fDiff = vAudioTargetGains[i] - vCurrentGains[i];
+
+        if (std::fabs(fDiff) < EQ_SMOOTHING_SNAP_DB)
+        {
+            vCurrentGains[i] = vAudioTargetGains[i];
+        }
+        else
+        {
+            vCurrentGains[i] += fDiff * EQ_SMOOTHING_PER_BLOCK;
+        }
+    }
+}
+
+void Equalizer::calculateCoefficients(int iBand, float fGainInDB, float* pCoefficients)
+{
+    // Peaking filter (RBJ Audio EQ Cookbook).
+    // Bands near or above Nyquist are not used.
+
+    const float vFrequencies[] = EQ_BAND_FREQUENCIES;
+
+    if ( (fGainInDB == 0.0f) || (vFrequencies[iBand] >= fSampleRate * 0.45f) )
+    {
+        pCoefficients[0] = 1.0f;
+        pCoefficients[1] = 0.0f;
+        pCoefficients[2] = 0.0f;
+        pCoefficients[3] = 0.0f;
+        pCoefficients[4] = 0.0f;
+
+        return;
+    }
+
+    double dPi    = 3.14159265358979323846;
+
+    double dA     = std::pow(10.0, fGainInDB / 40.0);
+    double dW0    = 2.0 * dPi * vFrequencies[iBand] / fSampleRate;
+    double dCos   = std::cos(dW0);
+    double dAlpha = std::sin(dW0) / (2.0 * EQ_BAND_Q);
+    double dA0    = 1.0 + dAlpha / dA;
+
+    pCoefficients[0] = static_cast<float>( (1.0 + dAlpha * dA) / dA0 );
+    pCoefficients[1] = static_cast<float>( (-2.0 * dCos)       / dA0 );
+    pCoefficients[2] = static_cast<float>( (1.0 - dAlpha * dA) / dA0 );
+    pCoefficients[3] = static_cast<float>( (-2.0 * dCos)       / dA0 );
+    pCoefficients[4] = static_cast<float>( (1.0 - dAlpha / dA) / dA0 );
+}
@@ -0,0 +1,107 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+
+
+
+
+struct EqualizerDSPCallbacks;
+
+namespace FMOD
+{
+    class System;
+    class DSP;
+}
+
+
+
+
+
+// 10-band equalizer (peaking biquads at the octave frequencies, see EQ_BAND_FREQUENCIES) as the FMOD DSP.
+// Filter states of all channels of one band are kept in one row of EQ_MAX_CHANNELS floats
+// and the inner loop goes over the whole row, so the compiler processes all channels with one vector instruction.
+// Gain changes are smoothed: the gain moves to the target a bit every block
+// and the coefficients are interpolated inside the block (nothing is allocated after the constructor).
+
+class Equalizer
+{
+
+public:
+
+    Equalizer(float fSampleRate);
+
+
+
+
+
+    // FMOD
+
+        // The DSP has one float parameter (gain in dB) per band.
+        static bool         createDSP           (FMOD::System* pSystem,  FMOD::DSP** ppDSP);
+
+
+    // Main functions
+
+        // 'pIn' and 'pOut' - interleaved samples, 'iFrameCount' samples of every channel.
+        void                process             (const float* pIn,  float* pOut,  unsigned int iFrameCount,  int iChannels);
+        void                reset               ();
+
+
+    // 'Set' functions
+
+        // Can be called from any thread, the audio thread picks the value up on the next block.
+        void                setBandGain         (int iBand,  float fGainInDB);
+
+
+    // 'Get' functions
+
+        float               getBandGain         (int iBand);
+        bool                isFlat              ();
+
+
+
+
+
+private:
+
+    friend struct EqualizerDSPCallbacks;
+
+
+    // Used in process()
+
+        void                updateGains         ();
+        void                calculateCoefficients (int iBand,  float fGainInDB,  float* pCoefficients);
+
+
+
+
+    float                fSampleRate;
+    int                  iBandCount;
+
+
+    // Gains set by the user (any thread).
+    std::mutex           mtxTargetGains;
+    std::vector<float>   vTargetGains;
+    std::atomic<bool>    bTargetGainsChanged;
+
+
+    // Audio thread
+    std::vector<float>   vAudioTargetGains;
+    std::vector<float>   vCurrentGains;
+    // b0, b1, b2, a1, a2 per band (normalized, a0 = 1) at the end of the last block.
+    std::vector<float>   vCoefficients;
+    // Transposed direct form II: [band][channel].
+    std::vector<float>   vZ1;
+    std::vector<float>   vZ2;
+};
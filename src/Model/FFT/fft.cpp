@@ -0,0 +1,117 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "fft.h"
+
+// STL
+#include <cmath>
+#include <utility>
+
+FFT::FFT(size_t iSize)
+{
+    this->iSize = iSize;
+
+    size_t iBits = 0;
+    while ( (static_cast<size_t>(1) << iBits) < iSize )
+    {
+        iBits++;
+    }
+
+    vBitReversed.resize(iSize);
+    for (size_t i = 0; i < iSize; i++)
+    {
+        size_t iReversed = 0;
+
+        for (size_t iBit = 0; iBit < iBits; iBit++)
+        {
+            if ( i & (static_cast<size_t>(1) << iBit) )
+            {
+                iReversed |= static_cast<size_t>(1) << (iBits - 1 - iBit);
+            }
+        }
+
+        vBitReversed[i] = iReversed;
+    }
+
+    vCos.resize(iSize / 2);
+    vSin.resize(iSize / 2);
+    for (size_t i = 0; i < iSize / 2; i++)
+    {
+        double dAngle = 2.0 * 3.14159265358979323846 * i / iSize;
+
+        vCos[i] = static_cast<float>( std::cos(dAngle) );
+        vSin[i] = static_cast<float>( -std::sin(dAngle) );
+    }
+}
+
+
+
+
+
+void FFT::forward(float* pRe, float* pIm) const
+{
+    transform(pRe, pIm);
+}
+
+void FFT::inverse(float* pRe, float* pIm) const
+{
+    // ifft(x) = swap(fft(swap(x))) / size, where swap() swaps the real and the imaginary parts.
+
+    transform(pIm, pRe);
+
+    float fScale = 1.0f / iSize;
+
+    for (size_t i = 0; i < iSize; i++)
+    {
+        pRe[i] *= fScale;
+        pIm[i] *= fScale;
+    }
+}
+
+size_t FFT::getSize() const
+{
+    return iSize;
+}
+
+void FFT::transform(float* pRe, float* pIm) const
+{
+    for (size_t i = 0; i < iSize; i++)
+    {
+        size_t j = vBitReversed[i];
+
+        if (i < j)
+        {
+            std::swap(pRe[i], pRe[j]);
+            std::swap(pIm[i], pIm[j]);
+        }
+    }
+
+    for (size_t iHalf = 1; iHalf < iSize; iHalf *= 2)
+    {
+        size_t iTwiddleStep = iSize / (iHalf * 2);
+
+        for (size_t iStart = 0; iStart < iSize; iStart += iHalf * 2)
+        {
+            float* pRe1 = pRe + iStart;
+            float* pIm1 = pIm + iStart;
+            float* pRe2 = pRe + iStart + iHalf;
+            float* pIm2 = pIm + iStart + iHalf;
+
+            for (size_t k = 0; k < iHalf; k++)
+            {
+                float fCos = vCos[k * iTwiddleStep];
+                float fSin = vSin[k * iTwiddleStep];
+
+                float fRe = pRe2[k] * fCos - pIm2[k] * fSin;
+                float fIm = pRe2[k] * fSin + pIm2[k] * fCos;
+
+                pRe2[k] = pRe1[k] - fRe;
+                pIm2[k] = pIm1[k] - fIm;
+                pRe1[k] = pRe1[k] + fRe;
+                pIm1[k] = pIm1[k] + fIm;
+            }
+        }
+    }
+}
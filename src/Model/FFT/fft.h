@@ -0,0 +1,62 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <cstddef>
+
+
+
+
+
+// Complex radix-2 FFT (iterative, in place) of the fixed size (power of 2).
+// Real and imaginary parts are kept in separate arrays so the loops over the bins can be vectorized.
+// Twiddles and the bit reversal are calculated in the constructor,
+// after that the object is not changed and can be used from many threads.
+
+class FFT
+{
+
+public:
+
+    FFT(size_t iSize);
+
+
+
+
+
+    // Main functions
+
+        void                forward             (float* pRe,  float* pIm) const;
+        // Scaled by 1 / size (inverse(forward(x)) == x).
+        void                inverse             (float* pRe,  float* pIm) const;
+
+
+    // 'Get' functions
+
+        size_t              getSize             () const;
+
+
+
+
+
+private:
+
+    // Used in forward() and inverse()
+
+        void                transform           (float* pRe,  float* pIm) const;
+
+
+    size_t               iSize;
+
+    std::vector<size_t>  vBitReversed;
+    // cos / -sin of 2 * pi * k / size, k < size / 2.
+    std::vector<float>   vCos;
+    std::vector<float>   vSin;
+};
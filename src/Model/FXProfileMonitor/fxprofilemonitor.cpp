@@ -0,0 +1,115 @@
+﻿// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "fxprofilemonitor.h"
+
+// Custom
+#include "globalparams.h"
+
+FXProfileMonitor::FXProfileMonitor(char cProfile)
+{
+    this->cProfile    = cProfile;
+    bAuto             = false;
+
+    fOverloadDSPUsage = FX_AUTO_OVERLOAD_DSP_USAGE;
+    iOverloadChecks   = 0;
+
+    vUsageSum   .resize(FX_PROFILE_COUNT, 0.0);
+    vUsageChecks.resize(FX_PROFILE_COUNT, 0);
+}
+
+
+
+
+
+void FXProfileMonitor::setProfile(char cProfile)
+{
+    if ( (cProfile < 0) || (cProfile > FX_PROFILE_AUTO) )
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mtxProfile);
+
+    bAuto           = (cProfile == FX_PROFILE_AUTO);
+    this->cProfile  = bAuto ? static_cast<char>(FX_PROFILE_HI_QUALITY) : cProfile;
+    iOverloadChecks = 0;
+}
+
+char FXProfileMonitor::getProfile()
+{
+    std::lock_guard<std::mutex> lock(mtxProfile);
+
+    return cProfile;
+}
+
+bool FXProfileMonitor::isAuto()
+{
+    std::lock_guard<std::mutex> lock(mtxProfile);
+
+    return bAuto;
+}
+
+bool FXProfileMonitor::addDSPUsage(float fDSPUsage)
+{
+    std::lock_guard<std::mutex> lock(mtxProfile);
+
+    vUsageSum[static_cast<size_t>(cProfile)] += fDSPUsage;
+    vUsageChecks[static_cast<size_t>(cProfile)]++;
+
+    if ( (bAuto == false) || (cProfile == FX_PROFILE_LIVE) )
+    {
+        return false;
+    }
+
+    if (fDSPUsage >= fOverloadDSPUsage)
+    {
+        iOverloadChecks++;
+    }
+    else
+    {
+        iOverloadChecks = 0;
+    }
+
+    if (iOverloadChecks < FX_AUTO_OVERLOAD_CHECKS)
+    {
+        return false;
+    }
+
+    cProfile--;
+    iOverloadChecks = 0;
+
+    return true;
+}
+
+void FXProfileMonitor::setOverloadDSPUsage(float fDSPUsage)
+{
+    std::lock_guard<std::mutex> lock(mtxProfile);
+
+    fOverloadDSPUsage = fDSPUsage;
+}
+
+FXProfileStats FXProfileMonitor::getStats(char cProfile)
+{
+    FXProfileStats stats;
+    stats.fLatencyInMS = 0.0f;
+    stats.fDSPUsage    = 0.0f;
+    stats.bMeasured    = false;
+
+    if ( (cProfile < 0) || (cProfile >= FX_PROFILE_COUNT) )
+    {
+        return stats;
+    }
+
+    std::lock_guard<std::mutex> lock(mtxProfile);
+
+    if (vUsageChecks[static_cast<size_t>(cProfile)] > 0)
+    {
+        stats.fDSPUsage = static_cast<float>( vUsageSum[static_cast<size_t>(cProfile)] / vUsageChecks[static_cast<size_t>(cProfile)] );
+        stats.bMeasured = true;
+    }
+
+    return stats;
+}
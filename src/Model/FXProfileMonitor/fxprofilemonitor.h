@@ -0,0 +1,83 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <mutex>
+
+
+
+
+struct FXProfileStats
+{
+    // Output buffer (of the running system) and the pitch shifter with the FFT size of the profile.
+    float  fLatencyInMS;
+    // DSP CPU usage (%, see FMOD::System::getCPUUsage()) averaged while the profile was active.
+    float  fDSPUsage;
+    // false if the profile was not active while playing yet.
+    bool   bMeasured;
+};
+
+
+
+
+// Active FX profile (FX_PROFILE_...) and the DSP usage measured with every profile.
+// In the auto mode (FX_PROFILE_AUTO) it starts with the best quality and steps down to the cheaper profile
+// after FX_AUTO_OVERLOAD_CHECKS overloaded measurements in a row.
+// The FMOD side of the profiles (FFT size, DSP buffer, resampler) is applied by AudioService.
+// Thread-safe: measured by the audio-control thread, read by the GUI.
+
+class FXProfileMonitor
+{
+
+public:
+
+    FXProfileMonitor(char cProfile);
+
+
+
+
+
+    // Profile
+
+        // FX_PROFILE_AUTO - the auto mode.
+        void            setProfile          (char cProfile);
+        // Active profile (never FX_PROFILE_AUTO).
+        char            getProfile          ();
+        bool            isAuto              ();
+
+
+    // Measurements
+
+        // Returns true if the auto mode stepped down (see getProfile()).
+        bool            addDSPUsage         (float fDSPUsage);
+        // DSP usage (%) that counts as the overload (FX_AUTO_OVERLOAD_DSP_USAGE by default).
+        void            setOverloadDSPUsage (float fDSPUsage);
+        // 'fLatencyInMS' is not filled here.
+        FXProfileStats  getStats            (char cProfile);
+
+
+
+
+
+private:
+
+    std::mutex                 mtxProfile;
+
+    char                       cProfile;
+    bool                       bAuto;
+
+    float                      fOverloadDSPUsage;
+    // Overloaded measurements in a row.
+    unsigned int               iOverloadChecks;
+
+    // Sum of the DSP usage and the number of measurements of every profile.
+    std::vector<double>        vUsageSum;
+    std::vector<unsigned int>  vUsageChecks;
+};
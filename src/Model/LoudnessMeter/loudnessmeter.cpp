@@ -0,0 +1,299 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "loudnessmeter.h"
+
+// STL
+#include <cmath>
+
+// Custom
+#include "globalparams.h"
+
+LoudnessMeter::LoudnessMeter(int iChannels, float fSampleRate)
+{
+    this->iChannels       = (iChannels > 0) ? iChannels : 1;
+
+    vShelfZ1              .resize(this->iChannels, 0.0);
+    vShelfZ2              .resize(this->iChannels, 0.0);
+    vHighPassZ1           .resize(this->iChannels, 0.0);
+    vHighPassZ2           .resize(this->iChannels, 0.0);
+    vSubBlockSums         .resize(this->iChannels, 0.0);
+    vChannelWeights       .resize(this->iChannels, 1.0);
+
+    if ( (this->iChannels == 6) || (this->iChannels == 8) )
+    {
+        // 5.1 and 7.1 (FL FR C LFE SL SR ...).
+        vChannelWeights[3] = 0.0;
+
+        for (int i = 4; i < this->iChannels; i++)
+        {
+            vChannelWeights[i] = 1.41;
+        }
+    }
+
+    iSubBlockSizeInFrames = static_cast<size_t>(fSampleRate / 10.0f + 0.5f);
+    if (iSubBlockSizeInFrames == 0)
+    {
+        iSubBlockSizeInFrames = 1;
+    }
+
+    iFramesInSubBlock     = 0;
+    iSubBlockCount        = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        vLastSubBlocks[i] = 0.0;
+    }
+
+    vHistory              .resize(this->iChannels * LOUDNESS_TAPS_PER_PHASE * 2, 0.0f);
+    iHistoryPos           = 0;
+    fTruePeak             = 0.0f;
+
+
+    setupKWeighting  (fSampleRate);
+    setupOversampling();
+}
+
+
+
+
+
+void LoudnessMeter::addFrames(const float* pFrames, size_t iFrameCount)
+{
+    // 'pFrames' - interleaved samples, 'iFrameCount' samples of every channel.
+
+    const size_t iTaps = LOUDNESS_TAPS_PER_PHASE;
+
+    for (size_t iFrame = 0; iFrame < iFrameCount; iFrame++)
+    {
+        const float* pFrame = pFrames + iFrame * static_cast<size_t>(iChannels);
+
+
+        // K-weighting
+
+        for (int c = 0; c < iChannels; c++)
+        {
+            double dIn       = pFrame[c];
+
+            double dShelf    = vShelfB[0] * dIn + vShelfZ1[c];
+            vShelfZ1[c]      = vShelfB[1] * dIn - vShelfA[1] * dShelf + vShelfZ2[c];
+            vShelfZ2[c]      = vShelfB[2] * dIn - vShelfA[2] * dShelf;
+
+            double dOut      = vHighPassB[0] * dShelf + vHighPassZ1[c];
+            vHighPassZ1[c]   = vHighPassB[1] * dShelf - vHighPassA[1] * dOut + vHighPassZ2[c];
+            vHighPassZ2[c]   = vHighPassB[2] * dShelf - vHighPassA[2] * dOut;
+
+            vSubBlockSums[c] += dOut * dOut;
+        }
+
+
+        // True peak
+
+        for (int c = 0; c < iChannels; c++)
+        {
+            float* pHistory = &vHistory[static_cast<size_t>(c) * iTaps * 2];
+
+            pHistory[iHistoryPos]         = pFrame[c];
+            pHistory[iHistoryPos + iTaps] = pFrame[c];
+
+            // The last 'iTaps' samples from the oldest one.
+            const float* pWindow = pHistory + iHistoryPos + 1;
+
+            for (size_t iPhase = 0; iPhase < LOUDNESS_OVERSAMPLING; iPhase++)
+            {
+                const float* pPhaseTaps = &vPhaseTaps[iPhase * iTaps];
+
+                float fSample = 0.0f;
+
+                for (size_t i = 0; i < iTaps; i++)
+                {
+                    fSample += pWindow[i] * pPhaseTaps[i];
+                }
+
+                fSample = std::fabs(fSample);
+
+                if (fSample > fTruePeak)
+                {
+                    fTruePeak = fSample;
+                }
+            }
+
+            // Sample peak is the lower bound.
+            if (std::fabs(pFrame[c]) > fTruePeak)
+            {
+                fTruePeak = std::fabs(pFrame[c]);
+            }
+        }
+
+        iHistoryPos = (iHistoryPos + 1) % iTaps;
+
+
+        iFramesInSubBlock++;
+
+        if (iFramesInSubBlock == iSubBlockSizeInFrames)
+        {
+            finishSubBlock();
+        }
+    }
+}
+
+float LoudnessMeter::getIntegratedLoudness(unsigned int* pGatedBlockCount) const
+{
+    // BS.1770: blocks below -70 LUFS are not counted,
+    // then blocks 10 LU below the loudness of the rest are not counted too.
+
+    if (pGatedBlockCount)
+    {
+        *pGatedBlockCount = 0;
+    }
+
+    double dAbsoluteGate = std::pow(10.0, (LOUDNESS_ABSOLUTE_GATE_LUFS + 0.691) / 10.0);
+
+    double dSum   = 0.0;
+    size_t iCount = 0;
+
+    for (size_t i = 0; i < vBlockEnergies.size(); i++)
+    {
+        if (vBlockEnergies[i] > dAbsoluteGate)
+        {
+            dSum += vBlockEnergies[i];
+            iCount++;
+        }
+    }
+
+    if (iCount == 0)
+    {
+        return LOUDNESS_ABSOLUTE_GATE_LUFS;
+    }
+
+
+    double dRelativeGate = (dSum / iCount) * std::pow(10.0, -LOUDNESS_RELATIVE_GATE_LU / 10.0);
+
+    dSum   = 0.0;
+    iCount = 0;
+
+    for (size_t i = 0; i < vBlockEnergies.size(); i++)
+    {
+        if ( (vBlockEnergies[i] > dAbsoluteGate) && (vBlockEnergies[i] > dRelativeGate) )
+        {
+            dSum += vBlockEnergies[i];
+            iCount++;
+        }
+    }
+
+    if (pGatedBlockCount)
+    {
+        *pGatedBlockCount = static_cast<unsigned int>(iCount);
+    }
+
+    return static_cast<float>( -0.691 + 10.0 * std::log10(dSum / iCount) );
+}
+
+float LoudnessMeter::getTruePeak() const
+{
+    return fTruePeak;
+}
+
+void LoudnessMeter::setupKWeighting(double dSampleRate)
+{
+    // Coefficients of the BS.1770 filters for any sample rate (the standard lists them only for 48 kHz).
+
+    double dPi = 3.14159265358979323846;
+
+
+    // Stage 1: high shelf (+4 dB above ~1.5 kHz, models the head).
+
+    double dFreq  = 1681.974450955533;
+    double dGain  = 3.999843853973347;
+    double dQ     = 0.7071752369554196;
+
+    double dK     = std::tan(dPi * dFreq / dSampleRate);
+    double dVh    = std::pow(10.0, dGain / 20.0);
+    double dVb    = std::pow(dVh, 0.4996667741545416);
+    double dA0    = 1.0 + dK / dQ + dK * dK;
+
+    vShelfB[0]    = (dVh + dVb * dK / dQ + dK * dK) / dA0;
+    vShelfB[1]    = 2.0 * (dK * dK - dVh) / dA0;
+    vShelfB[2]    = (dVh - dVb * dK / dQ + dK * dK) / dA0;
+    vShelfA[0]    = 1.0;
+    vShelfA[1]    = 2.0 * (dK * dK - 1.0) / dA0;
+    vShelfA[2]    = (1.0 - dK / dQ + dK * dK) / dA0;
+
+
+    // Stage 2: high pass (RLB weighting).
+
+    dFreq         = 38.13547087602444;
+    dQ            = 0.5003270373238773;
+
+    dK            = std::tan(dPi * dFreq / dSampleRate);
+    dA0           = 1.0 + dK / dQ + dK * dK;
+
+    vHighPassB[0] = 1.0;
+    vHighPassB[1] = -2.0;
+    vHighPassB[2] = 1.0;
+    vHighPassA[0] = 1.0;
+    vHighPassA[1] = 2.0 * (dK * dK - 1.0) / dA0;
+    vHighPassA[2] = (1.0 - dK / dQ + dK * dK) / dA0;
+}
+
+void LoudnessMeter::setupOversampling()
+{
+    // Windowed sinc low pass (cutoff at the original Nyquist) split into LOUDNESS_OVERSAMPLING phases.
+    // Taps of every phase are stored from the oldest sample to the newest one (like the history window).
+
+    double dPi     = 3.14159265358979323846;
+
+    size_t iTaps   = LOUDNESS_TAPS_PER_PHASE;
+    size_t iLength = iTaps * LOUDNESS_OVERSAMPLING;
+    double dCenter = (iLength - 1) / 2.0;
+
+    std::vector<double> vPrototype(iLength);
+    double              dSum = 0.0;
+
+    for (size_t i = 0; i < iLength; i++)
+    {
+        double dTime   = (i - dCenter) / LOUDNESS_OVERSAMPLING;
+        double dSinc   = (std::fabs(dTime) < 1e-9) ? 1.0 : std::sin(dPi * dTime) / (dPi * dTime);
+        double dWindow = 0.5 - 0.5 * std::cos(2.0 * dPi * (i + 0.5) / iLength);
+
+        vPrototype[i]  = dSinc * dWindow;
+        dSum          += vPrototype[i];
+    }
+
+    vPhaseTaps.resize(iLength);
+
+    for (size_t iPhase = 0; iPhase < LOUDNESS_OVERSAMPLING; iPhase++)
+    {
+        for (size_t i = 0; i < iTaps; i++)
+        {
+            // Every phase has the gain of 1.
+            vPhaseTaps[iPhase * iTaps + (iTaps - 1 - i)] =
+                    static_cast<float>(vPrototype[iPhase + i * LOUDNESS_OVERSAMPLING] * LOUDNESS_OVERSAMPLING / dSum);
+        }
+    }
+}
+
+void LoudnessMeter::finishSubBlock()
+{
+    // 400 ms block = 4 last sub-blocks of 100 ms (blocks overlap by 75%).
+
+    double dEnergy = 0.0;
+
+    for (int c = 0; c < iChannels; c++)
+    {
+        dEnergy          += vChannelWeights[c] * vSubBlockSums[c];
+        vSubBlockSums[c]  = 0.0;
+    }
+
+    vLastSubBlocks[iSubBlockCount % 4] = dEnergy / iSubBlockSizeInFrames;
+
+    iSubBlockCount++;
+    iFramesInSubBlock = 0;
+
+    if (iSubBlockCount >= 4)
+    {
+        vBlockEnergies.push_back( (vLastSubBlocks[0] + vLastSubBlocks[1] + vLastSubBlocks[2] + vLastSubBlocks[3]) / 4.0 );
+    }
+}
@@ -0,0 +1,99 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <cstddef>
+
+
+
+
+
+// Integrated loudness (ITU-R BS.1770-4 / EBU R128) and true peak of the interleaved float PCM.
+// Samples go through the K-weighting filters (high shelf + high pass) and are summed in 100 ms sub-blocks,
+// every 400 ms block (75% overlap) is kept for the gating when the whole track is added.
+// True peak is the max of the signal oversampled 4 times (48-tap polyphase FIR).
+// Channel states are kept in contiguous arrays and the inner loops go over the channels or the filter taps,
+// so the compiler can vectorize them.
+
+class LoudnessMeter
+{
+
+public:
+
+    LoudnessMeter(int iChannels,  float fSampleRate);
+
+
+
+
+
+    // Main functions
+
+        void                addFrames             (const float* pFrames,  size_t iFrameCount);
+
+
+    // 'Get' functions
+
+        // LUFS (LOUDNESS_ABSOLUTE_GATE_LUFS if all blocks are below the absolute gate).
+        float               getIntegratedLoudness (unsigned int* pGatedBlockCount = nullptr) const;
+        // Linear, 1.0 - full scale.
+        float               getTruePeak           () const;
+
+
+
+
+
+private:
+
+    // Used in the constructor
+
+        void                setupKWeighting       (double dSampleRate);
+        void                setupOversampling     ();
+
+    // Used in addFrames()
+
+        void                finishSubBlock        ();
+
+
+
+
+
+
+    int                  iChannels;
+
+
+    // K-weighting: two biquads per channel (transposed direct form II).
+    double               vShelfB[3];
+    double               vShelfA[3];
+    double               vHighPassB[3];
+    double               vHighPassA[3];
+    std::vector<double>  vShelfZ1;
+    std::vector<double>  vShelfZ2;
+    std::vector<double>  vHighPassZ1;
+    std::vector<double>  vHighPassZ2;
+    // Channel weights (LFE is not counted, surround channels are +1.5 dB).
+    std::vector<double>  vChannelWeights;
+
+
+    // Gating blocks
+    size_t               iSubBlockSizeInFrames;
+    size_t               iFramesInSubBlock;
+    std::vector<double>  vSubBlockSums;
+    // Mean square of the last 4 sub-blocks (ring).
+    double               vLastSubBlocks[4];
+    size_t               iSubBlockCount;
+    std::vector<double>  vBlockEnergies;
+
+
+    // True peak: per channel history of the last taps (twice, so the window is always contiguous).
+    std::vector<float>   vPhaseTaps;
+    std::vector<float>   vHistory;
+    size_t               iHistoryPos;
+    float                fTruePeak;
+};
@@ -0,0 +1,634 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "mp3parser.h"
+
+// STL
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+
+// Custom
+#include "globalparams.h"
+
+
+
+// Header tables.
+// [version][layer][bitrate index], version: 0 - MPEG-1, 1 - MPEG-2 and MPEG-2.5.
+static const short MP3_BITRATES_KBPS[2][3][16] =
+{
+    {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0},
+        {0, 32, 48, 56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 384, 0},
+        {0, 32, 40, 48,  56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 0}
+    },
+    {
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},
+        {0,  8, 16, 24, 32, 40, 48,  56,  64,  80,  96, 112, 128, 144, 160, 0},
+        {0,  8, 16, 24, 32, 40, 48,  56,  64,  80,  96, 112, 128, 144, 160, 0}
+    }
+};
+
+// [version][sampling rate index], version: 0 - MPEG-1, 1 - MPEG-2, 2 - MPEG-2.5.
+static const int MP3_SAMPLE_RATES[3][3] =
+{
+    {44100, 48000, 32000},
+    {22050, 24000, 16000},
+    {11025, 12000,  8000}
+};
+
+// [version][layer], version: 0 - MPEG-1, 1 - MPEG-2 and MPEG-2.5.
+static const short MP3_SAMPLES_PER_FRAME[2][3] =
+{
+    {384, 1152, 1152},
+    {384, 1152,  576}
+};
+
+
+
+MP3Parser::MP3Parser(const unsigned char* pData, size_t iSizeInBytes)
+{
+    this->pData        = pData;
+    this->iSizeInBytes = iSizeInBytes;
+}
+
+
+
+
+
+bool MP3Parser::calculateBitrate(int* pBitrate)
+{
+    // This function returns the average bitrate (from Xing/Info/VBRI header) if the file has one,
+    // otherwise it returns the bitrate that was encountered most of the times.
+
+    size_t         iFirstFrameOffset = 0;
+    MP3FrameHeader firstFrame;
+
+    if ( findFirstFrame(&iFirstFrameOffset, &firstFrame) == false )
+    {
+        return false;
+    }
+
+
+    size_t iAudioEnd = getAudioEnd(iFirstFrameOffset);
+
+
+
+    // Fast path: VBR/CBR info header already contains everything we need.
+
+    unsigned int iFrames = 0;
+    unsigned int iBytes  = 0;
+
+    if ( readXingOrVBRI(iFirstFrameOffset, firstFrame, &iFrames, &iBytes) )
+    {
+        if (iFrames > 0)
+        {
+            if (iBytes == 0)
+            {
+                iBytes = static_cast<unsigned int>(iAudioEnd - iFirstFrameOffset);
+            }
+
+            double dLengthInSec = static_cast<double>(iFrames) * firstFrame.iSamplesPerFrame / firstFrame.iSampleRate;
+
+            *pBitrate = static_cast<int>( round(iBytes * 8.0 / dLengthInSec / 1000.0) );
+
+            return true;
+        }
+
+        // This frame contains only the header so skip it.
+        iFirstFrameOffset += static_cast<size_t>(firstFrame.iFrameSizeInBytes);
+    }
+
+
+
+    // Slow path: look at the frames.
+
+    // On each index this array will contain the number of times
+    // the bitrate 'index * 8' kbit/s was encountered in the file.
+    unsigned int vHistogram[MP3_MAX_BITRATE_KBPS / 8 + 1];
+    memset(vHistogram, 0, sizeof(vHistogram));
+
+    if (iAudioEnd - iFirstFrameOffset <= MP3_FULL_SCAN_MAX_SIZE_IN_BYTES)
+    {
+        countFrames(iFirstFrameOffset, iAudioEnd, static_cast<size_t>(-1), vHistogram);
+    }
+    else
+    {
+        // The file is big, look only at some of the places in the file.
+
+        size_t iWindowSize = (iAudioEnd - iFirstFrameOffset) / MP3_SCAN_WINDOWS;
+
+        for (size_t i = 0; i < MP3_SCAN_WINDOWS; i++)
+        {
+            size_t iWindowStart = iFirstFrameOffset + i * iWindowSize;
+
+            size_t         iFrameOffset = 0;
+            MP3FrameHeader header;
+
+            if ( findFrameFrom(iWindowStart, iWindowStart + iWindowSize, &iFrameOffset, &header) )
+            {
+                countFrames(iFrameOffset, iAudioEnd, MP3_SCAN_FRAMES_IN_WINDOW, vHistogram);
+            }
+        }
+    }
+
+
+    // Find bitrate that was encountered most of the times.
+    size_t iMostFrequentIndex = 0;
+    for (size_t i = 1; i < sizeof(vHistogram) / sizeof(vHistogram[0]); i++)
+    {
+        if (vHistogram[i] > vHistogram[iMostFrequentIndex])
+        {
+            iMostFrequentIndex = i;
+        }
+    }
+
+    if (vHistogram[iMostFrequentIndex] == 0)
+    {
+        return false;
+    }
+
+    *pBitrate = static_cast<int>(iMostFrequentIndex * 8);
+
+    return true;
+}
+
+bool MP3Parser::buildSeekTable(std::vector<unsigned int>* pFrameOffsets, MP3FrameHeader* pFirstFrame, bool* pVBR)
+{
+    // This function walks through all audio frames and saves the offset of each one,
+    // so the exact position (in samples) of any frame is 'index * samples per frame'.
+    // Xing/Info/VBRI frame is not saved (it contains no audio).
+
+    pFrameOffsets->clear();
+    *pVBR = false;
+
+    if (iSizeInBytes > UINT32_MAX)
+    {
+        // Offsets are stored as 32 bit values.
+        return false;
+    }
+
+    size_t iFirstFrameOffset = 0;
+
+    if ( findFirstFrame(&iFirstFrameOffset, pFirstFrame) == false )
+    {
+        return false;
+    }
+
+    size_t iAudioEnd = getAudioEnd(iFirstFrameOffset);
+
+    unsigned int iFrames = 0;
+    unsigned int iBytes  = 0;
+
+    if ( readXingOrVBRI(iFirstFrameOffset, *pFirstFrame, &iFrames, &iBytes) )
+    {
+        iFirstFrameOffset += static_cast<size_t>(pFirstFrame->iFrameSizeInBytes);
+
+        if (iFrames > 0)
+        {
+            pFrameOffsets->reserve(iFrames);
+        }
+    }
+    else
+    {
+        // Guess from the file size.
+        pFrameOffsets->reserve( (iAudioEnd - iFirstFrameOffset) / static_cast<size_t>(pFirstFrame->iFrameSizeInBytes) + 1 );
+    }
+
+
+    int    iFirstBitrate = 0;
+    size_t iPos          = iFirstFrameOffset;
+
+    while (iPos + 4 <= iAudioEnd)
+    {
+        MP3FrameHeader header;
+
+        if ( decodeFrameHeader(pData + iPos, &header)
+             && (header.iSampleRate == pFirstFrame->iSampleRate)
+             && (iPos + static_cast<size_t>(header.iFrameSizeInBytes) <= iAudioEnd) )
+        {
+            if (iFirstBitrate == 0)
+            {
+                iFirstBitrate = header.iBitrateKbps;
+            }
+            else if (header.iBitrateKbps != iFirstBitrate)
+            {
+                *pVBR = true;
+            }
+
+            pFrameOffsets->push_back( static_cast<unsigned int>(iPos) );
+
+            iPos += static_cast<size_t>(header.iFrameSizeInBytes);
+        }
+        else
+        {
+            // Lost sync, look for the next frame.
+            size_t iFrameOffset = 0;
+
+            if ( findFrameFrom(iPos + 1, iAudioEnd, &iFrameOffset, &header) == false )
+            {
+                break;
+            }
+
+            iPos = iFrameOffset;
+        }
+    }
+
+    return pFrameOffsets->size() > 0;
+}
+
+bool MP3Parser::findFirstFrame(size_t* pFrameOffset, MP3FrameHeader* pHeader)
+{
+    size_t iStart = getID3v2Size();
+
+    return findFrameFrom(iStart, iSizeInBytes, pFrameOffset, pHeader);
+}
+
+bool MP3Parser::readXingOrVBRI(size_t iFrameOffset, const MP3FrameHeader& header, unsigned int* pFrames, unsigned int* pBytes)
+{
+    // This function returns 'true' if the frame contains Xing/Info or VBRI header.
+    // 'pFrames' and 'pBytes' will be 0 if the header does not contain these values.
+
+    *pFrames = 0;
+    *pBytes  = 0;
+
+    if (header.iLayer != 3)
+    {
+        return false;
+    }
+
+
+    // Xing / Info
+
+    size_t iXingOffset = iFrameOffset + getXingOffset(header);
+
+    if ( (iXingOffset + 16 <= iSizeInBytes)
+         &&
+         ( (memcmp(pData + iXingOffset, "Xing", 4) == 0) || (memcmp(pData + iXingOffset, "Info", 4) == 0) ) )
+    {
+        unsigned int iFlags = readBigEndian32(iXingOffset + 4);
+        size_t iPos = iXingOffset + 8;
+
+        if (iFlags & 0x1)
+        {
+            *pFrames = readBigEndian32(iPos);
+            iPos += 4;
+        }
+
+        if ( (iFlags & 0x2) && (iPos + 4 <= iSizeInBytes) )
+        {
+            *pBytes = readBigEndian32(iPos);
+        }
+
+        return true;
+    }
+
+
+    // VBRI (always 32 bytes after the frame header)
+
+    size_t iVBRIOffset = iFrameOffset + 36;
+
+    if ( (iVBRIOffset + 18 <= iSizeInBytes) && (memcmp(pData + iVBRIOffset, "VBRI", 4) == 0) )
+    {
+        *pBytes  = readBigEndian32(iVBRIOffset + 10);
+        *pFrames = readBigEndian32(iVBRIOffset + 14);
+
+        return true;
+    }
+
+    return false;
+}
+
+bool MP3Parser::readGaplessInfo(unsigned int* pStartInPCM, unsigned int* pEndInPCM)
+{
+    // This function returns the position (in decoded samples) of the first and the last + 1 real sample of the track.
+    // Encoder adds some silence (encoder delay) at the beginning and pads the last frame with silence,
+    // the decoder adds MP3_DECODER_DELAY_SAMPLES more at the beginning.
+    // Values are taken from the LAME header (after the Xing/Info header) or from the iTunSMPB comment (iTunes).
+
+    size_t         iFirstFrameOffset = 0;
+    MP3FrameHeader firstFrame;
+
+    if ( findFirstFrame(&iFirstFrameOffset, &firstFrame) == false )
+    {
+        return false;
+    }
+
+    unsigned int iFrames = 0;
+    unsigned int iBytes  = 0;
+
+    size_t iXingOffset = iFirstFrameOffset + getXingOffset(firstFrame);
+
+    if ( readXingOrVBRI(iFirstFrameOffset, firstFrame, &iFrames, &iBytes)
+         && (iFrames > 0)
+         && (iXingOffset + 8 <= iSizeInBytes)
+         && (memcmp(pData + iXingOffset, "VBRI", 4) != 0) )
+    {
+        // Skip Xing fields to get to the LAME header.
+
+        unsigned int iFlags = readBigEndian32(iXingOffset + 4);
+        size_t iLAMEOffset  = iXingOffset + 8;
+
+        if (iFlags & 0x1) iLAMEOffset += 4;   // frames
+        if (iFlags & 0x2) iLAMEOffset += 4;   // bytes
+        if (iFlags & 0x4) iLAMEOffset += 100; // TOC
+        if (iFlags & 0x8) iLAMEOffset += 4;   // quality
+
+        // 9 bytes - encoder version ("LAME3.100", "Lavc58.54" and etc.),
+        // 12 bits - encoder delay, 12 bits - padding (at offset 21).
+        if ( (iLAMEOffset + 24 <= iSizeInBytes)
+             && ( (memcmp(pData + iLAMEOffset, "LAME", 4) == 0) || (memcmp(pData + iLAMEOffset, "Lavc", 4) == 0)
+                  || (memcmp(pData + iLAMEOffset, "Lavf", 4) == 0) ) )
+        {
+            const unsigned char* pDelay = pData + iLAMEOffset + 21;
+
+            unsigned int iEncoderDelay = (static_cast<unsigned int>(pDelay[0]) << 4) | (pDelay[1] >> 4);
+            unsigned int iPadding      = (static_cast<unsigned int>(pDelay[1] & 0xF) << 8) | pDelay[2];
+
+            unsigned long long iSamplesInFrames = static_cast<unsigned long long>(iFrames) * static_cast<unsigned long long>(firstFrame.iSamplesPerFrame);
+
+            if ( ((iEncoderDelay != 0) || (iPadding != 0)) && (iEncoderDelay + iPadding < iSamplesInFrames) )
+            {
+                *pStartInPCM = iEncoderDelay + MP3_DECODER_DELAY_SAMPLES;
+                *pEndInPCM   = static_cast<unsigned int>( *pStartInPCM + iSamplesInFrames - iEncoderDelay - iPadding );
+
+                return true;
+            }
+        }
+    }
+
+    return readITunSMPB(pStartInPCM, pEndInPCM);
+}
+
+bool MP3Parser::decodeFrameHeader(const unsigned char* pHeaderBytes, MP3FrameHeader* pHeader)
+{
+    // Every mp3 frame starts with 11 'true' bits.
+    if ( (pHeaderBytes[0] != 0xFF) || ((pHeaderBytes[1] & 0xE0) != 0xE0) )
+    {
+        return false;
+    }
+
+    int iVersionBits    = (pHeaderBytes[1] >> 3) & 0x3;
+    int iLayerBits      = (pHeaderBytes[1] >> 1) & 0x3;
+    int iBitrateIndex   = (pHeaderBytes[2] >> 4) & 0xF;
+    int iSampleRateIdx  = (pHeaderBytes[2] >> 2) & 0x3;
+    int iPadding        = (pHeaderBytes[2] >> 1) & 0x1;
+    int iChannelMode    = (pHeaderBytes[3] >> 6) & 0x3;
+    int iEmphasis       =  pHeaderBytes[3]       & 0x3;
+
+    // 01 version is reserved, 00 layer is reserved, 0000 bitrate is 'free' (not supported), 1111 bitrate is not valid,
+    // 11 sampling rate is reserved, 10 emphasis is reserved.
+    if ( (iVersionBits == 1) || (iLayerBits == 0) || (iBitrateIndex == 0) || (iBitrateIndex == 15) || (iSampleRateIdx == 3) || (iEmphasis == 2) )
+    {
+        return false;
+    }
+
+
+    // 11 - MPEG-1, 10 - MPEG-2, 00 - MPEG-2.5
+    int iVersionTableIndex    = (iVersionBits == 3) ? 0 : ((iVersionBits == 2) ? 1 : 2);
+    int iBitrateTableVersion  = (iVersionBits == 3) ? 0 : 1;
+
+    // 11 - Layer I, 10 - Layer II, 01 - Layer III
+    int iLayer = 4 - iLayerBits;
+
+    pHeader->iVersion         = (iVersionBits == 3) ? 1 : ((iVersionBits == 2) ? 2 : 25);
+    pHeader->iLayer           = iLayer;
+    pHeader->iBitrateKbps     = MP3_BITRATES_KBPS[iBitrateTableVersion][iLayer - 1][iBitrateIndex];
+    pHeader->iSampleRate      = MP3_SAMPLE_RATES[iVersionTableIndex][iSampleRateIdx];
+    pHeader->iSamplesPerFrame = MP3_SAMPLES_PER_FRAME[iBitrateTableVersion][iLayer - 1];
+    pHeader->iChannels        = (iChannelMode == 3) ? 1 : 2;
+
+    if (iLayer == 1)
+    {
+        pHeader->iFrameSizeInBytes = (12 * pHeader->iBitrateKbps * 1000 / pHeader->iSampleRate + iPadding) * 4;
+    }
+    else
+    {
+        pHeader->iFrameSizeInBytes = (pHeader->iSamplesPerFrame / 8) * pHeader->iBitrateKbps * 1000 / pHeader->iSampleRate + iPadding;
+    }
+
+    return true;
+}
+
+size_t MP3Parser::getID3v2Size()
+{
+    // This function returns the size of all ID3v2 tags at the beginning of the file.
+
+    size_t iPos = 0;
+
+    while ( (iPos + 10 <= iSizeInBytes) && (memcmp(pData + iPos, "ID3", 3) == 0) )
+    {
+        // Tag size is stored in 4 bytes, last (left) bit of each byte does not contain data.
+        size_t iTagSize = (static_cast<size_t>(pData[iPos + 6] & 0x7F) << 21)
+                        | (static_cast<size_t>(pData[iPos + 7] & 0x7F) << 14)
+                        | (static_cast<size_t>(pData[iPos + 8] & 0x7F) << 7)
+                        |  static_cast<size_t>(pData[iPos + 9] & 0x7F);
+
+        // Header
+        iTagSize += 10;
+
+        if (pData[iPos + 5] & 0x10)
+        {
+            // Footer is present
+            iTagSize += 10;
+        }
+
+        iPos += iTagSize;
+    }
+
+    if (iPos > iSizeInBytes)
+    {
+        iPos = iSizeInBytes;
+    }
+
+    return iPos;
+}
+
+bool MP3Parser::readITunSMPB(unsigned int* pStartInPCM, unsigned int* pEndInPCM)
+{
+    // iTunes stores gapless info in the ID3v2 comment "iTunSMPB" as hex values:
+    // " 00000000 00000210 00000A2C 0000000000AB31D4 ...", reserved, priming samples, padding samples, original sample count.
+    // Priming samples already include the decoder delay.
+
+    size_t iTagsSize = getID3v2Size();
+
+    const char   sName[] = "iTunSMPB";
+    const size_t iNameLength = sizeof(sName) - 1;
+
+    for (size_t iPos = 0; iPos + iNameLength <= iTagsSize; iPos++)
+    {
+        if ( memcmp(pData + iPos, sName, iNameLength) != 0 )
+        {
+            continue;
+        }
+
+
+        // Read 4 hex values (skip text encoding bytes, spaces and null characters before each one).
+
+        unsigned long long vValues[4] = {0, 0, 0, 0};
+        size_t             iValue     = 0;
+        size_t             iDigits    = 0;
+
+        for (size_t i = iPos + iNameLength; (i < iTagsSize) && (iValue < 4); i++)
+        {
+            unsigned char c = pData[i];
+            int iDigit = -1;
+
+            if      ( (c >= '0') && (c <= '9') ) iDigit = c - '0';
+            else if ( (c >= 'A') && (c <= 'F') ) iDigit = c - 'A' + 10;
+            else if ( (c >= 'a') && (c <= 'f') ) iDigit = c - 'a' + 10;
+
+            if (iDigit != -1)
+            {
+                vValues[iValue] = (vValues[iValue] << 4) | static_cast<unsigned long long>(iDigit);
+                iDigits++;
+            }
+            else if (iDigits > 0)
+            {
+                iValue++;
+                iDigits = 0;
+            }
+            else if ( (c != ' ') && (c != '\0') && (c > 3) )
+            {
+                // Not a value (binary data of the frame or the other text).
+                break;
+            }
+        }
+
+        if ( (iValue == 4) && (vValues[3] > 0) && (vValues[1] + vValues[3] <= UINT32_MAX) )
+        {
+            *pStartInPCM = static_cast<unsigned int>( vValues[1] );
+            *pEndInPCM   = static_cast<unsigned int>( vValues[1] + vValues[3] );
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MP3Parser::findFrameFrom(size_t iStartOffset, size_t iEndOffset, size_t* pFrameOffset, MP3FrameHeader* pHeader)
+{
+    // This function looks for the frame header, which is followed by another header with the same parameters
+    // (so we won't take random 0xFF byte in the audio data as a frame).
+
+    if (iEndOffset > iSizeInBytes)
+    {
+        iEndOffset = iSizeInBytes;
+    }
+
+    size_t iPos = iStartOffset;
+
+    while (iPos + 4 <= iEndOffset)
+    {
+        const void* pSync = memchr(pData + iPos, 0xFF, iEndOffset - iPos - 3);
+        if (pSync == nullptr)
+        {
+            return false;
+        }
+
+        iPos = static_cast<size_t>(static_cast<const unsigned char*>(pSync) - pData);
+
+        MP3FrameHeader header;
+        if ( decodeFrameHeader(pData + iPos, &header) )
+        {
+            size_t iNextFrame = iPos + static_cast<size_t>(header.iFrameSizeInBytes);
+
+            MP3FrameHeader nextHeader;
+
+            if (iNextFrame + 4 > iSizeInBytes)
+            {
+                // Last frame in the file.
+                *pFrameOffset = iPos;
+                *pHeader      = header;
+
+                return true;
+            }
+            else if ( decodeFrameHeader(pData + iNextFrame, &nextHeader)
+                      && (nextHeader.iVersion    == header.iVersion)
+                      && (nextHeader.iLayer      == header.iLayer)
+                      && (nextHeader.iSampleRate == header.iSampleRate) )
+            {
+                *pFrameOffset = iPos;
+                *pHeader      = header;
+
+                return true;
+            }
+        }
+
+        iPos++;
+    }
+
+    return false;
+}
+
+size_t MP3Parser::getXingOffset(const MP3FrameHeader& header)
+{
+    // Xing/Info header is placed right after the side information.
+    // 4 - frame header size.
+
+    if (header.iVersion == 1)
+    {
+        return (header.iChannels == 1) ? (4 + 17) : (4 + 32);
+    }
+    else
+    {
+        return (header.iChannels == 1) ? (4 + 9)  : (4 + 17);
+    }
+}
+
+size_t MP3Parser::getAudioEnd(size_t iFirstFrameOffset)
+{
+    // This function returns the offset of the ID3v1 tag at the end of the file (or file size if there is no tag).
+
+    size_t iAudioEnd = iSizeInBytes;
+
+    if ( (iSizeInBytes - iFirstFrameOffset >= 128) && (memcmp(pData + iSizeInBytes - 128, "TAG", 3) == 0) )
+    {
+        iAudioEnd -= 128;
+    }
+
+    return iAudioEnd;
+}
+
+unsigned int MP3Parser::readBigEndian32(size_t iOffset)
+{
+    return (static_cast<unsigned int>(pData[iOffset])     << 24)
+         | (static_cast<unsigned int>(pData[iOffset + 1]) << 16)
+         | (static_cast<unsigned int>(pData[iOffset + 2]) << 8)
+         |  static_cast<unsigned int>(pData[iOffset + 3]);
+}
+
+void MP3Parser::countFrames(size_t iStartOffset, size_t iEndOffset, size_t iMaxFrames, unsigned int* pHistogram)
+{
+    size_t iPos    = iStartOffset;
+    size_t iFrames = 0;
+
+    while ( (iPos + 4 <= iEndOffset) && (iFrames < iMaxFrames) )
+    {
+        MP3FrameHeader header;
+
+        if ( decodeFrameHeader(pData + iPos, &header) && (iPos + static_cast<size_t>(header.iFrameSizeInBytes) <= iEndOffset) )
+        {
+            pHistogram[header.iBitrateKbps / 8]++;
+            iFrames++;
+
+            // Jump right to the beginning of a new mp3 frame.
+            iPos += static_cast<size_t>(header.iFrameSizeInBytes);
+        }
+        else
+        {
+            // Lost sync, look for the next frame.
+            size_t iFrameOffset = 0;
+
+            if ( findFrameFrom(iPos + 1, iEndOffset, &iFrameOffset, &header) == false )
+            {
+                break;
+            }
+
+            iPos = iFrameOffset;
+        }
+    }
+}
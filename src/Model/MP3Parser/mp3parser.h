@@ -0,0 +1,93 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <cstddef>
+#include <vector>
+
+
+
+
+
+struct MP3FrameHeader
+{
+    // 1 - MPEG-1, 2 - MPEG-2, 25 - MPEG-2.5
+    int iVersion;
+    // 1, 2 or 3
+    int iLayer;
+    int iBitrateKbps;
+    int iSampleRate;
+    int iSamplesPerFrame;
+    int iFrameSizeInBytes;
+    int iChannels;
+};
+
+
+
+
+
+// Parses MP3 (MPEG-1/2/2.5, layers I-III) data that is fully placed in memory (see MappedFile).
+
+class MP3Parser
+{
+
+public:
+
+    MP3Parser(const unsigned char* pData, size_t iSizeInBytes);
+
+
+
+
+
+    // Main functions
+
+        bool           calculateBitrate     (int* pBitrate);
+        bool           buildSeekTable       (std::vector<unsigned int>* pFrameOffsets,  MP3FrameHeader* pFirstFrame,  bool* pVBR);
+
+
+    // Frames
+
+        bool           findFirstFrame       (size_t* pFrameOffset,  MP3FrameHeader* pHeader);
+        bool           readXingOrVBRI       (size_t iFrameOffset,   const MP3FrameHeader& header,  unsigned int* pFrames,  unsigned int* pBytes);
+        bool           readGaplessInfo      (unsigned int* pStartInPCM,  unsigned int* pEndInPCM);
+
+        static bool    decodeFrameHeader    (const unsigned char* pHeaderBytes,  MP3FrameHeader* pHeader);
+
+
+    // Tags
+
+        size_t         getID3v2Size         ();
+        bool           readITunSMPB         (unsigned int* pStartInPCM,  unsigned int* pEndInPCM);
+
+
+
+
+
+private:
+
+    // Used in findFirstFrame(), calculateBitrate(), buildSeekTable() and readGaplessInfo()
+
+        bool           findFrameFrom        (size_t iStartOffset,  size_t iEndOffset,  size_t* pFrameOffset,  MP3FrameHeader* pHeader);
+        size_t         getXingOffset        (const MP3FrameHeader& header);
+        size_t         getAudioEnd          (size_t iFirstFrameOffset);
+        unsigned int   readBigEndian32      (size_t iOffset);
+
+
+    // Used in calculateBitrate()
+
+        void           countFrames          (size_t iStartOffset,  size_t iEndOffset,  size_t iMaxFrames,  unsigned int* pHistogram);
+
+
+
+
+
+
+    const unsigned char*  pData;
+    size_t                iSizeInBytes;
+};
@@ -0,0 +1,165 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "mappedfile.h"
+
+// Other
+#if _WIN32
+#include <windows.h>
+#else
+#include <locale>
+#include <codecvt>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    pData        = nullptr;
+    iSizeInBytes = 0;
+
+#if _WIN32
+    hFile        = INVALID_HANDLE_VALUE;
+    hMapping     = nullptr;
+#else
+    iFileDescriptor = -1;
+#endif
+}
+
+
+
+
+
+bool MappedFile::openFile(const std::wstring& sFilePath)
+{
+    // This function maps the whole file in memory (read-only).
+    // Returns 'false' if the file can't be opened or it's empty.
+
+    closeFile();
+
+#if _WIN32
+    hFile = CreateFileW(sFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if ( (GetFileSizeEx(hFile, &fileSize) == 0) || (fileSize.QuadPart == 0) )
+    {
+        closeFile();
+        return false;
+    }
+
+    hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (hMapping == nullptr)
+    {
+        closeFile();
+        return false;
+    }
+
+    pData = static_cast<const unsigned char*>( MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) );
+    if (pData == nullptr)
+    {
+        closeFile();
+        return false;
+    }
+
+    iSizeInBytes = fileSize.QuadPart;
+#else
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+    auto out = utf8_conv.to_bytes(sFilePath);
+
+    iFileDescriptor = open(out.c_str(), O_RDONLY);
+    if (iFileDescriptor == -1)
+    {
+        return false;
+    }
+
+    struct stat fileInfo;
+    if ( (fstat(iFileDescriptor, &fileInfo) == -1) || (fileInfo.st_size == 0) )
+    {
+        closeFile();
+        return false;
+    }
+
+    void* pMapped = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_SHARED, iFileDescriptor, 0);
+    if (pMapped == MAP_FAILED)
+    {
+        closeFile();
+        return false;
+    }
+
+    // We usually read the file from the beginning to the end.
+    madvise(pMapped, static_cast<size_t>(fileInfo.st_size), MADV_SEQUENTIAL);
+
+    pData        = static_cast<const unsigned char*>(pMapped);
+    iSizeInBytes = static_cast<long long>(fileInfo.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::closeFile()
+{
+#if _WIN32
+    if (pData)
+    {
+        UnmapViewOfFile(pData);
+    }
+
+    if (hMapping)
+    {
+        CloseHandle(hMapping);
+        hMapping = nullptr;
+    }
+
+    if (hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hFile);
+        hFile = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (pData)
+    {
+        munmap(const_cast<unsigned char*>(pData), static_cast<size_t>(iSizeInBytes));
+    }
+
+    if (iFileDescriptor != -1)
+    {
+        close(iFileDescriptor);
+        iFileDescriptor = -1;
+    }
+#endif
+
+    pData        = nullptr;
+    iSizeInBytes = 0;
+}
+
+const unsigned char* MappedFile::getData() const
+{
+    return pData;
+}
+
+long long MappedFile::getSizeInBytes() const
+{
+    return iSizeInBytes;
+}
+
+bool MappedFile::isOpened() const
+{
+    return pData != nullptr;
+}
+
+
+
+
+
+MappedFile::~MappedFile()
+{
+    closeFile();
+}
@@ -0,0 +1,70 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <string>
+#include <cstddef>
+
+
+
+
+
+// Read-only memory mapping of the whole file.
+// Used when we need to scan the file (for example, to calculate the bitrate)
+// so we don't need to read it byte by byte through std::ifstream.
+// Mappings are shared by all users of the file through MappedFileSystem.
+
+class MappedFile
+{
+
+public:
+
+    MappedFile();
+
+
+
+
+
+    // Open/close functions
+
+        bool                  openFile        (const std::wstring& sFilePath);
+        void                  closeFile       ();
+
+
+    // 'Get' functions
+
+        const unsigned char*  getData         () const;
+        long long             getSizeInBytes  () const;
+        bool                  isOpened        () const;
+
+
+
+
+
+    ~MappedFile();
+
+private:
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+
+
+
+
+    const unsigned char*  pData;
+    long long             iSizeInBytes;
+
+#if _WIN32
+    void*                 hFile;
+    void*                 hMapping;
+#else
+    int                   iFileDescriptor;
+#endif
+};
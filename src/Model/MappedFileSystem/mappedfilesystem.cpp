@@ -0,0 +1,198 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "mappedfilesystem.h"
+
+// STL
+#include <cstring>
+
+// Custom
+#include "../ext/FMOD/inc/fmod.hpp"
+
+// Other
+#if _WIN32
+#include <windows.h>
+#else
+#include <locale>
+#include <codecvt>
+#endif
+
+
+std::mutex                                          MappedFileSystem::mtxFiles;
+std::map<std::wstring, std::weak_ptr<MappedFile>>   MappedFileSystem::files;
+
+std::atomic<unsigned long long>                     MappedFileSystem::iOpens       (0);
+std::atomic<unsigned long long>                     MappedFileSystem::iNewMappings (0);
+std::atomic<unsigned long long>                     MappedFileSystem::iReads       (0);
+
+
+// The file opened by FMOD.
+struct MappedFileHandle
+{
+    std::shared_ptr<MappedFile> pFile;
+    unsigned int                iPos;
+};
+
+struct MappedFileCallbacks
+{
+    static FMOD_RESULT F_CALLBACK open(const char* pName, unsigned int* pFileSize, void** ppHandle, void* pUserData)
+    {
+        (void)pUserData;
+
+        // FMOD gives us the UTF-8 string.
+#if _WIN32
+        wchar_t filePathInUTF16[MAX_PATH];
+        MultiByteToWideChar(CP_UTF8, 0, pName, -1, filePathInUTF16, MAX_PATH);
+
+        std::wstring sFilePath(filePathInUTF16);
+#else
+        std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+
+        std::wstring sFilePath = utf8_conv.from_bytes(pName);
+#endif
+
+        std::shared_ptr<MappedFile> pFile = MappedFileSystem::mapFile(sFilePath);
+
+        if (pFile == nullptr)
+        {
+            return FMOD_ERR_FILE_NOTFOUND;
+        }
+
+        MappedFileHandle* pHandle = new MappedFileHandle();
+        pHandle->pFile = pFile;
+        pHandle->iPos  = 0;
+
+        *pFileSize = static_cast<unsigned int>(pFile->getSizeInBytes());
+        *ppHandle  = pHandle;
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK close(void* pHandle, void* pUserData)
+    {
+        (void)pUserData;
+
+        delete static_cast<MappedFileHandle*>(pHandle);
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK read(void* pHandle, void* pBuffer, unsigned int iSizeInBytes, unsigned int* pReadBytes, void* pUserData)
+    {
+        (void)pUserData;
+
+        MappedFileHandle* pFileHandle = static_cast<MappedFileHandle*>(pHandle);
+
+        unsigned long long iFileSize = static_cast<unsigned long long>(pFileHandle->pFile->getSizeInBytes());
+        unsigned long long iLeft     = (pFileHandle->iPos < iFileSize) ? (iFileSize - pFileHandle->iPos) : 0;
+
+        unsigned int iToRead = (iSizeInBytes < iLeft) ? iSizeInBytes : static_cast<unsigned int>(iLeft);
+
+        memcpy(pBuffer, pFileHandle->pFile->getData() + pFileHandle->iPos, iToRead);
+
+        pFileHandle->iPos += iToRead;
+        *pReadBytes        = iToRead;
+
+        MappedFileSystem::iReads++;
+
+        return (iToRead < iSizeInBytes) ? FMOD_ERR_FILE_EOF : FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK seek(void* pHandle, unsigned int iPos, void* pUserData)
+    {
+        (void)pUserData;
+
+        static_cast<MappedFileHandle*>(pHandle)->iPos = iPos;
+
+        return FMOD_OK;
+    }
+};
+
+
+
+
+
+bool MappedFileSystem::attach(FMOD::System* pSystem)
+{
+    // Should be called before the first sound is created.
+    // No block alignment: reads are served from the memory, FMOD does not need to buffer them.
+
+    return pSystem->setFileSystem(MappedFileCallbacks::open, MappedFileCallbacks::close, MappedFileCallbacks::read, MappedFileCallbacks::seek,
+                                  nullptr, nullptr, 0) == FMOD_OK;
+}
+
+std::shared_ptr<MappedFile> MappedFileSystem::mapFile(const std::wstring& sFilePath)
+{
+    // Returns the mapping of the file (shared with the other users of the file)
+    // or nullptr if the file can't be opened or it's empty.
+
+    iOpens++;
+
+    std::lock_guard<std::mutex> lock(mtxFiles);
+
+    auto it = files.find(sFilePath);
+
+    if (it != files.end())
+    {
+        std::shared_ptr<MappedFile> pFile = it->second.lock();
+
+        if (pFile)
+        {
+            return pFile;
+        }
+    }
+
+
+    // Map the file under the lock so two threads don't map the same file twice.
+
+    MappedFile* pNewFile = new MappedFile();
+
+    if ( pNewFile->openFile(sFilePath) == false )
+    {
+        delete pNewFile;
+        return nullptr;
+    }
+
+    iNewMappings++;
+
+    std::shared_ptr<MappedFile> pFile(pNewFile, [sFilePath](MappedFile* pMappedFile) { releaseFile(pMappedFile, sFilePath); });
+
+    files[sFilePath] = pFile;
+
+    return pFile;
+}
+
+MappedFileSystemStats MappedFileSystem::getStats()
+{
+    MappedFileSystemStats stats;
+
+    std::lock_guard<std::mutex> lock(mtxFiles);
+
+    stats.iMappedFiles = files.size();
+    stats.iOpens       = iOpens;
+    stats.iNewMappings = iNewMappings;
+    stats.iReads       = iReads;
+
+    return stats;
+}
+
+void MappedFileSystem::releaseFile(MappedFile* pFile, const std::wstring& sFilePath)
+{
+    // Called when the last user of the mapping is gone.
+
+    {
+        std::lock_guard<std::mutex> lock(mtxFiles);
+
+        auto it = files.find(sFilePath);
+
+        // The file may be already mapped again by someone else.
+        if ( (it != files.end()) && it->second.expired() )
+        {
+            files.erase(it);
+        }
+    }
+
+    delete pFile;
+}
@@ -0,0 +1,98 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+// Custom
+#include "Model/MappedFile/mappedfile.h"
+
+
+
+
+
+struct MappedFileCallbacks;
+
+namespace FMOD
+{
+    class System;
+}
+
+
+
+
+
+struct MappedFileSystemStats
+{
+    // Files that are mapped right now.
+    size_t             iMappedFiles;
+
+    // Every open of the file (by FMOD or by us) and how many of them created a new mapping.
+    unsigned long long iOpens;
+    unsigned long long iNewMappings;
+
+    // Reads of FMOD served from the mappings (without a syscall).
+    unsigned long long iReads;
+};
+
+
+
+
+
+// File system of all our FMOD systems (see attach()).
+// Every file is mapped once and the mapping is shared by everyone who opened it:
+// the stream of the track, the dummy sound, the bitrate scan, the seek table and the loudness analysis.
+// FMOD reads are served by memcpy from the mapping, so there is no syscall per read.
+// The mapping is closed when the last user releases it.
+
+class MappedFileSystem
+{
+
+public:
+
+    // Main functions
+
+        static bool                         attach      (FMOD::System* pSystem);
+        static std::shared_ptr<MappedFile>  mapFile     (const std::wstring& sFilePath);
+
+
+    // 'Get' functions
+
+        static MappedFileSystemStats        getStats    ();
+
+
+
+
+
+private:
+
+    friend struct MappedFileCallbacks;
+
+
+    // Used in mapFile()
+
+        static void                         releaseFile (MappedFile* pFile,  const std::wstring& sFilePath);
+
+
+
+
+    // Shared mappings by the path of the file.
+    static std::mutex                                          mtxFiles;
+    static std::map<std::wstring, std::weak_ptr<MappedFile>>   files;
+
+
+    // Stats
+    static std::atomic<unsigned long long>                     iOpens;
+    static std::atomic<unsigned long long>                     iNewMappings;
+    static std::atomic<unsigned long long>                     iReads;
+};
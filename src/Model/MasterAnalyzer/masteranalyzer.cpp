@@ -0,0 +1,245 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "masteranalyzer.h"
+
+// STL
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+
+// Custom
+#include "globalparams.h"
+#include "../ext/FMOD/inc/fmod.hpp"
+
+
+struct MasterAnalyzerDSPCallbacks
+{
+    static FMOD_RESULT F_CALLBACK create(FMOD_DSP_STATE* pDSPState)
+    {
+        int iSampleRate = 0;
+        FMOD_DSP_GETSAMPLERATE(pDSPState, &iSampleRate);
+
+        pDSPState->plugindata = new MasterAnalyzer( static_cast<float>(iSampleRate) );
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK release(FMOD_DSP_STATE* pDSPState)
+    {
+        delete static_cast<MasterAnalyzer*>(pDSPState->plugindata);
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK read(FMOD_DSP_STATE* pDSPState, float* pInBuffer, float* pOutBuffer, unsigned int iLength, int iInChannels, int* pOutChannels)
+    {
+        static_cast<MasterAnalyzer*>(pDSPState->plugindata)->process(pInBuffer, pOutBuffer, iLength, iInChannels);
+
+        *pOutChannels = iInChannels;
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK getParameterData(FMOD_DSP_STATE* pDSPState, int iIndex, void** ppValue, unsigned int* pLength, char* pValueString)
+    {
+        (void)iIndex;
+        (void)pValueString;
+
+        *ppValue = pDSPState->plugindata;
+        *pLength = sizeof(MasterAnalyzer*);
+
+        return FMOD_OK;
+    }
+};
+
+MasterAnalyzer::MasterAnalyzer(float fSampleRate) : fft(METER_FFT_SIZE), meterBuffer(METER_MAX_CHANNELS, METER_SPECTRUM_BANDS)
+{
+    this->fSampleRate = fSampleRate;
+
+    vPeak          .resize(METER_MAX_CHANNELS, 0.0f);
+    vSumOfSquares  .resize(METER_MAX_CHANNELS, 0.0);
+    iPeriodFrames  = 0;
+
+    vHistory       .resize(METER_FFT_SIZE, 0.0f);
+    iHistoryPos    = 0;
+
+    vRe            .resize(METER_FFT_SIZE, 0.0f);
+    vIm            .resize(METER_FFT_SIZE, 0.0f);
+    vWindow        .resize(METER_FFT_SIZE, 0.0f);
+
+
+    // Hann window, the amplitude of the sine in its bin is A * sum(window) / 2.
+
+    double dWindowSum = 0.0;
+    for (size_t i = 0; i < vWindow.size(); i++)
+    {
+        vWindow[i] = static_cast<float>( 0.5 - 0.5 * std::cos(2.0 * 3.14159265358979323846 * i / vWindow.size()) );
+        dWindowSum += vWindow[i];
+    }
+
+    fFullScalePower = static_cast<float>( (dWindowSum / 2.0) * (dWindowSum / 2.0) );
+
+
+    // Logarithmic bands from METER_MIN_FREQUENCY to the Nyquist frequency (every band has at least one bin).
+
+    vBandStart .resize(METER_SPECTRUM_BANDS, 0);
+    vBandEnd   .resize(METER_SPECTRUM_BANDS, 0);
+
+    const size_t iBinCount = METER_FFT_SIZE / 2 + 1;
+    double dNyquist  = std::max(static_cast<double>(fSampleRate) / 2.0, static_cast<double>(METER_MIN_FREQUENCY) * 2.0);
+    double dBinWidth = dNyquist * 2.0 / METER_FFT_SIZE;
+
+    size_t iLastEnd = 1;
+    for (int i = 0; i < METER_SPECTRUM_BANDS; i++)
+    {
+        double dTo  = METER_MIN_FREQUENCY * std::pow(dNyquist / METER_MIN_FREQUENCY, static_cast<double>(i + 1) / METER_SPECTRUM_BANDS);
+        size_t iEnd = static_cast<size_t>(dTo / dBinWidth) + 1;
+
+        vBandStart[static_cast<size_t>(i)] = std::min(iLastEnd, iBinCount - 1);
+        vBandEnd[static_cast<size_t>(i)]   = std::min(std::max(iEnd, vBandStart[static_cast<size_t>(i)] + 1), iBinCount);
+
+        iLastEnd = vBandEnd[static_cast<size_t>(i)];
+    }
+}
+
+
+
+
+
+bool MasterAnalyzer::createDSP(FMOD::System* pSystem, FMOD::DSP** ppDSP)
+{
+    static FMOD_DSP_PARAMETER_DESC  parameter;
+    static FMOD_DSP_PARAMETER_DESC* pParameter = &parameter;
+    static FMOD_DSP_DESCRIPTION     description;
+    static std::once_flag           descriptionReady;
+
+    std::call_once(descriptionReady, []
+    {
+        FMOD_DSP_INIT_PARAMDESC_DATA(parameter, "Analyzer", "", "MasterAnalyzer object", FMOD_DSP_PARAMETER_DATA_TYPE_USER);
+
+        memset(&description, 0, sizeof(description));
+
+        description.pluginsdkversion  = FMOD_PLUGIN_SDK_VERSION;
+        strncpy(description.name, "Bloody Analyzer", sizeof(description.name) - 1);
+        description.version           = 1;
+        description.numinputbuffers   = 1;
+        description.numoutputbuffers  = 1;
+        description.create            = MasterAnalyzerDSPCallbacks::create;
+        description.release           = MasterAnalyzerDSPCallbacks::release;
+        description.read              = MasterAnalyzerDSPCallbacks::read;
+        description.numparameters     = 1;
+        description.paramdesc         = &pParameter;
+        description.getparameterdata  = MasterAnalyzerDSPCallbacks::getParameterData;
+    });
+
+    return pSystem->createDSP(&description, ppDSP) == FMOD_OK;
+}
+
+MasterAnalyzer* MasterAnalyzer::getAnalyzer(FMOD::DSP* pDSP)
+{
+    void*        pData   = nullptr;
+    unsigned int iLength = 0;
+
+    if (pDSP->getParameterData(0, &pData, &iLength, nullptr, 0))
+    {
+        return nullptr;
+    }
+
+    return static_cast<MasterAnalyzer*>(pData);
+}
+
+void MasterAnalyzer::process(const float* pIn, float* pOut, unsigned int iFrameCount, int iChannels)
+{
+    if (pIn != pOut)
+    {
+        memcpy(pOut, pIn, iFrameCount * static_cast<size_t>(iChannels) * sizeof(float));
+    }
+
+    int   iMeteredChannels = std::min(iChannels, METER_MAX_CHANNELS);
+    float fMonoScale       = (iMeteredChannels > 0) ? 1.0f / iMeteredChannels : 0.0f;
+
+    for (unsigned int iFrame = 0; iFrame < iFrameCount; iFrame++)
+    {
+        const float* pFrame = pIn + iFrame * static_cast<size_t>(iChannels);
+
+        float fMono = 0.0f;
+
+        for (int c = 0; c < iMeteredChannels; c++)
+        {
+            float fSample = pFrame[c];
+
+            vPeak[static_cast<size_t>(c)]          = std::max(vPeak[static_cast<size_t>(c)], std::fabs(fSample));
+            vSumOfSquares[static_cast<size_t>(c)] += static_cast<double>(fSample) * fSample;
+
+            fMono += fSample;
+        }
+
+        vHistory[iHistoryPos] = fMono * fMonoScale;
+        iHistoryPos = (iHistoryPos + 1) & (METER_FFT_SIZE - 1);
+
+        iPeriodFrames++;
+
+        if (iPeriodFrames == METER_PERIOD_FRAMES)
+        {
+            publishFrame(iMeteredChannels);
+        }
+    }
+}
+
+bool MasterAnalyzer::readFrame(MeterFrame* pFrame)
+{
+    return meterBuffer.read(pFrame);
+}
+
+void MasterAnalyzer::publishFrame(int iChannels)
+{
+    MeterFrame* pFrame = meterBuffer.getWriteFrame();
+
+    pFrame->iChannels   = iChannels;
+    pFrame->fSampleRate = fSampleRate;
+
+
+    // Levels.
+
+    for (size_t c = 0; c < vPeak.size(); c++)
+    {
+        pFrame->vPeak[c] = vPeak[c];
+        pFrame->vRMS[c]  = static_cast<float>( std::sqrt(vSumOfSquares[c] / iPeriodFrames) );
+
+        vPeak[c]         = 0.0f;
+        vSumOfSquares[c] = 0.0;
+    }
+
+    iPeriodFrames = 0;
+
+
+    // Spectrum (oldest frame of the ring is at 'iHistoryPos').
+
+    for (size_t i = 0; i < vRe.size(); i++)
+    {
+        vRe[i] = vHistory[(iHistoryPos + i) & (METER_FFT_SIZE - 1)] * vWindow[i];
+        vIm[i] = 0.0f;
+    }
+
+    fft.forward(vRe.data(), vIm.data());
+
+    for (size_t i = 0; i < vBandStart.size(); i++)
+    {
+        float fMaxPower = 0.0f;
+
+        for (size_t k = vBandStart[i]; k < vBandEnd[i]; k++)
+        {
+            fMaxPower = std::max(fMaxPower, vRe[k] * vRe[k] + vIm[k] * vIm[k]);
+        }
+
+        float fLevel = (fMaxPower > 0.0f) ? 10.0f * std::log10(fMaxPower / fFullScalePower) : METER_MIN_DB;
+
+        pFrame->vSpectrum[i] = std::max(fLevel, METER_MIN_DB);
+    }
+
+    meterBuffer.publish();
+}
@@ -0,0 +1,107 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <cstddef>
+
+// Custom
+#include "Model/FFT/fft.h"
+#include "Model/MeterBuffer/meterbuffer.h"
+
+
+
+
+
+struct MasterAnalyzerDSPCallbacks;
+
+namespace FMOD
+{
+    class System;
+    class DSP;
+}
+
+
+
+
+
+// Analysis tap on the master output as the FMOD DSP (the signal is not changed).
+// Every METER_PERIOD_FRAMES frames the peak and RMS of every channel and the spectrum of the last METER_FFT_SIZE frames
+// (mono mix, Hann window, METER_SPECTRUM_BANDS logarithmic bands) are published to the MeterBuffer,
+// the GUI reads the latest frame on its own timer (see MainWindow::slotUpdateMeters()).
+// The audio thread never waits for the GUI and nothing is allocated after the constructor.
+
+class MasterAnalyzer
+{
+
+public:
+
+    MasterAnalyzer(float fSampleRate);
+
+
+
+
+
+    // FMOD
+
+        // The DSP has one data parameter - the MasterAnalyzer object (see getAnalyzer()).
+        static bool            createDSP        (FMOD::System* pSystem,  FMOD::DSP** ppDSP);
+        // Object of the DSP created by createDSP(), it's deleted with the DSP.
+        static MasterAnalyzer* getAnalyzer      (FMOD::DSP* pDSP);
+
+
+    // Main functions
+
+        // 'pIn' and 'pOut' - interleaved samples, 'iFrameCount' samples of every channel.
+        void                   process          (const float* pIn,  float* pOut,  unsigned int iFrameCount,  int iChannels);
+
+
+    // Reader (one thread)
+
+        // Returns 'false' if nothing new was published since the last call (see MeterBuffer::read()).
+        bool                   readFrame        (MeterFrame* pFrame);
+
+
+
+
+
+private:
+
+    friend struct MasterAnalyzerDSPCallbacks;
+
+
+    // Used in process()
+
+        void                   publishFrame     (int iChannels);
+
+
+    float                fSampleRate;
+
+    FFT                  fft;
+    MeterBuffer          meterBuffer;
+
+
+    // Audio thread
+    // Peak and sum of squares of every channel in the current period.
+    std::vector<float>   vPeak;
+    std::vector<double>  vSumOfSquares;
+    unsigned int         iPeriodFrames;
+    // Last METER_FFT_SIZE frames of the mono mix (ring).
+    std::vector<float>   vHistory;
+    size_t               iHistoryPos;
+    // FFT buffers.
+    std::vector<float>   vRe;
+    std::vector<float>   vIm;
+    std::vector<float>   vWindow;
+    // Power of the full scale sine (with the window).
+    float                fFullScalePower;
+    // Bins [vBandStart[i], vBandEnd[i]) are in the band 'i'.
+    std::vector<size_t>  vBandStart;
+    std::vector<size_t>  vBandEnd;
+};
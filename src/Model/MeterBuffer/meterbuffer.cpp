@@ -0,0 +1,59 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "meterbuffer.h"
+
+
+// Set in 'iMiddle' when the middle frame was published and not read yet.
+static const unsigned int NEW_FRAME_BIT = 4;
+
+
+MeterBuffer::MeterBuffer(size_t iChannelCount, size_t iBandCount)
+{
+    for (size_t i = 0; i < 3; i++)
+    {
+        vFrames[i].vPeak     .resize(iChannelCount, 0.0f);
+        vFrames[i].vRMS      .resize(iChannelCount, 0.0f);
+        vFrames[i].vSpectrum .resize(iBandCount,    0.0f);
+    }
+
+    iWriteIndex      = 0;
+    iMiddle          = 1;
+    iReadIndex       = 2;
+    iPublishedFrames = 0;
+}
+
+
+
+
+
+MeterFrame* MeterBuffer::getWriteFrame()
+{
+    return &vFrames[iWriteIndex];
+}
+
+void MeterBuffer::publish()
+{
+    iPublishedFrames++;
+    vFrames[iWriteIndex].iSequence = iPublishedFrames;
+
+    // The written frame becomes the middle one, the old middle frame (read or not) is written next.
+    iWriteIndex = iMiddle.exchange(iWriteIndex | NEW_FRAME_BIT, std::memory_order_acq_rel) & ~NEW_FRAME_BIT;
+}
+
+bool MeterBuffer::read(MeterFrame* pFrame)
+{
+    if ( (iMiddle.load(std::memory_order_relaxed) & NEW_FRAME_BIT) == 0 )
+    {
+        return false;
+    }
+
+    iReadIndex = iMiddle.exchange(iReadIndex, std::memory_order_acq_rel) & ~NEW_FRAME_BIT;
+
+    // The vectors have the same size, so nothing is allocated after the first read.
+    *pFrame = vFrames[iReadIndex];
+
+    return true;
+}
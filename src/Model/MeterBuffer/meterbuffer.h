@@ -0,0 +1,90 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+
+
+
+
+// Levels and spectrum of the master output (see MasterAnalyzer).
+
+struct MeterFrame
+{
+    MeterFrame()
+    {
+        iSequence   = 0;
+        iChannels   = 0;
+        fSampleRate = 0.0f;
+    }
+
+    // Number of the frame (incremented by every publish, 0 - nothing was published yet).
+    unsigned long long  iSequence;
+    int                 iChannels;
+    float               fSampleRate;
+
+    // Linear, per channel, over the last analysis period.
+    std::vector<float>  vPeak;
+    std::vector<float>  vRMS;
+
+    // Level of the bands in dB (see METER_SPECTRUM_BANDS), 0 dB - full scale sine.
+    std::vector<float>  vSpectrum;
+};
+
+
+
+
+
+// Lock-free triple buffer of the meter frames: the audio thread writes one frame, the GUI reads the other one
+// and the third is the latest published frame. Publish and read are a single atomic exchange of the index of the middle frame,
+// so neither side ever waits for the other one (the writer can publish many frames while the reader is reading its frame).
+// All frames are allocated in the constructor. There should be only one writer and one reader.
+
+class MeterBuffer
+{
+
+public:
+
+    MeterBuffer(size_t iChannelCount,  size_t iBandCount);
+
+
+
+
+
+    // Writer
+
+        // Frame to fill before publish() (owned by the writer until then).
+        MeterFrame*          getWriteFrame  ();
+        void                 publish        ();
+
+
+    // Reader
+
+        // Copies the latest published frame, returns 'false' if nothing new was published since the last read.
+        bool                 read           (MeterFrame* pFrame);
+
+
+
+
+
+private:
+
+    MeterFrame                 vFrames[3];
+
+    // Index of the middle frame and the 'new frame' bit.
+    std::atomic<unsigned int>  iMiddle;
+
+    // Used only by the writer / only by the reader.
+    unsigned int               iWriteIndex;
+    unsigned int               iReadIndex;
+    unsigned long long         iPublishedFrames;
+};
@@ -0,0 +1,134 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "positionsnapshot.h"
+
+// STL
+#include <chrono>
+#include <cmath>
+
+PositionSnapshot::PositionSnapshot()
+{
+    iSequence       = 0;
+
+    bValid          = false;
+
+    iDSPClock       = 0;
+    iTimeInNS       = 0;
+    iPositionInPCM  = 0;
+    iLengthInPCM    = 0;
+    iLoopStartInPCM = 0;
+    iLoopEndInPCM   = 0;
+    fRate           = 0.0f;
+    fSampleRate     = 0.0f;
+}
+
+
+
+
+
+void PositionSnapshot::publish(const PlaybackPosition& position)
+{
+    unsigned int iOldSequence = iSequence.load(std::memory_order_relaxed);
+
+    iSequence.store(iOldSequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    bValid          .store(true,                     std::memory_order_relaxed);
+    iDSPClock       .store(position.iDSPClock,       std::memory_order_relaxed);
+    iTimeInNS       .store(position.iTimeInNS,       std::memory_order_relaxed);
+    iPositionInPCM  .store(position.iPositionInPCM,  std::memory_order_relaxed);
+    iLengthInPCM    .store(position.iLengthInPCM,    std::memory_order_relaxed);
+    iLoopStartInPCM .store(position.iLoopStartInPCM, std::memory_order_relaxed);
+    iLoopEndInPCM   .store(position.iLoopEndInPCM,   std::memory_order_relaxed);
+    fRate           .store(position.fRate,           std::memory_order_relaxed);
+    fSampleRate     .store(position.fSampleRate,     std::memory_order_relaxed);
+
+    iSequence.store(iOldSequence + 2, std::memory_order_release);
+}
+
+void PositionSnapshot::invalidate()
+{
+    // Nothing is playing.
+
+    unsigned int iOldSequence = iSequence.load(std::memory_order_relaxed);
+
+    iSequence.store(iOldSequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    bValid.store(false, std::memory_order_relaxed);
+
+    iSequence.store(iOldSequence + 2, std::memory_order_release);
+}
+
+bool PositionSnapshot::read(PlaybackPosition* pPosition)
+{
+    // Returns 'false' if nothing is playing.
+
+    unsigned int iSequenceBefore = 0;
+    unsigned int iSequenceAfter  = 0;
+    bool         bValidPosition  = false;
+
+    do
+    {
+        iSequenceBefore = iSequence.load(std::memory_order_acquire);
+
+        if (iSequenceBefore % 2 == 1)
+        {
+            // The writer is in the middle of publish().
+            continue;
+        }
+
+        bValidPosition              = bValid          .load(std::memory_order_relaxed);
+        pPosition->iDSPClock        = iDSPClock       .load(std::memory_order_relaxed);
+        pPosition->iTimeInNS        = iTimeInNS       .load(std::memory_order_relaxed);
+        pPosition->iPositionInPCM   = iPositionInPCM  .load(std::memory_order_relaxed);
+        pPosition->iLengthInPCM     = iLengthInPCM    .load(std::memory_order_relaxed);
+        pPosition->iLoopStartInPCM  = iLoopStartInPCM .load(std::memory_order_relaxed);
+        pPosition->iLoopEndInPCM    = iLoopEndInPCM   .load(std::memory_order_relaxed);
+        pPosition->fRate            = fRate           .load(std::memory_order_relaxed);
+        pPosition->fSampleRate      = fSampleRate     .load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        iSequenceAfter = iSequence.load(std::memory_order_relaxed);
+
+    }while ( (iSequenceBefore % 2 == 1) || (iSequenceBefore != iSequenceAfter) );
+
+    return bValidPosition;
+}
+
+unsigned int PositionSnapshot::extrapolate(const PlaybackPosition& position, long long iTimeInNS)
+{
+    // Returns the position of the track at 'iTimeInNS' assuming that it plays with the same speed
+    // (the repeat section is looped and the position stops at the track end).
+
+    if ( (position.fRate <= 0.0f) || (iTimeInNS <= position.iTimeInNS) )
+    {
+        return position.iPositionInPCM;
+    }
+
+    double dPosInPCM = position.iPositionInPCM + (iTimeInNS - position.iTimeInNS) / 1000000000.0 * position.fRate;
+
+    if ( (position.iLoopEndInPCM > position.iLoopStartInPCM) && (position.iPositionInPCM < position.iLoopEndInPCM)
+         && (dPosInPCM >= position.iLoopEndInPCM) )
+    {
+        double dLoopLength = position.iLoopEndInPCM - position.iLoopStartInPCM;
+
+        dPosInPCM = position.iLoopStartInPCM + std::fmod(dPosInPCM - position.iLoopStartInPCM, dLoopLength);
+    }
+
+    if (dPosInPCM > position.iLengthInPCM)
+    {
+        dPosInPCM = position.iLengthInPCM;
+    }
+
+    return static_cast<unsigned int>(dPosInPCM);
+}
+
+long long PositionSnapshot::getTimeInNS()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,89 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <atomic>
+
+
+
+
+
+struct PlaybackPosition
+{
+    // DSP clock (of the master channel group) and the time (steady_clock) when the position was read.
+    unsigned long long iDSPClock;
+    long long          iTimeInNS;
+
+    unsigned int       iPositionInPCM;
+    unsigned int       iLengthInPCM;
+
+    // Repeat section [iLoopStartInPCM, iLoopEndInPCM) (0 and 0 if not looping).
+    unsigned int       iLoopStartInPCM;
+    unsigned int       iLoopEndInPCM;
+
+    // Samples of the track per second with the current speed (0 - paused).
+    float              fRate;
+    // Samples of the track per second with the normal speed (used to convert the position to time).
+    float              fSampleRate;
+};
+
+
+
+
+
+// Position of the current track published by the audio-control thread (see AudioService::publishPosition())
+// and read by the GUI at the display refresh rate (see MainWindow::slotUpdatePlayhead()).
+// This is a seqlock: the reader never waits and never allocates, it just reads again if the writer was in the middle of publish().
+// There should be only one writer at a time (AudioService calls publish() under 'mtxTracksVec').
+
+class PositionSnapshot
+{
+
+public:
+
+    PositionSnapshot();
+
+
+
+
+
+    // Writer
+
+        void                 publish        (const PlaybackPosition& position);
+        void                 invalidate     ();
+
+
+    // Readers
+
+        bool                 read           (PlaybackPosition* pPosition);
+
+        static unsigned int  extrapolate    (const PlaybackPosition& position,  long long iTimeInNS);
+        static long long     getTimeInNS    ();
+
+
+
+
+
+private:
+
+    // Odd - the writer is changing the fields.
+    std::atomic<unsigned int>        iSequence;
+
+
+    std::atomic<bool>                bValid;
+
+    std::atomic<unsigned long long>  iDSPClock;
+    std::atomic<long long>           iTimeInNS;
+    std::atomic<unsigned int>        iPositionInPCM;
+    std::atomic<unsigned int>        iLengthInPCM;
+    std::atomic<unsigned int>        iLoopStartInPCM;
+    std::atomic<unsigned int>        iLoopEndInPCM;
+    std::atomic<float>               fRate;
+    std::atomic<float>               fSampleRate;
+};
@@ -0,0 +1,180 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "preloadcache.h"
+
+// STL
+#include <cstring>
+
+// Custom
+#include "Model/MappedFileSystem/mappedfilesystem.h"
+
+PreloadCache::PreloadCache(size_t iBudgetInBytes)
+{
+    this->iBudgetInBytes = iBudgetInBytes;
+    iUsedBytes           = 0;
+
+    iHits                = 0;
+    iMisses              = 0;
+    dHitLatencySumInMS   = 0.0;
+    dMissLatencySumInMS  = 0.0;
+}
+
+
+
+
+
+std::shared_ptr<std::vector<char>> PreloadCache::load(const std::wstring& sFilePath)
+{
+    // This function returns the whole file from the cache or reads it from the disk.
+    // Returns nullptr if the file can't be read or it does not fit in the budget (the track will be streamed).
+
+    mtxCache.lock();
+
+    auto it = entriesByPath.find(sFilePath);
+    if (it != entriesByPath.end())
+    {
+        // Now it's the most recently used.
+        lEntries.splice(lEntries.begin(), lEntries, it->second);
+
+        std::shared_ptr<std::vector<char>> pData = it->second->pData;
+
+        mtxCache.unlock();
+
+        return pData;
+    }
+
+    size_t iBudget = iBudgetInBytes;
+
+    mtxCache.unlock();
+
+
+
+    // Read without the lock, it may take a while.
+
+    std::shared_ptr<MappedFile> pAudioFile = MappedFileSystem::mapFile(sFilePath);
+
+    if (pAudioFile == nullptr)
+    {
+        return nullptr;
+    }
+
+    size_t iSizeInBytes = static_cast<size_t>(pAudioFile->getSizeInBytes());
+
+    if (iSizeInBytes > iBudget)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<std::vector<char>> pData = std::make_shared<std::vector<char>>(iSizeInBytes);
+    memcpy(pData->data(), pAudioFile->getData(), iSizeInBytes);
+
+    pAudioFile.reset();
+
+
+
+    std::lock_guard<std::mutex> lock(mtxCache);
+
+    it = entriesByPath.find(sFilePath);
+    if (it != entriesByPath.end())
+    {
+        // Someone was faster.
+        lEntries.splice(lEntries.begin(), lEntries, it->second);
+        return it->second->pData;
+    }
+
+    if ( makeRoom(iSizeInBytes) == false )
+    {
+        // All cached files are used by the tracks.
+        return nullptr;
+    }
+
+    CacheEntry entry;
+    entry.sFilePath = sFilePath;
+    entry.pData     = pData;
+
+    lEntries.push_front(entry);
+    entriesByPath[sFilePath] = lEntries.begin();
+
+    iUsedBytes += iSizeInBytes;
+
+    return pData;
+}
+
+void PreloadCache::setBudget(size_t iBudgetInBytes)
+{
+    // 0 - nothing is preloaded.
+
+    std::lock_guard<std::mutex> lock(mtxCache);
+
+    this->iBudgetInBytes = iBudgetInBytes;
+
+    makeRoom(0);
+}
+
+size_t PreloadCache::getBudget()
+{
+    std::lock_guard<std::mutex> lock(mtxCache);
+
+    return iBudgetInBytes;
+}
+
+void PreloadCache::addTrackStart(bool bHit, double dFirstAudioLatencyInMS)
+{
+    std::lock_guard<std::mutex> lock(mtxCache);
+
+    if (bHit)
+    {
+        iHits++;
+        dHitLatencySumInMS += dFirstAudioLatencyInMS;
+    }
+    else
+    {
+        iMisses++;
+        dMissLatencySumInMS += dFirstAudioLatencyInMS;
+    }
+}
+
+PreloadStats PreloadCache::getStats()
+{
+    std::lock_guard<std::mutex> lock(mtxCache);
+
+    PreloadStats stats;
+
+    stats.iHits                   = iHits;
+    stats.iMisses                 = iMisses;
+    stats.dAverageHitLatencyInMS  = (iHits   > 0) ? (dHitLatencySumInMS  / iHits)   : 0.0;
+    stats.dAverageMissLatencyInMS = (iMisses > 0) ? (dMissLatencySumInMS / iMisses) : 0.0;
+    stats.iUsedBytes              = iUsedBytes;
+    stats.iBudgetInBytes          = iBudgetInBytes;
+
+    return stats;
+}
+
+bool PreloadCache::makeRoom(size_t iSizeInBytes)
+{
+    // 'mtxCache' should be locked.
+    // Removes the least recently used files (that are not used by the tracks) until 'iSizeInBytes' fits in the budget.
+
+    auto it = lEntries.end();
+
+    while ( (iUsedBytes + iSizeInBytes > iBudgetInBytes) && (it != lEntries.begin()) )
+    {
+        --it;
+
+        if (it->pData.use_count() > 1)
+        {
+            // Used by a track.
+            continue;
+        }
+
+        iUsedBytes -= it->pData->size();
+
+        entriesByPath.erase(it->sFilePath);
+        it = lEntries.erase(it);
+    }
+
+    return iUsedBytes + iSizeInBytes <= iBudgetInBytes;
+}
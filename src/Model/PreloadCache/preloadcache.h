@@ -0,0 +1,107 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+
+
+
+
+struct PreloadStats
+{
+    // Track start: playback of the preloaded track (hit) or of the stream from the disk (miss).
+    unsigned long long iHits;
+    unsigned long long iMisses;
+
+    // Time from AudioService::playTrack() to the first mixed audio.
+    double             dAverageHitLatencyInMS;
+    double             dAverageMissLatencyInMS;
+
+    size_t             iUsedBytes;
+    size_t             iBudgetInBytes;
+};
+
+
+
+
+
+// Whole files of the upcoming tracks read in memory (see AudioService::preloadNextTrack()),
+// tracks play them with FMOD_OPENMEMORY_POINT so a slow disk (or a network share) can't stall the stream.
+// Least recently used files are removed when the budget is exceeded,
+// the data that is used by a track is kept alive by the track (std::shared_ptr) and is never removed.
+
+class PreloadCache
+{
+
+public:
+
+    PreloadCache(size_t iBudgetInBytes);
+
+
+
+
+
+    // Main functions
+
+        std::shared_ptr<std::vector<char>>  load            (const std::wstring& sFilePath);
+        void                                setBudget       (size_t iBudgetInBytes);
+        size_t                              getBudget       ();
+
+
+    // Stats
+
+        void                                addTrackStart   (bool bHit,  double dFirstAudioLatencyInMS);
+        PreloadStats                        getStats        ();
+
+
+
+
+
+private:
+
+    struct CacheEntry
+    {
+        std::wstring                        sFilePath;
+        std::shared_ptr<std::vector<char>>  pData;
+    };
+
+
+    // Used in load() and setBudget()
+
+        bool                                makeRoom        (size_t iSizeInBytes);
+
+
+
+
+
+
+    std::mutex                 mtxCache;
+
+
+    // Front - most recently used.
+    std::list<CacheEntry>      lEntries;
+    std::map<std::wstring, std::list<CacheEntry>::iterator> entriesByPath;
+
+
+    size_t                     iBudgetInBytes;
+    size_t                     iUsedBytes;
+
+
+    // Stats
+    unsigned long long         iHits;
+    unsigned long long         iMisses;
+    double                     dHitLatencySumInMS;
+    double                     dMissLatencySumInMS;
+};
@@ -0,0 +1,176 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "seektable.h"
+
+// STL
+#include <fstream>
+#include <vector>
+#include <cstring>
+
+// Custom
+#include "Model/CacheFolder/cachefolder.h"
+#include "Model/MappedFileSystem/mappedfilesystem.h"
+#include "Model/MP3Parser/mp3parser.h"
+#include "globalparams.h"
+
+// Other
+#if !_WIN32
+#include <locale>
+#include <codecvt>
+#endif
+
+SeekTable::SeekTable()
+{
+    bVBR             = false;
+    bBuilt           = false;
+    bLoadedFromCache = false;
+}
+
+
+
+
+
+bool SeekTable::build(const std::wstring& sFilePath)
+{
+    // This function loads the VBR flag from the cache
+    // or (if there is no valid cache for this file) scans the file and saves the flag to the cache.
+
+    long long iFileSize         = 0;
+    long long iModificationTime = 0;
+
+    if ( CacheFolder::getFileInfo(sFilePath, &iFileSize, &iModificationTime) == false )
+    {
+        return false;
+    }
+
+    std::wstring sCacheFilePath = CacheFolder::getCacheFilePath(sFilePath, SEEK_TABLE_CACHE_FOLDER, SEEK_TABLE_CACHE_EXTENSION);
+
+    if ( (sCacheFilePath.empty() == false) && loadFromCache(sCacheFilePath, iFileSize, iModificationTime) )
+    {
+        bBuilt           = true;
+        bLoadedFromCache = true;
+        return true;
+    }
+
+
+
+    // Shared with the stream of the track (see MappedFileSystem).
+    std::shared_ptr<MappedFile> pAudioFile = MappedFileSystem::mapFile(sFilePath);
+
+    if (pAudioFile == nullptr)
+    {
+        return false;
+    }
+
+    MP3Parser                  parser(pAudioFile->getData(), static_cast<size_t>(pAudioFile->getSizeInBytes()));
+    MP3FrameHeader             firstFrame;
+    std::vector<unsigned int>  vFrameOffsets;
+
+    if ( parser.buildSeekTable(&vFrameOffsets, &firstFrame, &bVBR) == false )
+    {
+        return false;
+    }
+
+    pAudioFile.reset();
+
+
+    if (sCacheFilePath.empty() == false)
+    {
+        saveToCache(sCacheFilePath, iFileSize, iModificationTime);
+    }
+
+    bBuilt = true;
+
+    return true;
+}
+
+bool SeekTable::isBuilt() const
+{
+    return bBuilt;
+}
+
+bool SeekTable::isVBR() const
+{
+    return bVBR;
+}
+
+bool SeekTable::isLoadedFromCache() const
+{
+    return bLoadedFromCache;
+}
+
+bool SeekTable::loadFromCache(const std::wstring& sCacheFilePath, long long iFileSize, long long iModificationTime)
+{
+#if _WIN32
+    std::ifstream cacheFile(sCacheFilePath, std::ios::binary);
+#else
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+    auto out = utf8_conv.to_bytes(sCacheFilePath);
+
+    std::ifstream cacheFile(out, std::ios::binary);
+#endif
+
+    if (cacheFile.is_open() == false)
+    {
+        return false;
+    }
+
+
+    // Header
+
+    char         vMagic[4];
+    int          iVersion            = 0;
+    long long    iCachedFileSize     = 0;
+    long long    iCachedModification = 0;
+    char         cVBR                = 0;
+
+    cacheFile.read(vMagic,                                       sizeof(vMagic));
+    cacheFile.read(reinterpret_cast<char*>(&iVersion),            sizeof(iVersion));
+    cacheFile.read(reinterpret_cast<char*>(&iCachedFileSize),     sizeof(iCachedFileSize));
+    cacheFile.read(reinterpret_cast<char*>(&iCachedModification), sizeof(iCachedModification));
+    cacheFile.read(&cVBR,                                         sizeof(cVBR));
+
+    if ( (cacheFile.good() == false)
+         || (memcmp(vMagic, "BPST", 4) != 0)
+         || (iVersion != SEEK_TABLE_CACHE_VERSION)
+         || (iCachedFileSize != iFileSize)
+         || (iCachedModification != iModificationTime) )
+    {
+        // The file was changed (or the cache is from the other version).
+        return false;
+    }
+
+    bVBR = (cVBR != 0);
+
+    return true;
+}
+
+void SeekTable::saveToCache(const std::wstring& sCacheFilePath, long long iFileSize, long long iModificationTime)
+{
+#if _WIN32
+    std::ofstream cacheFile(sCacheFilePath, std::ios::binary);
+#else
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+    auto out = utf8_conv.to_bytes(sCacheFilePath);
+
+    std::ofstream cacheFile(out, std::ios::binary);
+#endif
+
+    if (cacheFile.is_open() == false)
+    {
+        // Not critical, we will just scan the file again next time.
+        return;
+    }
+
+    int          iVersion    = SEEK_TABLE_CACHE_VERSION;
+    char         cVBR        = bVBR ? 1 : 0;
+
+    cacheFile.write("BPST",                                             4);
+    cacheFile.write(reinterpret_cast<char*>(&iVersion),                 sizeof(iVersion));
+    cacheFile.write(reinterpret_cast<char*>(&iFileSize),                sizeof(iFileSize));
+    cacheFile.write(reinterpret_cast<char*>(&iModificationTime),        sizeof(iModificationTime));
+    cacheFile.write(&cVBR,                                              sizeof(cVBR));
+}
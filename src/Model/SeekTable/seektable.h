@@ -0,0 +1,63 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <string>
+
+
+
+
+
+// Scan of all MP3 frames of the file (see MP3Parser::buildSeekTable()).
+// FMOD 2.01 can't take the frame offsets for seeking, so only the result of the scan that we use is kept:
+// the VBR flag (VBR MP3 needs FMOD_ACCURATETIME for exact seeking, CBR MP3 does not).
+// The flag is saved to the cache folder, so next time we only read it from the disk.
+
+class SeekTable
+{
+
+public:
+
+    SeekTable();
+
+
+
+
+
+    // Main functions
+
+        bool                build               (const std::wstring& sFilePath);
+
+
+    // 'Get' functions
+
+        bool                isBuilt             () const;
+        bool                isVBR               () const;
+        bool                isLoadedFromCache   () const;
+
+
+
+
+
+private:
+
+    // Used in build()
+
+        bool                loadFromCache       (const std::wstring& sCacheFilePath,  long long iFileSize,  long long iModificationTime);
+        void                saveToCache         (const std::wstring& sCacheFilePath,  long long iFileSize,  long long iModificationTime);
+
+
+
+
+
+
+    bool                       bVBR;
+    bool                       bBuilt;
+    bool                       bLoadedFromCache;
+};
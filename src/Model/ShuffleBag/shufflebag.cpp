@@ -0,0 +1,165 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "shufflebag.h"
+
+ShuffleBag::ShuffleBag() : rndGen( std::random_device{}() )
+{
+    iDrawnCount = 0;
+}
+
+
+
+
+
+void ShuffleBag::addTrack(TrackHandle track)
+{
+    // New tracks are not played yet.
+
+    if (track.iSlot >= vBagPositions.size())
+    {
+        vBagPositions.resize(track.iSlot + 1);
+    }
+
+    vBagPositions[track.iSlot] = vBag.size();
+    vBag.push_back(track);
+}
+
+void ShuffleBag::removeTrack(TrackHandle track)
+{
+    size_t iPos = 0;
+
+    if (getBagPosition(track, &iPos) == false)
+    {
+        return;
+    }
+
+    if (iPos < iDrawnCount)
+    {
+        // Keep the played part contiguous.
+
+        swapTracks(iPos, iDrawnCount - 1);
+        iPos = iDrawnCount - 1;
+
+        iDrawnCount--;
+    }
+
+    swapTracks(iPos, vBag.size() - 1);
+
+    vBag.pop_back();
+}
+
+void ShuffleBag::clear()
+{
+    vBag.clear();
+
+    iDrawnCount = 0;
+}
+
+TrackHandle ShuffleBag::getNextTrack(TrackHandle currentTrack)
+{
+    // Returns a track that was not played in this round, 'currentTrack' is never returned
+    // if there are other tracks (so a new round does not start with the track that ended the old one).
+
+    if (vBag.empty())
+    {
+        return TrackHandle();
+    }
+
+    if (vBag.size() == 1)
+    {
+        return vBag[0];
+    }
+
+
+    size_t iLastCandidate = vBag.size() - 1;
+
+    if (iDrawnCount == vBag.size())
+    {
+        // New round.
+        iDrawnCount = 0;
+    }
+
+    size_t iCurrentPos = 0;
+
+    if ( getBagPosition(currentTrack, &iCurrentPos) && (iCurrentPos >= iDrawnCount) )
+    {
+        // Hide the current track at the end of the not played part.
+
+        swapTracks(iCurrentPos, vBag.size() - 1);
+
+        if (iDrawnCount != iLastCandidate)
+        {
+            iLastCandidate--;
+        }
+        else
+        {
+            // The current track is the only one left, start a new round.
+
+            iDrawnCount    = 0;
+            iLastCandidate = vBag.size() - 2;
+        }
+    }
+
+
+    std::uniform_int_distribution<size_t> uid(iDrawnCount, iLastCandidate);
+
+    size_t iPicked = uid(rndGen);
+
+    swapTracks(iPicked, iDrawnCount);
+    iDrawnCount++;
+
+    return vBag[iDrawnCount - 1];
+}
+
+void ShuffleBag::markPlayed(TrackHandle track)
+{
+    // The track was picked by the user (or by the 'next track' in order), don't play it again in this round.
+
+    size_t iPos = 0;
+
+    if ( (getBagPosition(track, &iPos) == false) || (iPos < iDrawnCount) )
+    {
+        return;
+    }
+
+    swapTracks(iPos, iDrawnCount);
+    iDrawnCount++;
+}
+
+bool ShuffleBag::getBagPosition(TrackHandle track, size_t* pPosition)
+{
+    if (track.iSlot >= vBagPositions.size())
+    {
+        return false;
+    }
+
+    size_t iPos = vBagPositions[track.iSlot];
+
+    if ( (iPos >= vBag.size()) || (vBag[iPos] != track) )
+    {
+        // Not in the bag (or the slot is used by other track now).
+        return false;
+    }
+
+    *pPosition = iPos;
+
+    return true;
+}
+
+void ShuffleBag::swapTracks(size_t iFirst, size_t iSecond)
+{
+    if (iFirst == iSecond)
+    {
+        return;
+    }
+
+    TrackHandle temp = vBag[iFirst];
+    vBag[iFirst]     = vBag[iSecond];
+    vBag[iSecond]    = temp;
+
+    vBagPositions[vBag[iFirst].iSlot]  = iFirst;
+    vBagPositions[vBag[iSecond].iSlot] = iSecond;
+}
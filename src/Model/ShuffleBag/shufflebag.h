@@ -0,0 +1,71 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <random>
+
+// Custom
+#include "Model/TrackStore/trackstore.h"
+
+
+
+
+// Play order of the 'random track' mode: every track is played once before any track is played again.
+// The bag is shuffled lazily (Fisher-Yates one step per getNextTrack()) so every call is O(1)
+// and a new round is started by just resetting 'iDrawnCount'.
+// Not thread-safe (used under AudioService::mtxTracksVec).
+
+class ShuffleBag
+{
+
+public:
+
+    ShuffleBag();
+
+
+
+
+
+    // Tracklist changes
+
+        void         addTrack         (TrackHandle track);
+        void         removeTrack      (TrackHandle track);
+        void         clear            ();
+
+
+    // Play order
+
+        TrackHandle  getNextTrack     (TrackHandle currentTrack);
+        void         markPlayed       (TrackHandle track);
+
+
+
+
+
+private:
+
+    // Used in removeTrack() and getNextTrack()
+
+        bool         getBagPosition   (TrackHandle track,  size_t* pPosition);
+        void         swapTracks       (size_t iFirst,     size_t iSecond);
+
+
+
+
+    // [0, iDrawnCount) - already played in this round, [iDrawnCount, size) - not played yet.
+    std::vector<TrackHandle>  vBag;
+    size_t                    iDrawnCount;
+
+    // Position of the track in 'vBag' by the slot of its handle (slots are small and dense, see TrackStore).
+    std::vector<size_t>       vBagPositions;
+
+
+    std::mt19937_64           rndGen;
+};
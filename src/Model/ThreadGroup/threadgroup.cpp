@@ -0,0 +1,91 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "threadgroup.h"
+
+ThreadGroup::ThreadGroup()
+{
+    bStopped = false;
+}
+
+
+
+
+
+bool ThreadGroup::start(std::function<void()> function)
+{
+    // This function can be called from any thread.
+
+    std::lock_guard<std::mutex> lock(mtxThreads);
+
+    if (bStopped)
+    {
+        return false;
+    }
+
+    joinFinished();
+
+    threads.push_back(GroupThread());
+
+    GroupThread* pGroupThread = &threads.back();
+    pGroupThread->bFinished   = false;
+
+    // The list node is not moved, so the thread can mark itself as finished.
+    pGroupThread->thread = std::thread([this, pGroupThread, function]()
+    {
+        function();
+
+        std::lock_guard<std::mutex> lock(mtxThreads);
+        pGroupThread->bFinished = true;
+    });
+
+    return true;
+}
+
+void ThreadGroup::joinAll()
+{
+    // Threads are joined without 'mtxThreads' locked, they lock it when they are finished.
+
+    std::list<GroupThread> stoppedThreads;
+
+    mtxThreads.lock();
+
+    bStopped = true;
+    stoppedThreads.splice(stoppedThreads.end(), threads);
+
+    mtxThreads.unlock();
+
+
+    for (std::list<GroupThread>::iterator it = stoppedThreads.begin(); it != stoppedThreads.end(); ++it)
+    {
+        it->thread.join();
+    }
+}
+
+ThreadGroup::~ThreadGroup()
+{
+    joinAll();
+}
+
+void ThreadGroup::joinFinished()
+{
+    // This function is executed in mtxThreads.lock();
+    // A finished thread has only to return from its function, so join() does not wait for long.
+
+    std::list<GroupThread>::iterator it = threads.begin();
+
+    while (it != threads.end())
+    {
+        if (it->bFinished)
+        {
+            it->thread.join();
+            it = threads.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
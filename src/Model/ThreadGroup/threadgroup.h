@@ -0,0 +1,70 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+
+
+
+
+
+// Background threads of the owner (see AudioService) that are joined instead of being detached.
+// A finished thread is joined when the next one is started, joinAll() waits for the rest
+// (the owner calls it in its destructor after the threads that start new ones are stopped).
+
+class ThreadGroup
+{
+
+public:
+
+    ThreadGroup();
+
+
+
+
+
+    // Main functions
+
+        // Returns false (and 'function' is not called) after joinAll().
+        bool                start              (std::function<void()> function);
+        void                joinAll            ();
+
+
+    ~ThreadGroup();
+
+
+
+
+
+private:
+
+    struct GroupThread
+    {
+        std::thread        thread;
+        bool               bFinished;
+    };
+
+
+    // Used in start()
+
+        void               joinFinished       ();
+
+
+
+
+
+    std::mutex              mtxThreads;
+    std::list<GroupThread>  threads;
+
+
+    bool                    bStopped;
+};
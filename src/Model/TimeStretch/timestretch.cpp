@@ -0,0 +1,347 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "timestretch.h"
+
+// STL
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <mutex>
+#include <algorithm>
+#include <limits>
+
+// Custom
+#include "globalparams.h"
+#include "../ext/FMOD/inc/fmod.hpp"
+
+
+struct TimeStretchDSPCallbacks
+{
+    static FMOD_RESULT F_CALLBACK create(FMOD_DSP_STATE* pDSPState)
+    {
+        int iSampleRate = 0;
+        FMOD_DSP_GETSAMPLERATE(pDSPState, &iSampleRate);
+
+        pDSPState->plugindata = new TimeStretch( static_cast<float>(iSampleRate) );
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK release(FMOD_DSP_STATE* pDSPState)
+    {
+        delete static_cast<TimeStretch*>(pDSPState->plugindata);
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK reset(FMOD_DSP_STATE* pDSPState)
+    {
+        static_cast<TimeStretch*>(pDSPState->plugindata)->reset();
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK read(FMOD_DSP_STATE* pDSPState, float* pInBuffer, float* pOutBuffer, unsigned int iLength, int iInChannels, int* pOutChannels)
+    {
+        static_cast<TimeStretch*>(pDSPState->plugindata)->process(pInBuffer, pOutBuffer, iLength, iInChannels);
+
+        *pOutChannels = iInChannels;
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK setParameterFloat(FMOD_DSP_STATE* pDSPState, int iIndex, float fValue)
+    {
+        (void)iIndex;
+
+        static_cast<TimeStretch*>(pDSPState->plugindata)->setSpeed(fValue);
+
+        return FMOD_OK;
+    }
+
+    static FMOD_RESULT F_CALLBACK getParameterFloat(FMOD_DSP_STATE* pDSPState, int iIndex, float* pValue, char* pValueString)
+    {
+        (void)iIndex;
+
+        *pValue = static_cast<TimeStretch*>(pDSPState->plugindata)->getSpeed();
+
+        if (pValueString)
+        {
+            snprintf(pValueString, FMOD_DSP_GETPARAM_VALUESTR_LENGTH, "x%.2f", static_cast<double>(*pValue));
+        }
+
+        return FMOD_OK;
+    }
+};
+
+TimeStretch::TimeStretch(float fSampleRate)
+{
+    this->fSampleRate = fSampleRate;
+
+    iGrainLength      = static_cast<int>(fSampleRate * TIME_STRETCH_GRAIN_MS / 1000) & ~1;
+    iHop              = iGrainLength / 2;
+    iSeekRange        = static_cast<int>(fSampleRate * TIME_STRETCH_SEEK_MS / 1000);
+
+    // The grain is centered on its place in the input and reads up to 'iGrainLength * ratio' frames
+    // (+ seek range, + 1 for the interpolation and + 1 for the ratio rounding), all of them should be written already.
+    iLatency          = static_cast<unsigned int>( iHop + std::ceil(iHop * TIME_STRETCH_MAX_RATIO) + iSeekRange + 2 );
+
+    iRingSize         = 1;
+    while (iRingSize < iLatency + static_cast<size_t>(iGrainLength * TIME_STRETCH_MAX_RATIO) + iSeekRange * 2 + iGrainLength)
+    {
+        iRingSize *= 2;
+    }
+
+    vInput     .resize(iRingSize * TIME_STRETCH_MAX_CHANNELS, 0.0f);
+    vMonoInput .resize(iRingSize, 0.0f);
+    vOutput    .resize(static_cast<size_t>(iGrainLength) * TIME_STRETCH_MAX_CHANNELS, 0.0f);
+
+    // Periodic Hann: grains with the hop of a half of the grain sum to 1.
+    vWindow    .resize(static_cast<size_t>(iGrainLength));
+    for (int i = 0; i < iGrainLength; i++)
+    {
+        vWindow[i] = static_cast<float>( 0.5 - 0.5 * std::cos(2.0 * 3.14159265358979323846 * i / iGrainLength) );
+    }
+
+    fSpeed = 1.0f;
+
+    reset();
+}
+
+
+
+
+
+bool TimeStretch::createDSP(FMOD::System* pSystem, FMOD::DSP** ppDSP)
+{
+    static FMOD_DSP_PARAMETER_DESC  speedParameter;
+    static FMOD_DSP_PARAMETER_DESC* vParameterPointers[1];
+    static FMOD_DSP_DESCRIPTION     description;
+    static std::once_flag           descriptionReady;
+
+    std::call_once(descriptionReady, []
+    {
+        // Speed is not limited here (the speed slider starts from 0), the pitch ratio is clamped instead.
+        FMOD_DSP_INIT_PARAMDESC_FLOAT(speedParameter, "Speed", "x", "Speed of the channels", 0.0f, 10.0f, 1.0f);
+        vParameterPointers[0] = &speedParameter;
+
+        memset(&description, 0, sizeof(description));
+
+        description.pluginsdkversion  = FMOD_PLUGIN_SDK_VERSION;
+        strncpy(description.name, "Bloody Time Stretch", sizeof(description.name) - 1);
+        description.version           = 1;
+        description.numinputbuffers   = 1;
+        description.numoutputbuffers  = 1;
+        description.create            = TimeStretchDSPCallbacks::create;
+        description.release           = TimeStretchDSPCallbacks::release;
+        description.reset             = TimeStretchDSPCallbacks::reset;
+        description.read              = TimeStretchDSPCallbacks::read;
+        description.numparameters     = 1;
+        description.paramdesc         = vParameterPointers;
+        description.setparameterfloat = TimeStretchDSPCallbacks::setParameterFloat;
+        description.getparameterfloat = TimeStretchDSPCallbacks::getParameterFloat;
+    });
+
+    return pSystem->createDSP(&description, ppDSP) == FMOD_OK;
+}
+
+void TimeStretch::process(const float* pIn, float* pOut, unsigned int iFrameCount, int iChannels)
+{
+    if (iChannels > TIME_STRETCH_MAX_CHANNELS)
+    {
+        // Not supported, pass the signal through.
+        memcpy(pOut, pIn, iFrameCount * static_cast<size_t>(iChannels) * sizeof(float));
+        return;
+    }
+
+    for (unsigned int iFrame = 0; iFrame < iFrameCount; iFrame++)
+    {
+        const float* pInFrame  = pIn  + iFrame * static_cast<size_t>(iChannels);
+        float*       pOutFrame = pOut + iFrame * static_cast<size_t>(iChannels);
+
+
+        // Write the input.
+
+        size_t iInputPos = static_cast<size_t>(iWrittenFrames & (iRingSize - 1));
+        float* pRingFrame = &vInput[iInputPos * TIME_STRETCH_MAX_CHANNELS];
+
+        float fMono = 0.0f;
+        for (int c = 0; c < iChannels; c++)
+        {
+            pRingFrame[c] = pInFrame[c];
+            fMono        += pInFrame[c];
+        }
+
+        vMonoInput[iInputPos] = fMono;
+
+        iWrittenFrames++;
+
+
+        // Read the output.
+
+        if (iProducedFrames % static_cast<unsigned long long>(iHop) == 0)
+        {
+            addGrain();
+        }
+
+        float* pOutputFrame = &vOutput[static_cast<size_t>(iProducedFrames % static_cast<unsigned long long>(iGrainLength)) * TIME_STRETCH_MAX_CHANNELS];
+
+        for (int c = 0; c < iChannels; c++)
+        {
+            pOutFrame[c] = pOutputFrame[c];
+        }
+
+        memset(pOutputFrame, 0, TIME_STRETCH_MAX_CHANNELS * sizeof(float));
+
+        iProducedFrames++;
+    }
+}
+
+void TimeStretch::reset()
+{
+    std::fill(vInput.begin(),     vInput.end(),     0.0f);
+    std::fill(vMonoInput.begin(), vMonoInput.end(), 0.0f);
+    std::fill(vOutput.begin(),    vOutput.end(),    0.0f);
+
+    iWrittenFrames  = iRingSize;
+    iProducedFrames = iRingSize;
+
+    dLastGrainStart = 0.0;
+    fLastGrainRatio = 1.0f;
+    bHasLastGrain   = false;
+}
+
+void TimeStretch::setSpeed(float fSpeed)
+{
+    this->fSpeed = fSpeed;
+}
+
+float TimeStretch::getSpeed() const
+{
+    return fSpeed;
+}
+
+unsigned int TimeStretch::getLatencyInFrames() const
+{
+    return iLatency;
+}
+
+void TimeStretch::addGrain()
+{
+    // Output frames [iProducedFrames, iProducedFrames + iGrainLength) get the grain
+    // read from the input at the pitch ratio around the same place 'iLatency' frames ago.
+
+    float fCurrentSpeed = fSpeed;
+    float fRatio        = (fCurrentSpeed > 0.0f) ? (1.0f / fCurrentSpeed) : TIME_STRETCH_MAX_RATIO;
+
+    fRatio = std::min(std::max(fRatio, TIME_STRETCH_MIN_RATIO), TIME_STRETCH_MAX_RATIO);
+
+
+    double dCenter       = static_cast<double>(iProducedFrames) + iHop - iLatency;
+    double dNominalStart = dCenter - iHop * static_cast<double>(fRatio);
+
+    double dStart = dNominalStart + static_cast<double>( findBestOffset(dNominalStart, fRatio) );
+
+
+    for (int i = 0; i < iGrainLength; i++)
+    {
+        double dPos   = dStart + i * static_cast<double>(fRatio);
+        double dFloor = std::floor(dPos);
+        float  fFrac  = static_cast<float>(dPos - dFloor);
+
+        unsigned long long iPos = static_cast<unsigned long long>(dFloor);
+
+        const float* pFrame1 = &vInput[static_cast<size_t>(iPos       & (iRingSize - 1)) * TIME_STRETCH_MAX_CHANNELS];
+        const float* pFrame2 = &vInput[static_cast<size_t>((iPos + 1) & (iRingSize - 1)) * TIME_STRETCH_MAX_CHANNELS];
+
+        float* pOutputFrame = &vOutput[static_cast<size_t>((iProducedFrames + i) % static_cast<unsigned long long>(iGrainLength)) * TIME_STRETCH_MAX_CHANNELS];
+
+        float fWeight1 = vWindow[i] * (1.0f - fFrac);
+        float fWeight2 = vWindow[i] * fFrac;
+
+        // All channels at once (unused channels are zeros).
+        for (int c = 0; c < TIME_STRETCH_MAX_CHANNELS; c++)
+        {
+            pOutputFrame[c] += pFrame1[c] * fWeight1 + pFrame2[c] * fWeight2;
+        }
+    }
+
+
+    dLastGrainStart = dStart;
+    fLastGrainRatio = fRatio;
+    bHasLastGrain   = true;
+}
+
+long long TimeStretch::findBestOffset(double dNominalStart, float fRatio)
+{
+    // Offset (in the seek range) of the grain that looks most like the continuation of the last grain
+    // (normalized cross-correlation of the mono mix over the overlap of the two grains).
+
+    if (bHasLastGrain == false)
+    {
+        return 0;
+    }
+
+    const size_t iMask = iRingSize - 1;
+
+    double dNaturalStart = dLastGrainStart + iHop * static_cast<double>(fLastGrainRatio);
+
+
+    // Onset in the grain: don't move it, so the attack stays where it was and is not repeated.
+
+    float fNaturalEnergy = 0.0f;
+    float fNominalEnergy = 0.0f;
+
+    for (int i = 0; i < iHop; i += TIME_STRETCH_CORRELATION_STEP)
+    {
+        float fNatural = vMonoInput[static_cast<size_t>(dNaturalStart + i * static_cast<double>(fRatio)) & iMask];
+        float fNominal = vMonoInput[static_cast<size_t>(dNominalStart + i * static_cast<double>(fRatio)) & iMask];
+
+        fNaturalEnergy += fNatural * fNatural;
+        fNominalEnergy += fNominal * fNominal;
+    }
+
+    if ( (fNaturalEnergy == 0.0f) || (fNominalEnergy > fNaturalEnergy * TIME_STRETCH_TRANSIENT_RATIO) )
+    {
+        return 0;
+    }
+
+
+    long long iBestOffset      = 0;
+    float     fBestCorrelation = std::numeric_limits<float>::lowest();
+
+    for (long long iOffset = -iSeekRange; iOffset <= iSeekRange; iOffset++)
+    {
+        double dCandidateStart = dNominalStart + static_cast<double>(iOffset);
+
+        float fCrossSum  = 0.0f;
+        float fEnergySum = 0.0f;
+
+        for (int i = 0; i < iHop; i += TIME_STRETCH_CORRELATION_STEP)
+        {
+            float fNatural   = vMonoInput[static_cast<size_t>(dNaturalStart   + i * static_cast<double>(fRatio)) & iMask];
+            float fCandidate = vMonoInput[static_cast<size_t>(dCandidateStart + i * static_cast<double>(fRatio)) & iMask];
+
+            fCrossSum  += fNatural   * fCandidate;
+            fEnergySum += fCandidate * fCandidate;
+        }
+
+        if (fEnergySum == 0.0f)
+        {
+            continue;
+        }
+
+        float fCorrelation = fCrossSum / std::sqrt(fEnergySum);
+
+        if (fCorrelation > fBestCorrelation)
+        {
+            fBestCorrelation = fCorrelation;
+            iBestOffset      = iOffset;
+        }
+    }
+
+    return iBestOffset;
+}
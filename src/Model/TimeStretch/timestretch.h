@@ -0,0 +1,118 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+
+
+
+
+struct TimeStretchDSPCallbacks;
+
+namespace FMOD
+{
+    class System;
+    class DSP;
+}
+
+
+
+
+
+// Pitch correction for the 'speed by time' as the FMOD DSP.
+// The channel plays the track faster (its frequency is changed) and this DSP brings the pitch back
+// so only the tempo is changed (WSOLA: windowed grains are read from the input at the pitch ratio
+// and every grain is moved inside the seek range to the position that continues the previous grain best).
+// Unlike the FFT pitch shifter it works in the time domain: the latency is about one and a half grains
+// and attacks are not smeared over the FFT window (grains that start on the attack are not moved at all).
+
+class TimeStretch
+{
+
+public:
+
+    TimeStretch(float fSampleRate);
+
+
+
+
+
+    // FMOD
+
+        // The DSP has one float parameter - the speed of the channels (pitch is changed by 1 / speed).
+        static bool         createDSP           (FMOD::System* pSystem,  FMOD::DSP** ppDSP);
+
+
+    // Main functions
+
+        // 'pIn' and 'pOut' - interleaved samples, 'iFrameCount' samples of every channel.
+        void                process             (const float* pIn,  float* pOut,  unsigned int iFrameCount,  int iChannels);
+        void                reset               ();
+
+
+    // 'Set' functions
+
+        // Can be called from any thread, the audio thread picks the value up on the next grain.
+        void                setSpeed            (float fSpeed);
+
+
+    // 'Get' functions
+
+        float               getSpeed            () const;
+        // Delay of the output in frames (constant, does not depend on the speed).
+        unsigned int        getLatencyInFrames  () const;
+
+
+
+
+
+private:
+
+    friend struct TimeStretchDSPCallbacks;
+
+
+    // Used in process()
+
+        void                addGrain            ();
+        long long           findBestOffset      (double dNominalStart,  float fRatio);
+
+
+    float                fSampleRate;
+
+
+    // Sizes in frames
+    int                  iGrainLength;
+    int                  iHop;
+    int                  iSeekRange;
+    unsigned int         iLatency;
+    // Power of 2.
+    size_t               iRingSize;
+
+
+    std::atomic<float>   fSpeed;
+
+
+    // Audio thread
+    // Input of the last 'iRingSize' frames: every frame is TIME_STRETCH_MAX_CHANNELS floats, and the mono mix for the seek.
+    std::vector<float>   vInput;
+    std::vector<float>   vMonoInput;
+    // Overlap-add of the grains, 'iGrainLength' frames.
+    std::vector<float>   vOutput;
+    std::vector<float>   vWindow;
+    // Frame counters (start at 'iRingSize' so the grains never read before the start of the ring).
+    unsigned long long   iWrittenFrames;
+    unsigned long long   iProducedFrames;
+    // Start of the last grain in the input.
+    double               dLastGrainStart;
+    float                fLastGrainRatio;
+    bool                 bHasLastGrain;
+};
@@ -9,9 +9,15 @@
 #include <fstream>
 #include <vector>
 #include <codecvt>
+#include <cmath>
+#include <cstring>
+#include <climits>
 
 // Custom
 #include "View/MainWindow/mainwindow.h"
+#include "Model/MappedFileSystem/mappedfilesystem.h"
+#include "Model/CacheFolder/cachefolder.h"
+#include "Model/MP3Parser/mp3parser.h"
 #include "globalparams.h"
 #include "../ext/FMOD/inc/fmod.hpp"
 #include "../ext/FMOD/inc/fmod_errors.h"
@@ -27,10 +33,44 @@
 #include <locale>
 #endif
 
+struct TrackChannelCallback
+{
+    static FMOD_RESULT F_CALLBACK callback(FMOD_CHANNELCONTROL* pChannelControl, FMOD_CHANNELCONTROL_TYPE controlType,
+                                           FMOD_CHANNELCONTROL_CALLBACK_TYPE callbackType, void* pCommandData1, void* pCommandData2)
+    {
+        (void)pCommandData1;
+        (void)pCommandData2;
+
+        if ( (controlType != FMOD_CHANNELCONTROL_CHANNEL) || (callbackType != FMOD_CHANNELCONTROL_CALLBACK_END) )
+        {
+            return FMOD_OK;
+        }
+
+        void* pUserData = nullptr;
+        reinterpret_cast<FMOD::Channel*>(pChannelControl)->getUserData(&pUserData);
+
+        Track* pTrack = static_cast<Track*>(pUserData);
+
+        if ( pTrack && pTrack->pEndCallback )
+        {
+            pTrack->pEndCallback(pTrack->pEndCallbackUserData);
+        }
+
+        return FMOD_OK;
+    }
+};
+
+
+
+
+
+
 Track::Track(const std::wstring& sFilePath, const std::wstring& sTrackName, MainWindow *pMainWindow, FMOD::System* pSystem)
 {
     pChannel          = nullptr;
     pSound            = nullptr;
+    pAccurateSound    = nullptr;
+    pPreloadedSound   = nullptr;
     pDummySound       = nullptr;
     this->sFilePath   = sFilePath;
     this->sTrackName  = sTrackName;
@@ -41,7 +81,17 @@ Track::Track(const std::wstring& sFilePath, const std::wstring& sTrackName, Main
     iMaxValueOnGraph  = 0;
 
     bPaused           = false;
+    bAccurateTime     = false;
+    pEndCallback      = nullptr;
+    pEndCallbackUserData = nullptr;
+    bScheduled        = false;
     bBitrateCalculated= false;
+    iStartInPCM       = 0;
+    iEndInPCM         = 0;
+    iLoopStartInPCM   = 0;
+    iLoopEndInPCM     = 0;
+    iBitrate          = 0;
+    fLoudnessGain     = 1.0f;
 
     fSpeedByFreq = 1.0f;
     fSpeedByTime = 1.0f;
@@ -55,33 +105,21 @@ Track::Track(const std::wstring& sFilePath, const std::wstring& sTrackName, Main
 bool Track::setupTrack()
 {
     // This function creates a track (pSound) in the FMOD system.
+    // We don't use FMOD_ACCURATETIME here because it makes FMOD scan the whole MP3 file,
+    // VBR MP3 will be reopened with it later in the background (see setAccurateSound()).
 
-    // wchar_t is 16 bits and holds UTF-16 code units
-    // FMOD accepts UTF-8 strings
-    // convert wchar_t* (UTF-16) to char* (UTF-8)
-#if _WIN32
-    char filePathInUTF8[MAX_PATH];
-    WideCharToMultiByte(CP_UTF8, 0, sFilePath.c_str(), -1, filePathInUTF8, sizeof(filePathInUTF8), nullptr, nullptr);
-#else
-    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
-    auto out = utf8_conv.to_bytes(sFilePath);
-#endif
-
+    std::string sError;
 
-    FMOD_RESULT result;
-#if _WIN32
-    result = pSystem->createStream(filePathInUTF8, FMOD_DEFAULT | FMOD_LOOP_OFF | FMOD_ACCURATETIME, nullptr, &pSound);
-#else
-    result = pSystem->createStream(out.c_str(), FMOD_DEFAULT | FMOD_LOOP_OFF | FMOD_ACCURATETIME, nullptr, &pSound);
-#endif
-    if (result)
+    if ( openStream(pSystem, sFilePath, false, &pSound, &sError) == false )
     {
         pMainWindow->showWMessageBox( true, std::wstring(L"Track::setupTrack::FMOD::System::createStream() failed.\n\n"
                                                        "Can't load the file \"" + sFilePath + L"\".\n\n"
-                                                       "Error: ") + stringToWString(std::string(FMOD_ErrorString(result))) );
+                                                       "Error: ") + stringToWString(sError) );
         return false;
     }
 
+    FMOD_RESULT result;
+
 
     // Get audio format (mp3, wav, flac, ogg and etc.)
     FMOD_SOUND_TYPE type;
@@ -106,9 +144,191 @@ bool Track::setupTrack()
     else if (formatType == FMOD_SOUND_FORMAT_PCM24) pcmFormat = "PCM24";
     else                                            pcmFormat = "NULL";
 
+
+    if (format == "MP3")
+    {
+        readGaplessInfo();
+    }
+
+    return true;
+}
+
+void Track::setSeekTable(const SeekTable& seekTable)
+{
+    this->seekTable = seekTable;
+}
+
+void Track::setAccurateSound(FMOD::Sound* pAccurateSound)
+{
+    // This sound will replace 'pSound' on the next playback start (see switchToAccurateSound()).
+
+    if (this->pAccurateSound)
+    {
+        this->pAccurateSound->release();
+    }
+
+    this->pAccurateSound = pAccurateSound;
+}
+
+bool Track::needsAccurateSound()
+{
+    // Only VBR MP3 needs FMOD_ACCURATETIME, FMOD can seek in CBR MP3 (and other formats) without it.
+
+    return (format == "MP3") && seekTable.isBuilt() && seekTable.isVBR() && (bAccurateTime == false) && (pAccurateSound == nullptr)
+           && (pPreloadedSound == nullptr);
+}
+
+bool Track::isAccurateSoundReady()
+{
+    return (pAccurateSound != nullptr) || bAccurateTime;
+}
+
+const SeekTable& Track::getSeekTable()
+{
+    return seekTable;
+}
+
+bool Track::openStream(FMOD::System* pSystem, const std::wstring& sFilePath, bool bAccurateTime, FMOD::Sound** ppSound, std::string* pErrorString)
+{
+    // wchar_t is 16 bits and holds UTF-16 code units
+    // FMOD accepts UTF-8 strings
+    // convert wchar_t* (UTF-16) to char* (UTF-8)
+#if _WIN32
+    char filePathInUTF8[MAX_PATH];
+    WideCharToMultiByte(CP_UTF8, 0, sFilePath.c_str(), -1, filePathInUTF8, sizeof(filePathInUTF8), nullptr, nullptr);
+#else
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+    auto out = utf8_conv.to_bytes(sFilePath);
+#endif
+
+    FMOD_MODE mode = FMOD_DEFAULT | FMOD_LOOP_OFF;
+    if (bAccurateTime)
+    {
+        mode |= FMOD_ACCURATETIME;
+    }
+
+    FMOD_RESULT result;
+#if _WIN32
+    result = pSystem->createStream(filePathInUTF8, mode, nullptr, ppSound);
+#else
+    result = pSystem->createStream(out.c_str(), mode, nullptr, ppSound);
+#endif
+    if (result)
+    {
+        if (pErrorString)
+        {
+            *pErrorString = FMOD_ErrorString(result);
+        }
+
+        *ppSound = nullptr;
+
+        return false;
+    }
+
+    return true;
+}
+
+void Track::setPreloadedSound(FMOD::Sound* pPreloadedSound, std::shared_ptr<std::vector<char>> pPreloadedData)
+{
+    // This sound will be used when the next channel is created (see getPlaybackSound()).
+
+    releasePreloadedSound();
+
+    this->pPreloadedSound = pPreloadedSound;
+    this->pPreloadedData  = pPreloadedData;
+}
+
+void Track::releasePreloadedSound()
+{
+    // The track will be streamed from the disk again.
+    // Should not be called for the current track.
+
+    if (pPreloadedSound == nullptr)
+    {
+        return;
+    }
+
+    if (pChannel)
+    {
+        FMOD::Sound* pChannelSound = nullptr;
+        pChannel->getCurrentSound(&pChannelSound);
+
+        if (pChannelSound == pPreloadedSound)
+        {
+            // Next playTrack() will create a new channel.
+            pChannel->setCallback(nullptr);
+            pChannel->stop();
+            pChannel = nullptr;
+
+            bScheduled = false;
+            bPaused    = false;
+        }
+    }
+
+    FMOD_RESULT result = pPreloadedSound->release();
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("Track::releasePreloadedSound::FMOD::Sound::release() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+    }
+
+    pPreloadedSound = nullptr;
+    pPreloadedData.reset();
+}
+
+bool Track::isPreloaded()
+{
+    return pPreloadedSound != nullptr;
+}
+
+bool Track::openMemoryStream(FMOD::System* pSystem, const std::vector<char>& vData, FMOD::Sound** ppSound)
+{
+    // FMOD_OPENMEMORY_POINT - FMOD reads 'vData' directly (without a copy) so it should live while the sound is not released.
+    // FMOD_ACCURATETIME scans the memory (not the disk) so it's fast.
+
+    FMOD_CREATESOUNDEXINFO exinfo;
+    memset(&exinfo, 0, sizeof(exinfo));
+    exinfo.cbsize = sizeof(exinfo);
+    exinfo.length = static_cast<unsigned int>(vData.size());
+
+    FMOD_RESULT result = pSystem->createStream(vData.data(), FMOD_DEFAULT | FMOD_LOOP_OFF | FMOD_OPENMEMORY_POINT | FMOD_ACCURATETIME, &exinfo, ppSound);
+    if (result)
+    {
+        *ppSound = nullptr;
+
+        return false;
+    }
+
     return true;
 }
 
+void Track::setLoudness(const TrackLoudness& loudness)
+{
+    this->loudness = loudness;
+}
+
+const TrackLoudness& Track::getLoudness()
+{
+    return loudness;
+}
+
+void Track::setLoudnessGain(float fGain)
+{
+    // Applied on the next setVolume() (or when the new channel is created).
+
+    fLoudnessGain = fGain;
+}
+
+float Track::getLoudnessGain()
+{
+    return fLoudnessGain;
+}
+
+void Track::setEndCallback(TrackEndCallback pEndCallback, void* pUserData)
+{
+    this->pEndCallback   = pEndCallback;
+    pEndCallbackUserData = pUserData;
+}
+
 bool Track::getPlaying()
 {
     // This function returns 'true' if the track is plaing right now.
@@ -269,19 +489,56 @@ bool Track::playTrack(float fVolume)
 {
     // This function starts track playback under various conditions, for example, no track is created, track is stopped, or ended.
 
+    if (bScheduled)
+    {
+        // The channel was started by scheduleTrack() right after the previous track.
+        bScheduled = false;
+        bPaused    = false;
+
+        pChannel->setVolumeRamp(true);
+
+        return true;
+    }
+
+    if ( (pPreloadedSound || pAccurateSound) && pChannel && bPaused )
+    {
+        // The track was preloaded (or got its FMOD_ACCURATETIME sound) after its channel was created.
+        // If the track is stopped then we start it again with the new sound.
+
+        FMOD::Sound* pChannelSound = nullptr;
+        unsigned int iPosInPCM     = 0;
+
+        pChannel->getCurrentSound(&pChannelSound);
+        pChannel->getPosition(&iPosInPCM, FMOD_TIMEUNIT_PCM);
+
+        bool bNewSound = (pAccurateSound != nullptr) || (pChannelSound != pPreloadedSound);
+
+        if ( bNewSound && (iPosInPCM <= iStartInPCM) )
+        {
+            pChannel->setCallback(nullptr);
+            pChannel->stop();
+            pChannel = nullptr;
+        }
+    }
+
     if (pChannel == nullptr)
     {
         // If we got here then it's our first time calling this function (playTrack()).
 
+        switchToAccurateSound();
+
         FMOD_RESULT result;
 
-        result = pSystem->playSound(pSound, nullptr, true, &pChannel);
+        result = pSystem->playSound(getPlaybackSound(), nullptr, true, &pChannel);
         if (result)
         {
             pMainWindow->showMessageBox( true, std::string("Track::playTrack::FMOD::System::playSound() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
             return false;
         }
 
+        setupChannelCallback();
+        skipEncoderDelay();
+
         float fFrequency;
         result = pChannel->getFrequency(&fFrequency);
         if (result)
@@ -291,7 +548,7 @@ bool Track::playTrack(float fVolume)
 
         fDefaultFrequency = fFrequency;
 
-        result = pChannel->setVolume(fVolume);
+        result = pChannel->setVolume(fVolume * fLoudnessGain);
         if (result)
         {
             pMainWindow->showMessageBox( true, std::string("Track::playTrack::FMOD::Channel::setVolume() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
@@ -325,7 +582,7 @@ bool Track::playTrack(float fVolume)
 
         FMOD_RESULT result;
 
-        result = pChannel->setVolume(fVolume);
+        result = pChannel->setVolume(fVolume * fLoudnessGain);
         if (result)
         {
             pMainWindow->showMessageBox( true, std::string("Track::playTrack::FMOD::Channel::setVolume() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
@@ -448,6 +705,11 @@ bool Track::stopTrack()
             return false;
         }
 
+        skipEncoderDelay();
+
+        // The repeat section is set again by AudioService if we will play this track.
+        clearLoopSection();
+
         bPaused = true;
 
         return true;
@@ -462,20 +724,31 @@ bool Track::reCreateTrack(float fVolume)
 
     if (pChannel != nullptr)
     {
+        // We don't need the 'end' callback from the channel that we stop.
+        pChannel->setCallback(nullptr);
+
         result = pChannel->stop();
         if ( (result != FMOD_ERR_INVALID_HANDLE) && (result != FMOD_OK) )
         {
             pMainWindow->showMessageBox( true, std::string("Track::reCreateTrack::FMOD::Channel::stop() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
         }
 
-        result = pSystem->playSound(pSound, nullptr, true, &pChannel);
+        switchToAccurateSound();
+
+        result = pSystem->playSound(getPlaybackSound(), nullptr, true, &pChannel);
         if (result)
         {
             pMainWindow->showMessageBox( true, std::string("Track::reCreateTrack::FMOD::System::playSound() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
             return false;
         }
 
-        result = pChannel->setVolume(fVolume);
+        iLoopStartInPCM = 0;
+        iLoopEndInPCM   = 0;
+
+        setupChannelCallback();
+        skipEncoderDelay();
+
+        result = pChannel->setVolume(fVolume * fLoudnessGain);
         if (result)
         {
             pMainWindow->showMessageBox( true, std::string("Track::reCreateTrack::FMOD::Channel::setVolume() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
@@ -490,103 +763,361 @@ bool Track::reCreateTrack(float fVolume)
     }
 }
 
-bool Track::setPositionInMS(unsigned int iPos)
+bool Track::scheduleTrack(float fVolume, unsigned long long iStartDSPClock)
 {
-    // This function sets the track position in milliseconds.
+    // This function starts the track at the 'iStartDSPClock' (DSP clock of the master channel group)
+    // so its first sample will be played right after the last sample of the previous track.
+
+    FMOD_RESULT result;
 
     if (pChannel != nullptr)
     {
-        // If we got here then it means that 'playTrack()' function was called.
-
-        FMOD_RESULT result;
+        pChannel->setCallback(nullptr);
+        pChannel->stop();
+        pChannel = nullptr;
+    }
 
-        result = pChannel->setPosition(iPos, FMOD_TIMEUNIT_MS);
-        if (result)
-        {
-            pMainWindow->showMessageBox( true, std::string("Track::setPositionInMS::FMOD::Channel::setPosition() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
-            return false;
-        }
+    switchToAccurateSound();
 
-        return true;
+    result = pSystem->playSound(getPlaybackSound(), nullptr, true, &pChannel);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("Track::scheduleTrack::FMOD::System::playSound() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+        pChannel = nullptr;
+        return false;
     }
 
-    return false;
-}
+    setupChannelCallback();
 
-bool Track::setVolume(float fNewVolume)
-{
-    // This function sets track volume.
+    // The first sample that we hear should be the first real sample of the track.
+    skipEncoderDelay();
 
-    if (pChannel != nullptr)
+    float fFrequency;
+    result = pChannel->getFrequency(&fFrequency);
+    if (result)
     {
-        // If we got here then it means that 'playTrack()' function was called.
-
-        FMOD_RESULT result;
+        pMainWindow->showMessageBox( true, std::string("Track::scheduleTrack::FMOD::Channel::getFrequency() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+    }
 
-        result = pChannel->setVolume(fNewVolume);
-        if (result)
-        {
-            pMainWindow->showMessageBox( true, std::string("Track::setVolume::FMOD::Channel::setVolume() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
-            return false;
-        }
+    fDefaultFrequency = fFrequency;
 
-        return true;
-    }
+    pChannel->setVolume(fVolume * fLoudnessGain);
 
-    return false;
-}
+    // Don't fade in the first samples (the previous track is not faded out).
+    pChannel->setVolumeRamp(false);
 
-void Track::setMaxPosInGraph(unsigned int iMax)
-{
-    iMaxValueOnGraph = iMax;
-}
+    if ( (fSpeedByFreq == 1.0f) && (fSpeedByTime == 1.0f) )
+    {
+        pChannel->setFrequency( fDefaultFrequency );
+    }
+    else
+    {
+        if (fSpeedByFreq != 1.0f) pChannel->setFrequency( fDefaultFrequency * fSpeedByFreq );
+        else                      pChannel->setFrequency( fDefaultFrequency * fSpeedByTime );
+    }
 
-void Track::setSpeedByFreq(float fSpeed)
-{
-    // Save the value even if pChannel is not created
-    fSpeedByFreq = fSpeed;
+    result = pChannel->setDelay(iStartDSPClock, 0, false);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("Track::scheduleTrack::FMOD::Channel::setDelay() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+        cancelSchedule();
+        return false;
+    }
 
-    if (pChannel != nullptr)
+    // The channel will be silent until 'iStartDSPClock'.
+    result = pChannel->setPaused(false);
+    if (result)
     {
-        if (fSpeedByFreq == 1.0f)
-        {
-            pChannel->setFrequency( fDefaultFrequency );
-        }
-        else
-        {
-            pChannel->setFrequency( fDefaultFrequency * fSpeedByFreq );
-        }
+        pMainWindow->showMessageBox( true, std::string("Track::scheduleTrack::FMOD::Channel::setPaused() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+        cancelSchedule();
+        return false;
     }
+
+    bScheduled = true;
+
+    return true;
 }
 
-void Track::setSpeedByTime(float fSpeed)
+void Track::cancelSchedule()
 {
-    // Save the value even if pChannel is not created
-    fSpeedByTime = fSpeed;
+    // This function stops the channel started by scheduleTrack(),
+    // next playTrack() will start the track from the beginning.
 
     if (pChannel != nullptr)
     {
-        if (fSpeedByTime == 1.0f)
-        {
-            pChannel->setFrequency( fDefaultFrequency );
-        }
-        else
-        {
-            pChannel->setFrequency( fDefaultFrequency * fSpeedByTime );
-        }
+        pChannel->setCallback(nullptr);
+        pChannel->stop();
+        pChannel = nullptr;
     }
+
+    bScheduled = false;
 }
 
-std::string Track::getPCMFormat()
+bool Track::isScheduled()
 {
-    return pcmFormat;
+    return bScheduled;
 }
 
-unsigned int Track::getLengthInMS()
+bool Track::getEndDSPClock(unsigned long long* pEndDSPClock)
 {
-    // This function returns the length of the track.
+    // This function returns the DSP clock (of the master channel group) at which the last sample of the track will be played.
 
-    if (pSound != nullptr)
+    if (pChannel == nullptr)
+    {
+        return false;
+    }
+
+    FMOD_RESULT result;
+
+    unsigned int iLengthInPCM = 0;
+    result = pSound->getLength(&iLengthInPCM, FMOD_TIMEUNIT_PCM);
+    if (result)
+    {
+        return false;
+    }
+
+    if ( (iEndInPCM > 0) && (iEndInPCM < iLengthInPCM) )
+    {
+        // Don't play the encoder padding.
+        iLengthInPCM = iEndInPCM;
+    }
+
+    return getDSPClockAtPCM(iLengthInPCM, pEndDSPClock);
+}
+
+bool Track::setStopDSPClock(unsigned long long iStopDSPClock)
+{
+    // This function stops the channel at the 'iStopDSPClock' (DSP clock of the master channel group),
+    // the track will end exactly where the next (scheduled) track starts. Pass 0 to cancel.
+
+    if (pChannel == nullptr)
+    {
+        return false;
+    }
+
+    FMOD_RESULT result;
+
+    if (iStopDSPClock == 0)
+    {
+        result = pChannel->setDelay(0, 0, false);
+    }
+    else
+    {
+        result = pChannel->setDelay(0, iStopDSPClock, true);
+    }
+
+    return result == FMOD_OK;
+}
+
+bool Track::getGaplessInfo(unsigned int* pStartInPCM, unsigned int* pEndInPCM)
+{
+    // Returns 'false' if the track has no encoder delay/padding info.
+
+    if (iEndInPCM == 0)
+    {
+        return false;
+    }
+
+    *pStartInPCM = this->iStartInPCM;
+    *pEndInPCM   = this->iEndInPCM;
+
+    return true;
+}
+
+bool Track::addFade(unsigned long long iStartDSPClock, unsigned long long iEndDSPClock, bool bFadeIn, char cCurve)
+{
+    // This function adds fade points (DSP clock of the master channel group) so the mixer changes the volume
+    // of the channel sample by sample, nobody needs to wait for the fade to end.
+    // FMOD interpolates linearly between the points so the equal power curve is made of CROSSFADE_CURVE_POINTS lines.
+
+    if ( (pChannel == nullptr) || (iEndDSPClock <= iStartDSPClock) )
+    {
+        return false;
+    }
+
+    int iPointsCount = (cCurve == CROSSFADE_CURVE_LINEAR) ? 1 : CROSSFADE_CURVE_POINTS;
+
+    double dPi = 3.14159265358979323846;
+
+    // Remove the old fade (if the track was faded in this range before).
+    pChannel->removeFadePoints(iStartDSPClock, iEndDSPClock);
+
+    for (int i = 0; i <= iPointsCount; i++)
+    {
+        double dPos = static_cast<double>(i) / iPointsCount;
+        double dVolume;
+
+        if (cCurve == CROSSFADE_CURVE_LINEAR)
+        {
+            dVolume = bFadeIn ? dPos : (1.0 - dPos);
+        }
+        else
+        {
+            // Equal power: fIn^2 + fOut^2 = 1 at any moment.
+            dVolume = bFadeIn ? sin(dPos * dPi / 2) : cos(dPos * dPi / 2);
+        }
+
+        unsigned long long iClock = iStartDSPClock + static_cast<unsigned long long>( llround((iEndDSPClock - iStartDSPClock) * dPos) );
+
+        FMOD_RESULT result = pChannel->addFadePoint(iClock, static_cast<float>(dVolume));
+        if (result)
+        {
+            pMainWindow->showMessageBox( true, std::string("Track::addFade::FMOD::Channel::addFadePoint() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Track::removeFades()
+{
+    // The channel volume returns to its normal value.
+
+    if (pChannel)
+    {
+        pChannel->removeFadePoints(0, ULLONG_MAX);
+    }
+}
+
+bool Track::setLoopSection(unsigned int iStartInMS, unsigned int iEndInMS)
+{
+    // This function makes the channel loop [iStartInMS, iEndInMS) until clearLoopSection() is called.
+    // The mixer jumps back on the exact sample so nobody needs to check the position.
+
+    if ( (pChannel == nullptr) || (iEndInMS <= iStartInMS) || (fDefaultFrequency <= 0.0f) )
+    {
+        return false;
+    }
+
+    iLoopStartInPCM = static_cast<unsigned int>( static_cast<double>(iStartInMS) * fDefaultFrequency / 1000 );
+    iLoopEndInPCM   = static_cast<unsigned int>( static_cast<double>(iEndInMS)   * fDefaultFrequency / 1000 );
+
+    return applyLoopSection();
+}
+
+void Track::clearLoopSection()
+{
+    // The track will play to the end.
+
+    iLoopStartInPCM = 0;
+    iLoopEndInPCM   = 0;
+
+    applyLoopSection();
+}
+
+bool Track::getLoopSeamDSPClock(unsigned long long* pSeamDSPClock)
+{
+    // This function returns the DSP clock (of the master channel group) at which the channel
+    // will jump from the end of the loop section to its start.
+
+    if ( (pChannel == nullptr) || (iLoopEndInPCM == 0) )
+    {
+        return false;
+    }
+
+    return getDSPClockAtPCM(iLoopEndInPCM, pSeamDSPClock);
+}
+
+bool Track::setPositionInMS(unsigned int iPos)
+{
+    // This function sets the track position in milliseconds.
+
+    if (pChannel != nullptr)
+    {
+        // If we got here then it means that 'playTrack()' function was called.
+
+        FMOD_RESULT result;
+
+        result = pChannel->setPosition(iPos, FMOD_TIMEUNIT_MS);
+        if (result)
+        {
+            pMainWindow->showMessageBox( true, std::string("Track::setPositionInMS::FMOD::Channel::setPosition() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+            return false;
+        }
+
+        skipEncoderDelay();
+
+        return true;
+    }
+
+    return false;
+}
+
+bool Track::setVolume(float fNewVolume)
+{
+    // This function sets track volume.
+
+    if (pChannel != nullptr)
+    {
+        // If we got here then it means that 'playTrack()' function was called.
+
+        FMOD_RESULT result;
+
+        result = pChannel->setVolume(fNewVolume * fLoudnessGain);
+        if (result)
+        {
+            pMainWindow->showMessageBox( true, std::string("Track::setVolume::FMOD::Channel::setVolume() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+            return false;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void Track::setMaxPosInGraph(unsigned int iMax)
+{
+    iMaxValueOnGraph = iMax;
+}
+
+void Track::setSpeedByFreq(float fSpeed)
+{
+    // Save the value even if pChannel is not created
+    fSpeedByFreq = fSpeed;
+
+    if (pChannel != nullptr)
+    {
+        if (fSpeedByFreq == 1.0f)
+        {
+            pChannel->setFrequency( fDefaultFrequency );
+        }
+        else
+        {
+            pChannel->setFrequency( fDefaultFrequency * fSpeedByFreq );
+        }
+    }
+}
+
+void Track::setSpeedByTime(float fSpeed)
+{
+    // Save the value even if pChannel is not created
+    fSpeedByTime = fSpeed;
+
+    if (pChannel != nullptr)
+    {
+        if (fSpeedByTime == 1.0f)
+        {
+            pChannel->setFrequency( fDefaultFrequency );
+        }
+        else
+        {
+            pChannel->setFrequency( fDefaultFrequency * fSpeedByTime );
+        }
+    }
+}
+
+std::string Track::getPCMFormat()
+{
+    return pcmFormat;
+}
+
+unsigned int Track::getLengthInMS()
+{
+    // This function returns the length of the track.
+
+    if (pSound != nullptr)
     {
         FMOD_RESULT result;
         unsigned int iLength;
@@ -606,6 +1137,56 @@ unsigned int Track::getLengthInMS()
     }
 }
 
+bool Track::getPlaybackPosition(PlaybackPosition* pPosition)
+{
+    // This function returns the position, the DSP clock and the speed from the same mix block
+    // so the position can be extrapolated (see PositionSnapshot).
+
+    if ( (pChannel == nullptr) || (pSound == nullptr) )
+    {
+        return false;
+    }
+
+    unsigned int       iPosInPCM      = 0;
+    unsigned long long iParentClock   = 0;
+    float              fFrequency     = 0.0f;
+    bool               bChannelPaused = true;
+
+    pSystem->lockDSP();
+
+    FMOD_RESULT resultPos    = pChannel->getPosition(&iPosInPCM, FMOD_TIMEUNIT_PCM);
+    FMOD_RESULT resultClock  = pChannel->getDSPClock(nullptr, &iParentClock);
+    FMOD_RESULT resultFreq   = pChannel->getFrequency(&fFrequency);
+    FMOD_RESULT resultPaused = pChannel->getPaused(&bChannelPaused);
+
+    pSystem->unlockDSP();
+
+    long long iTimeInNS = PositionSnapshot::getTimeInNS();
+
+    if ( resultPos || resultClock || resultFreq || resultPaused )
+    {
+        // The channel is ended.
+        return false;
+    }
+
+    unsigned int iLengthInPCM = 0;
+    if ( pSound->getLength(&iLengthInPCM, FMOD_TIMEUNIT_PCM) )
+    {
+        return false;
+    }
+
+    pPosition->iDSPClock       = iParentClock;
+    pPosition->iTimeInNS       = iTimeInNS;
+    pPosition->iPositionInPCM  = iPosInPCM;
+    pPosition->iLengthInPCM    = iLengthInPCM;
+    pPosition->iLoopStartInPCM = iLoopStartInPCM;
+    pPosition->iLoopEndInPCM   = iLoopEndInPCM;
+    pPosition->fRate           = bChannelPaused ? 0.0f : fFrequency;
+    pPosition->fSampleRate     = fDefaultFrequency;
+
+    return true;
+}
+
 unsigned int Track::getLengthInPCMbytes()
 {
     FMOD_RESULT result;
@@ -678,23 +1259,6 @@ unsigned int Track::getPositionInPCMBytes()
     return 0;
 }
 
-std::string Track::getCurrentTime()
-{
-    unsigned int iMS = getPositionInMS();
-    if (iMS == 0) return "";
-
-    unsigned int iSeconds = iMS / 1000;
-    unsigned int iMinutes = iSeconds / 60;
-    iSeconds -= (iMinutes * 60);
-    std::string trackTime = "";
-    trackTime += std::to_string(iMinutes);
-    trackTime += ":";
-    if (iSeconds < 10) trackTime += "0";
-    trackTime += std::to_string(iSeconds);
-
-    return trackTime;
-}
-
 std::string Track::getFormat()
 {
     // This function returns private 'std::string format' variable.
@@ -733,398 +1297,432 @@ bool Track::getChannelsAndBits(int* channels, int* bits)
 bool Track::getBitRate(int *bitrate)
 {
     // This function returns tracks bitrate.
+    // The bitrate is calculated only once, other calls will return the saved value.
+    // For MP3 we look at the frames (see MP3Parser), for other formats we only read the headers.
+
+    if (bBitrateCalculated)
+    {
+        *bitrate = iBitrate;
+        return true;
+    }
+
+    // Shared with the stream of the track (see MappedFileSystem).
+    std::shared_ptr<MappedFile> pAudioFile = MappedFileSystem::mapFile(sFilePath);
+
+    if (pAudioFile == nullptr)
+    {
+        // Can't open file
+        return false;
+    }
 
-    std::vector<int> framesBitrates;
+    const unsigned char* pData        = pAudioFile->getData();
+    size_t               iSizeInBytes = static_cast<size_t>(pAudioFile->getSizeInBytes());
 
-    // Some of the code below is from my other program so don't really pay attension to some of the comments
+    bool bResult = false;
 
+    if      (format == "MP3")
+    {
+        MP3Parser parser(pData, iSizeInBytes);
+        bResult = parser.calculateBitrate(bitrate);
+    }
+    else if (format == "FLAC")
+    {
+        bResult = getFLACBitrate(pData, iSizeInBytes, bitrate);
+    }
+    else if (format == "OGG")
+    {
+        bResult = getOGGBitrate(pData, iSizeInBytes, bitrate);
+    }
+    else if (format == "WAV")
+    {
+        bResult = getWAVBitrate(pData, iSizeInBytes, bitrate);
+    }
 
-    // Open selected file in binary mode
-#if _WIN32
-    std::ifstream mp3File (sFilePath, std::ios::binary);
-#else
-    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
-    auto out = utf8_conv.to_bytes(sFilePath);
+    if (bResult == false)
+    {
+        // Unsupported format
+        return false;
+    }
 
-    std::ifstream mp3File (out, std::ios::binary);
-#endif
+    // Publish the value before the flag so other threads never see the flag without the value.
+    iBitrate           = *bitrate;
+    bBitrateCalculated = true;
+
+    return true;
+}
+
+bool Track::isBitrateCalculated()
+{
+    return bBitrateCalculated;
+}
+
+long long Track::getFileSizeInBytes()
+{
+    // This function returns tracks file size in bytes (0 if the file can't be opened).
+
+    long long iFileSize         = 0;
+    long long iModificationTime = 0;
 
-    if (mp3File.is_open())
+    if ( CacheFolder::getFileInfo(sFilePath, &iFileSize, &iModificationTime) == false )
     {
-        // Will be 'true' if we passed the first mp3 frame
-        // We skip it because it is usually contains some VBR or CBR info
-        // I don't wanna touch it for now, maybe later
-        bool bFirstMP3FramePassed = false;
+        return 0;
+    }
 
-        // Get file size
-        int endPos = 0;
-        mp3File.seekg(0,std::ios::end);
-        // tellg() returns 'long long' value so we can't put it in endPos (int) yet
-        long long tempSize = mp3File.tellg();
+    return iFileSize;
+}
 
-        // File is more than 256 MB?
-        if (tempSize > 268435450)
-        {
-            // We close file
-            // Because 'amountOfBits' can hold 256 MB max (2147483648 numbers - in our case it's bits)
-            // But will it ever contain so much???
-            mp3File.close();
-            pMainWindow->showMessageBox(true, "File is larger than 256 MB, can't determine the bitrate.");
-            return false;
-        }
+bool Track::getPaused()
+{
+    // This function returns private 'bool bPaused' variable - 'true' if track is paused.
+    return bPaused;
+}
 
-        // Now we know that the size of the selected file is less than 256 MB and we can safely put it to 'endPos'
-        endPos = static_cast<int>(tempSize);
+float Track::getFrequency()
+{
+    // This function returns the sampling rate of the track.
 
-        // Set position to the beginning of this file
-        mp3File.seekg(0,std::ios::beg);
+    if (pSound != nullptr)
+    {
+        float freq = 0.0f;
+
+        pSound->getDefaults(&freq, nullptr);
+        return freq;
+    }
 
-        // 'pos' - current read position
-        int pos = 0;
-        // 'byte' will contain bytes that we read
-        unsigned char byte = 0;
+    return 0.0f;
+}
 
-        // Find the size of metadata
-        char metaBuffer[4];
-        memset(metaBuffer, 0, 4);
+void Track::setupChannelCallback()
+{
+    // FMOD will call TrackChannelCallback::callback() (from System::update()) when the channel is ended.
 
-        mp3File.read(metaBuffer, 3);
+    FMOD_RESULT result;
 
-        if (std::string(metaBuffer) == "ID3")
-        {
-            // Skip to tag size
-            mp3File.seekg(3, std::ios::cur);
-            mp3File.read(metaBuffer, 4);
+    result = pChannel->setUserData(this);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("Track::setupChannelCallback::FMOD::Channel::setUserData() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+        return;
+    }
 
-            int iTagSize = 0;
+    result = pChannel->setCallback(TrackChannelCallback::callback);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("Track::setupChannelCallback::FMOD::Channel::setCallback() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+    }
+}
 
-            int iCurrentBit = 0;
+void Track::skipEncoderDelay()
+{
+    // MP3 decoder outputs the encoder delay (and its own delay) before the first real sample,
+    // so if the channel is placed before 'iStartInPCM' we move it to the 'iStartInPCM'.
 
-            for (int i = 3; i >= 0; i--)
-            {
-                // last bit does not contain data
-                // so we read 7 bits and not 8
-                for (int j = 0; j < 7; j++)
-                {
-                    bool bit = (bool((1 << j)  &  metaBuffer[i]));
-
-                    if (bit)
-                    {
-                        // write true
-                        iTagSize |= (1 << iCurrentBit);
-                    }
-                    else
-                    {
-                        // write false
-                        iTagSize &= ~(1 << iCurrentBit);
-                    }
-
-                    iCurrentBit++;
-                }
-            }
+    if ( (iStartInPCM == 0) || (pChannel == nullptr) )
+    {
+        return;
+    }
 
-            mp3File.seekg(iTagSize, std::ios::cur);
-        }
-        else
+    unsigned int iPosInPCM = 0;
+
+    FMOD_RESULT result = pChannel->getPosition(&iPosInPCM, FMOD_TIMEUNIT_PCM);
+    if ( (result == FMOD_OK) && (iPosInPCM < iStartInPCM) )
+    {
+        result = pChannel->setPosition(iStartInPCM, FMOD_TIMEUNIT_PCM);
+        if (result)
         {
-            mp3File.seekg(0, std::ios::beg);
+            pMainWindow->showMessageBox( true, std::string("Track::skipEncoderDelay::FMOD::Channel::setPosition() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
         }
+    }
+}
 
+FMOD::Sound* Track::getPlaybackSound()
+{
+    // New channels play the file from memory if it's preloaded.
 
+    return pPreloadedSound ? pPreloadedSound : pSound;
+}
 
-        do
-        {
-            mp3File.read(reinterpret_cast<char*>(&byte),sizeof(byte));
-            pos++;
+bool Track::applyLoopSection()
+{
+    // Loop mode and loop points belong to the channel so we set them again when the channel is recreated.
 
-            // Every mp3 frame starts with 11 (from 0 to 10) 'true' bits
-            if (byte != 255)
-            {
-                continue;
-            }
+    if (pChannel == nullptr)
+    {
+        return false;
+    }
 
-            if ((static_cast<double>(pos)/endPos) * 100 > 99)
-            {
-                continue;
-            }
+    FMOD_RESULT result;
 
-            mp3File.read(reinterpret_cast<char*>(&byte),sizeof(byte));
-            pos++;
+    if (iLoopEndInPCM == 0)
+    {
+        // The channel may be already ended, it's not an error.
+        pChannel->setMode(FMOD_LOOP_OFF);
 
-            // Last bit (right bit) can be 0 and byte value will not be 251 but 250.
-            // Last bit holds protection info
-            if (byte == 251 || byte == 250)
-            {
-                // read 8, 9, 10th bit (starting from 0 bit) of mp3 frame
-                bool bit1 = (bool((1 << 7)  &  byte));
-                bool bit2 = (bool((1 << 6)  &  byte));
-                bool bit3 = (bool((1 << 5)  &  byte));
-                bool bit4 = false;
+        return true;
+    }
 
-                if (bit1 && bit2 && bit3)
-                {
-                    // 11 first bits is set to 'true' seems like it's mp3 frame
-
-                    // Check if format is MPEG-1
-                    bit1 = (bool((1 << 4)  &  byte));
-                    bit2 = (bool((1 << 3)  &  byte));
-                    if (bit1 && bit2)
-                    {
-                        // MPEG-1
-
-                        // Starting to read third byte of mp3 frame
-                        mp3File.read(reinterpret_cast<char*>(&byte),sizeof(byte));
-                        pos++;
-
-                        bit1 = (bool((1 << 7)  &  byte));
-                        bit2 = (bool((1 << 6)  &  byte));
-                        bit3 = (bool((1 << 5)  &  byte));
-                        bit4 = (bool((1 << 4)  &  byte));
-
-                        int iBitRate = tellBitRate(bit1, bit2, bit3, bit4);
-
-                        if ( iBitRate == -1 )
-                        {
-                            // bitrate code is 1111 or 0000 - this is not valid
-                            continue;
-                        }
-
-                        framesBitrates.push_back(iBitRate);
-
-                        // check if next 2 bits != 11
-                        bit1 = (bool((1 << 3)  &  byte));
-                        bit2 = (bool((1 << 2)  &  byte));
-
-                        int iSamplingRate = tellSamplingRate(bit1,bit2);
-
-                        if ( iSamplingRate == -1 )
-                        {
-                            // sampling rate index == 11 - this is not valid
-                            continue;
-                        }
-
-                        if (bFirstMP3FramePassed == false)
-                        {
-                            bFirstMP3FramePassed = true;
-                            // It will probably contain some VBR and LAME stuff which we do not want to change
-                            continue;
-                        }
-
-                        // check if padding bit is set
-                        bit1 = (bool((1 << 1)  &  byte));
-
-                        // Calculate the size of this mp3 frame
-                        // And we don't count padding byte here (we will do that later)
-                        // Not 1024 but 1000!
-                        iBitRate *= 1000;
-
-                        // We need to floor() it
-                        int iFrameSize = static_cast<int>(floor(144 * iBitRate / static_cast<double>(iSamplingRate)));
-
-                        // Minus header size
-                        iFrameSize -= 4;
-
-                        // read last (4th) byte of mp3 frame header
-                        mp3File.read(reinterpret_cast<char*>(&byte),sizeof(byte));
-                        pos++;
-
-                        // If padding bit is set
-                        if (bit1 == true)
-                        {
-                            iFrameSize++;
-                        }
-
-                        // Jump right to the end of this mp3 frame - the beginning of a new mp3 frame
-                        mp3File.seekg(iFrameSize,std::ios::cur);
-                        pos += iFrameSize;
-                    }
-                    else
-                    {
-                        // Unsupported format
-                        mp3File.close();
-
-                        return false;
-                    }
-                }
-            }
-        }while(pos < endPos);
+    result = pChannel->setMode(FMOD_LOOP_NORMAL);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("Track::applyLoopSection::FMOD::Channel::setMode() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+        return false;
+    }
 
-        mp3File.close();
+    result = pChannel->setLoopCount(-1);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("Track::applyLoopSection::FMOD::Channel::setLoopCount() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+        return false;
+    }
 
+    // Loop end is inclusive in FMOD.
+    result = pChannel->setLoopPoints(iLoopStartInPCM, FMOD_TIMEUNIT_PCM, iLoopEndInPCM - 1, FMOD_TIMEUNIT_PCM);
+    if (result)
+    {
+        pMainWindow->showMessageBox( true, std::string("Track::applyLoopSection::FMOD::Channel::setLoopPoints() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
+        return false;
+    }
 
+    return true;
+}
 
-        // On each index this vector will contain:
-        // (on 0 index) bitrate number
-        // (on 1 index) the number of times this bitrate was encountered in the file.
-        // So it will look something like this:
-        // [128, 4034] [224, 549] [256, 533] [320, 325].
-        std::vector<std::vector<int>> bitrates;
+bool Track::getDSPClockAtPCM(unsigned int iTargetInPCM, unsigned long long* pDSPClock)
+{
+    // This function returns the DSP clock (of the master channel group) at which the channel
+    // will reach the 'iTargetInPCM' sample (with the current speed).
 
-        // Fill vector
-        for (size_t i = 0; i < framesBitrates.size(); i++)
-        {
-            bool bExists = false;
-            for (size_t j = 0; j < bitrates.size(); j++)
-            {
-                if (bitrates[j][0] == framesBitrates[i])
-                {
-                    bExists = true;
+    FMOD_RESULT result;
 
-                    bitrates[j][1] += 1;
+    int iOutputRate = 0;
+    result = pSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr);
+    if (result)
+    {
+        return false;
+    }
 
-                    break;
-                }
-            }
 
-            if (bExists == false)
-            {
-                bitrates.resize( bitrates.size() + 1 );
-                bitrates[ bitrates.size() - 1 ].resize(2);
+    // Lock the mixer so the position and the clock are from the same mix block.
 
-                bitrates[ bitrates.size() - 1 ][0] = framesBitrates[i];
-                bitrates[ bitrates.size() - 1 ][1] = 0;
-            }
-        }
+    unsigned int       iPosInPCM    = 0;
+    unsigned long long iParentClock = 0;
+    float              fFrequency   = 0.0f;
 
-        // Find bitrate that was encountered most of the times.
-        size_t iAverageBitrateIndex = 0;
-        for (size_t i = 1; i < bitrates.size(); i++)
-        {
-            if (bitrates[i][1] > bitrates[iAverageBitrateIndex][1])
-            {
-                iAverageBitrateIndex = i;
-            }
-        }
+    pSystem->lockDSP();
 
-        *bitrate = bitrates[iAverageBitrateIndex][0];
+    FMOD_RESULT resultPos   = pChannel->getPosition(&iPosInPCM, FMOD_TIMEUNIT_PCM);
+    FMOD_RESULT resultClock = pChannel->getDSPClock(nullptr, &iParentClock);
+    FMOD_RESULT resultFreq  = pChannel->getFrequency(&fFrequency);
 
-        bBitrateCalculated = true;
+    pSystem->unlockDSP();
 
-        return true;
+    if ( resultPos || resultClock || resultFreq || (fFrequency <= 0.0f) || (iPosInPCM > iTargetInPCM) )
+    {
+        return false;
     }
-    else
+
+    if (iPosInPCM == 0)
     {
-        // Can't open file
+        // The position is not updated until the first mix block of the channel is finished
+        // so we don't know if the channel was started at this clock or one block before, try again later.
         return false;
     }
-}
 
-bool Track::isBitrateCalculated()
-{
-    return bBitrateCalculated;
+
+    // Samples left in the track -> samples in the output.
+    double dSamplesLeftInOutput = static_cast<double>(iTargetInPCM - iPosInPCM) * iOutputRate / fFrequency;
+
+    *pDSPClock = iParentClock + static_cast<unsigned long long>( llround(dSamplesLeftInOutput) );
+
+    return true;
 }
 
-long long Track::getFileSizeInBytes()
+void Track::readGaplessInfo()
 {
-    // This function returns tracks file size in bytes.
+    // Reads encoder delay and padding from the LAME header (or iTunSMPB tag).
 
-    // Open selected file in binary mode
-#if _WIN32
-    std::ifstream mp3File (sFilePath, std::ios::binary);
-#else
-    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
-    auto out = utf8_conv.to_bytes(sFilePath);
+    std::shared_ptr<MappedFile> pAudioFile = MappedFileSystem::mapFile(sFilePath);
 
-    std::ifstream mp3File (out, std::ios::binary);
-#endif
+    if (pAudioFile == nullptr)
+    {
+        return;
+    }
+
+    MP3Parser parser(pAudioFile->getData(), static_cast<size_t>(pAudioFile->getSizeInBytes()));
 
-    if (mp3File.is_open())
+    unsigned int iStart = 0;
+    unsigned int iEnd   = 0;
+
+    if ( parser.readGaplessInfo(&iStart, &iEnd) )
     {
-        // Get file size
-        long long endPos = 0;
-        mp3File.seekg(0, std::ios::end);
-        // tellg() returns 'long long' value so we can't put it in endPos (int) yet
-        endPos = mp3File.tellg();
+        iStartInPCM = iStart;
+        iEndInPCM   = iEnd;
+    }
+}
 
-        mp3File.close();
+bool Track::switchToAccurateSound()
+{
+    // This function replaces 'pSound' with 'pAccurateSound' (if it's ready).
+    // Called before the new channel is created, the playing channel keeps its sound.
 
-        return endPos;
+    if (pAccurateSound == nullptr)
+    {
+        return false;
     }
-    else
+
+    FMOD_RESULT result;
+
+    result = pSound->release();
+    if (result)
     {
-        // Can't open file
-        return 0;
+        pMainWindow->showMessageBox( true, std::string("Track::switchToAccurateSound::FMOD::Sound::release() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
     }
+
+    pSound         = pAccurateSound;
+    pAccurateSound = nullptr;
+    bAccurateTime  = true;
+
+    return true;
 }
 
-bool Track::getPaused()
+bool Track::getFLACBitrate(const unsigned char* pData, size_t iSizeInBytes, int* bitrate)
 {
-    // This function returns private 'bool bPaused' variable - 'true' if track is paused.
-    return bPaused;
+    // Average bitrate = size of the audio frames / track length.
+    // Audio frames start right after the last metadata block.
+
+    // FLAC file can have ID3v2 tag at the beginning.
+    MP3Parser id3Parser(pData, iSizeInBytes);
+    size_t iPos = id3Parser.getID3v2Size();
+
+    if ( (iPos + 4 > iSizeInBytes) || (memcmp(pData + iPos, "fLaC", 4) != 0) )
+    {
+        return false;
+    }
+
+    iPos += 4;
+
+    bool bLastBlock = false;
+
+    while ( (bLastBlock == false) && (iPos + 4 <= iSizeInBytes) )
+    {
+        // Metadata block header: 1 bit - 'last block' flag, 7 bits - block type, 24 bits - block size.
+        bLastBlock = (pData[iPos] & 0x80) != 0;
+
+        size_t iBlockSize = (static_cast<size_t>(pData[iPos + 1]) << 16)
+                          | (static_cast<size_t>(pData[iPos + 2]) << 8)
+                          |  static_cast<size_t>(pData[iPos + 3]);
+
+        iPos += 4 + iBlockSize;
+    }
+
+    if (iPos >= iSizeInBytes)
+    {
+        return false;
+    }
+
+    return getBitrateBySize(iSizeInBytes - iPos, bitrate);
 }
 
-float Track::getFrequency()
+bool Track::getOGGBitrate(const unsigned char* pData, size_t iSizeInBytes, int* bitrate)
 {
-    // This function returns the sampling rate of the track.
+    // Vorbis identification header (first packet of the first Ogg page) contains the nominal bitrate.
+    // If the encoder did not set it, we calculate the average bitrate from the file size.
 
-    if (pSound != nullptr)
+    // Ogg page header: 27 bytes + segment table (size is stored at 26 byte).
+    if ( (iSizeInBytes < 27) || (memcmp(pData, "OggS", 4) != 0) )
     {
-        float freq = 0.0f;
+        return false;
+    }
 
-        pSound->getDefaults(&freq, nullptr);
-        return freq;
+    size_t iPacket = 27 + static_cast<size_t>(pData[26]);
+
+    if ( (iPacket + 28 <= iSizeInBytes) && (pData[iPacket] == 1) && (memcmp(pData + iPacket + 1, "vorbis", 6) == 0) )
+    {
+        // 1 byte - packet type, 6 bytes - "vorbis", 4 bytes - version, 1 byte - channels, 4 bytes - sample rate,
+        // 4 bytes - maximum bitrate, 4 bytes - nominal bitrate (little-endian, bits per second).
+        const unsigned char* pNominal = pData + iPacket + 20;
+
+        int iNominalBitrate = static_cast<int>( static_cast<unsigned int>(pNominal[0])
+                                              | (static_cast<unsigned int>(pNominal[1]) << 8)
+                                              | (static_cast<unsigned int>(pNominal[2]) << 16)
+                                              | (static_cast<unsigned int>(pNominal[3]) << 24) );
+
+        if (iNominalBitrate > 0)
+        {
+            *bitrate = static_cast<int>( round(iNominalBitrate / 1000.0) );
+            return true;
+        }
     }
 
-    return 0.0f;
+    return getBitrateBySize(iSizeInBytes, bitrate);
 }
 
-int Track::tellBitRate(bool bit1, bool bit2, bool bit3, bool bit4)
+bool Track::getWAVBitrate(const unsigned char* pData, size_t iSizeInBytes, int* bitrate)
 {
-    // bit1 is first bit in third byte of mp3 header
+    // Average bitrate = size of the 'data' chunk / track length.
 
-    QString bitString = "";
+    if ( (iSizeInBytes < 12) || (memcmp(pData, "RIFF", 4) != 0) || (memcmp(pData + 8, "WAVE", 4) != 0) )
+    {
+        return false;
+    }
 
-    if (bit1) bitString+="1";
-    else      bitString+="0";
+    size_t iPos = 12;
 
-    if (bit2) bitString+="1";
-    else      bitString+="0";
+    // Average bytes per second from the "fmt " chunk.
+    size_t iByteRate = 0;
 
-    if (bit3) bitString+="1";
-    else      bitString+="0";
+    while (iPos + 8 <= iSizeInBytes)
+    {
+        size_t iChunkSize = static_cast<size_t>(pData[iPos + 4])
+                          | (static_cast<size_t>(pData[iPos + 5]) << 8)
+                          | (static_cast<size_t>(pData[iPos + 6]) << 16)
+                          | (static_cast<size_t>(pData[iPos + 7]) << 24);
 
-    if (bit4) bitString+="1";
-    else      bitString+="0";
+        if ( (memcmp(pData + iPos, "fmt ", 4) == 0) && (iChunkSize >= 12) && (iPos + 20 <= iSizeInBytes) )
+        {
+            iByteRate = static_cast<size_t>(pData[iPos + 16])
+                      | (static_cast<size_t>(pData[iPos + 17]) << 8)
+                      | (static_cast<size_t>(pData[iPos + 18]) << 16)
+                      | (static_cast<size_t>(pData[iPos + 19]) << 24);
+        }
+        else if (memcmp(pData + iPos, "data", 4) == 0)
+        {
+            size_t iDataStart = iPos + 8;
 
+            // Chunk size can be wrong (or 0xFFFFFFFF) if the file was written by the streaming software.
+            // FMOD takes the track length from the same chunk size, so the length is wrong too.
+            if ( (iChunkSize == 0) || (iChunkSize > iSizeInBytes - iDataStart) )
+            {
+                if (iByteRate > 0)
+                {
+                    *bitrate = static_cast<int>( round(iByteRate * 8.0 / 1000.0) );
+                    return true;
+                }
 
+                iChunkSize = iSizeInBytes - iDataStart;
+            }
 
+            return getBitrateBySize(iChunkSize, bitrate);
+        }
 
-         if (bitString == "0001") return 32;
-    else if (bitString == "0010") return 40;
-    else if (bitString == "0011") return 48;
-    else if (bitString == "0100") return 56;
-    else if (bitString == "0101") return 64;
-    else if (bitString == "0110") return 80;
-    else if (bitString == "0111") return 96;
-    else if (bitString == "1000") return 112;
-    else if (bitString == "1001") return 128;
-    else if (bitString == "1010") return 160;
-    else if (bitString == "1011") return 192;
-    else if (bitString == "1100") return 224;
-    else if (bitString == "1101") return 256;
-    else if (bitString == "1110") return 320;
+        // Chunks are aligned to 2 bytes.
+        iPos += 8 + iChunkSize + (iChunkSize % 2);
+    }
 
-         return -1;
+    return false;
 }
 
-int Track::tellSamplingRate(bool bit1, bool bit2)
+bool Track::getBitrateBySize(size_t iAudioSizeInBytes, int* bitrate)
 {
-    // bit1 is bit right after last bitrate bit
-
-    QString bitString = "";
-
-    if (bit1) bitString+="1";
-    else      bitString+="0";
-
-    if (bit2) bitString+="1";
-    else      bitString+="0";
+    double dLengthInSec = getLengthInMS() / 1000.0;
 
+    if (dLengthInSec <= 0.0)
+    {
+        return false;
+    }
 
-         if (bitString == "00") return 44100;
-    else if (bitString == "01") return 48000;
-    else if (bitString == "10") return 32000;
+    *bitrate = static_cast<int>( round(iAudioSizeInBytes * 8.0 / dLengthInSec / 1000.0) );
 
-         return -1;
+    return true;
 }
 
 std::wstring Track::stringToWString(const std::string &str)
@@ -1150,6 +1748,9 @@ Track::~Track()
 
     if (pChannel)
     {
+        // The track is deleted, the callback should not use it.
+        pChannel->setCallback(nullptr);
+
         result = pChannel->stop();
         if (result)
         {
@@ -1171,4 +1772,15 @@ Track::~Track()
             pMainWindow->showMessageBox( true, std::string("~Track::FMOD::Sound::release() failed. Error: ") + std::string(FMOD_ErrorString(result)) );
         }
     }
+
+    if (pAccurateSound)
+    {
+        pAccurateSound->release();
+    }
+
+    if (pPreloadedSound)
+    {
+        // Before 'pPreloadedData' is freed.
+        pPreloadedSound->release();
+    }
 }
@@ -9,12 +9,21 @@
 
 // STL
 #include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+
+// Custom
+#include "Model/SeekTable/seektable.h"
+#include "Model/TrackLoudness/trackloudness.h"
+#include "Model/PositionSnapshot/positionsnapshot.h"
 
 
 
 
 
 class MainWindow;
+struct TrackChannelCallback;
 
 namespace FMOD
 {
@@ -27,6 +36,10 @@ namespace FMOD
 
 
 
+// Called from FMOD::System::update() when the track's channel has ended (or was stopped).
+typedef void (*TrackEndCallback)(void* pUserData);
+
+
 
 class Track
 {
@@ -48,12 +61,66 @@ public:
         bool           reCreateTrack          (float fVolume);
 
 
+    // Gapless playback (see AudioService::scheduleNextTrack())
+
+        bool           scheduleTrack          (float fVolume,  unsigned long long iStartDSPClock);
+        void           cancelSchedule         ();
+        bool           isScheduled            ();
+        bool           getEndDSPClock         (unsigned long long* pEndDSPClock);
+        bool           setStopDSPClock        (unsigned long long iStopDSPClock);
+        bool           getGaplessInfo         (unsigned int* pStartInPCM,  unsigned int* pEndInPCM);
+
+
+    // Fades on the DSP clock (crossfades and repeat section, see AudioService::scheduleNextTrack())
+
+        bool           addFade                (unsigned long long iStartDSPClock,  unsigned long long iEndDSPClock,  bool bFadeIn,  char cCurve);
+        void           removeFades            ();
+
+
+    // Repeat section (see AudioService::setRepeatPoint())
+
+        bool           setLoopSection         (unsigned int iStartInMS,  unsigned int iEndInMS);
+        void           clearLoopSection       ();
+        bool           getLoopSeamDSPClock    (unsigned long long* pSeamDSPClock);
+
+
     // 'FX' functions
 
         void           setSpeedByFreq         (float fSpeed);
         void           setSpeedByTime         (float fSpeed);
 
 
+    // 'Seek table' functions (see AudioService::threadPrepareSeekTables())
+
+        void           setSeekTable           (const SeekTable& seekTable);
+        void           setAccurateSound       (FMOD::Sound* pAccurateSound);
+        bool           needsAccurateSound     ();
+        bool           isAccurateSoundReady   ();
+        const SeekTable& getSeekTable         ();
+        static bool    openStream             (FMOD::System* pSystem,  const std::wstring& sFilePath,  bool bAccurateTime,  FMOD::Sound** ppSound,  std::string* pErrorString = nullptr);
+
+
+    // Preload (see AudioService::preloadNextTrack())
+
+        void           setPreloadedSound      (FMOD::Sound* pPreloadedSound,  std::shared_ptr<std::vector<char>> pPreloadedData);
+        void           releasePreloadedSound  ();
+        bool           isPreloaded            ();
+        static bool    openMemoryStream       (FMOD::System* pSystem,  const std::vector<char>& vData,  FMOD::Sound** ppSound);
+
+
+    // Loudness normalization (see AudioService::threadAnalyzeLoudness())
+
+        void           setLoudness            (const TrackLoudness& loudness);
+        const TrackLoudness& getLoudness      ();
+        void           setLoudnessGain        (float fGain);
+        float          getLoudnessGain        ();
+
+
+    // Track end
+
+        void           setEndCallback         (TrackEndCallback pEndCallback,  void* pUserData);
+
+
     // 'Dummy Sound' functions (related to oscillogram drawing)
 
         bool           createDummySound       ();
@@ -77,10 +144,10 @@ public:
 
         // Time
 
-        std::string    getCurrentTime         ();
         unsigned int   getLengthInMS          ();
         unsigned int   getPositionInMS        (bool* bError = nullptr);
         unsigned int   getPositionInPCMBytes  ();
+        bool           getPlaybackPosition    (PlaybackPosition* pPosition);
 
 
         // Size
@@ -118,10 +185,34 @@ public:
 
 private:
 
-    // Funtions that used by getBitRate() function
+    friend struct TrackChannelCallback;
+
 
-        int tellBitRate      (bool bit1,  bool bit2,  bool bit3,  bool bit4);
-        int tellSamplingRate (bool bit1,  bool bit2);
+    // Used when the new channel is created
+
+        void setupChannelCallback  ();
+        void skipEncoderDelay      ();
+        bool applyLoopSection      ();
+        FMOD::Sound* getPlaybackSound ();
+
+    // Used in getEndDSPClock() and getLoopSeamDSPClock()
+
+        bool getDSPClockAtPCM      (unsigned int iTargetInPCM,  unsigned long long* pDSPClock);
+
+    // Used in setupTrack()
+
+        void readGaplessInfo       ();
+
+    // Used in playTrack(), reCreateTrack() and scheduleTrack()
+
+        bool switchToAccurateSound ();
+
+    // Used in getBitRate() (for formats other than MP3)
+
+        bool getFLACBitrate  (const unsigned char* pData,  size_t iSizeInBytes,  int* bitrate);
+        bool getOGGBitrate   (const unsigned char* pData,  size_t iSizeInBytes,  int* bitrate);
+        bool getWAVBitrate   (const unsigned char* pData,  size_t iSizeInBytes,  int* bitrate);
+        bool getBitrateBySize(size_t iAudioSizeInBytes,    int* bitrate);
 
     // Convert
 
@@ -137,6 +228,8 @@ private:
 
     // FMOD stuff
     FMOD::Sound*   pSound;
+    FMOD::Sound*   pAccurateSound;
+    FMOD::Sound*   pPreloadedSound;
     FMOD::Sound*   pDummySound;
     FMOD::Channel* pChannel;
     FMOD::System*  pSystem;
@@ -158,6 +251,48 @@ private:
     float          fSpeedByTime;
 
 
+    // Bitrate can be read by other threads while it's being calculated in the import thread.
+    std::atomic<int>  iBitrate;
+    std::atomic<bool> bBitrateCalculated;
+
+
+    // Seek table (the VBR flag) is built in the background (set under AudioService::mtxTracksVec).
+    // Streams are opened without FMOD_ACCURATETIME so import is fast, VBR MP3 is reopened
+    // with FMOD_ACCURATETIME in the background ('pAccurateSound') for exact seeking,
+    // the channel gets it only when it's created (never in the middle of the playback).
+    SeekTable      seekTable;
+    bool           bAccurateTime;
+
+
+    // Whole file in memory (see PreloadCache), new channels play 'pPreloadedSound' instead of 'pSound'.
+    // The data should live while the sound is not released.
+    std::shared_ptr<std::vector<char>> pPreloadedData;
+
+
+    // Loudness is analyzed in the background (set under AudioService::mtxTracksVec).
+    // The volume of the channel is multiplied by 'fLoudnessGain' (1.0 - normalization is off or not analyzed yet).
+    TrackLoudness  loudness;
+    float          fLoudnessGain;
+
+
+    TrackEndCallback pEndCallback;
+    void*            pEndCallbackUserData;
+
+
+    // Real audio of the MP3 is [iStartInPCM, iEndInPCM) without the encoder delay and padding
+    // (0 and 0 if there is no gapless info).
+    unsigned int   iStartInPCM;
+    unsigned int   iEndInPCM;
+
+
+    // Repeat section is looped by the mixer: [iLoopStartInPCM, iLoopEndInPCM) (0 and 0 if not looping).
+    unsigned int   iLoopStartInPCM;
+    unsigned int   iLoopEndInPCM;
+
+
+    // 'true' if the channel is started by scheduleTrack() and waits for the previous track to end.
+    bool           bScheduled;
+
+
     bool           bPaused;
-    bool           bBitrateCalculated;
 };
@@ -0,0 +1,316 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "trackexporter.h"
+
+// STL
+#include <algorithm>
+
+// Custom
+#include "Model/Track/track.h"
+#include "Model/MappedFileSystem/mappedfilesystem.h"
+#include "Model/Equalizer/equalizer.h"
+#include "Model/TimeStretch/timestretch.h"
+#include "Model/ConvolutionReverb/convolutionreverb.h"
+#include "globalparams.h"
+#include "../ext/FMOD/inc/fmod.hpp"
+#include "../ext/FMOD/inc/fmod_errors.h"
+
+// Other
+#if _WIN32
+#include <windows.h>
+#else
+#include <locale>
+#include <codecvt>
+#endif
+
+TrackExporter::TrackExporter(const ExportSettings& settings)
+{
+    this->settings = settings;
+
+    pPitch        = nullptr;
+    pTimeStretch  = nullptr;
+    pReverb       = nullptr;
+    pEcho         = nullptr;
+    pEqualizer    = nullptr;
+
+    pConvolutionReverb         = nullptr;
+    iImpulseResponseLengthInMS = 0;
+}
+
+
+
+
+
+bool TrackExporter::exportTrack(const ExportJob& job, const std::atomic<bool>* pContinue, std::string* pErrorString)
+{
+    // This function renders the track (or the range of it) in the calling thread.
+    // The output file is written by FMOD while we call System::update() and is finished in System::release().
+
+    FMOD::System* pExportSystem = nullptr;
+
+    FMOD_RESULT result;
+    result = FMOD::System_Create(&pExportSystem);
+    if (result)
+    {
+        *pErrorString = std::string("TrackExporter::exportTrack::FMOD::System_Create() failed. Error: ") + std::string(FMOD_ErrorString(result));
+        return false;
+    }
+
+    pExportSystem->setOutput(FMOD_OUTPUTTYPE_WAVWRITER_NRT);
+    MappedFileSystem::attach(pExportSystem);
+
+    std::string sOutputPath = toUTF8(job.sOutputPath);
+
+    // No mixer thread: streams are decoded in System::update() too.
+    result = pExportSystem->init(2, FMOD_INIT_STREAM_FROM_UPDATE, const_cast<char*>(sOutputPath.c_str()));
+    if (result)
+    {
+        *pErrorString = std::string("TrackExporter::exportTrack::FMOD::System::init() failed. Error: ") + std::string(FMOD_ErrorString(result));
+        pExportSystem->release();
+        return false;
+    }
+
+    if ( createMasterChain(pExportSystem, pErrorString) == false )
+    {
+        releaseMasterChain(pExportSystem);
+        pExportSystem->release();
+        return false;
+    }
+
+
+    FMOD::Sound* pSound = nullptr;
+
+    if ( Track::openStream(pExportSystem, job.sFilePath, true, &pSound, pErrorString) == false )
+    {
+        *pErrorString = std::string("TrackExporter::exportTrack::FMOD::System::createStream() failed. Error: ") + *pErrorString;
+        releaseMasterChain(pExportSystem);
+        pExportSystem->release();
+        return false;
+    }
+
+    unsigned int iLengthInMS = 0;
+    pSound->getLength(&iLengthInMS, FMOD_TIMEUNIT_MS);
+
+    unsigned int iToMS = ( (job.iToMS == 0) || (job.iToMS > iLengthInMS) ) ? iLengthInMS : job.iToMS;
+
+    if (job.iFromMS >= iToMS)
+    {
+        *pErrorString = "TrackExporter::exportTrack() failed. Error: the range is empty.";
+        pSound->release();
+        releaseMasterChain(pExportSystem);
+        pExportSystem->release();
+        return false;
+    }
+
+
+    FMOD::Channel* pChannel = nullptr;
+
+    result = pExportSystem->playSound(pSound, nullptr, true, &pChannel);
+    if (result)
+    {
+        *pErrorString = std::string("TrackExporter::exportTrack::FMOD::System::playSound() failed. Error: ") + std::string(FMOD_ErrorString(result));
+        pSound->release();
+        releaseMasterChain(pExportSystem);
+        pExportSystem->release();
+        return false;
+    }
+
+    float fDefaultFrequency = 0.0f;
+    pSound->getDefaults(&fDefaultFrequency, nullptr);
+
+    // Same as Track::setSpeedByFreq() and Track::setSpeedByTime() (only one of them is not 1.0).
+    float fSpeed = settings.fSpeedByPitch * settings.fSpeedByTime;
+
+    pChannel->setFrequency(fDefaultFrequency * fSpeed);
+    pChannel->setPosition(job.iFromMS, FMOD_TIMEUNIT_MS);
+    pChannel->setVolume(job.fGain);
+
+
+    // The range ends on the exact sample: the mixer stops the channel at the DSP clock.
+
+    int iOutputRate = 0;
+    pExportSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr);
+
+    unsigned long long iStartClock = 0;
+    pChannel->getDSPClock(nullptr, &iStartClock);
+
+    unsigned long long iRangeInClocks = static_cast<unsigned long long>( (iToMS - job.iFromMS) / fSpeed * iOutputRate / 1000.0 );
+    unsigned long long iTailInClocks  = static_cast<unsigned long long>(getTailInMS()) * iOutputRate / 1000;
+
+    pChannel->setDelay(iStartClock, iStartClock + iRangeInClocks, true);
+    pChannel->setPaused(false);
+
+
+    bool bPlaying = true;
+    unsigned long long iClock = iStartClock;
+
+    while ( (bPlaying || (iClock < iStartClock + iRangeInClocks + iTailInClocks)) && *pContinue )
+    {
+        pExportSystem->update();
+
+        pChannel->isPlaying(&bPlaying);
+
+        FMOD::ChannelGroup* pMaster = nullptr;
+        pExportSystem->getMasterChannelGroup(&pMaster);
+        pMaster->getDSPClock(nullptr, &iClock);
+    }
+
+
+    pSound->release();
+    releaseMasterChain(pExportSystem);
+    pExportSystem->release();
+
+    return *pContinue;
+}
+
+bool TrackExporter::createMasterChain(FMOD::System* pSystem, std::string* pErrorString)
+{
+    // Same DSPs in the same order as in AudioService::FMODinit().
+
+    FMOD::ChannelGroup* pMaster;
+    pSystem->getMasterChannelGroup(&pMaster);
+
+    FMOD_RESULT result;
+    if ( (result = pSystem->createDSPByType(FMOD_DSP_TYPE_PITCHSHIFT, &pPitch))
+         || (result = pSystem->createDSPByType(FMOD_DSP_TYPE_SFXREVERB,  &pReverb))
+         || (result = pSystem->createDSPByType(FMOD_DSP_TYPE_ECHO,       &pEcho)) )
+    {
+        *pErrorString = std::string("TrackExporter::createMasterChain::FMOD::System::createDSPByType() failed. Error: ") + std::string(FMOD_ErrorString(result));
+        return false;
+    }
+
+
+    pPitch->setParameterFloat(FMOD_DSP_PITCHSHIFT_FFTSIZE, 4096);
+    pPitch->setParameterFloat(FMOD_DSP_PITCHSHIFT_PITCH, settings.fPitch);
+    pPitch->setBypass(settings.fPitch == 1.0f);
+    pMaster->addDSP(0, pPitch);
+
+    if ( TimeStretch::createDSP(pSystem, &pTimeStretch) == false )
+    {
+        *pErrorString = "TrackExporter::createMasterChain::FMOD::System::createDSP() failed (time stretch).";
+        pTimeStretch = nullptr;
+        return false;
+    }
+
+    pTimeStretch->setParameterFloat(0, settings.fSpeedByTime);
+    pTimeStretch->setBypass(settings.fSpeedByTime == 1.0f);
+    pMaster->addDSP(1, pTimeStretch);
+
+    bool bConvolution = settings.sImpulseResponsePath.empty() == false;
+
+    pMaster->addDSP(3, pReverb);
+    pReverb->setParameterFloat(FMOD_DSP_SFXREVERB_WETLEVEL, settings.fReverbVolume);
+    pReverb->setBypass( bConvolution || (settings.fReverbVolume <= -80.0f) );
+
+    pMaster->addDSP(4, pEcho);
+    pEcho->setParameterFloat(FMOD_DSP_ECHO_DELAY, 1000);
+    pEcho->setParameterFloat(FMOD_DSP_ECHO_WETLEVEL, settings.fEchoVolume);
+    pEcho->setBypass(settings.fEchoVolume <= -80.0f);
+
+    if ( Equalizer::createDSP(pSystem, &pEqualizer) == false )
+    {
+        *pErrorString = "TrackExporter::createMasterChain::FMOD::System::createDSP() failed (equalizer).";
+        pEqualizer = nullptr;
+        return false;
+    }
+
+    for (size_t i = 0; i < settings.vEqualizerGains.size(); i++)
+    {
+        pEqualizer->setParameterFloat(static_cast<int>(i), settings.vEqualizerGains[i]);
+    }
+
+    pMaster->addDSP(5, pEqualizer);
+
+    if ( ConvolutionReverb::createDSP(pSystem, &pConvolutionReverb) == false )
+    {
+        *pErrorString = "TrackExporter::createMasterChain::FMOD::System::createDSP() failed (convolution reverb).";
+        pConvolutionReverb = nullptr;
+        return false;
+    }
+
+    // There is no deadline here, so the whole response is always applied.
+    pConvolutionReverb->setParameterBool(2, true);
+    pConvolutionReverb->setParameterFloat(0, settings.fReverbVolume);
+    pConvolutionReverb->setBypass( (bConvolution == false) || (settings.fReverbVolume <= -80.0f) );
+    pMaster->addDSP(6, pConvolutionReverb);
+
+    if (bConvolution)
+    {
+        ImpulseResponse* pImpulseResponse = ConvolutionReverb::loadImpulseResponse(pSystem, settings.sImpulseResponsePath, pErrorString);
+        if (pImpulseResponse == nullptr)
+        {
+            return false;
+        }
+
+        iImpulseResponseLengthInMS = pImpulseResponse->iLengthInMS;
+
+        ConvolutionReverb::setImpulseResponse(pConvolutionReverb, pImpulseResponse);
+    }
+
+    pMaster->setPan(settings.fPan);
+
+    return true;
+}
+
+void TrackExporter::releaseMasterChain(FMOD::System* pSystem)
+{
+    FMOD::ChannelGroup* pMaster;
+    pSystem->getMasterChannelGroup(&pMaster);
+
+    FMOD::DSP* vDSPs[] = {pPitch, pTimeStretch, pReverb, pEcho, pEqualizer, pConvolutionReverb};
+
+    for (size_t i = 0; i < 6; i++)
+    {
+        if (vDSPs[i])
+        {
+            pMaster->removeDSP(vDSPs[i]);
+            vDSPs[i]->release();
+        }
+    }
+
+    pPitch        = nullptr;
+    pTimeStretch  = nullptr;
+    pReverb       = nullptr;
+    pEcho         = nullptr;
+    pEqualizer    = nullptr;
+
+    pConvolutionReverb = nullptr;
+}
+
+unsigned int TrackExporter::getTailInMS() const
+{
+    // Reverb and echo ring after the last sample, pitch shifters delay the signal.
+
+    if ( (settings.fPitch != 1.0f) || (settings.fSpeedByTime != 1.0f) || (settings.fReverbVolume > -80.0f) || (settings.fEchoVolume > -80.0f) )
+    {
+        if (settings.fReverbVolume > -80.0f)
+        {
+            // The convolution reverb rings as long as its response (plus the pre-delay of one block, well under 100 ms).
+            return std::max(static_cast<unsigned int>(EXPORT_FX_TAIL_MS), iImpulseResponseLengthInMS + 100);
+        }
+
+        return EXPORT_FX_TAIL_MS;
+    }
+
+    return 0;
+}
+
+std::string TrackExporter::toUTF8(const std::wstring& sPath)
+{
+    // wchar_t is 16 bits and holds UTF-16 code units
+    // FMOD accepts UTF-8 strings
+
+#if _WIN32
+    char pathInUTF8[MAX_PATH];
+    WideCharToMultiByte(CP_UTF8, 0, sPath.c_str(), -1, pathInUTF8, sizeof(pathInUTF8), nullptr, nullptr);
+
+    return std::string(pathInUTF8);
+#else
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+
+    return utf8_conv.to_bytes(sPath);
+#endif
+}
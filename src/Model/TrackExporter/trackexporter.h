@@ -0,0 +1,128 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <string>
+#include <vector>
+#include <atomic>
+
+
+
+
+
+namespace FMOD
+{
+    class System;
+    class DSP;
+}
+
+
+
+
+
+// Settings of the master DSP chain at the moment of the export (see AudioService::getExportSettings()).
+
+struct ExportSettings
+{
+    ExportSettings()
+    {
+        fPitch        = 1.0f;
+        fSpeedByPitch = 1.0f;
+        fSpeedByTime  = 1.0f;
+        fReverbVolume = -80.0f;
+        fEchoVolume   = -80.0f;
+        fPan          = 0.0f;
+    }
+
+    float  fPitch;
+    float  fSpeedByPitch;
+    float  fSpeedByTime;
+    // dB, -80 - off.
+    float  fReverbVolume;
+    float  fEchoVolume;
+    float  fPan;
+    // Gain of every band of the equalizer in dB (empty - flat).
+    std::vector<float> vEqualizerGains;
+    // Impulse response of the convolution reverb (empty - the SFX reverb is used).
+    std::wstring       sImpulseResponsePath;
+};
+
+
+// One track to export.
+
+struct ExportJob
+{
+    ExportJob()
+    {
+        iFromMS = 0;
+        iToMS   = 0;
+        fGain   = 1.0f;
+    }
+
+    std::wstring  sFilePath;
+    std::wstring  sOutputPath;
+    // 'iToMS' == 0 - until the end of the track.
+    unsigned int  iFromMS;
+    unsigned int  iToMS;
+    // Loudness normalization gain.
+    float         fGain;
+};
+
+
+
+
+
+// Renders the track through the same master DSP chain as AudioService::FMODinit() builds
+// into a wav file. The system uses the non-realtime wav writer, so the track is mixed as fast as the CPU allows.
+// Every exporter has its own FMOD system (one exporter per thread).
+
+class TrackExporter
+{
+
+public:
+
+    TrackExporter(const ExportSettings& settings);
+
+
+
+
+
+    // Main functions
+
+        // 'pContinue' - export stops (and the output file is not finished) when it becomes 'false'.
+        bool                 exportTrack            (const ExportJob& job,  const std::atomic<bool>* pContinue,  std::string* pErrorString);
+
+
+
+
+
+private:
+
+    // Used in exportTrack()
+
+        bool                 createMasterChain      (FMOD::System* pSystem,  std::string* pErrorString);
+        void                 releaseMasterChain     (FMOD::System* pSystem);
+        unsigned int         getTailInMS            () const;
+        static std::string   toUTF8                 (const std::wstring& sPath);
+
+
+
+
+    ExportSettings    settings;
+
+
+    // Master chain of the current export (FMOD does not release the DSPs with the system).
+    FMOD::DSP*        pPitch;
+    FMOD::DSP*        pTimeStretch;
+    FMOD::DSP*        pReverb;
+    FMOD::DSP*        pEcho;
+    FMOD::DSP*        pEqualizer;
+    FMOD::DSP*        pConvolutionReverb;
+    unsigned int      iImpulseResponseLengthInMS;
+};
@@ -0,0 +1,89 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "trackhistory.h"
+
+TrackHistory::TrackHistory(size_t iCapacity)
+{
+    vRing .resize(iCapacity);
+
+    iFirst = 0;
+    iSize  = 0;
+}
+
+
+
+
+
+void TrackHistory::push(TrackHandle track)
+{
+    if (vRing.empty())
+    {
+        return;
+    }
+
+    if (iSize == vRing.size())
+    {
+        // Overwrite the oldest track.
+
+        vRing[iFirst] = track;
+        iFirst        = (iFirst + 1) % vRing.size();
+    }
+    else
+    {
+        vRing[(iFirst + iSize) % vRing.size()] = track;
+        iSize++;
+    }
+}
+
+void TrackHistory::popBack()
+{
+    if (iSize > 0)
+    {
+        iSize--;
+    }
+}
+
+void TrackHistory::removeTrack(TrackHandle track)
+{
+    // The track is deleted, remove all its entries (keeping the order of the others).
+    // O(capacity), the capacity is small (see MAX_HISTORY_SIZE).
+
+    size_t iNewSize = 0;
+
+    for (size_t i = 0; i < iSize; i++)
+    {
+        TrackHandle entry = vRing[(iFirst + i) % vRing.size()];
+
+        if (entry != track)
+        {
+            vRing[(iFirst + iNewSize) % vRing.size()] = entry;
+            iNewSize++;
+        }
+    }
+
+    iSize = iNewSize;
+}
+
+void TrackHistory::clear()
+{
+    iFirst = 0;
+    iSize  = 0;
+}
+
+TrackHandle TrackHistory::getFromBack(size_t iOffset)
+{
+    if (iOffset >= iSize)
+    {
+        return TrackHandle();
+    }
+
+    return vRing[(iFirst + iSize - 1 - iOffset) % vRing.size()];
+}
+
+size_t TrackHistory::getSize()
+{
+    return iSize;
+}
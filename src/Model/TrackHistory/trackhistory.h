@@ -0,0 +1,56 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <cstddef>
+
+// Custom
+#include "Model/TrackStore/trackstore.h"
+
+
+
+
+// Last played tracks (used by the 'previous track' button).
+// Fixed-size ring buffer: when it's full the oldest track is overwritten, so push() never moves elements.
+// Not thread-safe (used under AudioService::mtxTracksVec).
+
+class TrackHistory
+{
+
+public:
+
+    TrackHistory(size_t iCapacity);
+
+
+
+
+
+        void         push         (TrackHandle track);
+        void         popBack      ();
+        void         removeTrack  (TrackHandle track);
+        void         clear        ();
+
+
+        // 0 - last pushed track.
+        TrackHandle  getFromBack  (size_t iOffset);
+        size_t       getSize      ();
+
+
+
+
+
+private:
+
+    std::vector<TrackHandle> vRing;
+
+    // Index of the oldest track in 'vRing'.
+    size_t                   iFirst;
+    size_t                   iSize;
+};
@@ -0,0 +1,357 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "trackloudness.h"
+
+// STL
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+// Custom
+#include "Model/CacheFolder/cachefolder.h"
+#include "Model/LoudnessMeter/loudnessmeter.h"
+#include "globalparams.h"
+#include "../ext/FMOD/inc/fmod.hpp"
+
+// Other
+#if _WIN32
+#include <windows.h>
+#else
+#include <locale>
+#include <codecvt>
+#endif
+
+TrackLoudness::TrackLoudness()
+{
+    fIntegratedLoudness = LOUDNESS_ABSOLUTE_GATE_LUFS;
+    fTruePeak           = 0.0f;
+    iGatedBlockCount    = 0;
+
+    bAnalyzed           = false;
+}
+
+
+
+
+
+bool TrackLoudness::analyze(FMOD::System* pSystem, const std::wstring& sFilePath, const std::atomic<bool>* pContinue)
+{
+    // This function loads the loudness from the cache
+    // or (if there is no valid cache for this file) decodes the file and saves the result to the cache.
+    // 'pContinue' - analysis stops when it becomes 'false'.
+
+    long long iFileSize         = 0;
+    long long iModificationTime = 0;
+
+    if ( CacheFolder::getFileInfo(sFilePath, &iFileSize, &iModificationTime) == false )
+    {
+        return false;
+    }
+
+    std::wstring sCacheFilePath = CacheFolder::getCacheFilePath(sFilePath, LOUDNESS_CACHE_FOLDER, LOUDNESS_CACHE_EXTENSION);
+
+    if ( (sCacheFilePath.empty() == false) && loadFromCache(sCacheFilePath, iFileSize, iModificationTime) )
+    {
+        bAnalyzed = true;
+        return true;
+    }
+
+
+    if ( measure(pSystem, sFilePath, pContinue) == false )
+    {
+        return false;
+    }
+
+
+    if (sCacheFilePath.empty() == false)
+    {
+        saveToCache(sCacheFilePath, iFileSize, iModificationTime);
+    }
+
+    bAnalyzed = true;
+
+    return true;
+}
+
+bool TrackLoudness::isAnalyzed() const
+{
+    return bAnalyzed;
+}
+
+float TrackLoudness::getIntegratedLoudness() const
+{
+    return fIntegratedLoudness;
+}
+
+float TrackLoudness::getTruePeak() const
+{
+    return fTruePeak;
+}
+
+unsigned int TrackLoudness::getGatedBlockCount() const
+{
+    return iGatedBlockCount;
+}
+
+float TrackLoudness::getGain() const
+{
+    if ( (bAnalyzed == false) || (iGatedBlockCount == 0) )
+    {
+        // Not analyzed or silent.
+        return 1.0f;
+    }
+
+    float fGainInDB = LOUDNESS_TARGET_LUFS - fIntegratedLoudness;
+
+    if (fGainInDB > LOUDNESS_MAX_GAIN_DB)
+    {
+        fGainInDB = LOUDNESS_MAX_GAIN_DB;
+    }
+
+    float fGain = std::pow(10.0f, fGainInDB / 20.0f);
+
+    if ( (fTruePeak > 0.0f) && (fGain * fTruePeak > 1.0f) )
+    {
+        // Don't clip.
+        fGain = 1.0f / fTruePeak;
+    }
+
+    return fGain;
+}
+
+TrackLoudness TrackLoudness::getAlbumLoudness(const std::vector<TrackLoudness>& vAlbumTracks)
+{
+    // The relative gate of every track was applied separately, so this is the approximation
+    // of the album measured as one file (exact if the tracks have similar loudness).
+
+    TrackLoudness album;
+
+    double dEnergySum = 0.0;
+    double dBlockSum  = 0.0;
+
+    for (size_t i = 0; i < vAlbumTracks.size(); i++)
+    {
+        if (vAlbumTracks[i].isAnalyzed() == false)
+        {
+            continue;
+        }
+
+        album.bAnalyzed = true;
+
+        if (vAlbumTracks[i].fTruePeak > album.fTruePeak)
+        {
+            album.fTruePeak = vAlbumTracks[i].fTruePeak;
+        }
+
+        double dEnergy = std::pow(10.0, (vAlbumTracks[i].fIntegratedLoudness + 0.691) / 10.0);
+
+        dEnergySum += dEnergy * vAlbumTracks[i].iGatedBlockCount;
+        dBlockSum  += vAlbumTracks[i].iGatedBlockCount;
+    }
+
+    if (dBlockSum > 0.0)
+    {
+        album.fIntegratedLoudness = static_cast<float>( -0.691 + 10.0 * std::log10(dEnergySum / dBlockSum) );
+        album.iGatedBlockCount    = static_cast<unsigned int>(dBlockSum);
+    }
+
+    return album;
+}
+
+bool TrackLoudness::measure(FMOD::System* pSystem, const std::wstring& sFilePath, const std::atomic<bool>* pContinue)
+{
+    // This function decodes the whole file with Sound::readData() (in the calling thread).
+
+#if _WIN32
+    char filePathInUTF8[MAX_PATH];
+    WideCharToMultiByte(CP_UTF8, 0, sFilePath.c_str(), -1, filePathInUTF8, sizeof(filePathInUTF8), nullptr, nullptr);
+#else
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+    auto out = utf8_conv.to_bytes(sFilePath);
+#endif
+
+    FMOD::Sound* pSound = nullptr;
+
+    FMOD_RESULT result;
+#if _WIN32
+    result = pSystem->createSound(filePathInUTF8, FMOD_OPENONLY | FMOD_LOOP_OFF, nullptr, &pSound);
+#else
+    result = pSystem->createSound(out.c_str(), FMOD_OPENONLY | FMOD_LOOP_OFF, nullptr, &pSound);
+#endif
+    if (result)
+    {
+        return false;
+    }
+
+
+    FMOD_SOUND_FORMAT format;
+    int               iChannels       = 0;
+    int               iBits           = 0;
+    float             fSampleRate     = 0.0f;
+
+    pSound->getFormat(nullptr, &format, &iChannels, &iBits);
+    pSound->getDefaults(&fSampleRate, nullptr);
+
+    int iBytesPerSample = iBits / 8;
+
+    if ( (iChannels <= 0) || (fSampleRate <= 0.0f)
+         || ( (format != FMOD_SOUND_FORMAT_PCM8) && (format != FMOD_SOUND_FORMAT_PCM16) && (format != FMOD_SOUND_FORMAT_PCM24)
+              && (format != FMOD_SOUND_FORMAT_PCM32) && (format != FMOD_SOUND_FORMAT_PCMFLOAT) ) )
+    {
+        pSound->release();
+        return false;
+    }
+
+
+    LoudnessMeter meter(iChannels, fSampleRate);
+
+    unsigned int iFrameSizeInBytes = static_cast<unsigned int>(iBytesPerSample * iChannels);
+    unsigned int iBufferSize       = (LOUDNESS_READ_BUFFER_SIZE_IN_BYTES / iFrameSizeInBytes) * iFrameSizeInBytes;
+
+    std::vector<char>  vBuffer  (iBufferSize);
+    std::vector<float> vSamples (iBufferSize / iBytesPerSample);
+
+    bool bStopped = false;
+
+    while (true)
+    {
+        if (pContinue && (pContinue->load() == false))
+        {
+            bStopped = true;
+            break;
+        }
+
+        unsigned int iReadBytes = 0;
+
+        result = pSound->readData(vBuffer.data(), iBufferSize, &iReadBytes);
+
+        size_t iSampleCount = iReadBytes / iBytesPerSample;
+
+        const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(vBuffer.data());
+
+        for (size_t i = 0; i < iSampleCount; i++)
+        {
+            const unsigned char* pSample = pBytes + i * iBytesPerSample;
+
+            switch (format)
+            {
+            case FMOD_SOUND_FORMAT_PCM8:
+                vSamples[i] = (static_cast<int>(pSample[0]) - 128) / 128.0f;
+                break;
+            case FMOD_SOUND_FORMAT_PCM16:
+                vSamples[i] = static_cast<int16_t>( pSample[0] | (pSample[1] << 8) ) / 32768.0f;
+                break;
+            case FMOD_SOUND_FORMAT_PCM24:
+                vSamples[i] = static_cast<int32_t>( (pSample[0] << 8) | (pSample[1] << 16) | (static_cast<uint32_t>(pSample[2]) << 24) ) / 2147483648.0f;
+                break;
+            case FMOD_SOUND_FORMAT_PCM32:
+                vSamples[i] = static_cast<int32_t>( pSample[0] | (pSample[1] << 8) | (pSample[2] << 16) | (static_cast<uint32_t>(pSample[3]) << 24) ) / 2147483648.0f;
+                break;
+            default:
+                std::memcpy(&vSamples[i], pSample, sizeof(float));
+                break;
+            }
+        }
+
+        meter.addFrames(vSamples.data(), iSampleCount / iChannels);
+
+        if ( result || (iReadBytes < iBufferSize) )
+        {
+            // FMOD_ERR_FILE_EOF or the last part.
+            break;
+        }
+    }
+
+    pSound->release();
+
+    if (bStopped)
+    {
+        return false;
+    }
+
+
+    fIntegratedLoudness = meter.getIntegratedLoudness(&iGatedBlockCount);
+    fTruePeak           = meter.getTruePeak();
+
+    return true;
+}
+
+bool TrackLoudness::loadFromCache(const std::wstring& sCacheFilePath, long long iFileSize, long long iModificationTime)
+{
+#if _WIN32
+    std::ifstream cacheFile(sCacheFilePath, std::ios::binary);
+#else
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+    auto out = utf8_conv.to_bytes(sCacheFilePath);
+
+    std::ifstream cacheFile(out, std::ios::binary);
+#endif
+
+    if (cacheFile.is_open() == false)
+    {
+        return false;
+    }
+
+    char         vMagic[4];
+    int          iVersion            = 0;
+    long long    iCachedFileSize     = 0;
+    long long    iCachedModification = 0;
+
+    cacheFile.read(vMagic,                                        sizeof(vMagic));
+    cacheFile.read(reinterpret_cast<char*>(&iVersion),            sizeof(iVersion));
+    cacheFile.read(reinterpret_cast<char*>(&iCachedFileSize),     sizeof(iCachedFileSize));
+    cacheFile.read(reinterpret_cast<char*>(&iCachedModification), sizeof(iCachedModification));
+    cacheFile.read(reinterpret_cast<char*>(&fIntegratedLoudness), sizeof(fIntegratedLoudness));
+    cacheFile.read(reinterpret_cast<char*>(&fTruePeak),           sizeof(fTruePeak));
+    cacheFile.read(reinterpret_cast<char*>(&iGatedBlockCount),    sizeof(iGatedBlockCount));
+
+    if ( (cacheFile.good() == false)
+         || (memcmp(vMagic, "BPLN", 4) != 0)
+         || (iVersion != LOUDNESS_CACHE_VERSION)
+         || (iCachedFileSize != iFileSize)
+         || (iCachedModification != iModificationTime)
+         || (std::isfinite(fIntegratedLoudness) == false)
+         || (std::isfinite(fTruePeak) == false) )
+    {
+        // The file was changed (or the cache is from the other version).
+        fIntegratedLoudness = LOUDNESS_ABSOLUTE_GATE_LUFS;
+        fTruePeak           = 0.0f;
+        iGatedBlockCount    = 0;
+
+        return false;
+    }
+
+    return true;
+}
+
+void TrackLoudness::saveToCache(const std::wstring& sCacheFilePath, long long iFileSize, long long iModificationTime)
+{
+#if _WIN32
+    std::ofstream cacheFile(sCacheFilePath, std::ios::binary);
+#else
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> utf8_conv;
+    auto out = utf8_conv.to_bytes(sCacheFilePath);
+
+    std::ofstream cacheFile(out, std::ios::binary);
+#endif
+
+    if (cacheFile.is_open() == false)
+    {
+        // Not critical, we will just analyze the track again next time.
+        return;
+    }
+
+    int iVersion = LOUDNESS_CACHE_VERSION;
+
+    cacheFile.write("BPLN",                                          4);
+    cacheFile.write(reinterpret_cast<char*>(&iVersion),              sizeof(iVersion));
+    cacheFile.write(reinterpret_cast<char*>(&iFileSize),             sizeof(iFileSize));
+    cacheFile.write(reinterpret_cast<char*>(&iModificationTime),     sizeof(iModificationTime));
+    cacheFile.write(reinterpret_cast<char*>(&fIntegratedLoudness),   sizeof(fIntegratedLoudness));
+    cacheFile.write(reinterpret_cast<char*>(&fTruePeak),             sizeof(fTruePeak));
+    cacheFile.write(reinterpret_cast<char*>(&iGatedBlockCount),      sizeof(iGatedBlockCount));
+}
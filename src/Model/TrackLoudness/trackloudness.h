@@ -0,0 +1,89 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <string>
+#include <vector>
+#include <atomic>
+
+
+
+
+
+namespace FMOD
+{
+    class System;
+}
+
+
+
+
+
+// Integrated loudness and true peak of the track (see LoudnessMeter).
+// The whole file is decoded once in the background (see AudioService::threadAnalyzeLoudness())
+// and the result is saved to the cache folder, so next time we only read it from the disk.
+
+class TrackLoudness
+{
+
+public:
+
+    TrackLoudness();
+
+
+
+
+
+    // Main functions
+
+        bool                 analyze                (FMOD::System* pSystem,  const std::wstring& sFilePath,  const std::atomic<bool>* pContinue);
+
+
+    // 'Get' functions
+
+        bool                 isAnalyzed             () const;
+        float                getIntegratedLoudness  () const;
+        float                getTruePeak            () const;
+        unsigned int         getGatedBlockCount     () const;
+
+
+    // Gain
+
+        // Linear gain that brings the loudness to LOUDNESS_TARGET_LUFS without clipping the true peak.
+        float                getGain                () const;
+        // Album loudness is the mean energy of the gated blocks of all tracks, album peak is the max peak.
+        static TrackLoudness getAlbumLoudness       (const std::vector<TrackLoudness>& vAlbumTracks);
+
+
+
+
+
+private:
+
+    // Used in analyze()
+
+        bool                 measure                (FMOD::System* pSystem,  const std::wstring& sFilePath,  const std::atomic<bool>* pContinue);
+        bool                 loadFromCache          (const std::wstring& sCacheFilePath,  long long iFileSize,  long long iModificationTime);
+        void                 saveToCache            (const std::wstring& sCacheFilePath,  long long iFileSize,  long long iModificationTime);
+
+
+
+
+
+
+    // LUFS
+    float         fIntegratedLoudness;
+    // Linear, 1.0 - full scale.
+    float         fTruePeak;
+    // Number of 400 ms blocks that passed the gates (weight of the track in the album).
+    unsigned int  iGatedBlockCount;
+
+
+    bool          bAnalyzed;
+};
@@ -0,0 +1,226 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "trackstore.h"
+
+TrackStore::TrackStore()
+{
+    iFirstOrderKey = 0;
+}
+
+
+
+
+
+TrackHandle TrackStore::add(Track* pTrack)
+{
+    // Adds the track to the end of the tracklist.
+
+    unsigned int iSlot = 0;
+
+    if (vFreeSlots.empty())
+    {
+        TrackSlot slot;
+        slot.pTrack      = nullptr;
+        slot.iGeneration = 1;
+        slot.iOrderKey   = 0;
+
+        iSlot = static_cast<unsigned int>(vSlots.size());
+        vSlots.push_back(slot);
+    }
+    else
+    {
+        iSlot = vFreeSlots.back();
+        vFreeSlots.pop_back();
+    }
+
+    vSlots[iSlot].pTrack    = pTrack;
+    vSlots[iSlot].iOrderKey = iFirstOrderKey + static_cast<long long>(playOrder.size());
+
+    playOrder.push_back(iSlot);
+
+
+    TrackHandle handle;
+    handle.iSlot       = iSlot;
+    handle.iGeneration = vSlots[iSlot].iGeneration;
+
+    return handle;
+}
+
+Track* TrackStore::remove(size_t iIndex)
+{
+    // Returns the removed track (the caller should delete it).
+
+    if (iIndex >= playOrder.size())
+    {
+        return nullptr;
+    }
+
+    unsigned int iSlot  = playOrder[iIndex];
+    Track*       pTrack = vSlots[iSlot].pTrack;
+
+    if (iIndex < playOrder.size() / 2)
+    {
+        // Tracks before it keep their index with the new 'iFirstOrderKey'.
+
+        for (size_t i = 0; i < iIndex; i++)
+        {
+            vSlots[ playOrder[i] ].iOrderKey++;
+        }
+
+        iFirstOrderKey++;
+    }
+    else
+    {
+        for (size_t i = iIndex + 1; i < playOrder.size(); i++)
+        {
+            vSlots[ playOrder[i] ].iOrderKey--;
+        }
+    }
+
+    playOrder.erase(playOrder.begin() + static_cast<long long>(iIndex));
+
+    freeSlot(iSlot);
+
+    return pTrack;
+}
+
+void TrackStore::moveUp(size_t iIndex)
+{
+    // The first track goes to the end of the tracklist.
+
+    if (iIndex >= playOrder.size())
+    {
+        return;
+    }
+
+    if (iIndex == 0)
+    {
+        unsigned int iSlot = playOrder.front();
+
+        playOrder.pop_front();
+        iFirstOrderKey++;
+
+        vSlots[iSlot].iOrderKey = iFirstOrderKey + static_cast<long long>(playOrder.size());
+        playOrder.push_back(iSlot);
+    }
+    else
+    {
+        unsigned int iSlot     = playOrder[iIndex];
+        unsigned int iPrevSlot = playOrder[iIndex - 1];
+
+        playOrder[iIndex - 1] = iSlot;
+        playOrder[iIndex]     = iPrevSlot;
+
+        vSlots[iSlot]    .iOrderKey--;
+        vSlots[iPrevSlot].iOrderKey++;
+    }
+}
+
+void TrackStore::moveDown(size_t iIndex)
+{
+    // The last track goes to the beginning of the tracklist.
+
+    if (iIndex >= playOrder.size())
+    {
+        return;
+    }
+
+    if (iIndex == playOrder.size() - 1)
+    {
+        unsigned int iSlot = playOrder.back();
+
+        playOrder.pop_back();
+        iFirstOrderKey--;
+
+        vSlots[iSlot].iOrderKey = iFirstOrderKey;
+        playOrder.push_front(iSlot);
+    }
+    else
+    {
+        unsigned int iSlot     = playOrder[iIndex];
+        unsigned int iNextSlot = playOrder[iIndex + 1];
+
+        playOrder[iIndex + 1] = iSlot;
+        playOrder[iIndex]     = iNextSlot;
+
+        vSlots[iSlot]    .iOrderKey++;
+        vSlots[iNextSlot].iOrderKey--;
+    }
+}
+
+void TrackStore::clear()
+{
+    // Tracks are not deleted here.
+
+    for (size_t i = 0; i < playOrder.size(); i++)
+    {
+        freeSlot(playOrder[i]);
+    }
+
+    playOrder.clear();
+    iFirstOrderKey = 0;
+}
+
+Track* TrackStore::get(TrackHandle handle)
+{
+    // Returns nullptr if the track was removed.
+
+    if ( (handle.iSlot >= vSlots.size()) || (handle.iGeneration == 0) || (vSlots[handle.iSlot].iGeneration != handle.iGeneration) )
+    {
+        return nullptr;
+    }
+
+    return vSlots[handle.iSlot].pTrack;
+}
+
+bool TrackStore::getIndex(TrackHandle handle, size_t* pIndex)
+{
+    if (get(handle) == nullptr)
+    {
+        return false;
+    }
+
+    *pIndex = static_cast<size_t>(vSlots[handle.iSlot].iOrderKey - iFirstOrderKey);
+
+    return true;
+}
+
+Track* TrackStore::getTrack(size_t iIndex)
+{
+    return vSlots[ playOrder[iIndex] ].pTrack;
+}
+
+TrackHandle TrackStore::getHandle(size_t iIndex)
+{
+    TrackHandle handle;
+
+    if (iIndex < playOrder.size())
+    {
+        handle.iSlot       = playOrder[iIndex];
+        handle.iGeneration = vSlots[handle.iSlot].iGeneration;
+    }
+
+    return handle;
+}
+
+size_t TrackStore::size()
+{
+    return playOrder.size();
+}
+
+void TrackStore::freeSlot(unsigned int iSlot)
+{
+    vSlots[iSlot].pTrack = nullptr;
+    vSlots[iSlot].iGeneration++;
+
+    if (vSlots[iSlot].iGeneration == 0)
+    {
+        // 0 is the invalid handle.
+        vSlots[iSlot].iGeneration = 1;
+    }
+
+    vFreeSlots.push_back(iSlot);
+}
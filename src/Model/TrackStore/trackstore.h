@@ -0,0 +1,104 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+
+// STL
+#include <vector>
+#include <deque>
+#include <cstddef>
+
+
+class Track;
+
+
+
+
+// Stable reference to a track in the TrackStore.
+// The slot of a removed track gets a new generation so old handles to it are never resolved to another track.
+
+struct TrackHandle
+{
+    unsigned int iSlot       = 0;
+    // 0 - invalid handle.
+    unsigned int iGeneration = 0;
+
+    bool operator== (const TrackHandle& other) const { return (iSlot == other.iSlot) && (iGeneration == other.iGeneration); }
+    bool operator!= (const TrackHandle& other) const { return (*this == other) == false; }
+};
+
+
+
+
+// Tracks of the tracklist: slot map (track by handle) + play order (track by its index in the tracklist).
+// Tracks never move between slots, so reorders and removals don't invalidate the handles
+// of the playing/drawing/scheduled tracks.
+// Every slot stores its order key, the index of the track is (order key - 'iFirstOrderKey'),
+// so moving the first track to the end (and the last to the beginning) is O(1) and
+// removal renumbers only the shorter side of the play order.
+// Not thread-safe (used under AudioService::mtxTracksVec).
+
+class TrackStore
+{
+
+public:
+
+    TrackStore();
+
+
+
+
+
+    // Tracklist changes
+
+        TrackHandle  add          (Track* pTrack);
+        Track*       remove       (size_t iIndex);
+        void         moveUp       (size_t iIndex);
+        void         moveDown     (size_t iIndex);
+        void         clear        ();
+
+
+    // By handle
+
+        Track*       get          (TrackHandle handle);
+        bool         getIndex     (TrackHandle handle,  size_t* pIndex);
+
+
+    // By index in the tracklist
+
+        Track*       getTrack     (size_t iIndex);
+        TrackHandle  getHandle    (size_t iIndex);
+        size_t       size         ();
+
+
+
+
+
+private:
+
+    struct TrackSlot
+    {
+        Track*       pTrack;
+        unsigned int iGeneration;
+        long long    iOrderKey;
+    };
+
+
+    // Used in remove() and clear()
+
+        void         freeSlot     (unsigned int iSlot);
+
+
+
+
+    std::vector<TrackSlot>     vSlots;
+    std::vector<unsigned int>  vFreeSlots;
+
+    // Slots in the tracklist order.
+    std::deque<unsigned int>   playOrder;
+    long long                  iFirstOrderKey;
+};
@@ -8,7 +8,13 @@
 
 #include <QCloseEvent>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
+#include <QSlider>
+#include <QLabel>
+#include <QComboBox>
+
+#include "globalparams.h"
 
 #if _WIN32
 using std::memcpy;
@@ -26,7 +32,92 @@ FXWindow::FXWindow(QWidget *parent) :
     flags &= ~Qt::WindowMinimizeButtonHint;
     setWindowFlags(flags);
 
+
+    // Equalizer: gain label, vertical slider and frequency label for every band
+
+    float vBandFrequencies[] = EQ_BAND_FREQUENCIES;
+
+    for (int i = 0; i < EQ_BAND_COUNT; i++)
+    {
+        QLabel* pGainLabel = new QLabel("0 dB", this);
+        pGainLabel->setFont(ui->label_pan->font());
+        pGainLabel->setStyleSheet(ui->label_pan->styleSheet());
+        pGainLabel->setAlignment(Qt::AlignCenter);
+
+        QSlider* pSlider = new QSlider(Qt::Vertical, this);
+        pSlider->setStyleSheet(ui->horizontalSlider_pan->styleSheet());
+        pSlider->setRange(static_cast<int>(EQ_MIN_GAIN_DB), static_cast<int>(EQ_MAX_GAIN_DB));
+        pSlider->setValue(0);
+
+        QString sFrequency;
+        if (vBandFrequencies[i] < 1000.0f)
+        {
+            sFrequency = QString::number(static_cast<double>(vBandFrequencies[i]), 'f', 0) + " Hz";
+        }
+        else
+        {
+            sFrequency = QString::number(static_cast<double>(vBandFrequencies[i]) / 1000.0, 'f', 0) + " kHz";
+        }
+
+        QLabel* pFrequencyLabel = new QLabel(sFrequency, this);
+        pFrequencyLabel->setFont(ui->label_pan->font());
+        pFrequencyLabel->setStyleSheet(ui->label_pan->styleSheet());
+        pFrequencyLabel->setAlignment(Qt::AlignCenter);
+
+        QVBoxLayout* pBandLayout = new QVBoxLayout();
+        pBandLayout->addWidget(pGainLabel);
+        pBandLayout->addWidget(pSlider, 1, Qt::AlignHCenter);
+        pBandLayout->addWidget(pFrequencyLabel);
+
+        ui->horizontalLayout_equalizer->addLayout(pBandLayout);
+
+        connect(pSlider, &QSlider::valueChanged, this, [this, i, pGainLabel](int value)
+        {
+            pGainLabel->setText(QString::number(value) + " dB");
+
+            emit signalChangeEqualizerBandGain(i, static_cast<float>(value));
+        });
+
+        vEqualizerSliders.push_back(pSlider);
+    }
+
+
+    // FX profile: the combo box (same order as FX_PROFILE_...) and the measured latency / DSP usage under it
+
+    QLabel* pProfileLabel = new QLabel("Profile:", this);
+    pProfileLabel->setFont(ui->label_pan->font());
+    pProfileLabel->setStyleSheet(ui->label_pan->styleSheet());
+
+    pProfileComboBox = new QComboBox(this);
+    pProfileComboBox->setFont(ui->label_pan->font());
+    pProfileComboBox->addItems({"Live (low latency)", "Balanced", "Hi-quality", "Auto"});
+    pProfileComboBox->setCurrentIndex(DEFAULT_FX_PROFILE);
+
+    pProfileStatsLabel = new QLabel(this);
+    pProfileStatsLabel->setFont(ui->label_pan->font());
+    pProfileStatsLabel->setStyleSheet(ui->label_pan->styleSheet());
+
+    QHBoxLayout* pProfileLayout = new QHBoxLayout();
+    pProfileLayout->addStretch(30);
+    pProfileLayout->addWidget(pProfileLabel);
+    pProfileLayout->addWidget(pProfileComboBox, 40);
+    pProfileLayout->addStretch(30);
+
+    QVBoxLayout* pProfileBoxLayout = new QVBoxLayout();
+    pProfileBoxLayout->addLayout(pProfileLayout);
+    pProfileBoxLayout->addWidget(pProfileStatsLabel, 0, Qt::AlignHCenter);
+
+    // After the VST button.
+    ui->verticalLayout->insertLayout(5, pProfileBoxLayout, 10);
+
+    connect(pProfileComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, [this](int index)
+    {
+        emit signalChangeFXProfile(static_cast<char>(index));
+    });
+
+
     bVSTLoaded = false;
+    bImpulseResponseLoaded = false;
 }
 
 
@@ -160,6 +251,11 @@ void FXWindow::on_pushButton_reverb_clicked()
     ui->label_reverb->setText("Reverb wet volume: -80 dB");
 
     emit signalChangeReverbVolume(-80.0f);
+
+    if (bImpulseResponseLoaded)
+    {
+        on_pushButton_reverb_ir_clicked();
+    }
 }
 
 void FXWindow::on_horizontalSlider_reverb_valueChanged(int value)
@@ -169,6 +265,30 @@ void FXWindow::on_horizontalSlider_reverb_valueChanged(int value)
     emit signalChangeReverbVolume(static_cast<float>(value));
 }
 
+void FXWindow::on_pushButton_reverb_ir_clicked()
+{
+    // Loaded - the button unloads the response (back to the SFX reverb).
+
+    if (bImpulseResponseLoaded)
+    {
+        ui->pushButton_reverb_ir->setText("Load impulse response");
+        bImpulseResponseLoaded = false;
+
+        emit signalUnloadImpulseResponse();
+    }
+    else
+    {
+        QString pathToFile = QFileDialog::getOpenFileName(this, "Open file", "", "Impulse response (*.wav)");
+        if (pathToFile != "")
+        {
+            ui->pushButton_reverb_ir->setText(QFileInfo(pathToFile).fileName());
+            bImpulseResponseLoaded = true;
+
+            emit signalLoadImpulseResponse(pathToFile);
+        }
+    }
+}
+
 void FXWindow::on_horizontalSlider_delay_valueChanged(int value)
 {
     ui->label_delay->setText("Echo wet volume: " + QString::number(value) + " dB");
@@ -184,6 +304,15 @@ void FXWindow::on_pushButton_delay_clicked()
     emit signalChangeEchoVolume(-80.0f);
 }
 
+void FXWindow::on_pushButton_equalizer_clicked()
+{
+    // Only the moved sliders send the signal.
+    for (size_t i = 0; i < vEqualizerSliders.size(); i++)
+    {
+        vEqualizerSliders[i]->setValue(0);
+    }
+}
+
 void FXWindow::on_pushButton_vst_clicked()
 {
 #if _WIN32
@@ -228,6 +357,35 @@ void FXWindow::slotResetAll()
     on_pushButton_clicked();
 }
 
+void FXWindow::setFXProfileStats(const std::vector<FXProfileStats>& vStats, char cActiveProfile, bool bAuto)
+{
+    const char* vProfileNames[] = {"Live", "Balanced", "Hi-quality"};
+
+    QString sStats;
+
+    for (size_t i = 0; i < vStats.size(); i++)
+    {
+        sStats += QString("%1: %2 ms").arg(vProfileNames[i]).arg(static_cast<double>(vStats[i].fLatencyInMS), 0, 'f', 1);
+
+        if (vStats[i].bMeasured)
+        {
+            sStats += QString(", DSP %1%").arg(static_cast<double>(vStats[i].fDSPUsage), 0, 'f', 1);
+        }
+
+        if (bAuto && (static_cast<char>(i) == cActiveProfile))
+        {
+            sStats += " (active)";
+        }
+
+        if (i + 1 < vStats.size())
+        {
+            sStats += "    ";
+        }
+    }
+
+    pProfileStatsLabel->setText(sStats);
+}
+
 
 
 
@@ -240,6 +398,7 @@ void FXWindow::on_pushButton_clicked()
     if (ui->pushButton_speed_by_time->isEnabled()) on_pushButton_speed_by_time_clicked();
     on_pushButton_reverb_clicked();
     on_pushButton_delay_clicked();
+    on_pushButton_equalizer_clicked();
 }
 
 
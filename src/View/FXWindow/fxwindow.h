@@ -7,12 +7,19 @@
 
 #include <QMainWindow>
 
+#include <vector>
+
+#include "Model/FXProfileMonitor/fxprofilemonitor.h"
+
 namespace Ui
 {
     class FXWindow;
 }
 
 class QCloseEvent;
+class QSlider;
+class QComboBox;
+class QLabel;
 
 
 class FXWindow : public QMainWindow
@@ -27,6 +34,10 @@ signals:
     void signalChangeSpeedByTime  (float fSpeed);
     void signalChangeReverbVolume (float fVolume);
     void signalChangeEchoVolume   (float fEchoVolume);
+    void signalChangeEqualizerBandGain (int iBand, float fGainInDB);
+    void signalLoadImpulseResponse (QString path);
+    void signalUnloadImpulseResponse ();
+    void signalChangeFXProfile    (char cProfile);
     void signalOpenVST            (wchar_t* path);
     void signalShowVST            ();
 
@@ -41,6 +52,9 @@ public slots:
     void slotSetVSTName(QString name);
     void slotResetAll();
 
+    // 'vStats' - FX_PROFILE_COUNT profiles, 'cActiveProfile' - never FX_PROFILE_AUTO.
+    void setFXProfileStats(const std::vector<FXProfileStats>& vStats, char cActiveProfile, bool bAuto);
+
 protected:
 
     void closeEvent(QCloseEvent* ev);
@@ -66,11 +80,15 @@ private slots:
     // Reverb
     void on_pushButton_reverb_clicked();
     void on_horizontalSlider_reverb_valueChanged(int value);
+    void on_pushButton_reverb_ir_clicked();
 
     // Delay
     void on_pushButton_delay_clicked();
     void on_horizontalSlider_delay_valueChanged(int value);
 
+    // Equalizer
+    void on_pushButton_equalizer_clicked();
+
     // VST
     void on_pushButton_vst_clicked();
 
@@ -81,5 +99,13 @@ private:
 
     Ui::FXWindow *ui;
 
+    // One per band of the equalizer (created in the constructor).
+    std::vector<QSlider*> vEqualizerSliders;
+
+    // FX profile (created in the constructor).
+    QComboBox* pProfileComboBox;
+    QLabel*    pProfileStatsLabel;
+
     bool bVSTLoaded;
+    bool bImpulseResponseLoaded;
 };
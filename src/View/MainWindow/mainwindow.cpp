@@ -15,9 +15,11 @@
 #include <QHideEvent>
 #include <QVector>
 #include <QMouseEvent>
+#include <QTimer>
 
 // STL
 #include <cmath>
+#include <climits>
 #include <thread>
 
 // Custom
@@ -26,6 +28,7 @@
 #include "View/WaitWindow/waitwindow.h"
 #include "View/FXWindow/fxwindow.h"
 #include "View/VSTWindow/vstwindow.h"
+#include "View/SpectrumWidget/spectrumwidget.h"
 #include "View/AboutWindow/aboutwindow.h"
 #include "View/SearchWindow/searchwindow.h"
 #include "globalparams.h"
@@ -55,12 +58,15 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(pTrayIcon, &QSystemTrayIcon::activated, this, &MainWindow::slotShowWindow);
 
     iSelectedTrackIndex = -1;
+    pTrackInHeader      = nullptr;
     // Will be 'false' if something will go wrong.
     bSystemReady = true;
 
     qRegisterMetaType<std::string>("std::string");
     qRegisterMetaType<std::wstring>("std::wstring");
     qRegisterMetaType<size_t>("size_t");
+    qRegisterMetaType<std::vector<size_t>>("std::vector<size_t>");
+    qRegisterMetaType<std::vector<std::string>>("std::vector<std::string>");
 
     // This to this
     connect(this, &MainWindow::signalShowWaitWindow,      this, &MainWindow::slotShowWaitWindow);
@@ -73,13 +79,12 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(this, &MainWindow::signalClearGraph,          this, &MainWindow::slotClearGraph);
     connect(this, &MainWindow::signalSetXMaxToGraph,      this, &MainWindow::slotSetXMaxToGraph);
     connect(this, &MainWindow::signalAddDataToGraph,      this, &MainWindow::slotAddDataToGraph);
-    connect(this, &MainWindow::signalSetCurrentPos,       this, &MainWindow::slotSetCurrentPos);
 #if _WIN32
     connect(this, &MainWindow::signalHideVSTWindow,       this, &MainWindow::slotHideVSTWindow);
 #endif
     connect(this, &MainWindow::signalSetRepeatPoint,      this, &MainWindow::slotSetRepeatPoint);
     connect(this, &MainWindow::signalEraseRepeatSection,  this, &MainWindow::slotEraseRepeatSection);
-    connect(this, &MainWindow::signalSetTrackBitrate,     this, &MainWindow::slotSetTrackBitrate);
+    connect(this, &MainWindow::signalSetTracksBitrate,    this, &MainWindow::slotSetTracksBitrate);
     connect(this, &MainWindow::signalClearPlaylist,       this, &MainWindow::slotClearPlaylist);
 
     // Tracklist connect
@@ -171,6 +176,28 @@ MainWindow::MainWindow(QWidget *parent) :
     maxPosOnGraphForText = MAX_X_AXIS_VALUE * 97 / 100;
     maxPosOnGraphForText /= static_cast<double>(MAX_X_AXIS_VALUE);
 
+
+    // Playhead
+    dPlayheadX         = 0.0;
+    iPlayheadTimeInSec = UINT_MAX;
+
+    pPlayheadTimer = new QTimer(this);
+    pPlayheadTimer->setTimerType(Qt::PreciseTimer);
+    connect(pPlayheadTimer, &QTimer::timeout, this, &MainWindow::slotUpdatePlayhead);
+    pPlayheadTimer->start(PLAYHEAD_UPDATE_INTERVAL_MS);
+
+    // Meters
+    pSpectrumWidget = new SpectrumWidget(this);
+    pSpectrumWidget->setMinimumHeight(60);
+    ui->verticalLayout_4->addWidget(pSpectrumWidget);
+
+    meterClock.start();
+
+    pMeterTimer = new QTimer(this);
+    pMeterTimer->setTimerType(Qt::PreciseTimer);
+    connect(pMeterTimer, &QTimer::timeout, this, &MainWindow::slotUpdateMeters);
+    pMeterTimer->start(METER_UPDATE_INTERVAL_MS);
+
     // FXWindow
     pFXWindow = new FXWindow(this);
     pFXWindow->setWindowModality(Qt::WindowModality::WindowModal);
@@ -180,6 +207,10 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(pFXWindow, &FXWindow::signalChangeSpeedByTime,  this, &MainWindow::slotSetSpeedByTime);
     connect(pFXWindow, &FXWindow::signalChangeReverbVolume, this, &MainWindow::slotSetReverbVolume);
     connect(pFXWindow, &FXWindow::signalChangeEchoVolume,   this, &MainWindow::slotSetEchoVolume);
+    connect(pFXWindow, &FXWindow::signalChangeEqualizerBandGain, this, &MainWindow::slotSetEqualizerBandGain);
+    connect(pFXWindow, &FXWindow::signalLoadImpulseResponse,     this, &MainWindow::slotLoadImpulseResponse);
+    connect(pFXWindow, &FXWindow::signalUnloadImpulseResponse,   this, &MainWindow::slotUnloadImpulseResponse);
+    connect(pFXWindow, &FXWindow::signalChangeFXProfile,         this, &MainWindow::slotSetFXProfile);
 #if _WIN32
     connect(pFXWindow, &FXWindow::signalOpenVST,            this, &MainWindow::slotLoadVST);
     connect(pFXWindow, &FXWindow::signalShowVST,            this, &MainWindow::slotShowVST);
@@ -190,6 +221,11 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(this, &MainWindow::signalSetVSTName,            pFXWindow, &FXWindow::slotSetVSTName);
 #endif
 
+    // Latency and DSP usage of the FX profiles (shown in the FXWindow).
+    pFXProfileTimer = new QTimer(this);
+    connect(pFXProfileTimer, &QTimer::timeout, this, &MainWindow::slotUpdateFXProfileStats);
+    pFXProfileTimer->start(FX_PROFILE_STATS_INTERVAL_MS);
+
     pVSTWindow = nullptr;
 #if _WIN32
     // VSTWindow
@@ -273,9 +309,9 @@ void MainWindow::clearCurrentPlaylist()
     future.get();
 }
 
-void MainWindow::setTrackBitrate(size_t iNumber, std::string sBitrate)
+void MainWindow::setTracksBitrate(const std::vector<size_t>& vTrackIndexes, const std::vector<std::string>& vBitrates)
 {
-    emit signalSetTrackBitrate(iNumber, QString::fromStdString(sBitrate));
+    emit signalSetTracksBitrate(vTrackIndexes, vBitrates);
 }
 
 size_t MainWindow::getTracksCount()
@@ -344,11 +380,6 @@ void MainWindow::addDataToGraph(float* pData, unsigned int iSizeInSamples, unsig
     emit signalAddDataToGraph(pData, iSizeInSamples, iSamplesInOne);
 }
 
-void MainWindow::setCurrentPos(double x, std::string time)
-{
-    emit signalSetCurrentPos(x, time);
-}
-
 void MainWindow::setRepeatPoint(bool bFirstPoint, double x)
 {
     emit signalSetRepeatPoint(bFirstPoint, x);
@@ -553,16 +584,26 @@ void MainWindow::slotSetNumber(size_t iNumber)
     tracks[iNumber]->setNumber(iNumber+1);
 }
 
-void MainWindow::slotSetTrackBitrate(size_t iNumber, QString sBitrate)
+void MainWindow::slotSetTracksBitrate(std::vector<size_t> vTrackIndexes, std::vector<std::string> vBitrates)
 {
-    tracks[iNumber]->setBitrate(sBitrate);
+    for (size_t i = 0; i < vTrackIndexes.size(); i++)
+    {
+        // Some tracks could be removed while this signal was in the queue.
+        if (vTrackIndexes[i] < tracks.size())
+        {
+            tracks[ vTrackIndexes[i] ]->setBitrate( QString::fromStdString(vBitrates[i]) );
+        }
+    }
 }
 
 void MainWindow::slotUpdateTrackInfo(size_t iTrackIndex)
 {
     mtxAddTrackWidget .lock();
 
-    ui ->label_TrackInfo ->setText( tracks[iTrackIndex] ->trackInfo );
+    if ( (iTrackIndex < tracks.size()) && (tracks[iTrackIndex] == pTrackInHeader) )
+    {
+        ui ->label_TrackInfo ->setText( tracks[iTrackIndex] ->trackInfo );
+    }
 
     mtxAddTrackWidget .unlock();
 }
@@ -581,6 +622,7 @@ void MainWindow::slotClearPlaylist(std::promise<bool>* pPromiseResult)
 
         ui->label_TrackName->setText( "Track Name" );
         ui->label_TrackInfo->setText( "Track Info" );
+        pTrackInHeader = nullptr;
 
         slotClearGraph();
 
@@ -662,6 +704,9 @@ void MainWindow::slotClearGraph(bool stopTrack)
     pGraphTextTrackTime->setText("");
     backgnd->bottomRight->setCoords(0, 1);
 
+    dPlayheadX         = 0.0;
+    iPlayheadTimeInSec = UINT_MAX;
+
     if (stopTrack == false)
     {
         iCurrentXPosOnGraph = 0;
@@ -781,10 +826,48 @@ void MainWindow::slotAddDataToGraph(float* pData, unsigned int iSizeInSamples, u
     delete[] pData;
 }
 
-void MainWindow::slotSetCurrentPos(double x, std::string time)
+void MainWindow::slotUpdatePlayhead()
 {
+    // Called at the display refresh rate (see PLAYHEAD_UPDATE_INTERVAL_MS).
+    // The audio-control thread publishes the position a few times per second, here we extrapolate it
+    // so the playhead moves smoothly. Reading the position does not lock anything.
+
+    PlaybackPosition position;
+
+    if ( (pController->getPlaybackPosition(&position) == false) || (position.iLengthInPCM == 0) || (position.fSampleRate <= 0.0f) )
+    {
+        // Nothing is playing (the graph is cleared in slotClearGraph()).
+        return;
+    }
+
+    unsigned int iPosInPCM  = PositionSnapshot::extrapolate(position, PositionSnapshot::getTimeInNS());
+    double       x          = static_cast<double>(iPosInPCM) / position.iLengthInPCM;
+    unsigned int iTimeInSec = (iPosInPCM == 0) ? UINT_MAX : static_cast<unsigned int>(iPosInPCM / position.fSampleRate);
+
+    if ( (x == dPlayheadX) && (iTimeInSec == iPlayheadTimeInSec) )
+    {
+        // Paused.
+        return;
+    }
+
     backgnd->bottomRight->setCoords(x, 1);
-    pGraphTextTrackTime->setText(QString::fromStdString(time));
+    dPlayheadX = x;
+
+    if (iTimeInSec != iPlayheadTimeInSec)
+    {
+        // The text is changed only once per second.
+
+        if (iTimeInSec == UINT_MAX)
+        {
+            pGraphTextTrackTime->setText("");
+        }
+        else
+        {
+            pGraphTextTrackTime->setText( QString("%1:%2").arg(iTimeInSec / 60).arg(iTimeInSec % 60, 2, 10, QChar('0')) );
+        }
+
+        iPlayheadTimeInSec = iTimeInSec;
+    }
 
     if ( (x > (minPosOnGraphForText + 0.03)) && (x < maxPosOnGraphForText) )
     {
@@ -796,7 +879,30 @@ void MainWindow::slotSetCurrentPos(double x, std::string time)
         else if (x >= maxPosOnGraphForText) pGraphTextTrackTime->position->setCoords(maxPosOnGraphForText - 0.03, 0.5);
     }
 
-    ui->widget_graph->replot();
+    ui->widget_graph->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void MainWindow::slotUpdateMeters()
+{
+    // Called at the display refresh rate (see METER_UPDATE_INTERVAL_MS).
+    // Reading the frame is one atomic exchange (see MeterBuffer), it does not lock anything and never waits for the mixer.
+
+    qint64 iElapsedMS = meterClock.restart();
+
+    if (pController->getMeterFrame(&meterFrame))
+    {
+        pSpectrumWidget->setFrame(meterFrame, iElapsedMS);
+
+        if (meterFrame.iSequence % 64 == 0)
+        {
+            // GUI cost of the meters.
+            pSpectrumWidget->setToolTip( QString("Average paint time: %1 us").arg(pSpectrumWidget->getAveragePaintTimeInUS(), 0, 'f', 1) );
+        }
+    }
+    else
+    {
+        pSpectrumWidget->fall(iElapsedMS);
+    }
 }
 
 void MainWindow::slotSetRepeatPoint(bool bFirstPoint, double x)
@@ -870,6 +976,46 @@ void MainWindow::slotSetEchoVolume(float fEchoVolume)
     pController->setEchoVolume(fEchoVolume);
 }
 
+void MainWindow::slotSetFXProfile(char cProfile)
+{
+    pController->setFXProfile(cProfile);
+}
+
+void MainWindow::slotUpdateFXProfileStats()
+{
+    // The DSP usage is measured by the audio-control thread while the track is playing,
+    // in the auto mode the active profile can be changed there too.
+
+    if (pFXWindow->isVisible() == false)
+    {
+        return;
+    }
+
+    std::vector<FXProfileStats> vStats;
+
+    for (char i = 0; i < FX_PROFILE_COUNT; i++)
+    {
+        vStats.push_back( pController->getFXProfileStats(i) );
+    }
+
+    pFXWindow->setFXProfileStats(vStats, pController->getFXProfile(), pController->isFXProfileAuto());
+}
+
+void MainWindow::slotSetEqualizerBandGain(int iBand, float fGainInDB)
+{
+    pController->setEqualizerBandGain(iBand, fGainInDB);
+}
+
+void MainWindow::slotLoadImpulseResponse(QString sPath)
+{
+    pController->loadImpulseResponse(sPath.toStdWString());
+}
+
+void MainWindow::slotUnloadImpulseResponse()
+{
+    pController->unloadImpulseResponse();
+}
+
 #if _WIN32
 void MainWindow::slotLoadVST(wchar_t *pPath)
 {
@@ -903,11 +1049,13 @@ void MainWindow::slotSetTrack(size_t iTrackIndex, bool bClear)
     {
         ui->label_TrackName->setText( "Track Name" );
         ui->label_TrackInfo->setText( "Track Info" );
+        pTrackInHeader = nullptr;
     }
     else
     {
         ui->label_TrackName->setText( tracks[iTrackIndex]->trackName );
         ui->label_TrackInfo->setText( tracks[iTrackIndex]->trackInfo );
+        pTrackInHeader = tracks[iTrackIndex];
     }
 }
 
@@ -960,6 +1108,11 @@ void MainWindow::deleteSelectedTrack()
         // 'delete' below is causing a crash if the context menu is opened on TrackWidget
         // so we use 'deleteLater()'
         //delete tracks[iSelectedTrackIndex];
+        if (tracks[iSelectedTrackIndex] == pTrackInHeader)
+        {
+            pTrackInHeader = nullptr;
+        }
+
         tracks[iSelectedTrackIndex]->deleteLater();
         tracks.erase(tracks.begin() + iSelectedTrackIndex);
 
@@ -1099,6 +1252,7 @@ void MainWindow::on_pushButton_clearPlaylist_clicked()
 
         ui->label_TrackName->setText( "Track Name" );
         ui->label_TrackInfo->setText( "Track Info" );
+        pTrackInHeader = nullptr;
 
         slotClearGraph();
 
@@ -1171,6 +1325,8 @@ void MainWindow::on_actionOpen_2_triggered()
 
 MainWindow::~MainWindow()
 {
+    pPlayheadTimer->stop();
+
     mtxAddTrackWidget .lock();
     mtxAddTrackWidget .unlock();
 
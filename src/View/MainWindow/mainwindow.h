@@ -10,6 +10,7 @@
 
 // Qt
 #include <QMainWindow>
+#include <QElapsedTimer>
 
 // STL
 #include <string>
@@ -17,6 +18,9 @@
 #include <vector>
 #include <future>
 
+// Custom
+#include "Model/MeterBuffer/meterbuffer.h"
+
 
 
 class Controller;
@@ -24,12 +28,14 @@ class TrackWidget;
 class WaitWindow;
 class FXWindow;
 class VSTWindow;
+class SpectrumWidget;
 
 class QHideEvent;
 class QSystemTrayIcon;
 class QMouseEvent;
 class QCPItemText;
 class QCPItemRect;
+class QTimer;
 
 namespace Ui
 {
@@ -57,7 +63,6 @@ signals:
     // Oscillogram
 
         void     signalAddDataToGraph      (float* pData,  unsigned int iSizeInSamples,  unsigned int iSamplesInOne);
-        void     signalSetCurrentPos       (double x,          std::string time);
         void     signalSetRepeatPoint      (bool bFirstPoint, double x);
         void     signalEraseRepeatSection  ();
         void     signalClearGraph          (bool stopTrack = false);
@@ -81,7 +86,7 @@ signals:
         void     signalSetTrack            (size_t iTrackIndex,      bool bClear = false);
         void     signalShowMessageBox      (bool errorBox,           QString text);
         void     signalSetNumber           (size_t iNumber);
-        void     signalSetTrackBitrate     (size_t iNumber, QString sBitrate);
+        void     signalSetTracksBitrate    (std::vector<size_t> vTrackIndexes,  std::vector<std::string> vBitrates);
         void     signalClearPlaylist       (std::promise<bool>* pPromiseResult);
         void     signalResetAll            ();
 
@@ -114,7 +119,6 @@ public:
     // Oscillogram
 
         void     addDataToGraph            (float* pData,  unsigned int iSizeInSamples,  unsigned int iSamplesInOne);
-        void     setCurrentPos             (double x,          std::string time);
         void     setRepeatPoint            (bool bFirstPoint, double x);
         void     eraseRepeatSection        ();
         void     clearGraph                (bool stopTrack = false);
@@ -150,7 +154,7 @@ public:
         void     uncheckRandomTrackButton  ();
         void     uncheckRepeatTrackButton  ();
         void     clearCurrentPlaylist      ();
-        void     setTrackBitrate           (size_t iNumber, std::string sBitrate);
+        void     setTracksBitrate          (const std::vector<size_t>& vTrackIndexes,  const std::vector<std::string>& vBitrates);
 
 
     // GET functions
@@ -217,10 +221,15 @@ private slots:
     // Oscillogram
 
         void  slotAddDataToGraph                   (float* pData,     unsigned int iSizeInSamples,  unsigned int iSamplesInOne);
-        void  slotSetCurrentPos                    (double x,         std::string time);
+        void  slotUpdatePlayhead                   ();
         void  slotSetRepeatPoint                   (bool bFirstPoint, double x);
         void  slotEraseRepeatSection               ();
         void  slotClearGraph                       (bool stopTrack = false);
+
+
+    // Meters
+
+        void  slotUpdateMeters                     ();
         void  slotSetXMaxToGraph                   (unsigned int iMaxX);
         void  slotClickOnGraph                     (QMouseEvent* ev);
 
@@ -233,6 +242,11 @@ private slots:
         void  slotSetSpeedByTime                   (float     fSpeed);
         void  slotSetReverbVolume                  (float     fVolume);
         void  slotSetEchoVolume                    (float     fEchoVolume);
+        void  slotSetEqualizerBandGain             (int       iBand,  float fGainInDB);
+        void  slotLoadImpulseResponse              (QString   sPath);
+        void  slotUnloadImpulseResponse            ();
+        void  slotSetFXProfile                     (char      cProfile);
+        void  slotUpdateFXProfileStats             ();
 #if _WIN32
         void  slotLoadVST                          (wchar_t*  pPath);
         void  slotShowVST                          ();
@@ -283,7 +297,7 @@ private slots:
         void  slotSetTrack                         (size_t iTrackIndex,      bool bClear = false);
         void  slotShowMessageBox                   (bool errorBox,           QString text);
         void  slotSetNumber                        (size_t iNumber);
-        void  slotSetTrackBitrate                  (size_t iNumber, QString sBitrate);
+        void  slotSetTracksBitrate                 (std::vector<size_t> vTrackIndexes,  std::vector<std::string> vBitrates);
         void  slotUpdateTrackInfo                  (size_t iTrackIndex);
         void  slotClearPlaylist                    (std::promise<bool>* pPromiseResult);
 
@@ -303,11 +317,19 @@ private:
     QCPItemRect*     repeatLeft;
     QCPItemRect*     repeatRight;
     QCPItemRect*     backgndRight;
+    QTimer*          pPlayheadTimer;
+    QTimer*          pMeterTimer;
+    QTimer*          pFXProfileTimer;
+    SpectrumWidget*  pSpectrumWidget;
 
 
     std::mutex       mtxAddTrackWidget;
 
 
+    // Track which info is shown above the oscillogram.
+    TrackWidget*     pTrackInHeader;
+
+
     int iSelectedTrackIndex;
 
 
@@ -315,6 +337,16 @@ private:
     double maxPosOnGraphForText;
 
 
+    // Last drawn playhead (see slotUpdatePlayhead()), 'iPlayheadTimeInSec' is UINT_MAX if the time is not shown.
+    double       dPlayheadX;
+    unsigned int iPlayheadTimeInSec;
+
+
+    // Copy of the latest meter frame (see slotUpdateMeters()) and the time of the last update.
+    MeterFrame    meterFrame;
+    QElapsedTimer meterClock;
+
+
     unsigned int iCurrentXPosOnGraph;
 
 
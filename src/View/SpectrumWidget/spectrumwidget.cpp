@@ -0,0 +1,139 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "spectrumwidget.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+
+#include <algorithm>
+#include <cmath>
+
+#include "globalparams.h"
+
+SpectrumWidget::SpectrumWidget(QWidget *parent) : QWidget(parent)
+{
+    vShownSpectrum .resize(METER_SPECTRUM_BANDS, METER_MIN_DB);
+    vShownPeak     .resize(METER_MAX_CHANNELS,   METER_MIN_DB);
+    vShownRMS      .resize(METER_MAX_CHANNELS,   METER_MIN_DB);
+    iChannels      = 2;
+
+    iPaintTimeInNS = 0;
+    iPaintCount    = 0;
+
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void SpectrumWidget::setFrame(const MeterFrame& frame, qint64 iElapsedMS)
+{
+    float fFall = METER_FALL_DB_PER_SECOND * iElapsedMS / 1000.0f;
+
+    auto toDB = [](float fLinear)
+    {
+        return (fLinear > 0.0f) ? std::max(20.0f * std::log10(fLinear), METER_MIN_DB) : METER_MIN_DB;
+    };
+
+    for (size_t i = 0; (i < vShownSpectrum.size()) && (i < frame.vSpectrum.size()); i++)
+    {
+        vShownSpectrum[i] = std::max(frame.vSpectrum[i], vShownSpectrum[i] - fFall);
+    }
+
+    iChannels = std::max(1, std::min(frame.iChannels, 2));
+
+    for (size_t i = 0; (i < vShownPeak.size()) && (i < frame.vPeak.size()); i++)
+    {
+        vShownPeak[i] = std::max(toDB(frame.vPeak[i]), vShownPeak[i] - fFall);
+        vShownRMS[i]  = std::max(toDB(frame.vRMS[i]),  vShownRMS[i]  - fFall);
+    }
+
+    update();
+}
+
+void SpectrumWidget::fall(qint64 iElapsedMS)
+{
+    if (vShownPeak[0] <= METER_MIN_DB)
+    {
+        // Already on the floor, no need to repaint.
+        return;
+    }
+
+    float fFall = METER_FALL_DB_PER_SECOND * iElapsedMS / 1000.0f;
+
+    for (size_t i = 0; i < vShownSpectrum.size(); i++)
+    {
+        vShownSpectrum[i] = std::max(METER_MIN_DB, vShownSpectrum[i] - fFall);
+    }
+
+    for (size_t i = 0; i < vShownPeak.size(); i++)
+    {
+        vShownPeak[i] = std::max(METER_MIN_DB, vShownPeak[i] - fFall);
+        vShownRMS[i]  = std::max(METER_MIN_DB, vShownRMS[i]  - fFall);
+    }
+
+    update();
+}
+
+double SpectrumWidget::getAveragePaintTimeInUS() const
+{
+    if (iPaintCount == 0)
+    {
+        return 0.0;
+    }
+
+    return static_cast<double>(iPaintTimeInNS) / iPaintCount / 1000.0;
+}
+
+void SpectrumWidget::paintEvent(QPaintEvent* ev)
+{
+    Q_UNUSED(ev)
+
+    paintTimer.start();
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    const int iWidth  = width();
+    const int iHeight = height();
+
+    // Level meters take the right part (one bar per channel), the spectrum - the rest.
+    const int iMetersWidth   = iWidth / 10;
+    const int iSpectrumWidth = iWidth - iMetersWidth;
+
+    auto toHeight = [iHeight](float fLevelInDB)
+    {
+        return static_cast<int>( iHeight * (fLevelInDB - METER_MIN_DB) / -METER_MIN_DB );
+    };
+
+
+    // Spectrum
+
+    const int iBandCount = static_cast<int>(vShownSpectrum.size());
+    for (int i = 0; i < iBandCount; i++)
+    {
+        int iLeft  = iSpectrumWidth * i / iBandCount;
+        int iRight = iSpectrumWidth * (i + 1) / iBandCount;
+        int iBar   = toHeight(vShownSpectrum[static_cast<size_t>(i)]);
+
+        painter.fillRect(iLeft, iHeight - iBar, std::max(1, iRight - iLeft - 1), iBar, QColor(139, 0, 0));
+    }
+
+
+    // Levels (RMS - the bar, peak - the line)
+
+    for (int c = 0; c < iChannels; c++)
+    {
+        int iLeft = iSpectrumWidth + iMetersWidth * c / iChannels;
+        int iBarWidth = std::max(1, iMetersWidth / iChannels - 2);
+
+        int iRMS  = toHeight(vShownRMS[static_cast<size_t>(c)]);
+        int iPeak = toHeight(vShownPeak[static_cast<size_t>(c)]);
+
+        painter.fillRect(iLeft + 1, iHeight - iRMS, iBarWidth, iRMS, QColor(200, 0, 0));
+        painter.fillRect(iLeft + 1, iHeight - iPeak, iBarWidth, 2, Qt::white);
+    }
+
+    iPaintTimeInNS += paintTimer.nsecsElapsed();
+    iPaintCount++;
+}
@@ -0,0 +1,53 @@
+// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+#include <QWidget>
+#include <QElapsedTimer>
+
+#include <vector>
+
+#include "Model/MeterBuffer/meterbuffer.h"
+
+class QPaintEvent;
+
+// Spectrum bars and the level meters of the master output (see MasterAnalyzer).
+// MainWindow gives it the latest meter frame on its timer, the widget only keeps the copy
+// and falls smoothly to the new levels (paint does not touch the audio side at all).
+// Time of every paint is measured, see getAveragePaintTimeInUS().
+
+class SpectrumWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+
+    explicit SpectrumWidget(QWidget *parent = nullptr);
+
+    // 'iElapsedMS' - time since the last call (for the fall of the bars).
+    void setFrame(const MeterFrame& frame, qint64 iElapsedMS);
+    // Nothing is published (no output) - bars fall to the floor.
+    void fall(qint64 iElapsedMS);
+
+    double getAveragePaintTimeInUS() const;
+
+protected:
+
+    void paintEvent(QPaintEvent* ev);
+
+private:
+
+    // Shown levels in dB (fall at METER_FALL_DB_PER_SECOND, rise at once).
+    std::vector<float> vShownSpectrum;
+    std::vector<float> vShownPeak;
+    std::vector<float> vShownRMS;
+    int                iChannels;
+
+    // Paint cost.
+    QElapsedTimer      paintTimer;
+    qint64             iPaintTimeInNS;
+    qint64             iPaintCount;
+};
@@ -11,16 +11,145 @@
 
 #define BLOODY_PLAYER_VERSION "1.19.0"
 
+// output
+#define OUTPUT_MODE_DEVICE 0
+#define OUTPUT_MODE_NOSOUND_NRT 1
+#define OUTPUT_MODE_WAVWRITER_NRT 2
+
 #define MONITOR_TRACK_INTERVAL_MS 200
+#define MONITOR_TRACK_END_MARGIN_MS 5
+#define GAPLESS_SCHEDULE_BEFORE_END_MS 3000
 #define MAX_TIME_ERROR_MS 80
-#define TRANSITION_SLEEP_MS 2
 #define MAX_SECOND_REPEAT_BOUND_FROM_END_MS 1000
 #define MIN_TRACKS_TO_SHOW_LOADING 4
 #define MAX_HISTORY_SIZE 50
 #define WAIT_FOR_UI_IN_MS 250
+#define BITRATE_BATCH_SIZE 64
+#define BITRATE_BATCH_INTERVAL_MS 500
+
+// slider commands (see AudioService::enqueueLatestCommand())
+#define COMMAND_SLOT_VOLUME 0
+#define COMMAND_SLOT_PAN 1
+#define COMMAND_SLOT_PITCH 2
+#define COMMAND_SLOT_SPEED_BY_PITCH 3
+#define COMMAND_SLOT_SPEED_BY_TIME 4
+#define COMMAND_SLOT_REVERB_VOLUME 5
+#define COMMAND_SLOT_ECHO_VOLUME 6
+#define COMMAND_SLOT_COUNT 7
+
+// crossfade
+#define CROSSFADE_CURVE_LINEAR 0
+#define CROSSFADE_CURVE_EQUAL_POWER 1
+#define CROSSFADE_CURVE_POINTS 16
+#define DEFAULT_CROSSFADE_MS 0
+#define DEFAULT_CROSSFADE_CURVE CROSSFADE_CURVE_EQUAL_POWER
+#define MAX_CROSSFADE_MS 12000
+
+// repeat section
+#define DEFAULT_REPEAT_SEAM_FADE_MS 5
+#define MAX_REPEAT_SEAM_FADE_MS 50
+
+// preload
+#define DEFAULT_PRELOAD_BUDGET_MB 256
+#define PRELOAD_FIRST_AUDIO_POLL_MS 2
+
+// bitrate
+#define MP3_MAX_BITRATE_KBPS 448
+#define MP3_FULL_SCAN_MAX_SIZE_IN_BYTES 33554432
+#define MP3_SCAN_WINDOWS 64
+#define MP3_SCAN_FRAMES_IN_WINDOW 32
+#define MP3_DECODER_DELAY_SAMPLES 529
+
+// cache
+#define CACHE_APP_FOLDER "BloodyPlayer"
+
+// seek tables
+#define SEEK_TABLE_CACHE_FOLDER "SeekTables"
+#define SEEK_TABLE_CACHE_EXTENSION ".seek"
+#define SEEK_TABLE_CACHE_VERSION 2
+
+// loudness normalization
+#define LOUDNESS_NORMALIZATION_OFF 0
+#define LOUDNESS_NORMALIZATION_TRACK 1
+#define LOUDNESS_NORMALIZATION_ALBUM 2
+#define DEFAULT_LOUDNESS_NORMALIZATION LOUDNESS_NORMALIZATION_OFF
+#define LOUDNESS_TARGET_LUFS -18.0f
+#define LOUDNESS_MAX_GAIN_DB 12.0f
+#define LOUDNESS_ABSOLUTE_GATE_LUFS -70.0f
+#define LOUDNESS_RELATIVE_GATE_LU 10.0
+#define LOUDNESS_OVERSAMPLING 4
+#define LOUDNESS_TAPS_PER_PHASE 12
+#define LOUDNESS_READ_BUFFER_SIZE_IN_BYTES 65536
+#define LOUDNESS_MAX_ANALYSIS_THREADS 6
+#define LOUDNESS_CACHE_FOLDER "Loudness"
+#define LOUDNESS_CACHE_EXTENSION ".loud"
+#define LOUDNESS_CACHE_VERSION 1
+
+// lazy fx (see AudioService::applyLazyFX())
+#define LAZY_FX_PITCH 0
+#define LAZY_FX_TIME_STRETCH 1
+#define LAZY_FX_REVERB 2
+#define LAZY_FX_ECHO 3
+#define LAZY_FX_COUNT 4
+#define LAZY_FX_RELEASE_AFTER_MS 5000
+
+// equalizer
+#define EQ_BAND_COUNT 10
+#define EQ_BAND_FREQUENCIES {31.25f, 62.5f, 125.0f, 250.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f, 8000.0f, 16000.0f}
+#define EQ_BAND_Q 1.41f
+#define EQ_MIN_GAIN_DB -12.0f
+#define EQ_MAX_GAIN_DB 12.0f
+#define EQ_MAX_CHANNELS 8
+#define EQ_SMOOTHING_PER_BLOCK 0.3f
+#define EQ_SMOOTHING_SNAP_DB 0.05f
+
+// time stretch
+#define TIME_STRETCH_GRAIN_MS 20
+#define TIME_STRETCH_SEEK_MS 5
+#define TIME_STRETCH_CORRELATION_STEP 4
+#define TIME_STRETCH_MIN_RATIO 0.5f
+#define TIME_STRETCH_MAX_RATIO 2.0f
+#define TIME_STRETCH_MAX_CHANNELS 8
+#define TIME_STRETCH_TRANSIENT_RATIO 4.0f
+
+// fx profiles (pitch shifter FFT size, DSP buffer length and count, resampler)
+#define FX_PROFILE_LIVE 0
+#define FX_PROFILE_BALANCED 1
+#define FX_PROFILE_HI_QUALITY 2
+#define FX_PROFILE_COUNT 3
+#define FX_PROFILE_AUTO 3
+#define FX_PROFILE_FFT_SIZES {1024.0f, 2048.0f, 4096.0f}
+#define FX_PROFILE_BUFFER_LENGTHS {256, 512, 1024}
+#define FX_PROFILE_BUFFER_COUNTS {2, 4, 4}
+#define FX_PROFILE_RESAMPLERS {FMOD_DSP_RESAMPLER_LINEAR, FMOD_DSP_RESAMPLER_CUBIC, FMOD_DSP_RESAMPLER_SPLINE}
+#define DEFAULT_FX_PROFILE FX_PROFILE_HI_QUALITY
+#define FX_AUTO_OVERLOAD_DSP_USAGE 80.0f
+#define FX_AUTO_OVERLOAD_CHECKS 3
+#define FX_PROFILE_STATS_INTERVAL_MS 1000
+
+// convolution reverb
+#define CONVOLUTION_BLOCK_SIZE 512
+#define CONVOLUTION_HEAD_PARTITIONS 4
+#define CONVOLUTION_MAX_IR_SECONDS 10
+#define CONVOLUTION_WORKER_WAIT_MS 2
+
+// meters
+#define METER_MAX_CHANNELS 8
+#define METER_PERIOD_FRAMES 1024
+#define METER_FFT_SIZE 2048
+#define METER_SPECTRUM_BANDS 32
+#define METER_MIN_FREQUENCY 20.0f
+#define METER_MIN_DB -90.0f
+#define METER_UPDATE_INTERVAL_MS 16
+#define METER_FALL_DB_PER_SECOND 30.0f
+
+// export
+#define EXPORT_MAX_THREADS 6
+#define EXPORT_FX_TAIL_MS 2000
 
 // graph
 #define MAX_X_AXIS_VALUE 1000
 #define MAX_Y_AXIS_VALUE 1.02
 #define PLAYED_SECTION_ALPHA 130
 #define REPEAT_GRAYED_ALPHA 120
+#define PLAYHEAD_UPDATE_INTERVAL_MS 16
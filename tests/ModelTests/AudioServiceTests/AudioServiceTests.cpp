@@ -7,18 +7,176 @@
 
 #include <vector>
 #include <thread>
+#include <fstream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cmath>
 
 #include "View/MainWindow/mainwindow.h"
 #include "Model/AudioService/audioservice.h"
 #include "Controller/controller.h"
 #include "Model/Track/track.h"
+#include "Model/LoudnessMeter/loudnessmeter.h"
+#include "Model/MappedFileSystem/mappedfilesystem.h"
+#include "Model/Equalizer/equalizer.h"
+#include "Model/TimeStretch/timestretch.h"
+#include "Model/ConvolutionReverb/convolutionreverb.h"
+#include "Model/MasterAnalyzer/masteranalyzer.h"
+#include "Model/CacheFolder/cachefolder.h"
 #include "globalparams.h"
+#include "../ext/FMOD/inc/fmod.hpp"
 
-#if __linux__
+#if _WIN32
+#include <direct.h>
+#elif __linux__
 #include <unistd.h>
+#include <sys/stat.h>
 #endif
 
 
+// Output capture (used to check the rendered output).
+
+static std::vector<float>  vCapturedSamples;
+static std::atomic<size_t> iCapturedSamplesCount;
+
+static FMOD_RESULT F_CALLBACK captureDSPRead(FMOD_DSP_STATE* pDSPState, float* pInBuffer, float* pOutBuffer, unsigned int iLength, int iInChannels, int* pOutChannels) {
+	(void)pDSPState;
+
+	memcpy(pOutBuffer, pInBuffer, iLength * static_cast<unsigned int>(iInChannels) * sizeof(float));
+	*pOutChannels = iInChannels;
+
+	// Save only the first channel.
+	for (unsigned int i = 0; i < iLength; i++) {
+		size_t iIndex = iCapturedSamplesCount;
+
+		if (iIndex >= vCapturedSamples.size()) {
+			break;
+		}
+
+		vCapturedSamples[iIndex] = pInBuffer[i * static_cast<unsigned int>(iInChannels)];
+		iCapturedSamplesCount++;
+	}
+
+	return FMOD_OK;
+}
+
+static bool writeWav(const std::string& sPath, int iSampleRate, const std::vector<short>& vFrames) {
+	// Stereo 16 bit PCM (mono would be upmixed with a different volume depending on the other channels in the mix),
+	// both channels have the same samples.
+
+	std::ofstream wavFile(sPath, std::ios::binary);
+
+	if (wavFile.is_open() == false) {
+		return false;
+	}
+
+	unsigned int   iDataSize     = static_cast<unsigned int>(vFrames.size()) * 4;
+	unsigned int   iRiffSize     = 36 + iDataSize;
+	unsigned int   iFmtSize      = 16;
+	unsigned short iFormat       = 1;
+	unsigned short iChannels     = 2;
+	unsigned int   iRate         = static_cast<unsigned int>(iSampleRate);
+	unsigned int   iByteRate     = iRate * 4;
+	unsigned short iBlockAlign   = 4;
+	unsigned short iBits         = 16;
+
+	wavFile.write("RIFF", 4);
+	wavFile.write(reinterpret_cast<char*>(&iRiffSize),   4);
+	wavFile.write("WAVEfmt ", 8);
+	wavFile.write(reinterpret_cast<char*>(&iFmtSize),    4);
+	wavFile.write(reinterpret_cast<char*>(&iFormat),     2);
+	wavFile.write(reinterpret_cast<char*>(&iChannels),   2);
+	wavFile.write(reinterpret_cast<char*>(&iRate),       4);
+	wavFile.write(reinterpret_cast<char*>(&iByteRate),   4);
+	wavFile.write(reinterpret_cast<char*>(&iBlockAlign), 2);
+	wavFile.write(reinterpret_cast<char*>(&iBits),       2);
+	wavFile.write("data", 4);
+	wavFile.write(reinterpret_cast<char*>(&iDataSize),   4);
+
+	std::vector<short> vSamples(vFrames.size() * 2);
+	for (size_t i = 0; i < vFrames.size(); i++) {
+		vSamples[i * 2]     = vFrames[i];
+		vSamples[i * 2 + 1] = vFrames[i];
+	}
+
+	wavFile.write(reinterpret_cast<char*>(vSamples.data()), iDataSize);
+
+	return wavFile.good();
+}
+
+static unsigned int getWavLengthInMS(const std::string& sPath) {
+	// Reads the "fmt " and "data" chunks (0 if the file is not finished).
+
+	std::ifstream wavFile(sPath, std::ios::binary);
+
+	if (wavFile.is_open() == false) {
+		return 0;
+	}
+
+	char pRiff[12];
+	wavFile.read(pRiff, 12);
+
+	unsigned int   iRate       = 0;
+	unsigned short iBlockAlign = 0;
+
+	char         pChunkName[4];
+	unsigned int iChunkSize = 0;
+
+	while (wavFile.read(pChunkName, 4) && wavFile.read(reinterpret_cast<char*>(&iChunkSize), 4)) {
+		if (memcmp(pChunkName, "fmt ", 4) == 0) {
+			std::vector<char> vFormat(iChunkSize);
+			wavFile.read(vFormat.data(), iChunkSize);
+
+			memcpy(&iRate,       vFormat.data() + 4,  4);
+			memcpy(&iBlockAlign, vFormat.data() + 12, 2);
+		}
+		else if (memcmp(pChunkName, "data", 4) == 0) {
+			if ((iRate == 0) || (iBlockAlign == 0)) {
+				return 0;
+			}
+
+			return static_cast<unsigned int>(static_cast<unsigned long long>(iChunkSize) / iBlockAlign * 1000 / iRate);
+		}
+		else {
+			wavFile.seekg(iChunkSize, std::ios::cur);
+		}
+	}
+
+	return 0;
+}
+
+static float getLoudOnsetAfterSeek(Track* pTrack, unsigned int iPosInMS, int iOutputRate) {
+	// Time (ms) from the seek to the first loud sample of the output (the capture DSP has to be added),
+	// -1 if there is no loud sample in the captured second.
+	// The track is at the quiet part before the seek, so the audio mixed before the seek is quiet too.
+
+	pTrack->setPositionInMS(1000);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	iCapturedSamplesCount = 0;
+
+	pTrack->setPositionInMS(iPosInMS);
+
+	for (int i = 0; (i < 200) && (iCapturedSamplesCount < vCapturedSamples.size()); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	for (size_t i = 0; i < iCapturedSamplesCount; i++) {
+		if (std::fabs(vCapturedSamples[i]) > 0.1f) {
+			return static_cast<float>(i * 1000.0 / iOutputRate);
+		}
+	}
+
+	return -1.0f;
+}
+
+static bool writeConstantWav(const std::string& sPath, int iSampleRate, int iLengthInSamples, short iValue) {
+	return writeWav(sPath, iSampleRate, std::vector<short>(static_cast<size_t>(iLengthInSamples), iValue));
+}
+
+
 TEST_CASE("The FMOD system is created without any errors.", "[ModelTests::AudioServiceTests::FMODinit]") {
 	// Arrange
 
@@ -195,6 +353,66 @@ TEST_CASE("AudioService is able to pause a track without errors.", "[ModelTests:
 }
 
 
+TEST_CASE("AudioService: 'monitorTrack()' function does not wake up while the track is paused.", "[ModelTests::AudioServiceTests::monitorTrack (idle)]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// Setup path to track
+
+	const std::wstring sTrackName = L"Flone - Magic Store (cut).mp3";
+
+	const std::vector<std::wstring> vPathsToTracks = {sTrackName};
+
+
+	// Act
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	pAudioService->setVolume(0.0f); // don't need to hear music while testing
+	pAudioService->playTrack(0);
+	pAudioService->pauseTrack();
+
+	// Let the monitor see that the track is paused.
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS * 2));
+
+	unsigned long long iWakeUpsBefore = pAudioService->getMonitorWakeUpsCount();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS * 5));
+
+	unsigned long long iWakeUpsAfter = pAudioService->getMonitorWakeUpsCount();
+
+
+	// Assert
+
+	REQUIRE(iWakeUpsAfter == iWakeUpsBefore);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+}
+
 TEST_CASE("AudioService: 'monitorTrack()' function is switching to the next track without errors.", "[ModelTests::AudioServiceTests::monitorTrack]") {
 	// Arrange
 
@@ -642,6 +860,2204 @@ TEST_CASE("AudioService: played tracks history is working when 'random track' is
 }
 
 
+TEST_CASE("AudioService: 'random track' plays every track once before repeating any of them.", "[ModelTests::AudioServiceTests::shuffleBag]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// Setup path to track
+
+	const std::wstring sTrackName = L"Flone - Magic Store (cut).mp3";
+
+	const std::vector<std::wstring> vPathsToTracks = {sTrackName, sTrackName, sTrackName, sTrackName, sTrackName};
+
+	pAudioService->addTracks(vPathsToTracks);
+	size_t iTrackCount = pAudioService->getTracksCount();
+
+	if (iTrackCount != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Act
+
+	pAudioService->setVolume(0.0f); // don't need to hear music while testing
+	pAudioService->randomNextTrack();
+	pAudioService->playTrack(0);
+
+	std::vector<size_t> vPlayedCount(iTrackCount, 0);
+	vPlayedCount[0]++;
+
+	size_t iLastTrackIndex   = 0;
+	size_t iImmediateRepeats = 0;
+
+	// Two full rounds.
+	for (size_t i = 1; i < iTrackCount * 2; i++) {
+		pAudioService->nextTrack(false, true);
+
+		bool bSomethingIsPlaying = false;
+		size_t iCurrentTrackIndex = pAudioService->getPlayingTrackIndex(bSomethingIsPlaying);
+
+		if (bSomethingIsPlaying == false) {
+			delete pAudioService;
+			delete pMainWindow;
+
+			REQUIRE(false);
+			return;
+		}
+
+		if (iCurrentTrackIndex == iLastTrackIndex) {
+			iImmediateRepeats++;
+		}
+
+		vPlayedCount[iCurrentTrackIndex]++;
+		iLastTrackIndex = iCurrentTrackIndex;
+
+		if (i == iTrackCount - 1) {
+			// End of the first round.
+			for (size_t j = 0; j < iTrackCount; j++) {
+				REQUIRE(vPlayedCount[j] == 1);
+			}
+		}
+	}
+
+
+	// Assert
+
+	REQUIRE(iImmediateRepeats == 0);
+
+	for (size_t i = 0; i < iTrackCount; i++) {
+		REQUIRE(vPlayedCount[i] == 2);
+	}
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+}
+
+TEST_CASE("AudioService: playing track is followed by its handle when the tracklist changes.", "[ModelTests::AudioServiceTests::trackHandles]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// Setup path to track
+
+	const std::wstring sTrackName1 = L"Flone - Magic Store (cut).mp3";
+	const std::wstring sTrackName2 = L"Flone - Little Creature In The Night (cut).mp3";
+
+	const std::vector<std::wstring> vPathsToTracks = {sTrackName1, sTrackName2, sTrackName1, sTrackName2};
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Act
+
+	pAudioService->setVolume(0.0f); // don't need to hear music while testing
+	pAudioService->playTrack(1);
+
+	Track* pPlayingTrack = pAudioService->getCurrentTrack();
+
+	bool bSomethingIsPlaying = false;
+
+	// The first track goes to the end.
+	pAudioService->moveUp(0);
+	size_t iIndexAfterMoveUp = pAudioService->getPlayingTrackIndex(bSomethingIsPlaying);
+	Track* pTrackAfterMoveUp = pAudioService->getCurrentTrack();
+
+	// The last track goes to the beginning.
+	pAudioService->moveDown(pAudioService->getTracksCount() - 1);
+	size_t iIndexAfterMoveDown = pAudioService->getPlayingTrackIndex(bSomethingIsPlaying);
+	Track* pTrackAfterMoveDown = pAudioService->getCurrentTrack();
+
+	pAudioService->removeTrack(0);
+	size_t iIndexAfterRemove = pAudioService->getPlayingTrackIndex(bSomethingIsPlaying);
+	Track* pTrackAfterRemove = pAudioService->getCurrentTrack();
+
+
+	// Assert
+
+	REQUIRE(bSomethingIsPlaying);
+
+	REQUIRE(iIndexAfterMoveUp   == 0);
+	REQUIRE(iIndexAfterMoveDown == 1);
+	REQUIRE(iIndexAfterRemove   == 0);
+
+	REQUIRE(pTrackAfterMoveUp   == pPlayingTrack);
+	REQUIRE(pTrackAfterMoveDown == pPlayingTrack);
+	REQUIRE(pTrackAfterRemove   == pPlayingTrack);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+}
+
+TEST_CASE("AudioService: loudness of the tracks is analyzed in the background and applied as the gain.", "[ModelTests::AudioServiceTests::loudness]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// 1 kHz sine, -6 dBFS in both channels: -6.02 LUFS by BS.1770.
+
+	const float fSampleRate = 48000.0f;
+	const size_t iFrameCount = static_cast<size_t>(fSampleRate) * 5;
+
+	std::vector<float> vSine(iFrameCount * 2);
+	for (size_t i = 0; i < iFrameCount; i++) {
+		float fSample = 0.5f * static_cast<float>(std::sin(2.0 * 3.14159265358979323846 * 1000.0 * i / fSampleRate));
+
+		vSine[i * 2]     = fSample;
+		vSine[i * 2 + 1] = fSample;
+	}
+
+	LoudnessMeter meter(2, fSampleRate);
+	meter.addFrames(vSine.data(), iFrameCount);
+
+	// Setup path to track
+
+	const std::wstring sTrackName1 = L"Flone - Magic Store (cut).mp3";
+	const std::wstring sTrackName2 = L"Flone - Little Creature In The Night (cut).mp3";
+
+	const std::vector<std::wstring> vPathsToTracks = {sTrackName1, sTrackName2};
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Act
+
+	pAudioService->setVolume(0.0f); // don't need to hear music while testing
+	pAudioService->setLoudnessNormalization(LOUDNESS_NORMALIZATION_TRACK);
+
+	bool bAnalyzed = false;
+
+	for (int i = 0; (i < 300) && (bAnalyzed == false); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		bAnalyzed = pAudioService->isLoudnessAnalyzed(0) && pAudioService->isLoudnessAnalyzed(1);
+	}
+
+	pAudioService->playTrack(0);
+	TrackLoudness loudness1 = pAudioService->getCurrentTrack()->getLoudness();
+	float fTrackGain1 = pAudioService->getCurrentTrack()->getLoudnessGain();
+
+	pAudioService->playTrack(1);
+	TrackLoudness loudness2 = pAudioService->getCurrentTrack()->getLoudness();
+
+	// Both tracks are in the same folder.
+	pAudioService->setLoudnessNormalization(LOUDNESS_NORMALIZATION_ALBUM);
+	float fAlbumGain = pAudioService->getCurrentTrack()->getLoudnessGain();
+
+	pAudioService->setLoudnessNormalization(LOUDNESS_NORMALIZATION_OFF);
+	float fGainOff = pAudioService->getCurrentTrack()->getLoudnessGain();
+
+
+	// Assert
+
+	REQUIRE(std::fabs(meter.getIntegratedLoudness() - (-6.02f)) < 0.1f);
+	REQUIRE(std::fabs(meter.getTruePeak() - 0.5f) < 0.01f);
+
+	REQUIRE(bAnalyzed);
+
+	REQUIRE(loudness1.getIntegratedLoudness() > LOUDNESS_ABSOLUTE_GATE_LUFS);
+	REQUIRE(loudness1.getIntegratedLoudness() < 0.0f);
+	REQUIRE(loudness1.getTruePeak() > 0.0f);
+
+	REQUIRE(fTrackGain1 == loudness1.getGain());
+	REQUIRE(fTrackGain1 * loudness1.getTruePeak() <= 1.0f + 1e-5f);
+
+	REQUIRE(fAlbumGain == TrackLoudness::getAlbumLoudness({loudness1, loudness2}).getGain());
+	REQUIRE(fGainOff == 1.0f);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+}
+
+TEST_CASE("AudioService: non-realtime output plays the tracklist faster than real time on the virtual clock.", "[ModelTests::AudioServiceTests::virtualClock]") {
+	// Arrange
+
+	const std::string sTrack1    = "virtual_clock_test_1.wav";
+	const std::string sTrack2    = "virtual_clock_test_2.wav";
+	const std::string sOutput    = "virtual_clock_output.wav";
+	const int iSampleRate        = 44100;
+	const int iTrackLengthInMS   = 3000;
+
+	if ( (writeConstantWav(sTrack1, iSampleRate, iSampleRate * iTrackLengthInMS / 1000, 1000) == false)
+	     || (writeConstantWav(sTrack2, iSampleRate, iSampleRate * iTrackLengthInMS / 1000, 2000) == false) ) {
+		REQUIRE(false);
+		return;
+	}
+
+	remove(sOutput.c_str());
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow, OUTPUT_MODE_WAVWRITER_NRT, sOutput);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	pAudioService->addTracks({std::wstring(sTrack1.begin(), sTrack1.end()), std::wstring(sTrack2.begin(), sTrack2.end())});
+
+	if (pAudioService->getTracksCount() != 2) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Act
+
+	pAudioService->playTrack(0);
+
+	std::chrono::time_point<std::chrono::steady_clock> startTime = std::chrono::steady_clock::now();
+
+	pAudioService->advanceTime(iTrackLengthInMS + 500);
+
+	long long iWallTimeInMS = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+	bool   bSomethingIsPlaying = false;
+	size_t iPlayingTrackIndex  = pAudioService->getPlayingTrackIndex(bSomethingIsPlaying);
+	unsigned long long iVirtualTimeInMS = pAudioService->getVirtualTimeInMS();
+
+
+	// Cleanup
+
+	// The wav writer finishes the file when the system is released.
+	delete pAudioService;
+	delete pMainWindow;
+
+	std::ifstream outputFile(sOutput, std::ios::binary | std::ios::ate);
+	long long iOutputSize = outputFile.is_open() ? static_cast<long long>(outputFile.tellg()) : 0;
+	outputFile.close();
+
+	remove(sTrack1.c_str());
+	remove(sTrack2.c_str());
+	remove(sOutput.c_str());
+
+
+	// Assert
+
+	REQUIRE(bSomethingIsPlaying);
+	REQUIRE(iPlayingTrackIndex == 1);
+	REQUIRE(iVirtualTimeInMS >= static_cast<unsigned long long>(iTrackLengthInMS + 500));
+	REQUIRE(iWallTimeInMS < iTrackLengthInMS / 2);
+	// At least the first track was written (stereo float or 16 bit).
+	REQUIRE(iOutputSize >= static_cast<long long>(iSampleRate) * iTrackLengthInMS / 1000 * 2 * 2);
+}
+
+TEST_CASE("AudioService: export renders the tracks with the current speed faster than real time.", "[ModelTests::AudioServiceTests::export]") {
+	// Arrange
+
+	const std::string sTrack1    = "export_test_1.wav";
+	const std::string sTrack2    = "export_test_2.wav";
+	const std::string sRange     = "export_test_range.wav";
+	const int iSampleRate        = 44100;
+	const int iTrackLengthInMS   = 3000;
+
+	if ( (writeConstantWav(sTrack1, iSampleRate, iSampleRate * iTrackLengthInMS / 1000, 1000) == false)
+	     || (writeConstantWav(sTrack2, iSampleRate, iSampleRate * iTrackLengthInMS / 1000, 2000) == false) ) {
+		REQUIRE(false);
+		return;
+	}
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	pAudioService->addTracks({std::wstring(sTrack1.begin(), sTrack1.end()), std::wstring(sTrack2.begin(), sTrack2.end())});
+
+	if (pAudioService->getTracksCount() != 2) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	pAudioService->setSpeedByPitch(2.0f);
+
+#if _WIN32
+	_wmkdir(L"export_test_output");
+#elif __linux__
+	mkdir("export_test_output", 0755);
+#endif
+
+
+	// Act
+
+	std::chrono::time_point<std::chrono::steady_clock> startTime = std::chrono::steady_clock::now();
+
+	// Tracks are saved as "<track name>.wav", so the output folder is not the one with the tracks.
+	pAudioService->exportTracks({0, 1}, L"export_test_output");
+	pAudioService->exportTrack(0, std::wstring(sRange.begin(), sRange.end()), 1000, 2000);
+
+	while (pAudioService->isExportRunning()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	long long iWallTimeInMS = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+	unsigned int iTrack1LengthInMS = getWavLengthInMS("export_test_output/export_test_1.wav");
+	unsigned int iTrack2LengthInMS = getWavLengthInMS("export_test_output/export_test_2.wav");
+	unsigned int iRangeLengthInMS  = getWavLengthInMS(sRange);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	remove(sTrack1.c_str());
+	remove(sTrack2.c_str());
+	remove(sRange.c_str());
+	remove("export_test_output/export_test_1.wav");
+	remove("export_test_output/export_test_2.wav");
+
+#if _WIN32
+	_wrmdir(L"export_test_output");
+#elif __linux__
+	rmdir("export_test_output");
+#endif
+
+
+	// Assert
+
+	// Twice as fast, up to a couple of DSP buffers more.
+	REQUIRE(iTrack1LengthInMS >= iTrackLengthInMS / 2);
+	REQUIRE(iTrack1LengthInMS <= iTrackLengthInMS / 2 + 100);
+	REQUIRE(iTrack2LengthInMS >= iTrackLengthInMS / 2);
+	REQUIRE(iTrack2LengthInMS <= iTrackLengthInMS / 2 + 100);
+	REQUIRE(iRangeLengthInMS  >= 500);
+	REQUIRE(iRangeLengthInMS  <= 600);
+	REQUIRE(iWallTimeInMS < iTrackLengthInMS);
+}
+
+TEST_CASE("AudioService: all users of the file share one memory mapping.", "[ModelTests::AudioServiceTests::mappedFileSystem]") {
+	// Arrange
+
+	MappedFileSystemStats statsBefore = MappedFileSystem::getStats();
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	const std::wstring sTrackName = L"Flone - Magic Store (cut).mp3";
+
+	const std::vector<std::wstring> vPathsToTracks = {sTrackName, sTrackName};
+
+
+	// Act
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	pAudioService->setVolume(0.0f); // don't need to hear music while testing
+	pAudioService->playTrack(0);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS));
+
+	MappedFileSystemStats statsPlaying = MappedFileSystem::getStats();
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	MappedFileSystemStats statsAfter = MappedFileSystem::getStats();
+
+
+	// Assert
+
+	// Streams and dummy sounds of both tracks, the bitrate scan and the rest share the one mapping.
+	REQUIRE(statsPlaying.iNewMappings - statsBefore.iNewMappings == 1);
+	REQUIRE(statsPlaying.iOpens - statsBefore.iOpens >= 4);
+	REQUIRE(statsPlaying.iReads > statsBefore.iReads);
+	REQUIRE(statsPlaying.iMappedFiles == statsBefore.iMappedFiles + 1);
+	REQUIRE(statsAfter.iMappedFiles == statsBefore.iMappedFiles);
+}
+
+TEST_CASE("AudioService: equalizer boosts only its band and stays cheap per block.", "[ModelTests::AudioServiceTests::equalizer]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	const float        fSampleRate = 48000.0f;
+	const int          iChannels   = 2;
+	const unsigned int iBlockSize  = 1024;
+	const int          iBlocks     = 100;
+
+	// 1 kHz sine, the 1 kHz band is 5 and the 16 kHz band is 9.
+	std::vector<float> vInput(iBlockSize * iChannels * iBlocks);
+	for (size_t i = 0; i < vInput.size() / iChannels; i++) {
+		float fSample = 0.25f * static_cast<float>(std::sin(2.0 * 3.14159265358979323846 * 1000.0 * i / fSampleRate));
+
+		vInput[i * iChannels]     = fSample;
+		vInput[i * iChannels + 1] = fSample;
+	}
+
+	std::vector<float> vFlatOutput    (vInput.size());
+	std::vector<float> vBoostedOutput (vInput.size());
+	std::vector<float> vOtherOutput   (vInput.size());
+
+	auto getRMSOfLastBlock = [&](const std::vector<float>& vSamples) {
+		double dSum = 0.0;
+		for (size_t i = vSamples.size() - iBlockSize * iChannels; i < vSamples.size(); i++) {
+			dSum += static_cast<double>(vSamples[i]) * vSamples[i];
+		}
+		return std::sqrt(dSum / (iBlockSize * iChannels));
+	};
+
+
+	// Act
+
+	Equalizer flatEqualizer(fSampleRate);
+	Equalizer boostedEqualizer(fSampleRate);
+	Equalizer otherEqualizer(fSampleRate);
+
+	boostedEqualizer.setBandGain(5, 6.0f);
+	otherEqualizer.setBandGain(9, 12.0f);
+
+	auto timeStart = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iBlocks; i++) {
+		size_t iOffset = static_cast<size_t>(i) * iBlockSize * iChannels;
+
+		flatEqualizer.process(&vInput[iOffset], &vFlatOutput[iOffset], iBlockSize, iChannels);
+		boostedEqualizer.process(&vInput[iOffset], &vBoostedOutput[iOffset], iBlockSize, iChannels);
+		otherEqualizer.process(&vInput[iOffset], &vOtherOutput[iOffset], iBlockSize, iChannels);
+	}
+
+	auto timeEnd = std::chrono::steady_clock::now();
+
+	double dMicrosecondsPerBlock = std::chrono::duration<double, std::micro>(timeEnd - timeStart).count() / (iBlocks * 3);
+
+	FMOD::DSP* pDSP = nullptr;
+	bool bDSPCreated = Equalizer::createDSP(pAudioService->getFMODSystem(), &pDSP);
+
+	float fGainFromDSP = 0.0f;
+	if (bDSPCreated) {
+		pDSP->setParameterFloat(5, 100.0f);
+		pDSP->getParameterFloat(5, &fGainFromDSP, nullptr, 0);
+		pDSP->release();
+	}
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+
+	// Assert
+
+	REQUIRE(vFlatOutput == vInput);
+	REQUIRE(flatEqualizer.isFlat());
+	REQUIRE_FALSE(boostedEqualizer.isFlat());
+
+	double dInputRMS = getRMSOfLastBlock(vInput);
+
+	// Peak gain of the band is at its center frequency.
+	REQUIRE(std::fabs(20.0 * std::log10(getRMSOfLastBlock(vBoostedOutput) / dInputRMS) - 6.0) < 0.5);
+	REQUIRE(std::fabs(20.0 * std::log10(getRMSOfLastBlock(vOtherOutput)   / dInputRMS)) < 0.5);
+
+	// 1024 frames are 21 ms of the audio.
+	REQUIRE(dMicrosecondsPerBlock < 2000.0);
+
+	REQUIRE(bDSPCreated);
+	REQUIRE(fGainFromDSP == EQ_MAX_GAIN_DB);
+}
+
+TEST_CASE("AudioService: time stretch keeps the pitch with less latency than the FFT pitch shifter.", "[ModelTests::AudioServiceTests::timeStretch]") {
+	// Arrange
+
+	const int   iSampleRate = 48000;
+	const float fSpeed      = 2.0f;
+
+	// 1 second of silence and 3 seconds of 440 Hz.
+	const std::string sTrack = "time_stretch_test.wav";
+
+	std::vector<short> vFrames(static_cast<size_t>(iSampleRate) * 4, 0);
+	for (size_t i = static_cast<size_t>(iSampleRate); i < vFrames.size(); i++) {
+		vFrames[i] = static_cast<short>(16384.0 * std::sin(2.0 * 3.14159265358979323846 * 440.0 * i / iSampleRate));
+	}
+
+	if (writeWav(sTrack, iSampleRate, vFrames) == false) {
+		REQUIRE(false);
+		return;
+	}
+
+	enum Effect {NO_EFFECT, FFT_PITCH_SHIFT, TIME_STRETCH};
+
+	// Plays the track on its own non-realtime system with the speed (channel frequency) and the pitch correction.
+	auto render = [&](Effect effect, size_t* pOnset, double* pFrequency, double* pSeconds) {
+		FMOD::System* pSystem = nullptr;
+
+		if ( (FMOD::System_Create(&pSystem) != FMOD_OK)
+		     || (pSystem->setSoftwareFormat(iSampleRate, FMOD_SPEAKERMODE_STEREO, 0) != FMOD_OK)
+		     || (pSystem->setOutput(FMOD_OUTPUTTYPE_NOSOUND_NRT) != FMOD_OK)
+		     || (pSystem->init(32, FMOD_INIT_NORMAL, nullptr) != FMOD_OK) ) {
+			return false;
+		}
+
+		FMOD::Sound* pSound = nullptr;
+		pSystem->createSound(sTrack.c_str(), FMOD_DEFAULT, nullptr, &pSound);
+
+		FMOD_DSP_DESCRIPTION captureDesc;
+		memset(&captureDesc, 0, sizeof(captureDesc));
+		captureDesc.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+		strncpy(captureDesc.name, "Capture", sizeof(captureDesc.name) - 1);
+		captureDesc.numinputbuffers  = 1;
+		captureDesc.numoutputbuffers = 1;
+		captureDesc.read             = captureDSPRead;
+
+		FMOD::DSP*          pCaptureDSP = nullptr;
+		FMOD::DSP*          pEffectDSP  = nullptr;
+		FMOD::ChannelGroup* pMaster     = nullptr;
+
+		pSystem->createDSP(&captureDesc, &pCaptureDSP);
+		pSystem->getMasterChannelGroup(&pMaster);
+
+		if (effect == FFT_PITCH_SHIFT) {
+			// As it was in AudioService.
+			pSystem->createDSPByType(FMOD_DSP_TYPE_PITCHSHIFT, &pEffectDSP);
+			pEffectDSP->setParameterFloat(FMOD_DSP_PITCHSHIFT_FFTSIZE, 4096);
+			pEffectDSP->setParameterFloat(FMOD_DSP_PITCHSHIFT_PITCH, 1.0f / fSpeed);
+		}
+		else if (effect == TIME_STRETCH) {
+			TimeStretch::createDSP(pSystem, &pEffectDSP);
+			pEffectDSP->setParameterFloat(0, fSpeed);
+		}
+
+		if (pEffectDSP) {
+			pMaster->addDSP(0, pEffectDSP);
+		}
+		pMaster->addDSP(0, pCaptureDSP);
+
+		vCapturedSamples.assign(static_cast<size_t>(iSampleRate) * 3 / 2, 0.0f);
+		iCapturedSamplesCount = 0;
+
+		FMOD::Channel* pChannel = nullptr;
+		float fDefaultFrequency = 0.0f;
+
+		pSystem->playSound(pSound, nullptr, true, &pChannel);
+		pSound->getDefaults(&fDefaultFrequency, nullptr);
+		pChannel->setFrequency(fDefaultFrequency * fSpeed);
+		pChannel->setPaused(false);
+
+		auto timeStart = std::chrono::steady_clock::now();
+
+		while (iCapturedSamplesCount < vCapturedSamples.size()) {
+			pSystem->update();
+		}
+
+		*pSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - timeStart).count();
+
+		pSound->release();
+		pMaster->removeDSP(pCaptureDSP);
+		pCaptureDSP->release();
+		if (pEffectDSP) {
+			pMaster->removeDSP(pEffectDSP);
+			pEffectDSP->release();
+		}
+		pSystem->release();
+
+
+		size_t iOnset = 0;
+		while ( (iOnset < vCapturedSamples.size()) && (std::fabs(vCapturedSamples[iOnset]) < 0.05f) ) {
+			iOnset++;
+		}
+
+		// Rising zero crossings over 0.5 second after the effect has settled.
+		size_t iFrom = iOnset + static_cast<size_t>(iSampleRate) / 4;
+		size_t iTo   = iFrom + static_cast<size_t>(iSampleRate) / 2;
+		size_t iCrossings = 0;
+
+		for (size_t i = iFrom + 1; i < iTo && i < vCapturedSamples.size(); i++) {
+			if ( (vCapturedSamples[i - 1] < 0.0f) && (vCapturedSamples[i] >= 0.0f) ) {
+				iCrossings++;
+			}
+		}
+
+		*pOnset     = iOnset;
+		*pFrequency = iCrossings * 2.0;
+
+		return true;
+	};
+
+
+	// Act
+
+	size_t iDryOnset          = 0, iPitchShiftOnset     = 0, iTimeStretchOnset     = 0;
+	double dDryFrequency      = 0, dPitchShiftFrequency = 0, dTimeStretchFrequency = 0;
+	double dDrySeconds        = 0, dPitchShiftSeconds   = 0, dTimeStretchSeconds   = 0;
+
+	bool bRendered = render(NO_EFFECT,       &iDryOnset,         &dDryFrequency,         &dDrySeconds)
+	              && render(FFT_PITCH_SHIFT, &iPitchShiftOnset,  &dPitchShiftFrequency,  &dPitchShiftSeconds)
+	              && render(TIME_STRETCH,    &iTimeStretchOnset, &dTimeStretchFrequency, &dTimeStretchSeconds);
+
+	unsigned int iExpectedLatency = TimeStretch(static_cast<float>(iSampleRate)).getLatencyInFrames();
+
+
+	// Cleanup
+
+	remove(sTrack.c_str());
+
+
+	// Assert
+
+	REQUIRE(bRendered);
+
+	// Without the correction the pitch goes up with the speed.
+	REQUIRE(std::fabs(dDryFrequency - 880.0) < 10.0);
+	REQUIRE(std::fabs(dPitchShiftFrequency - 440.0) < 10.0);
+	REQUIRE(std::fabs(dTimeStretchFrequency - 440.0) < 10.0);
+
+	INFO("latency (frames): FFT pitch shift " << iPitchShiftOnset - iDryOnset << ", time stretch " << iTimeStretchOnset - iDryOnset);
+	INFO("render time (s): dry " << dDrySeconds << ", FFT pitch shift " << dPitchShiftSeconds << ", time stretch " << dTimeStretchSeconds);
+
+	// Onset of the time stretch is the grain that reaches the threshold first.
+	REQUIRE(iTimeStretchOnset - iDryOnset <= iExpectedLatency);
+	REQUIRE(iTimeStretchOnset - iDryOnset < iPitchShiftOnset - iDryOnset);
+
+	// 1.5 seconds of the audio.
+	REQUIRE(dTimeStretchSeconds < 1.5);
+	REQUIRE(dPitchShiftSeconds < 1.5);
+}
+
+TEST_CASE("AudioService: convolution reverb applies the whole impulse response and keeps the tail off the audio thread.", "[ModelTests::AudioServiceTests::convolutionReverb]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	int iSampleRate = 0;
+	pAudioService->getFMODSystem()->getSoftwareFormat(&iSampleRate, nullptr, nullptr);
+
+	const int          iChannels  = 2;
+	const unsigned int iBlockSize = 1024;
+
+	// 2 seconds of the decaying noise (at the output rate so it's not resampled).
+	const std::string sResponse = "convolution_test.wav";
+
+	std::vector<short> vResponse(static_cast<size_t>(iSampleRate) * 2);
+	unsigned int iRandom = 12345;
+	for (size_t i = 0; i < vResponse.size(); i++) {
+		iRandom = iRandom * 1664525u + 1013904223u;
+
+		double dNoise = static_cast<double>(iRandom >> 8) / (1 << 24) * 2.0 - 1.0;
+		vResponse[i]  = static_cast<short>(16000.0 * dNoise * std::exp(-3.0 * i / iSampleRate));
+	}
+
+	if (writeWav(sResponse, iSampleRate, vResponse) == false) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// The loader scales the response to the unit energy.
+	double dEnergy = 0.0;
+	for (size_t i = 0; i < vResponse.size(); i++) {
+		dEnergy += (vResponse[i] / 32768.0) * (vResponse[i] / 32768.0);
+	}
+	const double dScale = 1.0 / std::sqrt(dEnergy);
+
+	// One block of silence, an impulse and 3 seconds of silence.
+	std::vector<float> vInput(static_cast<size_t>(iSampleRate) * 3 * iChannels + iBlockSize * iChannels, 0.0f);
+	vInput[iBlockSize * iChannels]     = 1.0f;
+	vInput[iBlockSize * iChannels + 1] = 1.0f;
+
+	// 10 seconds of the noise.
+	std::vector<float> vNoise(static_cast<size_t>(iSampleRate) * 10 * iChannels);
+	for (size_t i = 0; i < vNoise.size(); i++) {
+		iRandom = iRandom * 1664525u + 1013904223u;
+
+		vNoise[i] = static_cast<float>(iRandom >> 8) / (1 << 24) * 0.5f - 0.25f;
+	}
+
+	std::vector<float> vImpulseOutput (vInput.size());
+	std::vector<float> vNoiseOutput   (vNoise.size());
+
+	auto processAll = [&](ConvolutionReverb& reverb, const std::vector<float>& vIn, std::vector<float>& vOut) {
+		for (size_t iOffset = 0; iOffset < vIn.size(); iOffset += iBlockSize * iChannels) {
+			unsigned int iFrames = static_cast<unsigned int>( std::min(static_cast<size_t>(iBlockSize), (vIn.size() - iOffset) / iChannels) );
+
+			reverb.process(&vIn[iOffset], &vOut[iOffset], iFrames, iChannels);
+		}
+	};
+
+
+	// Act
+
+	std::string sLoadError;
+	ImpulseResponse* pResponse = ConvolutionReverb::loadImpulseResponse(pAudioService->getFMODSystem(), std::wstring(sResponse.begin(), sResponse.end()), &sLoadError);
+
+	std::string sMissingError;
+	ImpulseResponse* pMissingResponse = ConvolutionReverb::loadImpulseResponse(pAudioService->getFMODSystem(), L"missing_convolution_test.wav", &sMissingError);
+
+	bool bLoaded = pResponse != nullptr;
+	unsigned int iPartitions = 0;
+	unsigned int iLengthInMS = 0;
+
+	double dMaxError       = 0.0;
+	float  fDry            = 0.0f;
+	double dSeconds        = 0.0;
+	unsigned long long iMissedTails = 0;
+
+	if (bLoaded) {
+		iPartitions = static_cast<unsigned int>(pResponse->iPartitionCount);
+		iLengthInMS = pResponse->iLengthInMS;
+
+		// The audio thread waits for the tail, so the output must be exact.
+		ConvolutionReverb impulseReverb;
+		impulseReverb.setWaitForTail(true);
+		impulseReverb.setImpulseResponse(pResponse);
+
+		processAll(impulseReverb, vInput, vImpulseOutput);
+
+		// The wet signal is delayed by one block of the convolution.
+		fDry = vImpulseOutput[iBlockSize * iChannels];
+
+		for (size_t i = iBlockSize + 1; i < vInput.size() / iChannels; i++) {
+			double dExpected = 0.0;
+			if ( (i >= iBlockSize + CONVOLUTION_BLOCK_SIZE) && (i - iBlockSize - CONVOLUTION_BLOCK_SIZE < vResponse.size()) ) {
+				dExpected = vResponse[i - iBlockSize - CONVOLUTION_BLOCK_SIZE] / 32768.0 * dScale;
+			}
+
+			dMaxError = std::max(dMaxError, std::fabs(vImpulseOutput[i * iChannels]     - dExpected));
+			dMaxError = std::max(dMaxError, std::fabs(vImpulseOutput[i * iChannels + 1] - dExpected));
+		}
+
+
+		// Whole cost of the convolution (the audio thread waits for the worker thread).
+		ConvolutionReverb noiseReverb;
+		noiseReverb.setWaitForTail(true);
+		noiseReverb.setImpulseResponse( ConvolutionReverb::loadImpulseResponse(pAudioService->getFMODSystem(), std::wstring(sResponse.begin(), sResponse.end()), &sLoadError) );
+
+		auto timeStart = std::chrono::steady_clock::now();
+
+		processAll(noiseReverb, vNoise, vNoiseOutput);
+
+		auto timeEnd = std::chrono::steady_clock::now();
+
+		dSeconds     = std::chrono::duration<double>(timeEnd - timeStart).count();
+		iMissedTails = noiseReverb.getMissedTails() + impulseReverb.getMissedTails();
+	}
+
+	FMOD::DSP* pDSP = nullptr;
+	bool bDSPCreated = ConvolutionReverb::createDSP(pAudioService->getFMODSystem(), &pDSP);
+
+	float fWetFromDSP = 0.0f;
+	if (bDSPCreated) {
+		// The DSP owns the response.
+		ConvolutionReverb::setImpulseResponse( pDSP, ConvolutionReverb::loadImpulseResponse(pAudioService->getFMODSystem(), std::wstring(sResponse.begin(), sResponse.end()), &sLoadError) );
+		ConvolutionReverb::setImpulseResponse(pDSP, nullptr);
+
+		pDSP->setParameterFloat(0, -6.0f);
+		pDSP->getParameterFloat(0, &fWetFromDSP, nullptr, 0);
+		pDSP->release();
+	}
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	remove(sResponse.c_str());
+
+
+	// Assert
+
+	REQUIRE(bLoaded);
+	REQUIRE(pMissingResponse == nullptr);
+	REQUIRE(sMissingError.empty() == false);
+
+	REQUIRE(iPartitions == (vResponse.size() + CONVOLUTION_BLOCK_SIZE - 1) / CONVOLUTION_BLOCK_SIZE);
+	REQUIRE(iLengthInMS == 2000);
+
+	REQUIRE(std::fabs(fDry - 1.0f) < 0.001f);
+	REQUIRE(dMaxError < 0.001);
+	REQUIRE(iMissedTails == 0);
+
+	INFO("10 seconds of the audio with the 2 second response: " << dSeconds << " s");
+
+	// Real time with a lot of room (optimized builds are well under 10% of one core).
+	REQUIRE(dSeconds < 10.0);
+
+	REQUIRE(bDSPCreated);
+	REQUIRE(fWetFromDSP == -6.0f);
+}
+
+TEST_CASE("AudioService: meters publish the levels and the spectrum of the output through the triple buffer.", "[ModelTests::AudioServiceTests::meters]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	const float        fSampleRate = 48000.0f;
+	const int          iChannels   = 2;
+	const unsigned int iBlockSize  = METER_PERIOD_FRAMES;
+	const int          iBlocks     = 200;
+
+	// 1 kHz sine: 0.5 in the left channel, 0.25 in the right one.
+	std::vector<float> vInput(iBlockSize * iChannels * iBlocks);
+	for (size_t i = 0; i < vInput.size() / iChannels; i++) {
+		float fSample = static_cast<float>(std::sin(2.0 * 3.14159265358979323846 * 1000.0 * i / fSampleRate));
+
+		vInput[i * iChannels]     = 0.5f  * fSample;
+		vInput[i * iChannels + 1] = 0.25f * fSample;
+	}
+
+	std::vector<float> vOutput(vInput.size());
+
+
+	// Act
+
+	MasterAnalyzer analyzer(fSampleRate);
+
+	auto timeStart = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iBlocks; i++) {
+		size_t iOffset = static_cast<size_t>(i) * iBlockSize * iChannels;
+
+		analyzer.process(&vInput[iOffset], &vOutput[iOffset], iBlockSize, iChannels);
+	}
+
+	auto timeEnd = std::chrono::steady_clock::now();
+
+	double dMicrosecondsPerBlock = std::chrono::duration<double, std::micro>(timeEnd - timeStart).count() / iBlocks;
+
+	MeterFrame frame;
+	bool bFirstRead  = analyzer.readFrame(&frame);
+	bool bSecondRead = analyzer.readFrame(&frame);
+
+	// Band of 1 kHz and the highest band.
+	float fToneBand = METER_MIN_DB;
+	for (size_t i = 0; i < frame.vSpectrum.size(); i++) {
+		fToneBand = std::max(fToneBand, frame.vSpectrum[i]);
+	}
+	float fHighBand = frame.vSpectrum.empty() ? 0.0f : frame.vSpectrum.back();
+
+
+	// Writer and reader at the same time: every field of the frame 'n' is 'n', a torn frame would have mixed values.
+	MeterBuffer buffer(METER_MAX_CHANNELS, METER_SPECTRUM_BANDS);
+
+	const unsigned long long iFramesToPublish = 200000;
+	std::atomic<bool> bWriterDone(false);
+
+	std::thread writer([&] {
+		for (unsigned long long i = 1; i <= iFramesToPublish; i++) {
+			MeterFrame* pFrame = buffer.getWriteFrame();
+
+			pFrame->iChannels = static_cast<int>(i % 1000);
+			std::fill(pFrame->vPeak.begin(),     pFrame->vPeak.end(),     static_cast<float>(i % 1000));
+			std::fill(pFrame->vRMS.begin(),      pFrame->vRMS.end(),      static_cast<float>(i % 1000));
+			std::fill(pFrame->vSpectrum.begin(), pFrame->vSpectrum.end(), static_cast<float>(i % 1000));
+
+			buffer.publish();
+		}
+
+		bWriterDone = true;
+	});
+
+	size_t iReadFrames = 0;
+	size_t iTornFrames = 0;
+	size_t iOutOfOrder = 0;
+	unsigned long long iLastSequence = 0;
+
+	MeterFrame readFrame;
+	bool bLastRead = false;
+	while (bLastRead == false) {
+		// One more read after the writer is done gets the last frame.
+		bLastRead = bWriterDone;
+
+		if (buffer.read(&readFrame) == false) {
+			continue;
+		}
+
+		iReadFrames++;
+
+		float fExpected = static_cast<float>(readFrame.iSequence % 1000);
+
+		bool bTorn = readFrame.iChannels != static_cast<int>(readFrame.iSequence % 1000);
+		for (size_t i = 0; i < readFrame.vSpectrum.size(); i++) {
+			bTorn |= readFrame.vSpectrum[i] != fExpected;
+		}
+		for (size_t i = 0; i < readFrame.vPeak.size(); i++) {
+			bTorn |= (readFrame.vPeak[i] != fExpected) || (readFrame.vRMS[i] != fExpected);
+		}
+
+		iTornFrames += bTorn ? 1 : 0;
+		iOutOfOrder += (readFrame.iSequence <= iLastSequence) ? 1 : 0;
+
+		iLastSequence = readFrame.iSequence;
+	}
+
+	writer.join();
+
+
+	// Analyzer of the running system (the GUI reads it the same way).
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+	MeterFrame systemFrame;
+	bool bSystemFrame = pAudioService->getMeterFrame(&systemFrame);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+
+	// Assert
+
+	// The signal is not changed.
+	REQUIRE(vOutput == vInput);
+
+	REQUIRE(bFirstRead);
+	REQUIRE_FALSE(bSecondRead);
+	REQUIRE(frame.iSequence == static_cast<unsigned long long>(iBlocks));
+	REQUIRE(frame.iChannels == 2);
+
+	REQUIRE(std::fabs(frame.vPeak[0] - 0.5f)  < 0.01f);
+	REQUIRE(std::fabs(frame.vPeak[1] - 0.25f) < 0.01f);
+	REQUIRE(std::fabs(frame.vRMS[0]  - 0.5f  / std::sqrt(2.0f)) < 0.01f);
+	REQUIRE(std::fabs(frame.vRMS[1]  - 0.25f / std::sqrt(2.0f)) < 0.01f);
+
+	// Mono mix is 0.375 (-8.5 dB of the full scale).
+	REQUIRE(std::fabs(fToneBand - 20.0f * std::log10(0.375f)) < 1.0f);
+	REQUIRE(fHighBand < -60.0f);
+
+	INFO("frames read: " << iReadFrames << " of " << iFramesToPublish);
+	REQUIRE(iReadFrames > 0);
+	REQUIRE(iTornFrames == 0);
+	REQUIRE(iOutOfOrder == 0);
+	REQUIRE(iLastSequence == iFramesToPublish);
+
+	REQUIRE(bSystemFrame);
+	REQUIRE(systemFrame.iSequence > 0);
+
+	// 1024 frames are 21 ms of the audio.
+	REQUIRE(dMicrosecondsPerBlock < 1000.0);
+}
+
+TEST_CASE("AudioService: speed is applied only to the current track and slider events are coalesced.", "[ModelTests::AudioServiceTests::speedCoalescing]") {
+	// Arrange
+
+	const std::string sTrack     = "speed_test.wav";
+	const int iSampleRate        = 44100;
+	const size_t iTracksCount    = 2000;
+	const size_t iSliderEvents   = 1000;
+	const size_t iSpeedChanges   = 100;
+
+	if (writeConstantWav(sTrack, iSampleRate, iSampleRate * 10, 1000) == false) {
+		REQUIRE(false);
+		return;
+	}
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		remove(sTrack.c_str());
+
+		REQUIRE(false);
+		return;
+	}
+
+	pAudioService->addTracks( std::vector<std::wstring>(iTracksCount, std::wstring(sTrack.begin(), sTrack.end())) );
+
+	if (pAudioService->getTracksCount() != iTracksCount) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		remove(sTrack.c_str());
+
+		REQUIRE(false);
+		return;
+	}
+
+	pAudioService->setVolume(0.0f); // don't need to hear music while testing
+	pAudioService->playTrack(0);
+
+
+	// Act
+
+	// Direct calls (what every slider event did before): the cost must not depend on the tracklist size.
+	std::chrono::time_point<std::chrono::steady_clock> startTime = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < iSpeedChanges; i++) {
+		pAudioService->setSpeedByPitch( (i % 2 == 0) ? 1.5f : 1.25f );
+	}
+
+	double dSpeedChangeInUS = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count()
+	                          / static_cast<double>(iSpeedChanges);
+
+	// Slider events while the audio-control thread is busy with another command.
+	std::mutex              mtxBusy;
+	std::condition_variable cvBusy;
+	bool                    bBusy = true;
+
+	pAudioService->enqueueCommand([&]() {
+		std::unique_lock<std::mutex> lock(mtxBusy);
+		cvBusy.wait(lock, [&]() { return bBusy == false; });
+	});
+
+	// Written only by the commands (in the audio-control thread).
+	std::atomic<size_t> iAppliedEvents(0);
+	float               fAppliedSpeed = 0.0f;
+
+	for (size_t i = 1; i <= iSliderEvents; i++) {
+		float fSpeed = 1.0f + i / static_cast<float>(iSliderEvents);
+
+		pAudioService->enqueueLatestCommand(COMMAND_SLOT_SPEED_BY_PITCH, [&, fSpeed]() {
+			iAppliedEvents++;
+			fAppliedSpeed = fSpeed;
+
+			pAudioService->setSpeedByPitch(fSpeed);
+		});
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mtxBusy);
+		bBusy = false;
+	}
+	cvBusy.notify_one();
+
+	for (int i = 0; (i < 100) && (iAppliedEvents == 0); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	// Wait for the published position with the new speed.
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS * 2));
+
+	PlaybackPosition position;
+	bool             bPositionValid = pAudioService->getPlaybackPosition(&position);
+
+	// The next track is started with the current speed too.
+	pAudioService->nextTrack();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS * 2));
+
+	PlaybackPosition nextPosition;
+	bool             bNextPositionValid = pAudioService->getPlaybackPosition(&nextPosition);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	remove(sTrack.c_str());
+
+
+	// Assert
+
+	REQUIRE(dSpeedChangeInUS < 5000.0);
+	REQUIRE(iAppliedEvents == 1);
+	REQUIRE(fAppliedSpeed == 2.0f);
+	REQUIRE(bPositionValid == true);
+	REQUIRE(std::abs(position.fRate - position.fSampleRate * 2.0f) < 1.0f);
+	REQUIRE(bNextPositionValid == true);
+	REQUIRE(std::abs(nextPosition.fRate - nextPosition.fSampleRate * 2.0f) < 1.0f);
+}
+
+TEST_CASE("AudioService: auto FX profile steps down when the DSP is overloaded.", "[ModelTests::AudioServiceTests::fxProfile]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	const std::vector<std::wstring> vPathsToTracks = {L"Flone - Magic Store (cut).mp3"};
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// DSP buffer of the profile that the system was started with.
+	const unsigned int vBufferLengths[] = FX_PROFILE_BUFFER_LENGTHS;
+	const int          vBufferCounts[]  = FX_PROFILE_BUFFER_COUNTS;
+
+	unsigned int iBufferLength = 0;
+	int          iBufferCount  = 0;
+	pAudioService->getFMODSystem()->getDSPBufferSize(&iBufferLength, &iBufferCount);
+
+
+	// Act
+
+	pAudioService->setVolume(0.0f); // don't need to hear music while testing
+	pAudioService->playTrack(0);
+	pAudioService->setPitch(1.5f);
+
+	pAudioService->setFXProfile(FX_PROFILE_AUTO);
+
+	char cAutoStartProfile = pAudioService->getFXProfile();
+
+	// Every measurement is the overload now.
+	pAudioService->setFXOverloadDSPUsage(0.0f);
+
+	for (int i = 0; (i < 100) && (pAudioService->getFXProfile() != FX_PROFILE_LIVE); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+
+	char cSteppedDownProfile = pAudioService->getFXProfile();
+	bool bAutoAfterStepDown  = pAudioService->isFXProfileAuto();
+
+	std::vector<FXProfileStats> vStats;
+	for (char i = 0; i < FX_PROFILE_COUNT; i++) {
+		vStats.push_back(pAudioService->getFXProfileStats(i));
+	}
+
+	// Manual profile turns the auto mode off.
+	pAudioService->setFXProfile(FX_PROFILE_BALANCED);
+
+	char cManualProfile = pAudioService->getFXProfile();
+	bool bAutoManual    = pAudioService->isFXProfileAuto();
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+
+	// Assert
+
+	REQUIRE(iBufferLength == vBufferLengths[DEFAULT_FX_PROFILE]);
+	REQUIRE(iBufferCount  == vBufferCounts[DEFAULT_FX_PROFILE]);
+
+	REQUIRE(cAutoStartProfile   == FX_PROFILE_HI_QUALITY);
+	REQUIRE(cSteppedDownProfile == FX_PROFILE_LIVE);
+	REQUIRE(bAutoAfterStepDown  == true);
+
+	// Smaller FFT - less latency.
+	REQUIRE(vStats[FX_PROFILE_LIVE].fLatencyInMS > 0.0f);
+	REQUIRE(vStats[FX_PROFILE_LIVE].fLatencyInMS < vStats[FX_PROFILE_BALANCED].fLatencyInMS);
+	REQUIRE(vStats[FX_PROFILE_BALANCED].fLatencyInMS < vStats[FX_PROFILE_HI_QUALITY].fLatencyInMS);
+
+	// Both profiles were measured before the step down.
+	REQUIRE(vStats[FX_PROFILE_HI_QUALITY].bMeasured == true);
+	REQUIRE(vStats[FX_PROFILE_BALANCED].bMeasured   == true);
+	REQUIRE(vStats[FX_PROFILE_HI_QUALITY].fDSPUsage >= 0.0f);
+
+	REQUIRE(cManualProfile == FX_PROFILE_BALANCED);
+	REQUIRE(bAutoManual    == false);
+}
+
+TEST_CASE("AudioService: FX are added to the master chain when turned on and released after they are idle.", "[ModelTests::AudioServiceTests::lazyFX]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow, OUTPUT_MODE_NOSOUND_NRT, "");
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	FMOD::ChannelGroup* pMaster = nullptr;
+	pAudioService->getFMODSystem()->getMasterChannelGroup(&pMaster);
+
+	int iDefaultDSPCount = 0;
+	pMaster->getNumDSPs(&iDefaultDSPCount);
+
+	int iDefaultMemory = 0;
+	FMOD::Memory_GetStats(&iDefaultMemory, nullptr);
+
+
+	// Act
+
+	pAudioService->setPitch(1.5f);
+	pAudioService->setSpeedByTime(1.5f);
+	pAudioService->setReverbVolume(-10.0f);
+	pAudioService->setEchoVolume(-10.0f);
+	pAudioService->advanceTime(100);
+
+	int iOnDSPCount = 0;
+	pMaster->getNumDSPs(&iOnDSPCount);
+
+	int iOnMemory = 0;
+	FMOD::Memory_GetStats(&iOnMemory, nullptr);
+
+	// Head (output) to tail: analyzer, pitch, time stretch, fader, reverb, echo, equalizer.
+	std::vector<int> vIndices;
+	for (int i = 0; i < iOnDSPCount; i++) {
+		FMOD::DSP* pDSP = nullptr;
+		pMaster->getDSP(i, &pDSP);
+
+		FMOD_DSP_TYPE type = FMOD_DSP_TYPE_UNKNOWN;
+		pDSP->getType(&type);
+
+		if ( (type == FMOD_DSP_TYPE_PITCHSHIFT) || (type == FMOD_DSP_TYPE_FADER) || (type == FMOD_DSP_TYPE_SFXREVERB) || (type == FMOD_DSP_TYPE_ECHO) ) {
+			vIndices.push_back(static_cast<int>(type));
+		}
+	}
+
+	// Turned off but not released yet.
+	pAudioService->setPitch(1.0f);
+	pAudioService->setSpeedByTime(1.0f);
+	pAudioService->setReverbVolume(-80.0f);
+	pAudioService->setEchoVolume(-80.0f);
+	pAudioService->advanceTime(100);
+
+	int iBypassedDSPCount = 0;
+	pMaster->getNumDSPs(&iBypassedDSPCount);
+
+	pAudioService->advanceTime(LAZY_FX_RELEASE_AFTER_MS + 500);
+
+	int iReleasedDSPCount = 0;
+	pMaster->getNumDSPs(&iReleasedDSPCount);
+
+	int iReleasedMemory = 0;
+	FMOD::Memory_GetStats(&iReleasedMemory, nullptr);
+
+	// Created again.
+	pAudioService->setEchoVolume(-10.0f);
+
+	int iEchoAgainDSPCount = 0;
+	pMaster->getNumDSPs(&iEchoAgainDSPCount);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+
+	// Assert
+
+	REQUIRE(iOnDSPCount == iDefaultDSPCount + LAZY_FX_COUNT);
+	REQUIRE(vIndices == std::vector<int>{FMOD_DSP_TYPE_PITCHSHIFT, FMOD_DSP_TYPE_FADER, FMOD_DSP_TYPE_SFXREVERB, FMOD_DSP_TYPE_ECHO});
+	REQUIRE(iBypassedDSPCount == iOnDSPCount);
+	REQUIRE(iReleasedDSPCount == iDefaultDSPCount);
+	// The echo alone keeps 1000 ms of the delay line.
+	REQUIRE(iOnMemory - iReleasedMemory > 100 * 1024);
+	REQUIRE(iEchoAgainDSPCount == iDefaultDSPCount + 1);
+}
+
+TEST_CASE("AudioService: seek table of the VBR MP3 is built, cached and reused.", "[ModelTests::AudioServiceTests::seekTable]") {
+	// Arrange
+
+	// VBR MP3 without the Xing header (FMOD can't seek in it without FMOD_ACCURATETIME and only the VBR flag is cached):
+	// quiet (sine, 0.02) for the first 3 seconds and loud (sine, 0.5 + noise) after that.
+	// Copy of the fixture has the new modification time, so the old cache (if any) is not valid for it.
+	const std::string  sTrack      = "seek_table_test.mp3";
+	const std::wstring sTrackPath  = std::wstring(sTrack.begin(), sTrack.end());
+
+	{
+		std::ifstream fixtureFile("Tone VBR (6 s).mp3", std::ios::binary);
+		std::ofstream trackFile(sTrack, std::ios::binary);
+
+		trackFile << fixtureFile.rdbuf();
+	}
+
+	std::wstring sCacheFilePath = CacheFolder::getCacheFilePath(sTrackPath, SEEK_TABLE_CACHE_FOLDER, SEEK_TABLE_CACHE_EXTENSION);
+	std::string  sCacheFile     = std::string(sCacheFilePath.begin(), sCacheFilePath.end());
+
+	remove(sCacheFile.c_str());
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if ( (pAudioService->isFMODStarted() != true) || sCacheFilePath.empty() ) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		remove(sTrack.c_str());
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Capture the signal before the master volume (master is muted so we don't hear it).
+
+	FMOD::System* pSystem = pAudioService->getFMODSystem();
+
+	int iOutputRate = 0;
+	pSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr);
+
+	vCapturedSamples.assign(static_cast<size_t>(iOutputRate), 0.0f);
+	iCapturedSamplesCount = vCapturedSamples.size();
+
+	FMOD_DSP_DESCRIPTION captureDesc;
+	memset(&captureDesc, 0, sizeof(captureDesc));
+	captureDesc.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+	strncpy(captureDesc.name, "Capture", sizeof(captureDesc.name) - 1);
+	captureDesc.numinputbuffers  = 1;
+	captureDesc.numoutputbuffers = 1;
+	captureDesc.read             = captureDSPRead;
+
+	FMOD::DSP*          pCaptureDSP = nullptr;
+	FMOD::ChannelGroup* pMaster     = nullptr;
+
+	pSystem->createDSP(&captureDesc, &pCaptureDSP);
+	pSystem->getMasterChannelGroup(&pMaster);
+	pMaster->addDSP(FMOD_CHANNELCONTROL_DSP_TAIL, pCaptureDSP);
+	pMaster->setVolume(0.0f);
+
+
+	// Act
+
+	pAudioService->addTracks({sTrackPath});
+	pAudioService->setVolume(1.0f);
+	pAudioService->playTrack(0);
+
+	bool bLoadedFromCache = true;
+	bool bBuilt           = false;
+
+	for (int i = 0; (i < 100) && (bBuilt == false); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		bBuilt = pAudioService->isSeekTableBuilt(0, &bLoadedFromCache);
+	}
+
+	bool bCacheWritten = std::ifstream(sCacheFile, std::ios::binary).is_open();
+
+	// The playing VBR track gets the sound opened with FMOD_ACCURATETIME.
+	bool bAccurateSoundReady = false;
+
+	for (int i = 0; (i < 100) && (bAccurateSoundReady == false); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		bAccurateSoundReady = pAudioService->isAccurateSoundReady(0);
+	}
+
+	// The playing channel keeps its sound, the track gets the accurate sound when it's started again.
+	// The loud part starts 100 ms after the seek
+	// (plus the decoder and the encoder delay - 1105 samples, this file has no LAME header to skip them).
+	pAudioService->stopTrack();
+	pAudioService->playTrack(0);
+
+	Track* pCurrentTrack = pAudioService->getCurrentTrack();
+
+	float fOnsetInMS = (pCurrentTrack != nullptr) ? getLoudOnsetAfterSeek(pCurrentTrack, 2900, iOutputRate) : -1.0f;
+
+	pAudioService->stopTrack();
+
+	pMaster->removeDSP(pCaptureDSP);
+	pCaptureDSP->release();
+	pMaster->setVolume(1.0f);
+
+	delete pAudioService;
+	delete pMainWindow;
+
+
+	// Next import of the same file.
+	pMainWindow   = new MainWindow();
+	pAudioService = new AudioService(pMainWindow);
+
+	pAudioService->addTracks({sTrackPath});
+
+	bool bLoadedFromCacheAgain = false;
+	bool bBuiltAgain           = false;
+
+	for (int i = 0; (i < 100) && (bBuiltAgain == false); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		bBuiltAgain = pAudioService->isSeekTableBuilt(0, &bLoadedFromCacheAgain);
+	}
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	remove(sTrack.c_str());
+	remove(sCacheFile.c_str());
+
+
+	// Assert
+
+	REQUIRE(bBuilt);
+	REQUIRE(bLoadedFromCache == false);
+	REQUIRE(bCacheWritten);
+	REQUIRE(bAccurateSoundReady);
+	REQUIRE(fOnsetInMS >= 100.0f);
+	REQUIRE(fOnsetInMS <= 150.0f);
+	REQUIRE(bBuiltAgain);
+	REQUIRE(bLoadedFromCacheAgain);
+}
+
+TEST_CASE("AudioService: next track starts right after the last sample of the current track.", "[ModelTests::AudioServiceTests::gapless]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	FMOD::System* pSystem = pAudioService->getFMODSystem();
+
+	int iOutputRate = 0;
+	pSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr);
+
+	// Two tracks with constant signal (at the output rate so there is no resampling),
+	// any silence in the output is a gap between the tracks.
+
+	const int   iTrackLengthInSamples = iOutputRate * 2;
+	const std::string sTrack1 = "gapless_test_1.wav";
+	const std::string sTrack2 = "gapless_test_2.wav";
+
+	if ( (writeConstantWav(sTrack1, iOutputRate, iTrackLengthInSamples, 16384) == false)
+	     || (writeConstantWav(sTrack2, iOutputRate, iTrackLengthInSamples, 16384) == false) ) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	const std::vector<std::wstring> vPathsToTracks = {L"gapless_test_1.wav", L"gapless_test_2.wav"};
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// Capture the signal before the master volume (master is muted so we don't hear it).
+
+	vCapturedSamples.assign(static_cast<size_t>(iOutputRate) * 10, 0.0f);
+	iCapturedSamplesCount = 0;
+
+	FMOD_DSP_DESCRIPTION captureDesc;
+	memset(&captureDesc, 0, sizeof(captureDesc));
+	captureDesc.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+	strncpy(captureDesc.name, "Capture", sizeof(captureDesc.name) - 1);
+	captureDesc.numinputbuffers  = 1;
+	captureDesc.numoutputbuffers = 1;
+	captureDesc.read             = captureDSPRead;
+
+	FMOD::DSP*          pCaptureDSP = nullptr;
+	FMOD::ChannelGroup* pMaster     = nullptr;
+
+	pSystem->createDSP(&captureDesc, &pCaptureDSP);
+	pSystem->getMasterChannelGroup(&pMaster);
+	pMaster->addDSP(FMOD_CHANNELCONTROL_DSP_TAIL, pCaptureDSP);
+	pMaster->setVolume(0.0f);
+
+
+	// Act
+
+	pAudioService->setVolume(1.0f);
+	pAudioService->playTrack(0);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(3500));
+
+	pAudioService->stopTrack();
+
+	size_t iCaptured = iCapturedSamplesCount;
+
+	// Look at the join: from the first sample of the first track to the middle of the second one.
+
+	size_t iFirstSample = 0;
+	while ( (iFirstSample < iCaptured) && (std::fabs(vCapturedSamples[iFirstSample]) < 0.1f) ) {
+		iFirstSample++;
+	}
+
+	size_t iLastSample = iFirstSample + static_cast<size_t>(iTrackLengthInSamples) + static_cast<size_t>(iOutputRate / 2);
+
+	bool bCapturedEnough = (iLastSample <= iCaptured);
+
+	size_t iSilentSamples = 0;
+	for (size_t i = iFirstSample; (i < iLastSample) && (i < iCaptured); i++) {
+		if (std::fabs(vCapturedSamples[i]) < 0.1f) {
+			iSilentSamples++;
+		}
+	}
+
+
+	// Assert
+
+	REQUIRE(bCapturedEnough == true);
+	REQUIRE(iSilentSamples == 0);
+
+
+	// Cleanup
+
+	pMaster->removeDSP(pCaptureDSP);
+	pCaptureDSP->release();
+	pMaster->setVolume(1.0f);
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	remove(sTrack1.c_str());
+	remove(sTrack2.c_str());
+}
+
+TEST_CASE("AudioService: crossfade overlaps the end of the current track with the start of the next one.", "[ModelTests::AudioServiceTests::crossfade]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	FMOD::System* pSystem = pAudioService->getFMODSystem();
+
+	int iOutputRate = 0;
+	pSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr);
+
+	// Two tracks with different constant signals (the second one is 2 times quieter),
+	// linear crossfade will make a line from the first level to the second one in the output.
+	// The second track is longer so its own crossfade (to the first track) starts after we stop.
+
+	const int   iTrackLengthInSamples = iOutputRate * 2;
+	const int   iCrossfadeInMS        = 1000;
+	const std::string sTrack1 = "crossfade_test_1.wav";
+	const std::string sTrack2 = "crossfade_test_2.wav";
+
+	if ( (writeConstantWav(sTrack1, iOutputRate, iTrackLengthInSamples, 16384) == false)
+	     || (writeConstantWav(sTrack2, iOutputRate, iTrackLengthInSamples * 2, 8192) == false) ) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	const std::vector<std::wstring> vPathsToTracks = {L"crossfade_test_1.wav", L"crossfade_test_2.wav"};
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// Capture the signal before the master volume (master is muted so we don't hear it).
+
+	vCapturedSamples.assign(static_cast<size_t>(iOutputRate) * 10, 0.0f);
+	iCapturedSamplesCount = 0;
+
+	FMOD_DSP_DESCRIPTION captureDesc;
+	memset(&captureDesc, 0, sizeof(captureDesc));
+	captureDesc.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+	strncpy(captureDesc.name, "Capture", sizeof(captureDesc.name) - 1);
+	captureDesc.numinputbuffers  = 1;
+	captureDesc.numoutputbuffers = 1;
+	captureDesc.read             = captureDSPRead;
+
+	FMOD::DSP*          pCaptureDSP = nullptr;
+	FMOD::ChannelGroup* pMaster     = nullptr;
+
+	pSystem->createDSP(&captureDesc, &pCaptureDSP);
+	pSystem->getMasterChannelGroup(&pMaster);
+	pMaster->addDSP(FMOD_CHANNELCONTROL_DSP_TAIL, pCaptureDSP);
+	pMaster->setVolume(0.0f);
+
+
+	// Act
+
+	pAudioService->setCrossfade(iCrossfadeInMS, CROSSFADE_CURVE_LINEAR);
+	pAudioService->setVolume(1.0f);
+	pAudioService->playTrack(0);
+
+	// The speed slider is moved while the crossfade is running, this should not cancel the crossfade.
+	std::this_thread::sleep_for(std::chrono::milliseconds(1250));
+	pAudioService->setSpeedByPitch(1.0f);
+	std::this_thread::sleep_for(std::chrono::milliseconds(1750));
+
+	pAudioService->stopTrack();
+
+	size_t iCaptured = iCapturedSamplesCount;
+
+	size_t iFirstSample = 0;
+	while ( (iFirstSample < iCaptured) && (std::fabs(vCapturedSamples[iFirstSample]) < 0.1f) ) {
+		iFirstSample++;
+	}
+
+	// Crossfade: [track length - crossfade, track length].
+	size_t iCrossfadeStart  = iFirstSample + static_cast<size_t>(iTrackLengthInSamples - iOutputRate * iCrossfadeInMS / 1000);
+	size_t iCrossfadeMiddle = iCrossfadeStart + static_cast<size_t>(iOutputRate * iCrossfadeInMS / 2000);
+	size_t iSecondTrackOnly = iFirstSample + static_cast<size_t>(iTrackLengthInSamples + iOutputRate / 4);
+
+	bool bCapturedEnough = (iSecondTrackOnly < iCaptured);
+
+	float fFirstLevel  = 0.0f;
+	float fSecondLevel = 0.0f;
+	float fMiddleLevel = 0.0f;
+
+	size_t iBadSamples = 0;
+
+	if (bCapturedEnough) {
+		fFirstLevel  = vCapturedSamples[iCrossfadeStart - static_cast<size_t>(iOutputRate / 10)];
+		fSecondLevel = vCapturedSamples[iSecondTrackOnly];
+		fMiddleLevel = vCapturedSamples[iCrossfadeMiddle];
+
+		// Skip the volume ramp at the start of the first track.
+		for (size_t i = iFirstSample + static_cast<size_t>(iOutputRate / 10); i < iSecondTrackOnly; i++) {
+			// No gaps and no dips (the end of the track is known with the accuracy of one mix block
+			// so the fade may end a bit later than the first track, this is about 2% of the second level).
+			if ( (vCapturedSamples[i] < fSecondLevel * 0.97f) || (vCapturedSamples[i] > fFirstLevel * 1.01f) ) {
+				iBadSamples++;
+			}
+		}
+	}
+
+
+	// Assert
+
+	REQUIRE(bCapturedEnough == true);
+	REQUIRE(iBadSamples == 0);
+	REQUIRE(std::fabs(fSecondLevel - fFirstLevel / 2) < 0.01f);
+	REQUIRE(std::fabs(fMiddleLevel - (fFirstLevel + fSecondLevel) / 2) < 0.01f);
+
+
+	// Cleanup
+
+	pMaster->removeDSP(pCaptureDSP);
+	pCaptureDSP->release();
+	pMaster->setVolume(1.0f);
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	remove(sTrack1.c_str());
+	remove(sTrack2.c_str());
+}
+
+TEST_CASE("AudioService: repeat section is looped by the mixer on the exact sample.", "[ModelTests::AudioServiceTests::repeatSection]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	FMOD::System* pSystem = pAudioService->getFMODSystem();
+
+	int iOutputRate = 0;
+	pSystem->getSoftwareFormat(&iOutputRate, nullptr, nullptr);
+
+	// Ramp: each sample tells its position in the track.
+	// Loop [1000 ms, 1500 ms) means that after the sample 'B - 1' we should hear the sample 'A'.
+
+	const int   iTrackLengthInSamples = iOutputRate * 4;
+	const int   iLoopStart            = iOutputRate;
+	const int   iLoopEnd              = iOutputRate * 3 / 2;
+	const short iRampDivider          = 8;
+	const std::string sTrack = "repeat_section_test.wav";
+
+	std::vector<short> vRamp(static_cast<size_t>(iTrackLengthInSamples));
+	for (size_t i = 0; i < vRamp.size(); i++) {
+		vRamp[i] = static_cast<short>(i / iRampDivider);
+	}
+
+	if (writeWav(sTrack, iOutputRate, vRamp) == false) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	const std::vector<std::wstring> vPathsToTracks = {L"repeat_section_test.wav"};
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// Capture the signal before the master volume (master is muted so we don't hear it).
+
+	vCapturedSamples.assign(static_cast<size_t>(iOutputRate) * 10, 0.0f);
+	iCapturedSamplesCount = 0;
+
+	FMOD_DSP_DESCRIPTION captureDesc;
+	memset(&captureDesc, 0, sizeof(captureDesc));
+	captureDesc.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+	strncpy(captureDesc.name, "Capture", sizeof(captureDesc.name) - 1);
+	captureDesc.numinputbuffers  = 1;
+	captureDesc.numoutputbuffers = 1;
+	captureDesc.read             = captureDSPRead;
+
+	FMOD::DSP*          pCaptureDSP = nullptr;
+	FMOD::ChannelGroup* pMaster     = nullptr;
+
+	pSystem->createDSP(&captureDesc, &pCaptureDSP);
+	pSystem->getMasterChannelGroup(&pMaster);
+	pMaster->addDSP(FMOD_CHANNELCONTROL_DSP_TAIL, pCaptureDSP);
+	pMaster->setVolume(0.0f);
+
+
+	// Act
+
+	pAudioService->setVolume(1.0f);
+	pAudioService->playTrack(0);
+
+	bool bLoopSet = pAudioService->getCurrentTrack()->setLoopSection(1000, 1500);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(3000));
+
+	pAudioService->stopTrack();
+
+	size_t iCaptured = iCapturedSamplesCount;
+
+	// Find all jumps back (but not the silence after the stop).
+	std::vector<size_t> vJumps;
+	for (size_t i = 1; i < iCaptured; i++) {
+		if ( (vCapturedSamples[i] < vCapturedSamples[i - 1]) && (vCapturedSamples[i] > 0.0f) ) {
+			vJumps.push_back(i);
+		}
+	}
+
+	const float fSampleToFloat = 1.0f / 32768;
+
+	size_t iBadJumps = 0;
+	for (size_t i = 0; i < vJumps.size(); i++) {
+		float fBefore = vCapturedSamples[vJumps[i] - 1];
+		float fAfter  = vCapturedSamples[vJumps[i]];
+
+		if ( (std::fabs(fBefore - static_cast<float>((iLoopEnd - 1) / iRampDivider) * fSampleToFloat) > fSampleToFloat / 2)
+		     || (std::fabs(fAfter - static_cast<float>(iLoopStart / iRampDivider) * fSampleToFloat) > fSampleToFloat / 2) ) {
+			iBadJumps++;
+		}
+
+		if ( (i > 0) && (vJumps[i] - vJumps[i - 1] != static_cast<size_t>(iLoopEnd - iLoopStart)) ) {
+			iBadJumps++;
+		}
+	}
+
+
+	// Assert
+
+	REQUIRE(bLoopSet == true);
+	REQUIRE(vJumps.size() >= 2);
+	REQUIRE(iBadJumps == 0);
+
+
+	// Cleanup
+
+	pMaster->removeDSP(pCaptureDSP);
+	pCaptureDSP->release();
+	pMaster->setVolume(1.0f);
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	remove(sTrack.c_str());
+}
+
+TEST_CASE("AudioService: next track is preloaded in memory and its start is counted as a hit.", "[ModelTests::AudioServiceTests::preload]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// Setup path to track
+
+	const std::wstring sTrackName = L"Flone - Magic Store (cut).mp3";
+
+	const std::vector<std::wstring> vPathsToTracks = {sTrackName, sTrackName};
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Act
+
+	pAudioService->setVolume(0.0f); // don't need to hear music while testing
+	pAudioService->playTrack(0);
+
+	// Wait for the first audio and for the preload of the next track.
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS * 2));
+
+	pAudioService->nextTrack();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS));
+
+	Track* pCurrentTrack = pAudioService->getCurrentTrack();
+	bool   bPreloaded    = (pCurrentTrack != nullptr) && pCurrentTrack->isPreloaded();
+
+	PreloadStats stats = pAudioService->getPreloadStats();
+
+
+	// Assert
+
+	REQUIRE(bPreloaded == true);
+	REQUIRE(stats.iMisses == 1);
+	REQUIRE(stats.iHits == 1);
+	REQUIRE(stats.dAverageHitLatencyInMS > 0.0);
+	REQUIRE(stats.iUsedBytes > 0);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+}
+
+TEST_CASE("AudioService: commands from many threads are executed in order by the audio-control thread.", "[ModelTests::AudioServiceTests::enqueueCommand]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	const size_t iProducers           = 4;
+	const size_t iCommandsPerProducer = 1000;
+
+	// Written only by the commands (in the audio-control thread).
+	std::vector<size_t>    vLastValue(iProducers, 0);
+	size_t                 iOutOfOrder = 0;
+	std::thread::id        controlThreadId;
+	size_t                 iOtherThreads = 0;
+
+
+	// Act
+
+	std::vector<std::thread> vProducers;
+
+	for (size_t iProducer = 0; iProducer < iProducers; iProducer++) {
+		vProducers.push_back(std::thread([&, iProducer]() {
+			for (size_t i = 1; i <= iCommandsPerProducer; i++) {
+				pAudioService->enqueueCommand([&, iProducer, i]() {
+					if (controlThreadId == std::thread::id()) {
+						controlThreadId = std::this_thread::get_id();
+					}
+					else if (controlThreadId != std::this_thread::get_id()) {
+						iOtherThreads++;
+					}
+
+					if (vLastValue[iProducer] + 1 != i) {
+						iOutOfOrder++;
+					}
+
+					vLastValue[iProducer] = i;
+				});
+			}
+		}));
+	}
+
+	for (size_t i = 0; i < vProducers.size(); i++) {
+		vProducers[i].join();
+	}
+
+	CommandQueueStats stats = pAudioService->getCommandQueueStats();
+
+	for (int i = 0; (i < 100) && (stats.iExecutedCommands < iProducers * iCommandsPerProducer); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+		stats = pAudioService->getCommandQueueStats();
+	}
+
+
+	// Assert
+
+	REQUIRE(stats.iExecutedCommands == iProducers * iCommandsPerProducer);
+	REQUIRE(iOutOfOrder == 0);
+	REQUIRE(iOtherThreads == 0);
+	REQUIRE(controlThreadId != std::this_thread::get_id());
+	REQUIRE(stats.dMaxLatencyInMS >= stats.dAverageLatencyInMS);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+}
+
+TEST_CASE("AudioService: published playback position is extrapolated to the actual position.", "[ModelTests::AudioServiceTests::playbackPosition]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// Setup path to track
+
+	const std::vector<std::wstring> vPathsToTracks = {L"Flone - Magic Store (cut).mp3"};
+
+	pAudioService->addTracks(vPathsToTracks);
+
+	if (pAudioService->getTracksCount() != vPathsToTracks.size()) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Act
+
+	pAudioService->setVolume(0.0f); // don't need to hear music while testing
+	pAudioService->playTrack(0);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS * 2));
+
+	PlaybackPosition playing;
+	bool             bPlayingValid = pAudioService->getPlaybackPosition(&playing);
+
+	// The GUI extrapolates the position between the wake-ups of the audio-control thread.
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS / 2));
+
+	unsigned int iExtrapolatedInPCM = PositionSnapshot::extrapolate(playing, PositionSnapshot::getTimeInNS());
+	unsigned int iActualInMS        = pAudioService->getCurrentTrack()->getPositionInMS();
+	double       dErrorInMS         = std::abs(iExtrapolatedInPCM / static_cast<double>(playing.fSampleRate) * 1000.0 - iActualInMS);
+
+	pAudioService->pauseTrack();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_TRACK_INTERVAL_MS));
+
+	PlaybackPosition paused;
+	bool             bPausedValid = pAudioService->getPlaybackPosition(&paused);
+
+	pAudioService->clearPlaylist();
+
+	PlaybackPosition cleared;
+	bool             bClearedValid = pAudioService->getPlaybackPosition(&cleared);
+
+
+	// Assert
+
+	REQUIRE(bPlayingValid == true);
+	REQUIRE(playing.fRate > 0.0f);
+	REQUIRE(playing.iLengthInPCM > 0);
+	REQUIRE(dErrorInMS < MAX_TIME_ERROR_MS);
+
+	REQUIRE(bPausedValid == true);
+	REQUIRE(paused.fRate == 0.0f);
+	REQUIRE(PositionSnapshot::extrapolate(paused, PositionSnapshot::getTimeInNS()) == paused.iPositionInPCM);
+
+	REQUIRE(bClearedValid == false);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+}
+
 TEST_CASE("AudioService: 'clear playlist' is working without errors.", "[ModelTests::AudioServiceTests::clearPlaylist]") {
 	// Arrange
 
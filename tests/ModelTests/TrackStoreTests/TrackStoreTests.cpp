@@ -0,0 +1,115 @@
+﻿// This file is part of the Bloody Player.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "../ext/Catch2/catch.hpp"
+
+#include "Model/TrackStore/trackstore.h"
+
+#include <vector>
+#include <cstddef>
+
+
+
+TEST_CASE("TrackStore keeps the indices and the handles of 100 000 tracks right after removals.", "[ModelTests::TrackStoreTests::remove]") {
+	// Arrange
+
+	// Tracks are not dereferenced by the TrackStore so we use addresses of chars.
+	const size_t iTrackCount    = 100000;
+	const size_t iRemoveCount   = 1000;
+
+	std::vector<char>         vDummyTracks(iTrackCount + 1);
+	std::vector<Track*>       vExpectedOrder;
+	std::vector<TrackHandle>  vRemovedHandles;
+
+	TrackStore tracks;
+
+	for (size_t i = 0; i < iTrackCount; i++) {
+		Track* pTrack = reinterpret_cast<Track*>(&vDummyTracks[i]);
+
+		tracks.add(pTrack);
+		vExpectedOrder.push_back(pTrack);
+	}
+
+
+	// Act
+
+	// Removes the first, the last, the middle and other tracks of the tracklist
+	// (the first and the last ones are moved to the other end from time to time).
+	size_t iRandom           = 1;
+	bool   bRemovedTrackOk   = true;
+
+	for (size_t i = 0; i < iRemoveCount; i++) {
+		size_t iIndex = 0;
+
+		switch (i % 4) {
+		case 0: iIndex = 0; break;
+		case 1: iIndex = tracks.size() - 1; break;
+		case 2: iIndex = tracks.size() / 2; break;
+		default: {
+			iRandom = (iRandom * 1103515245 + 12345) % 2147483648;
+			iIndex  = iRandom % tracks.size();
+		}
+		}
+
+		if (i % 10 == 0) {
+			tracks.moveUp(0);
+			vExpectedOrder.push_back(vExpectedOrder.front());
+			vExpectedOrder.erase(vExpectedOrder.begin());
+
+			tracks.moveDown(tracks.size() - 1);
+			vExpectedOrder.insert(vExpectedOrder.begin(), vExpectedOrder.back());
+			vExpectedOrder.pop_back();
+
+			tracks.moveDown(tracks.size() - 1);
+			vExpectedOrder.insert(vExpectedOrder.begin(), vExpectedOrder.back());
+			vExpectedOrder.pop_back();
+		}
+
+		vRemovedHandles.push_back(tracks.getHandle(iIndex));
+
+		if (tracks.remove(iIndex) != vExpectedOrder[iIndex]) {
+			bRemovedTrackOk = false;
+		}
+
+		vExpectedOrder.erase(vExpectedOrder.begin() + static_cast<long long>(iIndex));
+	}
+
+	// The slot of a removed track is reused.
+	Track*      pNewTrack  = reinterpret_cast<Track*>(&vDummyTracks[iTrackCount]);
+	TrackHandle newTrack   = tracks.add(pNewTrack);
+	vExpectedOrder.push_back(pNewTrack);
+
+
+	// Assert
+
+	REQUIRE(bRemovedTrackOk == true);
+	REQUIRE(tracks.size() == iTrackCount - iRemoveCount + 1);
+	REQUIRE(tracks.get(newTrack) == pNewTrack);
+
+	bool bOrderOk = true;
+
+	for (size_t i = 0; i < tracks.size(); i++) {
+		size_t iIndex = 0;
+
+		if ( (tracks.getTrack(i) != vExpectedOrder[i])
+		     || (tracks.getIndex(tracks.getHandle(i), &iIndex) == false) || (iIndex != i) ) {
+			bOrderOk = false;
+			break;
+		}
+	}
+
+	REQUIRE(bOrderOk == true);
+
+	bool bRemovedHandlesOk = true;
+
+	for (size_t i = 0; i < vRemovedHandles.size(); i++) {
+		if (tracks.get(vRemovedHandles[i]) != nullptr) {
+			bRemovedHandlesOk = false;
+			break;
+		}
+	}
+
+	REQUIRE(bRemovedHandlesOk == true);
+}
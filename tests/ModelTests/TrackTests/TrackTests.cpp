@@ -9,6 +9,113 @@
 #include "Model/AudioService/audioservice.h"
 #include "Model/Track/track.h"
 
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <iterator>
+
+
+
+static bool writeWavWithDataSize(const std::string& sPath, int iSampleRate, int iLengthInSamples, unsigned int iDataChunkSize) {
+	// Stereo 16 bit PCM (silence), 'iDataChunkSize' is written to the "data" chunk header as is
+	// (streaming software writes 0xFFFFFFFF there).
+
+	std::ofstream wavFile(sPath, std::ios::binary);
+
+	if (wavFile.is_open() == false) {
+		return false;
+	}
+
+	unsigned int   iDataSize     = static_cast<unsigned int>(iLengthInSamples) * 4;
+	unsigned int   iRiffSize     = 36 + iDataSize;
+	unsigned int   iFmtSize      = 16;
+	unsigned short iFormat       = 1;
+	unsigned short iChannels     = 2;
+	unsigned int   iRate         = static_cast<unsigned int>(iSampleRate);
+	unsigned int   iByteRate     = iRate * 4;
+	unsigned short iBlockAlign   = 4;
+	unsigned short iBits         = 16;
+
+	wavFile.write("RIFF", 4);
+	wavFile.write(reinterpret_cast<char*>(&iRiffSize),      4);
+	wavFile.write("WAVEfmt ", 8);
+	wavFile.write(reinterpret_cast<char*>(&iFmtSize),       4);
+	wavFile.write(reinterpret_cast<char*>(&iFormat),        2);
+	wavFile.write(reinterpret_cast<char*>(&iChannels),      2);
+	wavFile.write(reinterpret_cast<char*>(&iRate),          4);
+	wavFile.write(reinterpret_cast<char*>(&iByteRate),      4);
+	wavFile.write(reinterpret_cast<char*>(&iBlockAlign),    2);
+	wavFile.write(reinterpret_cast<char*>(&iBits),          2);
+	wavFile.write("data", 4);
+	wavFile.write(reinterpret_cast<char*>(&iDataChunkSize), 4);
+
+	std::vector<char> vSamples(iDataSize, 0);
+	wavFile.write(vSamples.data(), iDataSize);
+
+	return wavFile.good();
+}
+
+static bool copyOggWithoutNominalBitrate(const std::string& sFromPath, const std::string& sToPath) {
+	// Sets the nominal bitrate in the Vorbis identification header to 0 (as some encoders do)
+	// and updates the CRC of the first Ogg page.
+
+	std::ifstream inFile(sFromPath, std::ios::binary);
+	std::vector<unsigned char> vData((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+
+	if (vData.size() < 28) {
+		return false;
+	}
+
+	size_t iPageSize = 27 + vData[26];
+	for (size_t i = 0; i < vData[26]; i++) {
+		iPageSize += vData[27 + i];
+	}
+
+	size_t iPacket = 27 + static_cast<size_t>(vData[26]);
+
+	if ( (iPageSize > vData.size()) || (iPacket + 24 > iPageSize) ) {
+		return false;
+	}
+
+	memset(vData.data() + iPacket + 20, 0, 4);
+
+	// Ogg CRC: polynomial 0x04C11DB7, no reflection, initial value 0, CRC field is 0 while calculating.
+	memset(vData.data() + 22, 0, 4);
+
+	unsigned int iCRC = 0;
+	for (size_t i = 0; i < iPageSize; i++) {
+		iCRC ^= static_cast<unsigned int>(vData[i]) << 24;
+
+		for (int iBit = 0; iBit < 8; iBit++) {
+			iCRC = (iCRC & 0x80000000u) ? ((iCRC << 1) ^ 0x04C11DB7u) : (iCRC << 1);
+		}
+	}
+
+	for (size_t i = 0; i < 4; i++) {
+		vData[22 + i] = static_cast<unsigned char>(iCRC >> (8 * i));
+	}
+
+	std::ofstream outFile(sToPath, std::ios::binary);
+	outFile.write(reinterpret_cast<char*>(vData.data()), static_cast<std::streamsize>(vData.size()));
+
+	return outFile.good();
+}
+
+static bool getTrackBitrate(MainWindow* pMainWindow, AudioService* pAudioService, const std::wstring& sTrackPath, int* pBitrate) {
+	Track* pTrackObject = new Track(sTrackPath,
+	                                sTrackPath,
+	                                pMainWindow,
+	                                pAudioService->getFMODSystem());
+
+	bool bResult = pTrackObject->setupTrack() && pTrackObject->getBitRate(pBitrate);
+
+	delete pTrackObject; // delete track before audio service because track will call FMOD::releaseSound().
+
+	return bResult;
+}
+
 
 
 TEST_CASE("Track object is created without errors.", "[ModelTests::TrackTests::setupTrack]") {
@@ -401,6 +508,243 @@ TEST_CASE("Track object can be recreated without errors.", "[ModelTests::TrackTe
 	REQUIRE(bResult == true);
 
 
+	// Cleanup
+
+	delete pTrackObject; // delete track before audio service because track will call FMOD::releaseSound().
+	delete pAudioService;
+	delete pMainWindow;
+}
+
+
+TEST_CASE("Track's bitrate is calculated without errors.", "[ModelTests::TrackTests::getBitRate]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Setup path to track
+
+	const std::wstring sTrackPath = L"Flone - Magic Store (cut).mp3";
+	const std::wstring sTrackName = L"Flone - Magic Store (cut)";
+
+	// Create track
+
+	Track* pTrackObject = new Track(sTrackPath,
+	                                sTrackName,
+	                                pMainWindow,
+	                                pAudioService->getFMODSystem());
+
+	// Prepare for test (bitrate depends on the format)
+
+	if (pTrackObject->setupTrack() != true) {
+		delete pTrackObject;
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Act
+
+	int iBitrate = 0;
+	bool bResult = pTrackObject->getBitRate(&iBitrate);
+
+	// Assert
+
+	REQUIRE(bResult == true);
+	REQUIRE(iBitrate == 128);
+	REQUIRE(pTrackObject->isBitrateCalculated() == true);
+
+
+	// Cleanup
+
+	delete pTrackObject; // delete track before audio service because track will call FMOD::releaseSound().
+	delete pAudioService;
+	delete pMainWindow;
+}
+
+
+TEST_CASE("Track's bitrate of WAV tracks is calculated from the data chunk.", "[ModelTests::TrackTests::getWAVBitrate]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// 1 second of stereo 16 bit PCM at 44100 Hz - 1411.2 kbps.
+	const std::string sTrack        = "wav_bitrate_test.wav";
+	const std::string sUnknownSize  = "wav_bitrate_test_unknown_size.wav";
+	const int iSampleRate           = 44100;
+
+	if ( (writeWavWithDataSize(sTrack,       iSampleRate, iSampleRate, iSampleRate * 4) == false)
+	     || (writeWavWithDataSize(sUnknownSize, iSampleRate, iSampleRate, 0xFFFFFFFF) == false) ) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Act
+
+	int iBitrate             = 0;
+	int iUnknownSizeBitrate  = 0;
+
+	bool bResult             = getTrackBitrate(pMainWindow, pAudioService, std::wstring(sTrack.begin(), sTrack.end()), &iBitrate);
+	// FMOD takes the length from the chunk size too, so the bitrate comes from the "fmt " chunk.
+	bool bUnknownSizeResult  = getTrackBitrate(pMainWindow, pAudioService, std::wstring(sUnknownSize.begin(), sUnknownSize.end()), &iUnknownSizeBitrate);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	remove(sTrack.c_str());
+	remove(sUnknownSize.c_str());
+
+
+	// Assert
+
+	REQUIRE(bResult == true);
+	REQUIRE(iBitrate == 1411);
+	REQUIRE(bUnknownSizeResult == true);
+	REQUIRE(iUnknownSizeBitrate == 1411);
+}
+
+TEST_CASE("Track's bitrate of FLAC and OGG tracks is calculated from the headers.", "[ModelTests::TrackTests::getFLACOGGBitrate]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+	// Both files: 2 seconds of 440 Hz (left) and 660 Hz (right) sines, 44100 Hz.
+	// FLAC: 64152 bytes of audio frames after the metadata blocks - 256.6 kbps.
+	// OGG: nominal bitrate in the Vorbis header - 128000, file size - 11244 bytes (45 kbps).
+	const std::wstring sFLACPath       = L"Sine 440 Hz (2 s).flac";
+	const std::wstring sOGGPath        = L"Sine 440 Hz (2 s).ogg";
+	const std::string  sNoNominalPath  = "ogg_bitrate_test_no_nominal.ogg";
+
+	if (copyOggWithoutNominalBitrate("Sine 440 Hz (2 s).ogg", sNoNominalPath) == false) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Act
+
+	int iFLACBitrate       = 0;
+	int iOGGBitrate        = 0;
+	int iNoNominalBitrate  = 0;
+
+	bool bFLACResult       = getTrackBitrate(pMainWindow, pAudioService, sFLACPath, &iFLACBitrate);
+	bool bOGGResult        = getTrackBitrate(pMainWindow, pAudioService, sOGGPath, &iOGGBitrate);
+	// Calculated from the file size.
+	bool bNoNominalResult  = getTrackBitrate(pMainWindow, pAudioService, std::wstring(sNoNominalPath.begin(), sNoNominalPath.end()), &iNoNominalBitrate);
+
+
+	// Cleanup
+
+	delete pAudioService;
+	delete pMainWindow;
+
+	remove(sNoNominalPath.c_str());
+
+
+	// Assert
+
+	REQUIRE(bFLACResult == true);
+	REQUIRE(iFLACBitrate == 257);
+	REQUIRE(bOGGResult == true);
+	REQUIRE(iOGGBitrate == 128);
+	REQUIRE(bNoNominalResult == true);
+	REQUIRE(iNoNominalBitrate == 45);
+}
+
+
+TEST_CASE("Track's encoder delay and padding are read from the LAME header.", "[ModelTests::TrackTests::getGaplessInfo]") {
+	// Arrange
+
+	MainWindow*   pMainWindow = new MainWindow();
+	AudioService* pAudioService = new AudioService(pMainWindow);
+
+	// Check if the FMOD is even started
+	// (we have a test for this)
+	if (pAudioService->isFMODStarted() != true) {
+		delete pAudioService;
+		delete pMainWindow;
+
+		REQUIRE(false);
+		return;
+	}
+
+
+	// Setup path to track
+
+	// LAME 3.100: 1814 frames, encoder delay - 576, padding - 701.
+	const std::wstring sTrackPath = L"Flone - Magic Store (cut).mp3";
+	const std::wstring sTrackName = L"Flone - Magic Store (cut)";
+
+	// Create track
+
+	Track* pTrackObject = new Track(sTrackPath,
+	                                sTrackName,
+	                                pMainWindow,
+	                                pAudioService->getFMODSystem());
+
+
+	// Act
+
+	bool bResult = pTrackObject->setupTrack();
+
+	unsigned int iStartInPCM = 0;
+	unsigned int iEndInPCM   = 0;
+	bool bGaplessInfo = pTrackObject->getGaplessInfo(&iStartInPCM, &iEndInPCM);
+
+	// Assert
+
+	REQUIRE(bResult == true);
+	REQUIRE(bGaplessInfo == true);
+	REQUIRE(iStartInPCM == 576 + 529);
+	REQUIRE(iEndInPCM == 576 + 529 + 1814 * 1152 - 576 - 701);
+
+
 	// Cleanup
 
 	delete pTrackObject; // delete track before audio service because track will call FMOD::releaseSound().